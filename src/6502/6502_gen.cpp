@@ -699,6 +699,7 @@ public:
             } else {
                 this->GeneratePhi1(&this->cycles[(size_t)i]);
                 P("s->tfn=&T%d_%s;\n",i+1,this->stem.c_str());
+                P("SET_TSTATE(s,T%d_%s);\n",i+1,this->stem.c_str());
 
                 if(i==(int)this->cycles.size()-1) {
                     this->GenerateD1x1();
@@ -1317,7 +1318,85 @@ static std::vector<InstrGen> GetAll() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-static void GenerateConfig(std::set<std::string> *tfns,std::set<std::string> *ifuns,const std::string &stem,const std::map<uint8_t,Instr> &instrs0,const std::map<uint8_t,Instr> &instrs1) {
+// The switch-dispatched M6502_Step covers the generated tfns only. The
+// hand-written ones are still called via tfn.
+static std::vector<std::string> GetTStateFnNames(const std::vector<InstrGen> &gens) {
+    std::vector<std::string> fn_names;
+
+    for(const InstrGen &gen:gens) {
+        for(std::string &fn_name:gen.GetFnNames()) {
+            fn_names.push_back(std::move(fn_name));
+        }
+    }
+
+    return fn_names;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void GenerateTStateEnum(const std::vector<std::string> &tstate_fn_names) {
+    Sep();
+    Sep();
+    P("\n");
+
+    // T0_All is hand-written, but it's the first state of every
+    // instruction, so it gets a fixed value that 6502.c can use.
+    P("enum M6502TState {\n");
+    P("M6502TState_None=0,\n");
+    P("M6502TState_T0_All=TSTATE_T0_ALL,\n");
+    for(const std::string &fn_name:tstate_fn_names) {
+        P("M6502TState_%s,\n",fn_name.c_str());
+    }
+    P("M6502TState_Count,\n");
+    P("};\n");
+    P("\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Generates g_tstate_fns, mapping each M6502TState to its tfn, and
+// StepTState, calling a tstate's tfn directly, for M6502_Step to use.
+static void GenerateSwitchDispatch(const std::vector<std::string> &tstate_fn_names) {
+    Sep();
+    Sep();
+    P("\n");
+
+    P("#if M6502_SWITCH_DISPATCH\n");
+    P("\n");
+
+    P("static const M6502Fn g_tstate_fns[M6502TState_Count]={\n");
+    P("[M6502TState_T0_All]=&T0_All,\n");
+    for(const std::string &fn_name:tstate_fn_names) {
+        P("[M6502TState_%s]=&%s,\n",fn_name.c_str(),fn_name.c_str());
+    }
+    P("};\n");
+    P("\n");
+
+    P("static void StepTState(M6502 *s,unsigned tstate) {\n");
+    P("switch(tstate) {\n");
+    P("default:\n");
+    P("assert(0);\n");
+    P("break;\n");
+    for(const std::string &fn_name:tstate_fn_names) {
+        P("\n");
+        P("case M6502TState_%s:\n",fn_name.c_str());
+        P("%s(s);\n",fn_name.c_str());
+        P("break;\n");
+    }
+    P("}\n");
+    P("}\n");
+    P("\n");
+
+    P("#endif\n");
+    P("\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void GenerateConfig(std::set<std::string> *tfns,std::set<std::string> *ifuns,const std::set<std::string> &tstate_fn_names,const std::string &stem,const std::map<uint8_t,Instr> &instrs0,const std::map<uint8_t,Instr> &instrs1) {
     const Instr *instrs[256]={};
 
     for(auto &&it:instrs0) {
@@ -1352,6 +1431,12 @@ static void GenerateConfig(std::set<std::string> *tfns,std::set<std::string> *if
         } else {
             P("&%s",ifun.c_str());
         }
+        P(",");
+        if(tstate_fn_names.count(tfun)>0) {
+            P("M6502TState_%s",tfun.c_str());
+        } else {
+            P("M6502TState_None");
+        }
         P(",},\n");
 
         if(!ifun.empty()) {
@@ -1583,9 +1668,14 @@ int main(int argc,char *argv[]) {
 
     std::vector<InstrGen> gens=GetAll();
 
+    std::vector<std::string> tstate_fn_names=GetTStateFnNames(gens);
+    std::set<std::string> tstate_fn_names_set(tstate_fn_names.begin(),tstate_fn_names.end());
+
     P("// Automatically generated by 6502_gen.cpp\n");
     P("\n");
 
+    GenerateTStateEnum(tstate_fn_names);
+
     for(const InstrGen &gen:gens) {
         gen.GenerateC();
     }
@@ -1593,12 +1683,14 @@ int main(int argc,char *argv[]) {
     // tfuns, ifuns... really need to decide which it is!
     std::set<std::string> tfns,ifuns;
 
-    GenerateConfig(&tfns,&ifuns,"defined",GetDefinedInstructions(),GetUndefinedTrapInstructions());
-    GenerateConfig(&tfns,&ifuns,"nmos6502",GetDefinedInstructions(),GetUndefinedInstructions());
-    GenerateConfig(&tfns,&ifuns,"cmos6502",GetCMOSInstructions(),{});
+    GenerateConfig(&tfns,&ifuns,tstate_fn_names_set,"defined",GetDefinedInstructions(),GetUndefinedTrapInstructions());
+    GenerateConfig(&tfns,&ifuns,tstate_fn_names_set,"nmos6502",GetDefinedInstructions(),GetUndefinedInstructions());
+    GenerateConfig(&tfns,&ifuns,tstate_fn_names_set,"cmos6502",GetCMOSInstructions(),{});
 
     GenerateFnNameStuff(gens,tfns,extra_tfns,ifuns);
 
+    GenerateSwitchDispatch(tstate_fn_names);
+
     g_code_file_printer.SetFILE(nullptr);
 
     if(of) {
@@ -120,6 +120,12 @@
 // The IRQ-related T0 functions are an exception, and when performing
 // an interrupt, M6502_NextInstruction sets tfn to &T0_IRQ.
 //
+// When M6502_SWITCH_DISPATCH is set, M6502_Step dispatches the
+// generated states via a switch on tstate instead, which the generated
+// code keeps in sync with tfn. The hand-written states don't bother
+// with tstate, so when tstate and tfn disagree, M6502_Step just calls
+// tfn.
+//
 // ifn
 // ---
 //
@@ -212,6 +218,19 @@
 // - the Tn_ prefix bears no relation at all to the Tn state names in
 //   Visual6502. This is a bad naming convention and it needs to change
 
+// Value of M6502TState_T0_All, needed before 6502_internal.inl is
+// included.
+#define TSTATE_T0_ALL 1
+
+#if M6502_SWITCH_DISPATCH
+#define SET_TSTATE(S,X) ((S)->tstate=M6502TState_##X,(void)0)
+#else
+#define SET_TSTATE(S,X) ((void)0)
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if M6502_DBUS_OFFSET
 
 #define SET_DBUS(F) (s->dbus_offset=offsetof(M6502,F),(void)0)
@@ -964,6 +983,9 @@ void M6502_NextInstruction(M6502 *s) {
         s->opcode_pc=s->abus;
         s->read=M6502ReadType_Opcode;
         s->tfn=&T0_All;
+#if M6502_SWITCH_DISPATCH
+        s->tstate=TSTATE_T0_ALL;
+#endif
     }
 }
 
@@ -1578,6 +1600,41 @@ typedef struct NamedFn NamedFn;
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+#if M6502_SWITCH_DISPATCH
+void M6502_Step(M6502 *s) {
+    unsigned tstate=s->tstate;
+
+    // The hand-written states, and anything outside this file, only
+    // update tfn, so tstate may be stale. Leave it be, so the state is
+    // the same as if tfn had been called directly.
+    if(g_tstate_fns[tstate]!=s->tfn) {
+        (*s->tfn)(s);
+        return;
+    }
+
+    if(tstate==M6502TState_T0_All) {
+        /* As T0_All, but going via the switch when possible. */
+        s->opcode=s->dbus;
+
+        const M6502Fns *fns=&s->fns[s->opcode];
+
+        s->ifn=fns->ifn;
+
+        if(fns->t0_tstate==M6502TState_None) {
+            (*fns->t0fn)(s);
+            return;
+        }
+
+        tstate=fns->t0_tstate;
+    }
+
+    StepTState(s,tstate);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 static const char *FindNameByFn(const NamedFn *named_fns,M6502Fn fn) {
     for(const NamedFn *named_fn=named_fns;named_fn->name;++named_fn) {
         if(named_fn->fn==fn) {
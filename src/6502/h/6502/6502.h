@@ -118,6 +118,10 @@ typedef void (*M6502Callback)(struct M6502 *,void *);
 
 struct M6502Fns {
     M6502Fn t0fn,ifn;
+
+    /* (internal) t0fn's index in the switch-dispatched M6502_Step,
+     * or 0 if it's not one of the generated ones. */
+    uint16_t t0_tstate;
 };
 typedef struct M6502Fns M6502Fns;
 
@@ -309,6 +313,11 @@ struct M6502 {
 
     // (57-58)
 
+    /* (internal) When M6502_SWITCH_DISPATCH is set, a hint as to
+     * which case in M6502_Step corresponds to tfn. Only valid if
+     * tfn agrees - so it's fine to set tfn directly. */
+    uint16_t tstate;
+
     /* Pointer to the config object this 6502 was initialised with. */
     const M6502Config *config;
 
@@ -380,6 +389,20 @@ uint8_t M6502_GetOpcode(const M6502 *s);
  */
 #define M6502_IsProbablyIRQ(S) ((S)->irq_flags!=0)
 
+/* Step the 6502 one cycle - the same as calling tfn directly.
+ *
+ * When M6502_SWITCH_DISPATCH is set, most cycles are dispatched through
+ * a switch instead, avoiding an indirect call (and its likely
+ * misprediction) each cycle. Only the hand-written states still go via
+ * tfn. (There's no need for computed goto, as there's only the one
+ * dispatch per call.)
+ */
+#if M6502_SWITCH_DISPATCH
+void M6502_Step(M6502 *s);
+#else
+#define M6502_Step(S) ((*(S)->tfn)(S))
+#endif
+
 /* After the end state of an instruction, point the PC at the right
  * place and call this to set things up for the next one. */
 void M6502_NextInstruction(M6502 *s);
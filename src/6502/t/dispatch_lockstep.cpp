@@ -0,0 +1,222 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include <6502/6502.h>
+#include <stdio.h>
+#include <shared/log.h>
+#include <shared/path.h>
+#include <string.h>
+#include <inttypes.h>
+#include <string>
+#include <vector>
+
+/* Runs two 6502s in lockstep, one stepped with M6502_Step and one by
+ * calling tfn directly, and checks the whole M6502 struct matches after
+ * every cycle.
+ *
+ * Only interesting when M6502_SWITCH_DISPATCH is set - otherwise
+ * M6502_Step is the direct call anyway. */
+
+LOG_DEFINE(OUTPUT,"",&log_printer_stdout_and_debugger)
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const uint64_t MAX_NUM_KLAUS_CYCLES=200000000;
+
+static const uint64_t NUM_RANDOM_CYCLES=100000;
+static const uint32_t NUM_RANDOM_SEEDS=100;
+
+static uint8_t g_mem[65536];
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintState(const char *name,const M6502 *s) {
+    char pbuf[9];
+    M6502P p=M6502_GetP(s);
+
+    LOGF(OUTPUT,"%s: %s abus=$%04X dbus=$%02X read=%u\n",
+         name,
+         M6502_GetStateName((M6502 *)s,1),
+         s->abus.w,
+         s->dbus,
+         s->read);
+    LOGF(OUTPUT,"    PC=$%04X A=$%02X X=$%02X Y=$%02X S=$%02X P=%s ($%02X) opcode=$%02X data=$%02X ad=$%04X ia=$%04X\n",
+         s->pc.w,
+         s->a,
+         s->x,
+         s->y,
+         s->s.b.l,
+         M6502P_GetString(pbuf,p),
+         p.value,
+         s->opcode,
+         s->data,
+         s->ad.w,
+         s->ia.w);
+    LOGF(OUTPUT,"    tstate=%u irq_flags=$%02X nmi_flags=$%02X acarry=%u d1x1=%u\n",
+         s->tstate,
+         s->irq_flags,
+         s->nmi_flags,
+         s->acarry,
+         s->d1x1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Steps both 6502s one cycle and checks they're still the same. The
+// memory access is done once, for both.
+static void StepLockstep(M6502 *step,M6502 *tfn,uint64_t cycle) {
+    M6502_Step(step);
+    (*tfn->tfn)(tfn);
+
+    if(memcmp(step,tfn,sizeof *step)!=0) {
+        LOGF(OUTPUT,"Mismatch after cycle %" PRIu64 ":\n",cycle);
+        PrintState("M6502_Step",step);
+        PrintState("tfn",tfn);
+        TEST_FAIL("6502 states differ");
+    }
+
+    if(step->read) {
+        step->dbus=tfn->dbus=g_mem[step->abus.w];
+    } else {
+        g_mem[step->abus.w]=step->dbus;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The pair must be initialised the same way, including any padding, so
+// one is a byte-for-byte copy of the other.
+static void InitLockstep(M6502 *step,M6502 *tfn,const M6502Config *config) {
+    M6502_Init(step,config);
+    memcpy(tfn,step,sizeof *tfn);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Runs one of Klaus Dormann's tests to completion, as per klaus.cpp.
+static void TestKlaus(const std::string &fname,
+                      uint16_t load_address,
+                      uint16_t init_pc,
+                      const M6502Config *config)
+{
+    {
+        std::string path=PathJoined(KLAUS_FOLDER_NAME,fname);
+
+        std::vector<uint8_t> data;
+        TEST_TRUE(PathLoadBinaryFile(&data,path));
+        TEST_TRUE(load_address+data.size()<=sizeof g_mem);
+
+        memset(g_mem,0,sizeof g_mem);
+        memcpy(g_mem+load_address,data.data(),data.size());
+    }
+
+    M6502 step,tfn;
+    InitLockstep(&step,&tfn,config);
+
+    step.tfn=tfn.tfn=&M6502_NextInstruction;
+    step.pc.w=tfn.pc.w=init_pc;
+
+    int last_pc=-1;
+    uint64_t cycle=0;
+
+    for(;;) {
+        if(M6502_IsAboutToExecute(&step)) {
+            // Stuck in a loop means a test failed.
+            TEST_NE_II(step.abus.w,last_pc);
+            last_pc=step.abus.w;
+        }
+
+        TEST_LT_UU(cycle,MAX_NUM_KLAUS_CYCLES);
+
+        if(!step.read&&step.abus.w==0xff00) {
+            TEST_EQ_UU(step.dbus,0);
+            break;
+        }
+
+        StepLockstep(&step,&tfn,cycle++);
+    }
+
+    LOGF(OUTPUT,"%s, %s: %" PRIu64 " cycles\n",fname.c_str(),config->name,cycle);
+
+    M6502_Destroy(&step);
+    M6502_Destroy(&tfn);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static uint32_t g_random_state;
+
+static uint32_t GetRandom() {
+    g_random_state=g_random_state*1664525+1013904223;
+    return g_random_state>>16;
+}
+
+// Runs random memory contents, with IRQs and NMIs coming and going, to
+// cover the states the Klaus tests don't: undocumented instructions,
+// interrupts, and (on NMOS) HLT.
+static void TestRandom(uint32_t seed,const M6502Config *config) {
+    g_random_state=seed;
+
+    for(size_t i=0;i<sizeof g_mem;++i) {
+        g_mem[i]=(uint8_t)GetRandom();
+    }
+
+    M6502 step,tfn;
+    InitLockstep(&step,&tfn,config);
+
+    for(uint64_t cycle=0;cycle<NUM_RANDOM_CYCLES;++cycle) {
+        uint32_t r=GetRandom();
+
+        if(r%64==0) {
+            int wants_irq=!(step.device_irq_flags&1);
+            M6502_SetDeviceIRQ(&step,1,wants_irq);
+            M6502_SetDeviceIRQ(&tfn,1,wants_irq);
+        }
+
+        if(r%256==1) {
+            int wants_nmi=!(step.device_nmi_flags&1);
+            M6502_SetDeviceNMI(&step,1,wants_nmi);
+            M6502_SetDeviceNMI(&tfn,1,wants_nmi);
+        }
+
+        // A reset now and again gets things going again after an HLT.
+        if(r%20000==2) {
+            M6502_Reset(&step);
+            M6502_Reset(&tfn);
+        }
+
+        StepLockstep(&step,&tfn,cycle);
+    }
+
+    M6502_Destroy(&step);
+    M6502_Destroy(&tfn);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+#if M6502_SWITCH_DISPATCH
+    LOGF(OUTPUT,"M6502_Step: switch dispatch\n");
+#else
+    LOGF(OUTPUT,"M6502_Step: tfn (M6502_SWITCH_DISPATCH not set)\n");
+#endif
+
+    TestKlaus("6502.bin",0,0x400,&M6502_nmos6502_config);
+    TestKlaus("6502.bin",0,0x400,&M6502_cmos6502_config);
+    TestKlaus("65c02.bin",0,0x400,&M6502_cmos6502_config);
+    TestKlaus("d0.bin",0x200,0x200,&M6502_nmos6502_config);
+    TestKlaus("d1.bin",0x200,0x200,&M6502_cmos6502_config);
+
+    for(uint32_t seed=1;seed<=NUM_RANDOM_SEEDS;++seed) {
+        TestRandom(seed,&M6502_nmos6502_config);
+        TestRandom(seed,&M6502_cmos6502_config);
+    }
+
+    LOGF(OUTPUT,"%u random runs of %" PRIu64 " cycles each\n",2*NUM_RANDOM_SEEDS,NUM_RANDOM_CYCLES);
+}
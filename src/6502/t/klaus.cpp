@@ -66,7 +66,7 @@ static int DoTest(const std::string &fname,
             last_pc=s->abus.w;
         }
 
-        (*s->tfn)(s);
+        M6502_Step(s);
 
         if(s->read) {
             s->dbus=g_mem[s->abus.w];
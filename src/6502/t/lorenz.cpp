@@ -351,7 +351,7 @@ int main(int argc,char *argv[]) {
     int last_pc=-1;
 
     while(!g_done) {
-        (*s.tfn)(&s);
+        M6502_Step(&s);
         ++num_cycles;
 
         if(LOG(6502).enabled||g_options.test_disassembler) {
@@ -536,7 +536,7 @@ static void TestVisual6502URL(const std::string &description,const std::string &
         }
 
         //TEST_FALSE(s->p.bits._);
-        (*s->tfn)(s);
+        M6502_Step(s);
         //TEST_FALSE(s->p.bits._);
         if(s->read) {
             s->dbus=g_mem[s->abus.w];
@@ -44,6 +44,7 @@ public:
     bool video_nula=true;
     bool ext_mem=false;
     bool beeblink=false;
+    bool turbo_disc=false;
 protected:
 private:
 };
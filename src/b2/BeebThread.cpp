@@ -30,6 +30,11 @@
 #include "GenerateThumbnailJob.h"
 #include "VideoWriter.h"
 #include "BeebLinkHTTPHandler.h"
+#include "JobQueue.h"
+#include "HostTrace.h"
+#include <map>
+#include <algorithm>
+#include <typeinfo>
 
 #include <shared/enum_def.h>
 #include "BeebThread.inl"
@@ -53,9 +58,42 @@ static const int32_t RUN_2MHz_CYCLES=2000;
 static constexpr size_t NUM_VIDEO_UNITS=262144;
 static constexpr size_t NUM_AUDIO_UNITS=NUM_VIDEO_UNITS/2;//(1<<SOUND_CLOCK_SHIFT);
 
+// Size of the resampled audio buffer for BeebThreads with a sound device,
+// in sound device buffers. The thread is only allowed ~2.5 buffers ahead,
+// so this just needs to be comfortably bigger than that.
+static constexpr size_t NUM_SOUND_SAMPLES_BUFFERS=8;
+
 // When recording, how often to save a state.
 static const uint64_t TIMELINE_SAVE_STATE_FREQUENCY_2MHz_CYCLES=(uint64_t)2e6;
 
+// When not speed limited, video output is turned off, apart from one
+// preview field in this many. (At 50Hz, that's twice per emulated
+// second.)
+static const uint32_t FAST_FORWARD_PREVIEW_INTERVAL_FIELDS=25;
+
+// Seek prefetch states are found on a grid with this spacing. After a seek,
+// the grid points from 1 before to 2 after the seek point are prefetched.
+static const uint64_t SEEK_PREFETCH_INTERVAL_2MHz_CYCLES=(uint64_t)1e6;
+static const int SEEK_PREFETCH_FIRST=-1;
+static const int SEEK_PREFETCH_LAST=2;
+
+// Max number of prefetched states to keep.
+static const size_t MAX_NUM_SEEK_STATES=32;
+
+// The seek jobs' BeebThreads don't produce any audio, but they need some
+// figures to go on.
+static const int SEEK_JOB_SOUND_FREQ=48000;
+static const size_t SEEK_JOB_SOUND_BUFFER_SIZE_SAMPLES=1024;
+
+// How often BeebThread::ReplayEventList checks for cancellation.
+static const uint64_t REPLAY_CANCEL_CHECK_INTERVAL_2MHz_CYCLES=(uint64_t)1e5;
+
+#if BBCMICRO_DEBUGGER
+// Layout of BeebThread::m_debug_snapshot_middle.
+static const uint32_t DEBUG_SNAPSHOT_INDEX_MASK=3;
+static const uint32_t DEBUG_SNAPSHOT_NEW=4;
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
@@ -97,16 +135,90 @@ static const std::string COPY_BASIC_PREFIX=strprintf("%cOLD\n\r>LIST\n\r",BBCMic
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-static const float VOLUMES_TABLE[]={
-    0.00000f, 0.03981f, 0.05012f, 0.06310f,
-    0.07943f, 0.10000f, 0.12589f, 0.15849f,
-    0.19953f, 0.25119f, 0.31623f, 0.39811f,
-    0.50119f, 0.63096f, 0.79433f, 1.00000f,
+// Finds the state at a given point in the timeline, by replaying the
+// timeline from an earlier state on the job thread.
+class SeekPrefetchJob:
+    public JobQueue::Job
+{
+public:
+    SeekPrefetchJob(std::shared_ptr<MessageList> message_list,
+                    BeebThread::TimelineEventList event_list,
+                    uint64_t target_2MHz_cycles,
+                    JobPriority priority);
+
+    uint64_t GetTarget2MHzCycles() const;
+
+    // Only valid once the job has finished. Null if it failed or was
+    // canceled.
+    std::shared_ptr<const BeebState> GetBeebState() const;
+
+    JobPriority GetPriority() const override;
+
+    void ThreadExecute() override;
+protected:
+private:
+    std::shared_ptr<MessageList> m_message_list;
+    BeebThread::TimelineEventList m_event_list;
+    const uint64_t m_target_2MHz_cycles=0;
+    const JobPriority m_priority=JobPriority_Background;
+    std::shared_ptr<const BeebState> m_beeb_state;
 };
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+SeekPrefetchJob::SeekPrefetchJob(std::shared_ptr<MessageList> message_list,
+                                 BeebThread::TimelineEventList event_list,
+                                 uint64_t target_2MHz_cycles,
+                                 JobPriority priority):
+    m_message_list(std::move(message_list)),
+    m_event_list(std::move(event_list)),
+    m_target_2MHz_cycles(target_2MHz_cycles),
+    m_priority(priority)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t SeekPrefetchJob::GetTarget2MHzCycles() const {
+    return m_target_2MHz_cycles;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const BeebState> SeekPrefetchJob::GetBeebState() const {
+    ASSERT(this->IsFinished());
+
+    return m_beeb_state;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+JobPriority SeekPrefetchJob::GetPriority() const {
+    return m_priority;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SeekPrefetchJob::ThreadExecute() {
+    // The events need a BeebThread to handle them, but it's never started.
+    BeebThread beeb_thread(m_message_list,
+                           0,
+                           SEEK_JOB_SOUND_FREQ,
+                           SEEK_JOB_SOUND_BUFFER_SIZE_SAMPLES,
+                           BeebLoadedConfig(),
+                           std::vector<BeebThread::TimelineEventList>());
+
+    m_beeb_state=beeb_thread.ReplayEventList(m_event_list,this);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 struct BeebThread::ThreadState {
     bool stop=false;
 
@@ -136,6 +248,15 @@ struct BeebThread::ThreadState {
     size_t timeline_replay_list_event_index=0;
     uint64_t timeline_replay_time_2MHz_cycles=0;
 
+    // States found by seek prefetch jobs, indexed by time. Each state is as
+    // it was before any events at that time were handled.
+    std::map<uint64_t,std::shared_ptr<const BeebState>> timeline_seek_states;
+    std::vector<std::shared_ptr<SeekPrefetchJob>> timeline_seek_prefetch_jobs;
+
+    // The unfinished seek, if any.
+    std::shared_ptr<SeekPrefetchJob> timeline_seek_job;
+    Message::CompletionFun timeline_seek_completion_fun;
+
     bool copy_basic=false;
     std::function<void(std::vector<uint8_t>)> copy_stop_fun;
     std::vector<uint8_t> copy_data;
@@ -151,6 +272,37 @@ struct BeebThread::ThreadState {
 
     std::unique_ptr<BeebLinkHTTPHandler> beeblink_handler;
 
+#if BBCMICRO_DEBUGGER
+    // Index of the debug snapshot slot the thread owns.
+    uint32_t debug_snapshot_back=2;
+    uint64_t last_debug_snapshot_ticks=0;
+
+    // Set when the debugger has changed something, so the next snapshot
+    // should be published straight away.
+    bool debug_snapshot_forced=false;
+
+    // Whether the BBCMicro was halted as of the last snapshot.
+    bool debug_snapshot_halted=false;
+#endif
+
+    std::vector<VSyncFn> vsync_fns;
+
+    // Set when the run loop stopped at a vsync for the VSyncFns' benefit.
+    bool vsync_break=false;
+
+    // The running script, if any. script_index is the current step.
+    std::vector<ScriptStep> script;
+    size_t script_index=0;
+    Message::CompletionFun script_completion_fun;
+
+    // Set when the current step is a wait, and the wait has started.
+    bool script_waiting=false;
+    uint64_t script_wait_end_2MHz_cycles=0;
+
+    // Set by the script's instruction fn when the wait condition is met.
+    // Stops the BBCMicro::Update loop.
+    bool script_break=false;
+
     Log log{"BEEB  ",LOG(BTHREAD)};
     Messages msgs;
 };
@@ -162,12 +314,15 @@ struct BeebThread::AudioThreadData {
     uint64_t sound_freq;
     Remapper remapper;
     uint64_t num_consumed_sound_units=0;
-    float bbc_sound_scale=1.f;
-    float disc_sound_scale=1.f;
+    std::atomic<float> bbc_sound_scale{1.f};
+    std::atomic<float> disc_sound_scale{1.f};
     std::vector<AudioCallbackRecord> records;
     size_t record0_index=0;
     uint64_t sound_buffer_size_samples=0;
 
+    // Used by ThreadRenderAudio only.
+    float last_rendered_sample=0.f;
+
 #if LOGGING
     volatile uint64_t num_executed_cycles=0;
     uint64_t last_print_ticks=0;
@@ -461,6 +616,10 @@ void BeebThread::HardResetMessage::HardReset(BeebThread *beeb_thread,
 
     beeb->SetOSROM(ts->current_config.os);
 
+    // The hard reset message carries the config, so the timeline gets
+    // this too.
+    beeb->SetTurboDisc(ts->current_config.config.turbo_disc);
+
     for(uint8_t i=0;i<16;++i) {
         if(ts->current_config.config.roms[i].writeable) {
             if(!!ts->current_config.roms[i]) {
@@ -889,6 +1048,8 @@ bool BeebThread::StartReplayMessage::ThreadPrepare(std::shared_ptr<Message> *ptr
         return false;
     }
 
+    beeb_thread->ThreadCancelSeek(ts);
+
     if(ts->timeline_state==BeebThreadTimelineState_None) {
         if(ts->beeb) {
             // TODO - how to get the TVOutput here? Don't remember what I had
@@ -930,6 +1091,7 @@ bool BeebThread::StopReplayMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
         return false;
     }
 
+    beeb_thread->ThreadCancelSeek(ts);
     beeb_thread->ThreadStopReplay(ts);
 
     return true;
@@ -938,6 +1100,40 @@ bool BeebThread::StopReplayMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+BeebThread::SeekMessage::SeekMessage(uint64_t target_2MHz_cycles,bool prefetch):
+    m_target_2MHz_cycles(target_2MHz_cycles),
+    m_prefetch(prefetch)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BeebThread::SeekMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
+                                            CompletionFun *completion_fun,
+                                            BeebThread *beeb_thread,
+                                            ThreadState *ts)
+{
+    if(ts->timeline_state==BeebThreadTimelineState_Record) {
+        // Not valid in record mode.
+        return false;
+    }
+
+    if(!beeb_thread->ThreadSeek(ts,m_target_2MHz_cycles,completion_fun)) {
+        return false;
+    }
+
+    if(m_prefetch) {
+        beeb_thread->ThreadPrefetchSeekStates(ts,m_target_2MHz_cycles);
+    }
+
+    ptr->reset();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool BeebThread::StartRecordingMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
                                                       CompletionFun *completion_fun,
                                                       BeebThread *beeb_thread,
@@ -1139,6 +1335,47 @@ void BeebThread::StopPasteMessage::ThreadHandle(BeebThread *beeb_thread,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+BeebThread::RunScriptMessage::RunScriptMessage(std::vector<ScriptStep> steps):
+    m_steps(std::move(steps))
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BeebThread::RunScriptMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
+                                                 CompletionFun *completion_fun,
+                                                 BeebThread *beeb_thread,
+                                                 ThreadState *ts)
+{
+    if(!PrepareUnlessReplaying(ptr,completion_fun,beeb_thread,ts)) {
+        return false;
+    }
+
+    for(const ScriptStep &step:m_steps) {
+        if(step.type==BeebThreadScriptStepType_WaitByte&&step.addr>=0x8000) {
+            CallCompletionFun(completion_fun,false,"byte address not in main RAM");
+            return false;
+        }
+    }
+
+    beeb_thread->ThreadStopScript(ts,false);
+
+    ts->script=std::move(m_steps);
+    ts->script_index=0;
+    ts->script_completion_fun=std::move(*completion_fun);
+
+    // The script isn't recorded, just its effects.
+    ptr->reset();
+
+    beeb_thread->ThreadUpdateScript(ts);
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 BeebThread::StartCopyMessage::StartCopyMessage(std::function<void(std::vector<uint8_t>)> stop_fun,
                                                bool basic):
     m_stop_fun(std::move(stop_fun)),
@@ -1233,6 +1470,28 @@ bool BeebThread::StopCopyMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool BeebThread::DebugWakeUpMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
+                                                   CompletionFun *completion_fun,
+                                                   BeebThread *beeb_thread,
+                                                   ThreadState *ts)
+{
+    (void)completion_fun,(void)beeb_thread;
+
+#if BBCMICRO_DEBUGGER
+    // Whatever was done via LockMutableBeeb should show up in the
+    // debugger.
+    ts->debug_snapshot_forced=true;
+#else
+    (void)ts;
+#endif
+
+    ptr->reset();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_DEBUGGER
 BeebThread::DebugSetByteMessage::DebugSetByteMessage(uint16_t addr,
                                                      uint32_t dpo,
@@ -1269,6 +1528,8 @@ void BeebThread::DebugSetByteMessage::ThreadHandle(BeebThread *beeb_thread,
     M6502Word addr={m_addr};
 
     ts->beeb->DebugSetBytes(addr,m_dpo,&m_value,1);
+
+    ts->debug_snapshot_forced=true;
 }
 #endif
 
@@ -1309,6 +1570,8 @@ void BeebThread::DebugSetBytesMessage::ThreadHandle(BeebThread *beeb_thread,
     (void)beeb_thread;
 
     ts->beeb->DebugSetBytes({(uint16_t)m_addr},m_dpo,m_values.data(),m_values.size());
+
+    ts->debug_snapshot_forced=true;
     //
     //    M6502Word addr={(uint16_t)m_addr};
     //
@@ -1356,6 +1619,8 @@ void BeebThread::DebugSetExtByteMessage::ThreadHandle(BeebThread *beeb_thread,
     (void)beeb_thread;
 
     ts->beeb->SetExtMemory(m_addr,m_value);
+
+    ts->debug_snapshot_forced=true;
 }
 #endif
 
@@ -1410,6 +1675,106 @@ void BeebThread::DebugAsyncCallMessage::ThreadHandle(BeebThread *beeb_thread,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+#if BBCMICRO_DEBUGGER
+BeebThread::BatchMessage::BatchMessage(std::vector<BatchOp> ops,ResultsFun results_fun):
+    m_ops(std::move(ops)),
+    m_results_fun(std::move(results_fun))
+{
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+bool BeebThread::BatchMessage::ThreadPrepare(std::shared_ptr<Message> *ptr,
+                                             CompletionFun *completion_fun,
+                                             BeebThread *beeb_thread,
+                                             ThreadState *ts)
+{
+    bool pokes=false,calls_or_keys=false;
+    for(const BatchOp &op:m_ops) {
+        switch(op.type) {
+        case BeebThreadBatchOpType_Peek:
+            break;
+
+        case BeebThreadBatchOpType_Poke:
+            pokes=true;
+            break;
+
+        case BeebThreadBatchOpType_Call:
+        case BeebThreadBatchOpType_Key:
+            calls_or_keys=true;
+            break;
+        }
+    }
+
+    if(calls_or_keys) {
+        if(!this->PrepareUnlessReplayingOrHalted(ptr,completion_fun,beeb_thread,ts)) {
+            return false;
+        }
+    } else if(pokes) {
+        if(!this->PrepareUnlessReplaying(ptr,completion_fun,beeb_thread,ts)) {
+            return false;
+        }
+    } else {
+        // Peeks only. Nothing to record - do it now.
+        this->ThreadHandle(beeb_thread,ts);
+        ptr->reset();
+    }
+
+    return true;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+void BeebThread::BatchMessage::ThreadHandle(BeebThread *beeb_thread,
+                                            ThreadState *ts) const
+{
+    // The results fun is only wanted once. When replaying, don't bother
+    // with the peeks at all.
+    ResultsFun results_fun=std::move(m_results_fun);
+    m_results_fun=nullptr;
+
+    std::vector<uint8_t> peek_data;
+
+    for(const BatchOp &op:m_ops) {
+        switch(op.type) {
+        case BeebThreadBatchOpType_Peek:
+            if(!!results_fun) {
+                size_t offset=peek_data.size();
+                peek_data.resize(offset+op.num_bytes);
+                ts->beeb->DebugGetBytes(peek_data.data()+offset,op.num_bytes,{(uint16_t)op.addr},0);
+            }
+            break;
+
+        case BeebThreadBatchOpType_Poke:
+            ts->beeb->DebugSetBytes({(uint16_t)op.addr},0,op.values.data(),op.values.size());
+            ts->debug_snapshot_forced=true;
+            break;
+
+        case BeebThreadBatchOpType_Call:
+            ts->beeb->DebugSetAsyncCall((uint16_t)op.addr,op.a,op.x,op.y,op.c,&BeebThread::DebugAsyncCallCallback,ts);
+            break;
+
+        case BeebThreadBatchOpType_Key:
+            beeb_thread->ThreadSetKeyState(ts,op.key,op.state);
+            break;
+        }
+    }
+
+    if(!!results_fun) {
+        results_fun(*ts->num_executed_2MHz_cycles,std::move(peek_data));
+    }
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_DEBUGGER
 BeebThread::DebugSetAddressDebugFlags::DebugSetAddressDebugFlags(M6502Word addr,uint8_t addr_flags):
     m_addr(addr),
@@ -1431,6 +1796,8 @@ bool BeebThread::DebugSetAddressDebugFlags::ThreadPrepare(std::shared_ptr<Messag
 
     ts->beeb->DebugSetAddressDebugFlags(m_addr,m_addr_flags);
 
+    ts->debug_snapshot_forced=true;
+
     ptr->reset();
     return true;
 }
@@ -1463,6 +1830,8 @@ bool BeebThread::DebugSetByteDebugFlags::ThreadPrepare(std::shared_ptr<Message>
 
     ts->beeb->DebugSetByteDebugFlags(m_big_page_index,m_offset,m_byte_flags);
 
+    ts->debug_snapshot_forced=true;
+
     ptr->reset();
     return true;
 }
@@ -1640,11 +2009,19 @@ m_message_list(std::move(message_list))
     ASSERT(sound_freq >= 0);
     m_audio_thread_data = new AudioThreadData((uint64_t)sound_freq, (uint64_t)sound_buffer_size_samples, 100);
 
+    if(m_sound_device_id!=0) {
+        m_sound_samples=std::make_unique<OutputDataBuffer<float>>(sound_buffer_size_samples*NUM_SOUND_SAMPLES_BUFFERS);
+    }
+
     this->SetBBCVolume(MAX_DB);
     this->SetDiscVolume(MAX_DB);
 
     MUTEX_SET_NAME(m_mutex, "BeebThread");
     m_mq.SetName("BeebThread MQ");
+
+#if BBCMICRO_DEBUGGER
+    this->SetDebugSnapshotRate(DEFAULT_DEBUG_SNAPSHOT_RATE_HZ);
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -1713,6 +2090,93 @@ bool BeebThread::IsStarted() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+std::shared_ptr<const BeebState> BeebThread::ReplayEventList(const TimelineEventList &event_list,
+                                                             const JobQueue::Job *job)
+{
+    ASSERT(!this->IsStarted());
+    ASSERT(!event_list.events.empty());
+    ASSERT(!event_list.events.back().message);
+
+    ThreadState ts;
+
+    ts.beeb_thread=this;
+    ts.msgs=Messages(m_message_list);
+    ts.current_config=m_default_loaded_config;
+
+    // So that a hard reset keeps the replayed key state, same as in the
+    // main loop.
+    ts.timeline_state=BeebThreadTimelineState_Replay;
+
+    this->ThreadReplaceBeeb(&ts,event_list.state_event.message->GetBeebState()->CloneBBCMicro(),0);
+
+    std::shared_ptr<const BeebState> state;
+    VideoDataUnit vunit;
+    SoundDataUnit sunit;
+
+    for(const TimelineEvent &event:event_list.events) {
+        ASSERT(*ts.num_executed_2MHz_cycles<=event.time_2MHz_cycles);
+
+        while(*ts.num_executed_2MHz_cycles<event.time_2MHz_cycles) {
+            if(job&&job->WasCanceled()) {
+                goto done;
+            }
+
+            uint64_t stop_2MHz_cycles=*ts.num_executed_2MHz_cycles+REPLAY_CANCEL_CHECK_INTERVAL_2MHz_CYCLES;
+            if(stop_2MHz_cycles>event.time_2MHz_cycles) {
+                stop_2MHz_cycles=event.time_2MHz_cycles;
+            }
+
+            // Handling an event can replace the BBCMicro.
+            BBCMicro *beeb=ts.beeb;
+            if(beeb->IsVideoEnabled()) {
+                beeb->SetVideoEnabled(false,0);
+            }
+
+            while(*ts.num_executed_2MHz_cycles<stop_2MHz_cycles) {
+#if BBCMICRO_DEBUGGER
+                if(beeb->DebugIsHalted()) {
+                    // Stuck.
+                    goto done;
+                }
+#endif
+
+                beeb->Update(&vunit,&sunit);
+            }
+
+            if(ts.boot) {
+                if(beeb->GetAndResetDiscAccessFlag()) {
+                    this->ThreadSetBootState(&ts,false);
+                }
+            }
+        }
+
+        if(!event.message) {
+            // end event
+            break;
+        }
+
+        event.message->ThreadHandle(this,&ts);
+    }
+
+    {
+        ts.beeb->SetVideoEnabled(true,0);
+
+        std::unique_ptr<BBCMicro> clone=ts.beeb->Clone();
+        if(clone) {
+            state=std::make_shared<BeebState>(std::move(clone));
+        }
+    }
+
+done:
+    delete ts.beeb;
+    ts.beeb=nullptr;
+
+    return state;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 uint64_t BeebThread::GetEmulated2MHzCycles() const {
     return (uint64_t)m_num_2MHz_cycles;
 }
@@ -1786,12 +2250,12 @@ BBCMicro *BeebThread::LockMutableBeeb(std::unique_lock<Mutex> *lock) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-#if BBCMICRO_TRACE
-const volatile TraceStats *BeebThread::GetTraceStats() const {
-    if(m_is_tracing.load(std::memory_order_acquire)) {
-        return &m_trace_stats;
-    } else {
-        return nullptr;
+#if BBCMICRO_DEBUGGER
+void BeebThread::UpdateDebugSnapshot() {
+    if(m_debug_snapshot_middle.load(std::memory_order_acquire)&DEBUG_SNAPSHOT_NEW) {
+        uint32_t middle=m_debug_snapshot_middle.exchange(m_debug_snapshot_front,std::memory_order_acq_rel);
+
+        m_debug_snapshot_front=middle&DEBUG_SNAPSHOT_INDEX_MASK;
     }
 }
 #endif
@@ -1799,21 +2263,87 @@ const volatile TraceStats *BeebThread::GetTraceStats() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-bool BeebThread::IsSpeedLimited() const {
-    return m_is_speed_limited.load(std::memory_order_acquire);
+#if BBCMICRO_DEBUGGER
+const BBCMicro *BeebThread::GetDebugSnapshot() {
+    return this->GetDebugSnapshotPtr().get();
 }
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-float BeebThread::GetSpeedScale() const {
-    return m_speed_scale.load(std::memory_order_acquire);
+#if BBCMICRO_DEBUGGER
+const std::shared_ptr<const BBCMicro> &BeebThread::GetDebugSnapshotPtr() {
+    m_debug_snapshot_wanted.store(true,std::memory_order_release);
+
+    std::shared_ptr<const BBCMicro> *front=&m_debug_snapshots[m_debug_snapshot_front];
+
+    if(!*front) {
+        // Nothing published yet. Make one the slow way, so there's
+        // always something to look at.
+        std::unique_lock<Mutex> lock;
+        const BBCMicro *beeb=this->LockBeeb(&lock);
+
+        *front=beeb->CloneForDebugger();
+    }
+
+    return *front;
 }
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-//bool BeebThread::IsPaused() const {
+#if BBCMICRO_DEBUGGER
+void BeebThread::SetDebugSnapshotRate(float hz) {
+    if(hz<1.f) {
+        hz=1.f;
+    }
+
+    m_debug_snapshot_interval_ticks.store(GetTicksFromSeconds(1./hz),std::memory_order_release);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::AddVSyncFn(VSyncFn fn) {
+    std::lock_guard<Mutex> lock(m_mutex);
+
+    m_new_vsync_fns.push_back(std::move(fn));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_TRACE
+const volatile TraceStats *BeebThread::GetTraceStats() const {
+    if(m_is_tracing.load(std::memory_order_acquire)) {
+        return &m_trace_stats;
+    } else {
+        return nullptr;
+    }
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BeebThread::IsSpeedLimited() const {
+    return m_is_speed_limited.load(std::memory_order_acquire);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+float BeebThread::GetSpeedScale() const {
+    return m_speed_scale.load(std::memory_order_acquire);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+//bool BeebThread::IsPaused() const {
 //    std::lock_guard<Mutex> lock(m_mutex);
 //
 //    return m_paused;
@@ -1994,12 +2524,12 @@ size_t BeebThread::AudioThreadFillAudioBuffer(float *samples,
 
     float *dest=samples;
 
-    float sn_scale=1/4.f*atd->bbc_sound_scale;
+    float sn_scale=1/4.f*atd->bbc_sound_scale.load(std::memory_order_acquire);
 #if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
-    float disc_sound_scale=1.f*atd->disc_sound_scale;
+    float disc_sound_scale=1.f*atd->disc_sound_scale.load(std::memory_order_acquire);
 #endif
 
-#define MIXCH(CH) (VOLUMES_TABLE[unit->sn_output.ch[CH]])
+#define MIXCH(CH) (SN_VOLUMES_TABLE[unit->sn_output.ch[CH]])
 #define MIXSN (sn_scale*(MIXCH(0)+MIXCH(1)+MIXCH(2)+MIXCH(3)))
 #if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
 #define MIXALL (disc_sound_scale*unit->disc_drive_sound+MIXSN)
@@ -2088,6 +2618,75 @@ size_t BeebThread::AudioThreadFillAudioBuffer(float *samples,
     return num_samples;
 }
 
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::AudioThreadMixAudioBuffer(float *mix_buffer,size_t num_samples) {
+    HostTraceScope hts("Audio mix",m_num_2MHz_cycles.load(std::memory_order_acquire));
+
+    AudioThreadData *const atd=m_audio_thread_data;
+    ASSERT(m_sound_samples);
+
+    const float *sa,*sb;
+    size_t num_sa,num_sb;
+    if(!m_sound_samples->GetConsumerBuffers(&sa,&num_sa,&sb,&num_sb)) {
+        num_sa=0;
+        num_sb=0;
+    }
+
+    size_t num_available=num_sa+num_sb;
+
+    if(num_sa>num_samples) {
+        num_sa=num_samples;
+    }
+
+    if(num_sb>num_samples-num_sa) {
+        num_sb=num_samples-num_sa;
+    }
+
+    for(size_t i=0;i<num_sa;++i) {
+        mix_buffer[i]+=sa[i];
+    }
+
+    for(size_t i=0;i<num_sb;++i) {
+        mix_buffer[num_sa+i]+=sb[i];
+    }
+
+    m_sound_samples->Consume(num_sa+num_sb);
+
+    // The remapper belongs to the thread now, so work the unit counts out
+    // from scratch.
+    double units_per_sample=SOUND_CLOCK_HZ*(double)this->GetSpeedScale()/atd->sound_freq;
+
+    if(!atd->records.empty()) {
+        ASSERT(atd->record0_index<atd->records.size());
+        AudioCallbackRecord *record=&atd->records[atd->record0_index];
+
+        ++atd->record0_index;
+        atd->record0_index%=atd->records.size();
+
+        record->time=GetCurrentTickCount();
+        record->needed=(uint64_t)(num_samples*units_per_sample);
+        record->available=(uint64_t)(num_available*units_per_sample);
+    }
+
+    // Let the thread run until there's ~2.5 buffers' worth of audio
+    // buffered up.
+    uint64_t max_sound_units;
+    if(this->IsSpeedLimited()) {
+        size_t num_buffered=num_available-(num_sa+num_sb);
+        size_t num_wanted=num_samples*5/2;
+
+        max_sound_units=m_num_2MHz_cycles.load(std::memory_order_acquire)>>SOUND_CLOCK_SHIFT;
+        if(num_buffered<num_wanted) {
+            max_sound_units+=(uint64_t)((num_wanted-num_buffered)*units_per_sample);
+        }
+    } else {
+        max_sound_units=UINT64_MAX;
+    }
+    this->SendTimingMessage(max_sound_units);
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -2294,6 +2893,44 @@ bool BeebThread::ThreadStopCopyOnOSWORD0(const BBCMicro *beeb,const M6502 *cpu,v
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool BeebThread::ThreadScriptInstructionFn(const BBCMicro *beeb,const M6502 *cpu,void *context) {
+    auto ts=(ThreadState *)context;
+
+    if(!ts->script_waiting||ts->script_index>=ts->script.size()) {
+        return false;
+    }
+
+    const ScriptStep *step=&ts->script[ts->script_index];
+    bool met;
+
+    switch(step->type) {
+    default:
+        return false;
+
+    case BeebThreadScriptStepType_WaitPC:
+        met=cpu->abus.w==step->addr;
+        break;
+
+    case BeebThreadScriptStepType_WaitByte:
+        met=(beeb->GetRAM()[step->addr]&step->mask)==step->value;
+        break;
+
+    case BeebThreadScriptStepType_WaitOSWORD:
+        met=cpu->pc.w==0xfff2&&cpu->a==step->value;
+        break;
+    }
+
+    if(met) {
+        ts->script_break=true;
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool BeebThread::ThreadAddCopyData(const BBCMicro *beeb,const M6502 *cpu,void *context) {
     (void)beeb;
     auto ts=(ThreadState *)context;
@@ -2353,6 +2990,10 @@ void BeebThread::ThreadReplaceBeeb(ThreadState *ts,std::unique_ptr<BBCMicro> bee
                 }
             }
 
+            // Any script is abandoned - while there's still a BBCMicro
+            // to remove its instruction fn from.
+            this->ThreadStopScript(ts,false);
+
             delete ts->beeb;
             ts->beeb=nullptr;
         }
@@ -2710,11 +3351,27 @@ void BeebThread::ThreadMain(void) {
         const char *what;
         (void)what;
 
-        if(paused||
-            (m_is_speed_limited.load(std::memory_order_acquire)&&
-             ts.next_stop_2MHz_cycles<=*ts.num_executed_2MHz_cycles))
-        {
+        bool wait=(paused||
+                   (m_is_speed_limited.load(std::memory_order_acquire)&&
+                    ts.next_stop_2MHz_cycles<=*ts.num_executed_2MHz_cycles));
+
+#if BBCMICRO_DEBUGGER
+        if(paused) {
+            // Publish the state it halted in, or any changes made while
+            // halted, before going to sleep.
+            this->ThreadUpdateDebugSnapshot(&ts);
+        }
+#endif
+
+        if(wait&&ts.timeline_seek_job) {
+            // Nothing to signal the seek job finishing, so keep checking.
+            if(!m_mq.ConsumerPollForMessages(&messages)) {
+                SleepMS(1);
+            }
+            what="polled for seek";
+        } else if(wait) {
             rmt_ScopedCPUSample(MessageQueueWaitForMessage,0);
+            HostTraceScope hts("Wait");
             m_mq.ConsumerWaitForMessages(&messages);
             what="waited";
         } else {
@@ -2739,16 +3396,18 @@ void BeebThread::ThreadMain(void) {
                 }
 
                 if(!!m.message) {
+                    HostTraceScope hts("Message",ts.num_executed_2MHz_cycles?*ts.num_executed_2MHz_cycles:HOST_TRACE_NO_CYCLE);
+                    hts.SetDetail(GetHostTraceTypeName(typeid(*m.message)));
+
                     m.message->ThreadHandle(this,&ts);
 
+                    if(ts.num_executed_2MHz_cycles) {
+                        hts.SetEndCycle(*ts.num_executed_2MHz_cycles);
+                    }
+
                     Message::CallCompletionFun(&m.completion_fun,true,nullptr);
 
-                    if(ts.timeline_state==BeebThreadTimelineState_Record) {
-                        ASSERT(!ts.timeline_event_lists.empty());
-                        TimelineEvent event{*ts.num_executed_2MHz_cycles,std::move(m.message)};
-                        ts.timeline_event_lists.back().events.emplace_back(std::move(event));
-                        ++m_timeline_state.num_events;
-                    }
+                    this->ThreadRecordMessage(&ts,std::move(m.message));
                 }
 
                 if(ts.stop) {
@@ -2756,10 +3415,30 @@ void BeebThread::ThreadMain(void) {
                 }
             }
 
+            this->ThreadUpdateSeek(&ts);
+
+            this->ThreadUpdateScript(&ts);
+
             stop_2MHz_cycles=ts.next_stop_2MHz_cycles;
 
+            if(ts.script_waiting) {
+                if(ts.script[ts.script_index].type==BeebThreadScriptStepType_WaitCycles) {
+                    if(ts.script_wait_end_2MHz_cycles<stop_2MHz_cycles) {
+                        stop_2MHz_cycles=ts.script_wait_end_2MHz_cycles;
+                    }
+                }
+            }
+
             messages.clear();
 
+            if(!m_new_vsync_fns.empty()) {
+                for(VSyncFn &fn:m_new_vsync_fns) {
+                    ts.vsync_fns.push_back(std::move(fn));
+                }
+
+                m_new_vsync_fns.clear();
+            }
+
             uint32_t clone_impediments=ts.beeb->GetCloneImpediments();
 
             m_clone_impediments.store(clone_impediments,std::memory_order_release);
@@ -2853,6 +3532,12 @@ void BeebThread::ThreadMain(void) {
         //            }
         //        }
 
+#if BBCMICRO_DEBUGGER
+        this->ThreadUpdateDebugSnapshot(&ts);
+#endif
+
+        this->ThreadCallVSyncFns(&ts);
+
         if(m_is_pasting) {
             if(!ts.beeb->IsPasting()) {
                 m_is_pasting.store(false,std::memory_order_release);
@@ -2877,9 +3562,17 @@ void BeebThread::ThreadMain(void) {
 
         if(!paused&&stop_2MHz_cycles>*ts.num_executed_2MHz_cycles) {
             rmt_ScopedCPUSample(BeebUpdate,0);
+            HostTraceScope hts("Run",*ts.num_executed_2MHz_cycles);
 
             ASSERT(ts.beeb);
 
+            // Don't bother generating video that will mostly just get
+            // thrown away.
+            bool video_enabled=m_is_speed_limited.load(std::memory_order_acquire);
+            if(ts.beeb->IsVideoEnabled()!=video_enabled) {
+                ts.beeb->SetVideoEnabled(video_enabled,FAST_FORWARD_PREVIEW_INTERVAL_FIELDS);
+            }
+
             uint64_t num_2MHz_cycles=stop_2MHz_cycles-*ts.num_executed_2MHz_cycles;
             if(num_2MHz_cycles>RUN_2MHz_CYCLES) {
                 num_2MHz_cycles=RUN_2MHz_CYCLES;
@@ -2905,6 +3598,8 @@ void BeebThread::ThreadMain(void) {
 
             size_t num_sound_units=(size_t)((num_va+num_vb+(1<<SOUND_CLOCK_SHIFT)-1)>>SOUND_CLOCK_SHIFT);
 
+            this->ThreadRenderAudio();
+
             SoundDataUnit *sa,*sb;
             size_t num_sa,num_sb;
             if(!m_sound_output.GetProducerBuffers(&sa,&num_sa,&sb,&num_sb)) {
@@ -2922,13 +3617,17 @@ void BeebThread::ThreadMain(void) {
             total_num_audio_units_produced+=num_sound_units;
 
             {
-                VideoDataUnit *vunit;
+                // With video output disabled, there may be fewer video
+                // units than cycles, so vunit runs from va into vb as
+                // required, like sunit does.
+                VideoDataUnit *vunit=va;
+                size_t num_vunits;
                 size_t i;
                 std::unique_lock<Mutex> lock(m_mutex,std::defer_lock);
 
                 // A.
                 {
-                    vunit=va;
+                    num_vunits=0;
 
                     for(i=0;i<num_va;++i) {
                         if(!lock.owns_lock()) {
@@ -2941,7 +3640,30 @@ void BeebThread::ThreadMain(void) {
                         }
 #endif
 
-                        if(ts.beeb->Update(vunit++,sunit)) {
+                        if(ts.script_break||ts.vsync_break) {
+                            break;
+                        }
+
+                        uint32_t update_result=ts.beeb->Update(vunit,sunit);
+
+                        if(update_result&BBCMicroUpdateResultFlag_VSync) {
+                            if(!ts.vsync_fns.empty()) {
+                                // Stop here, so the VSyncFns get called
+                                // once per vsync, at the vsync.
+                                ts.vsync_break=true;
+                            }
+                        }
+
+                        if(update_result&BBCMicroUpdateResultFlag_VideoUnit) {
+                            ++vunit;
+                            ++num_vunits;
+
+                            if(vunit==va+num_va) {
+                                vunit=vb;
+                            }
+                        }
+
+                        if(update_result&BBCMicroUpdateResultFlag_AudioUnit) {
                             lock.unlock();
 
                             ++sunit;
@@ -2956,7 +3678,7 @@ void BeebThread::ThreadMain(void) {
                         }
                     }
 
-                    m_video_output.Produce(i);
+                    m_video_output.Produce(num_vunits);
                 }
 
                 if(!lock.owns_lock()) {
@@ -2968,7 +3690,7 @@ void BeebThread::ThreadMain(void) {
                 if(!ts.beeb->DebugIsHalted())//<--note
 #endif/////////////////////////////////////////<--note
                 {//////////////////////////////<--note
-                    vunit=vb;
+                    num_vunits=0;
 
                     for(i=0;i<num_vb;++i) {
                         if(!lock.owns_lock()) {
@@ -2981,7 +3703,30 @@ void BeebThread::ThreadMain(void) {
                         }
 #endif
 
-                        if(ts.beeb->Update(vunit++,sunit)) {
+                        if(ts.script_break||ts.vsync_break) {
+                            break;
+                        }
+
+                        uint32_t update_result=ts.beeb->Update(vunit,sunit);
+
+                        if(update_result&BBCMicroUpdateResultFlag_VSync) {
+                            if(!ts.vsync_fns.empty()) {
+                                // Stop here, so the VSyncFns get called
+                                // once per vsync, at the vsync.
+                                ts.vsync_break=true;
+                            }
+                        }
+
+                        if(update_result&BBCMicroUpdateResultFlag_VideoUnit) {
+                            ++vunit;
+                            ++num_vunits;
+
+                            if(vunit==va+num_va) {
+                                vunit=vb;
+                            }
+                        }
+
+                        if(update_result&BBCMicroUpdateResultFlag_AudioUnit) {
                             lock.unlock();
 
                             ++sunit;
@@ -2996,15 +3741,19 @@ void BeebThread::ThreadMain(void) {
                         }
                     }
 
-                    m_video_output.Produce(i);
+                    m_video_output.Produce(num_vunits);
                 }
             }
 
             // It's a bit dumb having multiple copies.
             m_num_2MHz_cycles.store(*ts.num_executed_2MHz_cycles,std::memory_order_release);
+
+            hts.SetEndCycle(*ts.num_executed_2MHz_cycles);
         }
     }
 done:
+    this->ThreadClearSeekStates(&ts);
+
     {
         std::lock_guard<Mutex> lock(m_mutex);
 
@@ -3018,7 +3767,7 @@ done:
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void BeebThread::SetVolume(float *scale_var,float db) {
+void BeebThread::SetVolume(std::atomic<float> *scale_var,float db) {
     if(db>MAX_DB) {
         db=MAX_DB;
     }
@@ -3027,11 +3776,58 @@ void BeebThread::SetVolume(float *scale_var,float db) {
         db=MIN_DB;
     }
 
-    {
-        AudioDeviceLock lock(m_sound_device_id);
+    scale_var->store(powf(10.f,db/20.f),std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Resample as much of the sound output as will fit into m_sound_samples,
+// using the same filter as AudioThreadFillAudioBuffer. b2_bench's
+// audio/mix times ResampleSoundUnits too.
+void BeebThread::ThreadRenderAudio() {
+    if(!m_sound_samples) {
+        return;
+    }
+
+    HostTraceScope hts("Render audio");
+
+    AudioThreadData *const atd=m_audio_thread_data;
+
+    const SoundDataUnit *ua,*ub;
+    size_t num_ua,num_ub;
+    if(!m_sound_output.GetConsumerBuffers(&ua,&num_ua,&ub,&num_ub)) {
+        return;
+    }
 
-        *scale_var=powf(10.f,db/20.f);
+    size_t num_units=num_ua+num_ub;
+    size_t unit_index=0;
+
+    float *sa,*sb;
+    size_t num_sa,num_sb;
+    if(m_sound_samples->GetProducerBuffers(&sa,&num_sa,&sb,&num_sb)) {
+        float sn_scale=1/4.f*atd->bbc_sound_scale.load(std::memory_order_acquire);
+        float disc_sound_scale=1.f*atd->disc_sound_scale.load(std::memory_order_acquire);
+
+        size_t num_samples=ResampleSoundUnits(sa,num_sa,
+                                              &unit_index,ua,num_ua,ub,num_ub,
+                                              &atd->remapper,&atd->last_rendered_sample,
+                                              sn_scale,disc_sound_scale);
+        if(num_samples==num_sa&&sb) {
+            num_samples+=ResampleSoundUnits(sb,num_sb,
+                                            &unit_index,ua,num_ua,ub,num_ub,
+                                            &atd->remapper,&atd->last_rendered_sample,
+                                            sn_scale,disc_sound_scale);
+        }
+
+        m_sound_samples->Produce(num_samples);
+    } else if(!m_is_speed_limited.load(std::memory_order_acquire)) {
+        // The audio can't keep up when the thread is running flat out.
+        // Drop it, so the thread isn't held up.
+        unit_index=num_units;
     }
+
+    m_sound_output.Consume(unit_index);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -3078,6 +3874,8 @@ void BeebThread::ThreadStopRecording(ThreadState *ts) {
 void BeebThread::ThreadClearRecording(ThreadState *ts) {
     this->ThreadCheckTimeline(ts);
 
+    this->ThreadClearSeekStates(ts);
+
     this->ThreadStopRecording(ts);
 
     ts->timeline_event_lists.clear();
@@ -3184,6 +3982,9 @@ void BeebThread::ThreadTruncateTimeline(ThreadState *ts,
         return;// Umm...
     }
 
+    // Prefetched states from beyond the new end would be invalid.
+    this->ThreadClearSeekStates(ts);
+
     TimelineEventList *list=&ts->timeline_event_lists[index];
 
     // Account for removal of this state's events.
@@ -3293,6 +4094,530 @@ void BeebThread::ThreadStopReplay(ThreadState *ts) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+size_t BeebThread::ThreadFindTimelineEventListIndexByTime(ThreadState *ts,uint64_t time_2MHz_cycles) {
+    ASSERT(!ts->timeline_event_lists.empty());
+    ASSERT(time_2MHz_cycles>=ts->timeline_event_lists[0].state_event.time_2MHz_cycles);
+
+    auto it=std::upper_bound(ts->timeline_event_lists.begin(),
+                             ts->timeline_event_lists.end(),
+                             time_2MHz_cycles,
+                             [](uint64_t t,const TimelineEventList &list) {
+                                 return t<list.state_event.time_2MHz_cycles;
+                             });
+    ASSERT(it!=ts->timeline_event_lists.begin());
+
+    return (size_t)(it-ts->timeline_event_lists.begin())-1;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BeebThread::ThreadSeek(ThreadState *ts,
+                            uint64_t target_2MHz_cycles,
+                            Message::CompletionFun *completion_fun)
+{
+    this->ThreadCheckTimeline(ts);
+
+    if(ts->timeline_event_lists.empty()) {
+        return false;
+    }
+
+    if(target_2MHz_cycles<ts->timeline_event_lists[0].state_event.time_2MHz_cycles||
+       target_2MHz_cycles>ts->timeline_end_event.time_2MHz_cycles)
+    {
+        return false;
+    }
+
+    this->ThreadCancelSeek(ts);
+    this->ThreadUpdateSeekStates(ts,target_2MHz_cycles);
+
+    std::shared_ptr<SeekPrefetchJob> job=this->ThreadCreateSeekJob(ts,
+                                                                   target_2MHz_cycles,
+                                                                   JobPriority_Interactive);
+    if(job) {
+        LOGF(REPLAY,"seek to %" PRIu64 ": started job\n",target_2MHz_cycles);
+
+        ts->timeline_seek_job=job;
+        ts->timeline_seek_completion_fun=std::move(*completion_fun);
+        *completion_fun=nullptr;
+
+        BeebWindows::AddJob(std::move(job));
+    } else {
+        uint64_t start_2MHz_cycles;
+        std::shared_ptr<const BeebState> start_state;
+        this->ThreadFindSeekStartState(ts,target_2MHz_cycles,&start_2MHz_cycles,&start_state);
+        ASSERT(start_2MHz_cycles==target_2MHz_cycles);
+
+        this->ThreadStartReplayFromSeekState(ts,start_2MHz_cycles,std::move(start_state));
+
+        Message::CallCompletionFun(completion_fun,true,nullptr);
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadUpdateSeek(ThreadState *ts) {
+    if(!ts->timeline_seek_job||!ts->timeline_seek_job->IsFinished()) {
+        return;
+    }
+
+    uint64_t target_2MHz_cycles=ts->timeline_seek_job->GetTarget2MHzCycles();
+    std::shared_ptr<const BeebState> state=ts->timeline_seek_job->GetBeebState();
+    ts->timeline_seek_job.reset();
+
+    if(!state) {
+        Message::CallCompletionFun(&ts->timeline_seek_completion_fun,false,"seek failed");
+        return;
+    }
+
+    // Whatever the outcome, the state is good for future seeks.
+    ts->timeline_seek_states[target_2MHz_cycles]=state;
+
+    if(ts->timeline_state==BeebThreadTimelineState_Record) {
+        // Recording started in the meantime.
+        Message::CallCompletionFun(&ts->timeline_seek_completion_fun,false,nullptr);
+        return;
+    }
+
+    this->ThreadStartReplayFromSeekState(ts,target_2MHz_cycles,std::move(state));
+
+    Message::CallCompletionFun(&ts->timeline_seek_completion_fun,true,nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadCancelSeek(ThreadState *ts) {
+    if(ts->timeline_seek_job) {
+        ts->timeline_seek_job->Cancel();
+        ts->timeline_seek_job.reset();
+
+        Message::CallCompletionFun(&ts->timeline_seek_completion_fun,false,nullptr);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadStartReplayFromSeekState(ThreadState *ts,
+                                                uint64_t start_2MHz_cycles,
+                                                std::shared_ptr<const BeebState> start_state)
+{
+    if(ts->timeline_state==BeebThreadTimelineState_None) {
+        if(ts->beeb) {
+            ts->timeline_replay_old_state=std::make_shared<BeebState>(ts->beeb->Clone());
+        }
+    }
+
+    ts->timeline_state=BeebThreadTimelineState_Replay;
+
+    // Replay from the first event at or after the start point.
+    size_t list_index=this->ThreadFindTimelineEventListIndexByTime(ts,start_2MHz_cycles);
+    const TimelineEventList *list=&ts->timeline_event_lists[list_index];
+
+    size_t event_index=0;
+    while(event_index<list->events.size()&&
+          list->events[event_index].time_2MHz_cycles<start_2MHz_cycles)
+    {
+        ++event_index;
+    }
+
+    // ThreadNextReplayEvent will add 1, and skip to the next non-empty
+    // list if necessary. (When event_index is 0, this wraps round, same
+    // as in StartReplayMessage.)
+    ts->timeline_replay_list_index=list_index;
+    ts->timeline_replay_list_event_index=event_index-1;
+    this->ThreadNextReplayEvent(ts);
+    ts->timeline_replay_time_2MHz_cycles=start_2MHz_cycles;
+
+    LOGF(REPLAY,"seek: start=%" PRIu64 ", list index=%zu, list event index=%zu\n",
+         start_2MHz_cycles,
+         ts->timeline_replay_list_index,
+         ts->timeline_replay_list_event_index);
+
+    this->ThreadReplaceBeeb(ts,start_state->CloneBBCMicro(),0);
+
+    m_num_2MHz_cycles.store(*ts->num_executed_2MHz_cycles,std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+size_t BeebThread::ThreadFindSeekStartState(ThreadState *ts,
+                                            uint64_t time_2MHz_cycles,
+                                            uint64_t *start_2MHz_cycles,
+                                            std::shared_ptr<const BeebState> *start_state)
+{
+    size_t list_index=this->ThreadFindTimelineEventListIndexByTime(ts,time_2MHz_cycles);
+    const TimelineBeebStateEvent *state_event=&ts->timeline_event_lists[list_index].state_event;
+
+    *start_2MHz_cycles=state_event->time_2MHz_cycles;
+    *start_state=state_event->message->GetBeebState();
+
+    auto it=ts->timeline_seek_states.upper_bound(time_2MHz_cycles);
+    if(it!=ts->timeline_seek_states.begin()) {
+        --it;
+
+        // A prefetched state at the same time as a timeline state doesn't
+        // include the events from the previous list at that time, so only
+        // use it if it's strictly later.
+        if(it->first>*start_2MHz_cycles) {
+            *start_2MHz_cycles=it->first;
+            *start_state=it->second;
+        }
+    }
+
+    return list_index;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<SeekPrefetchJob> BeebThread::ThreadCreateSeekJob(ThreadState *ts,
+                                                                 uint64_t time_2MHz_cycles,
+                                                                 JobPriority priority)
+{
+    uint64_t start_2MHz_cycles;
+    std::shared_ptr<const BeebState> start_state;
+    size_t list_index=this->ThreadFindSeekStartState(ts,time_2MHz_cycles,&start_2MHz_cycles,&start_state);
+    if(start_2MHz_cycles==time_2MHz_cycles) {
+        return nullptr;
+    }
+
+    TimelineEventList event_list;
+    event_list.state_event.time_2MHz_cycles=start_2MHz_cycles;
+    event_list.state_event.message=std::make_shared<BeebStateMessage>(std::move(start_state),false);
+
+    // Events from the start state up to, but not including, the target
+    // time, and an end event to mark the target.
+    for(size_t j=list_index;j<ts->timeline_event_lists.size();++j) {
+        for(const TimelineEvent &event:ts->timeline_event_lists[j].events) {
+            if(event.time_2MHz_cycles>=time_2MHz_cycles) {
+                goto got_events;
+            }
+
+            if(event.time_2MHz_cycles>=start_2MHz_cycles) {
+                event_list.events.push_back(event);
+            }
+        }
+    }
+got_events:;
+
+    event_list.events.push_back(TimelineEvent{time_2MHz_cycles,nullptr});
+
+    return std::make_shared<SeekPrefetchJob>(m_message_list,
+                                             std::move(event_list),
+                                             time_2MHz_cycles,
+                                             priority);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadPrefetchSeekStates(ThreadState *ts,uint64_t target_2MHz_cycles) {
+    ASSERT(!ts->timeline_event_lists.empty());
+
+    const uint64_t begin_2MHz_cycles=ts->timeline_event_lists[0].state_event.time_2MHz_cycles;
+    const uint64_t end_2MHz_cycles=ts->timeline_end_event.time_2MHz_cycles;
+    const uint64_t grid_2MHz_cycles=target_2MHz_cycles/SEEK_PREFETCH_INTERVAL_2MHz_CYCLES*SEEK_PREFETCH_INTERVAL_2MHz_CYCLES;
+
+    for(int i=SEEK_PREFETCH_FIRST;i<=SEEK_PREFETCH_LAST;++i) {
+        if(i<0&&grid_2MHz_cycles<(uint64_t)-i*SEEK_PREFETCH_INTERVAL_2MHz_CYCLES) {
+            continue;
+        }
+
+        uint64_t time_2MHz_cycles=grid_2MHz_cycles+(uint64_t)i*SEEK_PREFETCH_INTERVAL_2MHz_CYCLES;
+        if(time_2MHz_cycles<=begin_2MHz_cycles||time_2MHz_cycles>=end_2MHz_cycles) {
+            continue;
+        }
+
+        if(ts->timeline_seek_states.count(time_2MHz_cycles)>0) {
+            continue;
+        }
+
+        if(ts->timeline_seek_job&&ts->timeline_seek_job->GetTarget2MHzCycles()==time_2MHz_cycles) {
+            continue;
+        }
+
+        bool pending=false;
+        for(const std::shared_ptr<SeekPrefetchJob> &job:ts->timeline_seek_prefetch_jobs) {
+            if(job->GetTarget2MHzCycles()==time_2MHz_cycles) {
+                pending=true;
+                break;
+            }
+        }
+
+        if(pending) {
+            continue;
+        }
+
+        // If there's a state close enough already, don't bother.
+        uint64_t start_2MHz_cycles;
+        std::shared_ptr<const BeebState> start_state;
+        this->ThreadFindSeekStartState(ts,time_2MHz_cycles,&start_2MHz_cycles,&start_state);
+        if(time_2MHz_cycles-start_2MHz_cycles<SEEK_PREFETCH_INTERVAL_2MHz_CYCLES) {
+            continue;
+        }
+
+        std::shared_ptr<SeekPrefetchJob> job=this->ThreadCreateSeekJob(ts,
+                                                                       time_2MHz_cycles,
+                                                                       JobPriority_Background);
+        ASSERT(job);
+        ts->timeline_seek_prefetch_jobs.push_back(job);
+        BeebWindows::AddJob(std::move(job));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadUpdateSeekStates(ThreadState *ts,uint64_t target_2MHz_cycles) {
+    std::vector<std::shared_ptr<SeekPrefetchJob>> *jobs=&ts->timeline_seek_prefetch_jobs;
+
+    for(auto it=jobs->begin();it!=jobs->end();) {
+        const std::shared_ptr<SeekPrefetchJob> &job=*it;
+
+        if(job->IsFinished()) {
+            std::shared_ptr<const BeebState> state=job->GetBeebState();
+            if(state) {
+                ts->timeline_seek_states[job->GetTarget2MHzCycles()]=std::move(state);
+            }
+
+            it=jobs->erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    while(ts->timeline_seek_states.size()>MAX_NUM_SEEK_STATES) {
+        auto furthest_it=ts->timeline_seek_states.end();
+        uint64_t furthest_distance=0;
+
+        for(auto it=ts->timeline_seek_states.begin();it!=ts->timeline_seek_states.end();++it) {
+            uint64_t distance;
+            if(it->first>=target_2MHz_cycles) {
+                distance=it->first-target_2MHz_cycles;
+            } else {
+                distance=target_2MHz_cycles-it->first;
+            }
+
+            if(furthest_it==ts->timeline_seek_states.end()||distance>furthest_distance) {
+                furthest_it=it;
+                furthest_distance=distance;
+            }
+        }
+
+        ts->timeline_seek_states.erase(furthest_it);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadClearSeekStates(ThreadState *ts) {
+    this->ThreadCancelSeek(ts);
+
+    for(const std::shared_ptr<SeekPrefetchJob> &job:ts->timeline_seek_prefetch_jobs) {
+        job->Cancel();
+    }
+
+    ts->timeline_seek_prefetch_jobs.clear();
+    ts->timeline_seek_states.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+void BeebThread::ThreadUpdateDebugSnapshot(ThreadState *ts) {
+    if(!ts->beeb) {
+        return;
+    }
+
+    // The debugger wants to see the state it stopped in, and to see that
+    // it's running again, right away.
+    bool halted=ts->beeb->DebugIsHalted();
+    if(halted!=ts->debug_snapshot_halted) {
+        ts->debug_snapshot_forced=true;
+    }
+
+    uint64_t now_ticks=GetCurrentTickCount();
+
+    if(!ts->debug_snapshot_forced) {
+        if(now_ticks-ts->last_debug_snapshot_ticks<m_debug_snapshot_interval_ticks.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        // Don't bother if nobody's looked at the previous one.
+        if(!m_debug_snapshot_wanted.exchange(false,std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+
+    rmt_ScopedCPUSample(UpdateDebugSnapshot,0);
+
+    // Replacing the old copy, rather than overwriting it, is simplest.
+    // It's only a few hundred KB. The UI thread may be fiddling with the
+    // debug state via LockMutableBeeb.
+    {
+        std::lock_guard<Mutex> lock(m_mutex);
+
+        m_debug_snapshots[ts->debug_snapshot_back]=ts->beeb->CloneForDebugger();
+    }
+
+    ts->debug_snapshot_forced=false;
+    ts->debug_snapshot_halted=halted;
+
+    uint32_t old_middle=m_debug_snapshot_middle.exchange(ts->debug_snapshot_back|DEBUG_SNAPSHOT_NEW,std::memory_order_acq_rel);
+    ts->debug_snapshot_back=old_middle&DEBUG_SNAPSHOT_INDEX_MASK;
+
+    ts->last_debug_snapshot_ticks=now_ticks;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadCallVSyncFns(ThreadState *ts) {
+    if(!ts->vsync_break) {
+        return;
+    }
+
+    ts->vsync_break=false;
+
+    if(!ts->beeb) {
+        return;
+    }
+
+    size_t i=0;
+    while(i<ts->vsync_fns.size()) {
+        if(ts->vsync_fns[i](ts->beeb)) {
+            ++i;
+        } else {
+            ts->vsync_fns.erase(ts->vsync_fns.begin()+(ptrdiff_t)i);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadRecordMessage(ThreadState *ts,std::shared_ptr<Message> message) {
+    if(ts->timeline_state==BeebThreadTimelineState_Record) {
+        ASSERT(!ts->timeline_event_lists.empty());
+        TimelineEvent event{*ts->num_executed_2MHz_cycles,std::move(message)};
+        ts->timeline_event_lists.back().events.emplace_back(std::move(event));
+        ++m_timeline_state.num_events;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Handle a message generated by the script as though it had been sent in
+// the usual way.
+void BeebThread::ThreadHandleScriptMessage(ThreadState *ts,std::shared_ptr<Message> message) {
+    Message::CompletionFun completion_fun;
+
+    if(!message->ThreadPrepare(&message,&completion_fun,this,ts)) {
+        return;
+    }
+
+    if(!!message) {
+        message->ThreadHandle(this,ts);
+
+        this->ThreadRecordMessage(ts,std::move(message));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Run script steps until one has to wait.
+void BeebThread::ThreadUpdateScript(ThreadState *ts) {
+    if(ts->script.empty()) {
+        return;
+    }
+
+#if BBCMICRO_DEBUGGER
+    if(ts->beeb->DebugIsHalted()) {
+        return;
+    }
+#endif
+
+    while(ts->script_index<ts->script.size()) {
+        const ScriptStep *step=&ts->script[ts->script_index];
+
+        switch(step->type) {
+        case BeebThreadScriptStepType_Key:
+            this->ThreadHandleScriptMessage(ts,std::make_shared<KeyMessage>(step->key,step->state));
+            break;
+
+        case BeebThreadScriptStepType_Paste:
+            this->ThreadHandleScriptMessage(ts,std::make_shared<StartPasteMessage>(step->text));
+            break;
+
+        case BeebThreadScriptStepType_WaitCycles:
+            if(!ts->script_waiting) {
+                ts->script_waiting=true;
+                ts->script_wait_end_2MHz_cycles=*ts->num_executed_2MHz_cycles+step->num_2MHz_cycles;
+            }
+
+            if(*ts->num_executed_2MHz_cycles<ts->script_wait_end_2MHz_cycles) {
+                return;
+            }
+            break;
+
+        case BeebThreadScriptStepType_WaitPC:
+        case BeebThreadScriptStepType_WaitByte:
+        case BeebThreadScriptStepType_WaitOSWORD:
+            if(!ts->script_waiting) {
+                ts->script_waiting=true;
+                ts->script_break=false;
+                ts->beeb->AddInstructionFn(&ThreadScriptInstructionFn,ts);
+            }
+
+            if(!ts->script_break) {
+                return;
+            }
+
+            ts->script_break=false;
+            break;
+        }
+
+        ts->script_waiting=false;
+        ++ts->script_index;
+    }
+
+    this->ThreadStopScript(ts,true);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebThread::ThreadStopScript(ThreadState *ts,bool success) {
+    if(ts->script.empty()) {
+        return;
+    }
+
+    if(ts->script_waiting&&ts->beeb) {
+        ts->beeb->RemoveInstructionFn(&ThreadScriptInstructionFn,ts);
+    }
+
+    ts->script.clear();
+    ts->script_index=0;
+    ts->script_waiting=false;
+    ts->script_break=false;
+
+    Message::CallCompletionFun(&ts->script_completion_fun,success,nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool BeebThread::ThreadWaitForHardReset(const BBCMicro *beeb,const M6502 *cpu,void *context) {
     (void)beeb;
     auto ts=(ThreadState *)context;
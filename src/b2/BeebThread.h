@@ -23,6 +23,7 @@
 #include "BeebConfig.h"
 #include "MessageQueue.h"
 #include "BeebWindow.h"
+#include "JobQueue.h"
 
 #include <shared/enum_decl.h>
 #include "BeebThread.inl"
@@ -40,6 +41,7 @@ class MessageList;
 //class BeebEvent;
 class VideoWriter;
 class R6522;
+class SeekPrefetchJob;
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -452,6 +454,37 @@ public:
     private:
     };
 
+    // Seek to an arbitrary point in the timeline, and start replaying from
+    // there.
+    //
+    // If there's a state for the seek point already - a timeline state, or
+    // one found by a previous seek's prefetch jobs - replay starts straight
+    // away. Otherwise, a job replays the timeline from the nearest earlier
+    // state to the seek point, with video output off, and replay starts
+    // once it's done. The BeebThread carries on as it was in the meantime.
+    // The completion fun is called once replay starts. A newer seek
+    // cancels any unfinished older one.
+    //
+    // If PREFETCH is set, jobs are then started to find the states at a
+    // few neighbouring points, so that seeking nearby is quicker.
+    //
+    // Not valid in record mode.
+    class SeekMessage:
+        public Message
+    {
+    public:
+        explicit SeekMessage(uint64_t target_2MHz_cycles,bool prefetch);
+
+        bool ThreadPrepare(std::shared_ptr<Message> *ptr,
+                           CompletionFun *completion_fun,
+                           BeebThread *beeb_thread,
+                           ThreadState *ts) override;
+    protected:
+    private:
+        const uint64_t m_target_2MHz_cycles=0;
+        const bool m_prefetch=false;
+    };
+
     class StartRecordingMessage:
         public Message
     {
@@ -551,6 +584,57 @@ public:
         std::shared_ptr<const std::string> m_text;
     };
 
+    struct ScriptStep {
+        BeebThreadScriptStepType type=BeebThreadScriptStepType_Key;
+
+        // Key.
+        BeebKey key=BeebKey_None;
+        bool state=false;
+
+        // Paste.
+        std::string text;
+
+        // WaitCycles.
+        uint64_t num_2MHz_cycles=0;
+
+        // WaitPC (address of instruction), WaitByte (main RAM address).
+        uint16_t addr=0;
+
+        // WaitByte (wait until (byte&mask)==value), WaitOSWORD (A).
+        uint8_t value=0;
+        uint8_t mask=0xff;
+    };
+
+    // Run a list of steps on the Beeb thread, one after another, with no
+    // round trips to any other thread.
+    //
+    // Key and Paste steps are handled exactly as if a KeyMessage or
+    // StartPasteMessage had been received at that cycle, and recorded
+    // into the timeline as such. The waits aren't recorded - but as a
+    // wait stops the emulation on exactly the cycle its condition is met,
+    // independent of how fast the emulator is running, the result is the
+    // same each time.
+    //
+    // PC, byte and OSWORD conditions are checked before each instruction.
+    //
+    // Only one script runs at once; a new one replaces any previous one.
+    // The completion fun is called with true when the script finishes, or
+    // false if it's replaced or the BBC is reset or replaced.
+    class RunScriptMessage:
+        public Message
+    {
+    public:
+        explicit RunScriptMessage(std::vector<ScriptStep> steps);
+
+        bool ThreadPrepare(std::shared_ptr<Message> *ptr,
+                           CompletionFun *completion_fun,
+                           BeebThread *beeb_thread,
+                           ThreadState *ts) override;
+    protected:
+    private:
+        std::vector<ScriptStep> m_steps;
+    };
+
     class StopPasteMessage:
         public Message
     {
@@ -592,12 +676,17 @@ public:
     private:
     };
 
-    // Wake thread up when emulator is being resumed. The thread could
-    // have gone to sleep.
+    // Wake thread up when emulator is being resumed, or the debugger has
+    // changed something via LockMutableBeeb. The thread could have gone
+    // to sleep.
     class DebugWakeUpMessage:
         public Message
     {
     public:
+        bool ThreadPrepare(std::shared_ptr<Message> *ptr,
+                           CompletionFun *completion_fun,
+                           BeebThread *beeb_thread,
+                           ThreadState *ts) override;
     protected:
     private:
     };
@@ -701,6 +790,61 @@ public:
     };
 #endif
 
+#if BBCMICRO_DEBUGGER
+    struct BatchOp {
+        BeebThreadBatchOpType type=BeebThreadBatchOpType_Peek;
+
+        // Peek, Poke, Call.
+        uint32_t addr=0;
+
+        // Peek.
+        uint32_t num_bytes=0;
+
+        // Poke.
+        std::vector<uint8_t> values;
+
+        // Call.
+        uint8_t a=0,x=0,y=0;
+        bool c=false;
+
+        // Key.
+        BeebKey key=BeebKey_None;
+        bool state=false;
+    };
+
+    // Perform a list of operations one after another, all at the same
+    // cycle. The bytes read by the peeks are concatenated and passed to
+    // RESULTS_FUN, on the BeebThread, along with the cycle count.
+    //
+    // A batch that affects the emulated state is recorded like any other
+    // message. RESULTS_FUN is only called the first time round, not on
+    // replay.
+    //
+    // Each op is checked against its own policy, and the batch uses the
+    // strictest one it contains: peeks are always valid, even when halted
+    // or replaying; pokes are valid when halted, but not when replaying;
+    // calls and keys follow the same rules as DebugAsyncCallMessage and
+    // KeyMessage.
+    class BatchMessage:
+        public Message
+    {
+    public:
+        typedef std::function<void(uint64_t num_2MHz_cycles,std::vector<uint8_t> peek_data)> ResultsFun;
+
+        BatchMessage(std::vector<BatchOp> ops,ResultsFun results_fun);
+
+        bool ThreadPrepare(std::shared_ptr<Message> *ptr,
+                           CompletionFun *completion_fun,
+                           BeebThread *beeb_thread,
+                           ThreadState *ts) override;
+        void ThreadHandle(BeebThread *beeb_thread,ThreadState *ts) const override;
+    protected:
+    private:
+        const std::vector<BatchOp> m_ops;
+        mutable ResultsFun m_results_fun;
+    };
+#endif
+
 #if BBCMICRO_DEBUGGER
     class DebugSetAddressDebugFlags:
     public Message
@@ -839,6 +983,16 @@ public:
     // Returns true if Start was called and the thread is running.
     bool IsStarted() const;
 
+    // Replay EVENT_LIST on the calling thread, and return a copy of the
+    // state as of its final event, which must be an end event (null
+    // message). The BeebThread is only there to handle the events, and
+    // mustn't be started.
+    //
+    // Returns null if the replay goes wrong, or if JOB (if not null) is
+    // canceled part way through.
+    std::shared_ptr<const BeebState> ReplayEventList(const TimelineEventList &event_list,
+                                                     const JobQueue::Job *job);
+
     // Get number of 2MHz cycles elapsed. This value is for UI
     // purposes only - it's updated regularly, but it isn't
     // authoritative.
@@ -873,8 +1027,38 @@ public:
     // As well as the LockBeeb guarantees, it's also safe to call the
     // non-const DebugXXX functions.
     BBCMicro *LockMutableBeeb(std::unique_lock<Mutex> *lock);
+
+    // Debugger UI should read from the debug snapshot rather than using
+    // LockBeeb, so it doesn't hold up the emulation. The snapshot is a
+    // copy of the BBCMicro (see BBCMicro::CloneForDebugger) that the
+    // thread publishes every so often, via a triple buffer, while
+    // somebody is asking for it.
+    //
+    // A new snapshot is also published straight away when the BBCMicro
+    // halts or resumes, and after the debugger writes to memory or
+    // changes debug flags.
+    //
+    // Call UpdateDebugSnapshot once per frame to pick up the latest
+    // snapshot. The result of GetDebugSnapshot is valid until the next
+    // call to UpdateDebugSnapshot; hang on to the result of
+    // GetDebugSnapshotPtr to keep a snapshot around for longer. These
+    // must always be called from the same thread.
+    void UpdateDebugSnapshot();
+    const BBCMicro *GetDebugSnapshot();
+    const std::shared_ptr<const BBCMicro> &GetDebugSnapshotPtr();
+
+    // Maximum number of snapshots to publish per second.
+    void SetDebugSnapshotRate(float hz);
 #endif
 
+    // Called on the BeebThread once per vsync, straight after the cycle
+    // on which the CRTC's vsync output went active. (The emulation stops
+    // there to make the call, so it's called for every vsync even when
+    // running flat out.) The BBCMicro is in a consistent state, as for
+    // CustomMessage. Return false to be removed.
+    typedef std::function<bool(BBCMicro *beeb)> VSyncFn;
+    void AddVSyncFn(VSyncFn fn);
+
     // Get trace stats, or nullptr if there's no trace.
     const volatile TraceStats *GetTraceStats() const;
 
@@ -938,6 +1122,15 @@ public:
                                       void (*fn)(int,float,void *)=nullptr,
                                       void *fn_context=nullptr);
 
+    // For a BeebThread with a sound device, the thread resamples its own
+    // audio as it goes, so this just adds up to NUM_SAMPLES samples of
+    // it into MIX_BUFFER, and tells the thread how far it can run ahead.
+    // (AudioThreadFillAudioBuffer is for BeebThreads without a sound
+    // device.)
+    //
+    // If there's underflow, the rest of the buffer is left as it is.
+    void AudioThreadMixAudioBuffer(float *mix_buffer,size_t num_samples);
+
     // Set sound/disc volume as attenuation in decibels.
     void SetBBCVolume(float db);
     void SetDiscVolume(float db);
@@ -983,6 +1176,10 @@ private:
     MessageQueue<SentMessage> m_mq;
     OutputDataBuffer<VideoDataUnit> m_video_output;
     OutputDataBuffer<SoundDataUnit> m_sound_output;
+
+    // Resampled audio, when there's a sound device. Produced by the
+    // thread, consumed by AudioThreadMixAudioBuffer.
+    std::unique_ptr<OutputDataBuffer<float>> m_sound_samples;
     KeyStates m_effective_key_states;//includes fake shift
     KeyStates m_real_key_states;//corresponds to PC keys pressed
 
@@ -1018,6 +1215,21 @@ private:
     // Main thread must take mutex to access.
     ThreadState *m_thread_state=nullptr;
 
+#if BBCMICRO_DEBUGGER
+    // Debug snapshot triple buffer. The thread owns one slot, the UI owns
+    // m_debug_snapshot_front, and m_debug_snapshot_middle holds the index
+    // of the remaining slot, plus DEBUG_SNAPSHOT_NEW if the thread has
+    // put a new snapshot there since the UI last looked.
+    std::shared_ptr<const BBCMicro> m_debug_snapshots[3];
+    std::atomic<uint32_t> m_debug_snapshot_middle{1};
+    uint32_t m_debug_snapshot_front=0;
+    std::atomic<bool> m_debug_snapshot_wanted{false};
+    std::atomic<uint64_t> m_debug_snapshot_interval_ticks{0};
+#endif
+
+    // VSync fns not yet picked up by the thread. Controlled by m_mutex.
+    std::vector<VSyncFn> m_new_vsync_fns;
+
     // Last recorded trace. Controlled by m_mutex.
     std::shared_ptr<Trace> m_last_trace;
 
@@ -1047,6 +1259,7 @@ private:
 #endif
 
     static bool ThreadStopCopyOnOSWORD0(const BBCMicro *beeb,const M6502 *cpu,void *context);
+    static bool ThreadScriptInstructionFn(const BBCMicro *beeb,const M6502 *cpu,void *context);
     static bool ThreadAddCopyData(const BBCMicro *beeb,const M6502 *cpu,void *context);
 
     std::shared_ptr<BeebState> ThreadSaveState(ThreadState *ts);
@@ -1064,7 +1277,8 @@ private:
     void ThreadStartPaste(ThreadState *ts,std::shared_ptr<const std::string> text);
     void ThreadStopCopy(ThreadState *ts);
     void ThreadMain();
-    void SetVolume(float *scale_var,float db);
+    void ThreadRenderAudio();
+    void SetVolume(std::atomic<float> *scale_var,float db);
     bool ThreadRecordSaveState(ThreadState *ts,bool user_initiated);
     void ThreadStopRecording(ThreadState *ts);
     void ThreadClearRecording(ThreadState *ts);
@@ -1081,6 +1295,71 @@ private:
                                                      size_t *index,
                                                      const std::shared_ptr<const BeebState> &state);
 
+    // Find index of the last event list whose state is at or before the
+    // given time. The time mustn't be before the start of the timeline.
+    size_t ThreadFindTimelineEventListIndexByTime(ThreadState *ts,uint64_t time_2MHz_cycles);
+
+    // Returns false if the target is outside the timeline. Otherwise,
+    // starts replaying from the target straight away if there's a state
+    // for that exact point; if not, starts a job to find it, and
+    // ThreadUpdateSeek picks up the result. If the seek goes ahead, it
+    // takes *COMPLETION_FUN, and calls it when the replay starts, or when
+    // the seek fails or is canceled.
+    bool ThreadSeek(ThreadState *ts,uint64_t target_2MHz_cycles,Message::CompletionFun *completion_fun);
+
+    // Start replaying from the finished seek job's state, if there's one.
+    void ThreadUpdateSeek(ThreadState *ts);
+
+    // Cancel any unfinished seek, e.g., because a newer request makes it
+    // irrelevant.
+    void ThreadCancelSeek(ThreadState *ts);
+
+    // Start replaying from STATE, which is at the given point in the
+    // timeline.
+    void ThreadStartReplayFromSeekState(ThreadState *ts,
+                                        uint64_t start_2MHz_cycles,
+                                        std::shared_ptr<const BeebState> start_state);
+
+    // Find the nearest state at or before the given time - either a
+    // timeline state, or a prefetched state. Returns the timeline event
+    // list index for that time.
+    size_t ThreadFindSeekStartState(ThreadState *ts,
+                                    uint64_t time_2MHz_cycles,
+                                    uint64_t *start_2MHz_cycles,
+                                    std::shared_ptr<const BeebState> *start_state);
+
+    // Create a job to find the state at the given time, starting from the
+    // nearest earlier state. Returns null if there's a state for that
+    // exact point already.
+    std::shared_ptr<SeekPrefetchJob> ThreadCreateSeekJob(ThreadState *ts,
+                                                         uint64_t time_2MHz_cycles,
+                                                         JobPriority priority);
+
+    // Start jobs to find states near the target, if there aren't any
+    // suitable ones already.
+    void ThreadPrefetchSeekStates(ThreadState *ts,uint64_t target_2MHz_cycles);
+
+    // Collect the results of any finished prefetch jobs, and discard the
+    // prefetched states furthest from the target if there are too many.
+    void ThreadUpdateSeekStates(ThreadState *ts,uint64_t target_2MHz_cycles);
+
+    // Discard prefetched states and cancel seek and prefetch jobs, e.g.,
+    // because the timeline has changed.
+    void ThreadClearSeekStates(ThreadState *ts);
+
+#if BBCMICRO_DEBUGGER
+    // Publish a new debug snapshot, if one is wanted and it's been long
+    // enough since the last.
+    void ThreadUpdateDebugSnapshot(ThreadState *ts);
+#endif
+
+    void ThreadCallVSyncFns(ThreadState *ts);
+
+    void ThreadRecordMessage(ThreadState *ts,std::shared_ptr<Message> message);
+    void ThreadHandleScriptMessage(ThreadState *ts,std::shared_ptr<Message> message);
+    void ThreadUpdateScript(ThreadState *ts);
+    void ThreadStopScript(ThreadState *ts,bool success);
+
     // Get next un-replayed replay event.
     const TimelineEvent *ThreadGetNextReplayEvent(ThreadState *ts);
 
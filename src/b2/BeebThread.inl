@@ -58,3 +58,33 @@ EEND()
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
+
+// Values are as per the HTTP script request format.
+#define ENAME BeebThreadScriptStepType
+EBEGIN()
+EPNV(Key,0)
+EPNV(Paste,1)
+EPNV(WaitCycles,2)
+EPNV(WaitPC,3)
+EPNV(WaitByte,4)
+EPNV(WaitOSWORD,5)
+EEND()
+#undef ENAME
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Values are as per the HTTP batch request format.
+#if BBCMICRO_DEBUGGER
+#define ENAME BeebThreadBatchOpType
+EBEGIN()
+EPNV(Peek,0)
+EPNV(Poke,1)
+EPNV(Call,2)
+EPNV(Key,3)
+EEND()
+#undef ENAME
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
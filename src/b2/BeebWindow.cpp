@@ -29,6 +29,8 @@
 #include "TraceUI.h"
 #include <IconsFontAwesome5.h>
 #include "DataRateUI.h"
+#include "SubsystemProfilerUI.h"
+#include "CycleProfilerUI.h"
 #include <shared/path.h>
 #include "CommandKeymapsUI.h"
 #include "DearImguiTestUI.h"
@@ -38,6 +40,7 @@
 #include "SavedStatesUI.h"
 #include "BeebLinkUI.h"
 #include "SettingsUI.h"
+#include "HostTrace.h"
 
 #ifdef _MSC_VER
 #include <crtdbg.h>
@@ -101,6 +104,7 @@ static const double LEDS_POPUP_TIME_SECONDS=1.;
 static const std::string RECENT_PATHS_DISC_IMAGE="disc_image";
 //static const std::string RECENT_PATHS_RAM="ram";
 static const std::string RECENT_PATHS_NVRAM="nvram";
+static const std::string RECENT_PATHS_HOST_TRACE="host_trace";
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -227,6 +231,10 @@ void BeebWindow::OptionsUI::DoImGui() {
     ImGui::NewLine();
 
 #if BBCMICRO_DEBUGGER
+    if(ImGui::SliderFloat("Debugger update rate",&settings->debug_snapshot_rate,1.f,100.f,"%.0f Hz")) {
+        beeb_thread->SetDebugSnapshotRate(settings->debug_snapshot_rate);
+    }
+
     if(ImGui::CollapsingHeader("Display Debug Flags",ImGuiTreeNodeFlags_DefaultOpen)) {
         {
             std::unique_lock<Mutex> lock;
@@ -291,6 +299,9 @@ BeebWindow::BeebWindow(BeebWindowInitArguments init_arguments):
     m_beeb_thread->SetBBCVolume(m_settings.bbc_volume);
     m_beeb_thread->SetDiscVolume(m_settings.disc_volume);
     m_beeb_thread->SetPowerOnTone(m_settings.power_on_tone);
+#if BBCMICRO_DEBUGGER
+    m_beeb_thread->SetDebugSnapshotRate(m_settings.debug_snapshot_rate);
+#endif
 
     m_blend_amt=1.f;
 }
@@ -299,6 +310,8 @@ BeebWindow::BeebWindow(BeebWindowInitArguments init_arguments):
 //////////////////////////////////////////////////////////////////////////
 
 BeebWindow::~BeebWindow() {
+    BeebWindows::RemoveAudioSource(m_sound_device,m_beeb_thread.get());
+
     m_beeb_thread->Stop();
 
     // Clear these explicitly before destroying the dear imgui stuff
@@ -574,6 +587,8 @@ bool BeebWindow::DoImGui(uint64_t ticks) {
 
 #if BBCMICRO_DEBUGGER
     m_got_debug_halted=false;
+
+    m_beeb_thread->UpdateDebugSnapshot();
 #endif
 
     for(const SDL_KeyboardEvent &event:m_sdl_keyboard_events) {
@@ -811,6 +826,7 @@ const BeebWindow::SettingsUIMetadata BeebWindow::ms_settings_uis[]={
 #endif
     // inconsistent naming as this window has had multiple rebrands.
     {BeebWindowPopupType_AudioCallback,"Performance","toggle_date_rate",&CreateDataRateUI},
+    {BeebWindowPopupType_SubsystemProfiler,"Emulator Profiler","toggle_subsystem_profiler",&CreateSubsystemProfilerUI},
 #if BBCMICRO_DEBUGGER&&VIDEO_TRACK_METADATA
     // slightly inconsistent naming as this was created before the debugger...
     {BeebWindowPopupType_PixelMetadata,"Pixel Metadata","toggle_pixel_metadata",&CreatePixelMetadataDebugWindow},
@@ -841,6 +857,7 @@ const BeebWindow::SettingsUIMetadata BeebWindow::ms_settings_uis[]={
     {BeebWindowPopupType_PagingDebugger,"Paging Debug","toggle_paging_debugger",&CreatePagingDebugWindow,},
     {BeebWindowPopupType_BreakpointsDebugger,"Breakpoints","toggle_breakpoints_debugger",&CreateBreakpointsDebugWindow,},
     {BeebWindowPopupType_StackDebugger,"Stack","toggle_stack_debugger",&CreateStackDebugWindow,},
+    {BeebWindowPopupType_CycleProfiler,"Code Profiler","toggle_cycle_profiler",&CreateCycleProfilerUI,},
 #endif
     {BeebWindowPopupType_BeebLink,"BeebLink Options","toggle_beeblink_options",&CreateBeebLinkUI},
 
@@ -1329,7 +1346,9 @@ void BeebWindow::DoFileMenu() {
                     if(ImGui::MenuItem("Save copy as...")) {
                         SaveFileDialog fd(RECENT_PATHS_DISC_IMAGE);
 
-                        disc_image->AddFileDialogFilter(&fd);
+                        if(const char *ext=disc_image->GetFileExtension()) {
+                            fd.AddFilter("BBC disc image",{ext});
+                        }
                         fd.AddAllFilesFilter();
 
                         std::string path;
@@ -1411,6 +1430,9 @@ void BeebWindow::DoToolsMenu() {
         // Is there somewhere better for this?
         m_cc.DoMenuItemUI("reset_default_nvram");
 
+        ImGui::Separator();
+        m_cc.DoMenuItemUI("save_host_trace");
+
         ImGui::Separator();
         m_cc.DoMenuItemUI("clean_up_recent_files_lists");
         m_cc.DoMenuItemUI("reset_dock_windows");
@@ -1430,6 +1452,7 @@ void BeebWindow::DoDebugMenu() {
 #endif
         m_cc.DoMenuItemUI("toggle_event_trace");
         m_cc.DoMenuItemUI("toggle_date_rate");
+        m_cc.DoMenuItemUI("toggle_subsystem_profiler");
 
 #if SYSTEM_WINDOWS
         if(GetConsoleWindow()) {
@@ -1476,6 +1499,7 @@ void BeebWindow::DoDebugMenu() {
         m_cc.DoMenuItemUI("toggle_paging_debugger");
         m_cc.DoMenuItemUI("toggle_breakpoints_debugger");
         m_cc.DoMenuItemUI("toggle_stack_debugger");
+        m_cc.DoMenuItemUI("toggle_cycle_profiler");
 
         ImGui::Separator();
 
@@ -1556,6 +1580,8 @@ bool BeebWindow::DoWindowMenu() {
 //////////////////////////////////////////////////////////////////////////
 
 void BeebWindow::UpdateTVTexture(VBlankRecord *vblank_record) {
+    HostTraceScope hts("UpdateTVTexture",m_beeb_thread->GetEmulated2MHzCycles());
+
     {
         Timer tmr(&g_HandleVBlank_UpdateTVTexture_Consume_timer_def);
 
@@ -1625,11 +1651,24 @@ void BeebWindow::UpdateTVTexture(VBlankRecord *vblank_record) {
         Timer tmr(&g_HandleVBlank_UpdateTVTexture_Copy_timer_def);
 
         if(m_tv_texture) {
-            void *dest_pixels;
-            int dest_pitch;
-            if(SDL_LockTexture(m_tv_texture,nullptr,&dest_pixels,&dest_pitch)==0) {
-                m_tv.CopyTexturePixels(dest_pixels,(size_t)dest_pitch);
-                SDL_UnlockTexture(m_tv_texture);
+            // Only the rows that changed need uploading. A static display
+            // doesn't need touching at all.
+            size_t begin_y,end_y;
+            if(m_tv.GetDirtyRows(&begin_y,&end_y)) {
+                SDL_Rect rect;
+                rect.x=0;
+                rect.y=(int)begin_y;
+                rect.w=TV_TEXTURE_WIDTH;
+                rect.h=(int)(end_y-begin_y);
+
+                void *dest_pixels;
+                int dest_pitch;
+                if(SDL_LockTexture(m_tv_texture,&rect,&dest_pixels,&dest_pitch)==0) {
+                    m_tv.CopyTexturePixels(dest_pixels,(size_t)dest_pitch,begin_y,end_y);
+                    SDL_UnlockTexture(m_tv_texture);
+
+                    m_tv.ClearDirtyRows();
+                }
             }
         }
     }
@@ -1770,6 +1809,7 @@ bool BeebWindow::DoBeebDisplayUI() {
 
 bool BeebWindow::HandleVBlank(uint64_t ticks) {
     Timer tmr(&g_HandleVBlank_timer_def);
+    HostTraceScope hts("HandleVBlank",m_beeb_thread->GetEmulated2MHzCycles());
 
     ImGuiContextSetter setter(m_imgui_stuff);
 
@@ -2058,6 +2098,8 @@ bool BeebWindow::InitInternal() {
         return false;
     }
 
+    BeebWindows::AddAudioSource(m_sound_device,m_beeb_thread);
+
     if(!!m_init_arguments.initial_state) {
         // Load initial state.
         m_beeb_thread->Send(std::make_shared<BeebThread::LoadStateMessage>(m_init_arguments.initial_state,
@@ -2161,21 +2203,6 @@ bool BeebWindow::InitInternal() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void BeebWindow::ThreadFillAudioBuffer(SDL_AudioDeviceID audio_device_id,float *mix_buffer,size_t num_samples) {
-    if(!m_beeb_thread->IsStarted()) {
-        return;
-    }
-
-    if(m_sound_device!=audio_device_id) {
-        return;
-    }
-
-    m_beeb_thread->AudioThreadFillAudioBuffer(mix_buffer,num_samples,false);
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
 void BeebWindow::UpdateTitle() {
     if(!m_beeb_thread->IsStarted()) {
         return;
@@ -2237,6 +2264,28 @@ std::shared_ptr<BeebThread> BeebWindow::GetBeebThread() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+std::vector<uint8_t> BeebWindow::GetTVOutputRGBA() const {
+    const uint32_t *pixels=m_tv.GetTexturePixels(nullptr);
+    size_t n=(size_t)TV_TEXTURE_WIDTH*TV_TEXTURE_HEIGHT;
+
+    std::vector<uint8_t> rgba(n*4);
+    uint8_t *dest=rgba.data();
+
+    for(size_t i=0;i<n;++i) {
+        uint32_t pixel=pixels[i];
+
+        *dest++=(uint8_t)(pixel>>m_pixel_format->Rshift);
+        *dest++=(uint8_t)(pixel>>m_pixel_format->Gshift);
+        *dest++=(uint8_t)(pixel>>m_pixel_format->Bshift);
+        *dest++=0xff;
+    }
+
+    return rgba;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 std::shared_ptr<MessageList> BeebWindow::GetMessageList() const {
     return m_message_list;
 }
@@ -2282,6 +2331,17 @@ std::vector<BeebWindow::VBlankRecord> BeebWindow::GetVBlankRecords() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool BeebWindow::GetVBlankPacingStats(VBlankPacingStats *stats) const {
+    if(!m_vblank_monitor) {
+        return false;
+    }
+
+    return m_vblank_monitor->GetPacingStats(m_vblank_display_data,stats);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 const BeebKeymap *BeebWindow::GetCurrentKeymap() const {
     return m_keymap;
 }
@@ -2333,6 +2393,9 @@ bool BeebWindow::HandleVBlank(VBlankMonitor *vblank_monitor,void *display_data,u
         return true;
     }
 
+    m_vblank_monitor=vblank_monitor;
+    m_vblank_display_data=display_data;
+
     return this->HandleVBlank(ticks);
 }
 
@@ -2395,6 +2458,9 @@ bool BeebWindow::RecreateTexture() {
         return false;
     }
 
+    // New texture needs filling in.
+    m_tv.SetAllRowsDirty();
+
     return true;
 }
 
@@ -2418,6 +2484,7 @@ void BeebWindow::CleanUpRecentFilesLists() {
 
     n+=CleanUpRecentPaths(RECENT_PATHS_DISC_IMAGE,&PathIsFileOnDisk);
     n+=CleanUpRecentPaths(RECENT_PATHS_NVRAM,&PathIsFileOnDisk);
+    n+=CleanUpRecentPaths(RECENT_PATHS_HOST_TRACE,&PathIsFileOnDisk);
 
     if(n>0) {
         m_msg.i.f("Removed %zu items\n",n);
@@ -2829,6 +2896,29 @@ bool BeebWindow::SaveDefaultNVRAMIsEnabled() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Grab the trace first, so that it covers whatever was happening when
+// the command was chosen rather than the file dialog.
+void BeebWindow::SaveHostTrace() {
+    std::string json=GetHostTraceChromeTrace(GetHostTraceThreads());
+
+    SaveFileDialog fd(RECENT_PATHS_HOST_TRACE);
+
+    fd.AddFilter("JSON files",{".json"});
+    fd.AddAllFilesFilter();
+
+    std::string path;
+    if(fd.Open(&path)) {
+        fd.AddLastPathToRecentPaths();
+
+        if(SaveTextFile(json,path,&m_msg)) {
+            m_msg.i.f("Saved activity trace: %s\n",path.c_str());
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void BeebWindow::SaveConfig() {
     this->SaveSettings();
 
@@ -2881,6 +2971,7 @@ ObjectCommandTable<BeebWindow> BeebWindow::ms_command_table("Beeb Window",{
     GetTogglePopupCommand<BeebWindowPopupType_Trace>(),
 #endif
     GetTogglePopupCommand<BeebWindowPopupType_AudioCallback>(),
+    GetTogglePopupCommand<BeebWindowPopupType_SubsystemProfiler>(),
     GetTogglePopupCommand<BeebWindowPopupType_CommandContextStack>(),
     GetTogglePopupCommand<BeebWindowPopupType_CommandKeymaps>(),
     {CommandDef("exit","Exit").MustConfirm(),&BeebWindow::Exit},
@@ -2924,6 +3015,7 @@ ObjectCommandTable<BeebWindow> BeebWindow::ms_command_table("Beeb Window",{
     GetTogglePopupCommand<BeebWindowPopupType_PagingDebugger>(),
     GetTogglePopupCommand<BeebWindowPopupType_BreakpointsDebugger>(),
     GetTogglePopupCommand<BeebWindowPopupType_StackDebugger>(),
+    GetTogglePopupCommand<BeebWindowPopupType_CycleProfiler>(),
 
     {CommandDef("debug_stop","Stop").Shortcut(SDLK_F5|PCKeyModifier_Shift),&BeebWindow::DebugStop,nullptr,&BeebWindow::DebugIsStopEnabled},
     {CommandDef("debug_run","Run").Shortcut(SDLK_F5),&BeebWindow::DebugRun,nullptr,&BeebWindow::DebugIsRunEnabled},
@@ -2933,5 +3025,6 @@ ObjectCommandTable<BeebWindow> BeebWindow::ms_command_table("Beeb Window",{
     {CommandDef("save_default_nvram","Save default NVRAM"),&BeebWindow::SaveDefaultNVRAM,nullptr,&BeebWindow::SaveDefaultNVRAMIsEnabled},
     {CommandDef("reset_default_nvram","Reset default NVRAM").MustConfirm(),&BeebWindow::ResetDefaultNVRAM,nullptr,&BeebWindow::SaveDefaultNVRAMIsEnabled},
     {CommandDef("save_config","Save config"),&BeebWindow::SaveConfig},
+    {CommandDef("save_host_trace","Save activity trace..."),&BeebWindow::SaveHostTrace},
     {CommandDef("toggle_prioritize_shortcuts","Prioritize command keys"),&BeebWindow::TogglePrioritizeCommandShortcuts,&BeebWindow::IsPrioritizeCommandShortcutsTicked,nullptr},
 });
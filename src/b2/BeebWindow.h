@@ -8,6 +8,7 @@
 
 struct BeebWindowInitArguments;
 class VBlankMonitor;
+struct VBlankPacingStats;
 class BeebThread;
 class TimelineUI;
 struct SDL_Texture;
@@ -71,6 +72,10 @@ struct BeebWindowSettings {
     bool correct_aspect_ratio=true;
     float display_manual_scale=1.f;
     bool display_filter=true;
+
+#if BBCMICRO_DEBUGGER
+    float debug_snapshot_rate=DEFAULT_DEBUG_SNAPSHOT_RATE_HZ;
+#endif
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -205,8 +210,6 @@ public:
     void HandleSDLTextInput(const char *text);
     void HandleSDLMouseMotionEvent(const SDL_MouseMotionEvent &event);
 
-    void ThreadFillAudioBuffer(SDL_AudioDeviceID audio_device_id,float *mix_buffer,size_t num_samples);
-
     bool HandleVBlank(VBlankMonitor *vblank_monitor,void *display_data,uint64_t ticks);
 
     bool HandleVBlank(uint64_t ticks);
@@ -219,6 +222,12 @@ public:
     // BeebThread is the same as that of the window.)
     std::shared_ptr<BeebThread> GetBeebThread() const;
 
+    // Copy of the TV output as it currently stands, RGBA, one byte per
+    // channel, TV_TEXTURE_WIDTH*TV_TEXTURE_HEIGHT. Between vblanks, the
+    // part of the display the beam hasn't reached yet is from the
+    // previous field - the same as what's on screen.
+    std::vector<uint8_t> GetTVOutputRGBA() const;
+
     //
     std::shared_ptr<MessageList> GetMessageList() const;
 
@@ -231,6 +240,10 @@ public:
 
     std::vector<VBlankRecord> GetVBlankRecords() const;
 
+    // Pacing stats for the display the window was on as of the last
+    // vblank, if the vblank monitor has any.
+    bool GetVBlankPacingStats(VBlankPacingStats *stats) const;
+
     const BeebKeymap *GetCurrentKeymap() const;
     void SetCurrentKeymap(const BeebKeymap *keymap);
 
@@ -274,6 +287,8 @@ private:
     std::vector<VBlankRecord> m_vblank_records;
     size_t m_vblank_index=0;
     uint64_t m_last_vblank_ticks=0;
+    const VBlankMonitor *m_vblank_monitor=nullptr;
+    void *m_vblank_display_data=nullptr;
 
     // TV output.
     TVOutput m_tv;
@@ -432,6 +447,7 @@ private:
     void ResetDefaultNVRAM();
     void SaveDefaultNVRAM();
     bool SaveDefaultNVRAMIsEnabled() const;
+    void SaveHostTrace();
 
     void SaveConfig();
 
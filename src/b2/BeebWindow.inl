@@ -60,6 +60,8 @@ EPN(SN76489Debugger)
 EPN(PagingDebugger)
 EPN(BreakpointsDebugger)
 EPN(StackDebugger)
+EPN(SubsystemProfiler)
+EPN(CycleProfiler)
 
 // must be last
 EQPN(MaxValue)
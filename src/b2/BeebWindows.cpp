@@ -22,15 +22,22 @@ LOG_EXTERN(OUTPUT);
 //////////////////////////////////////////////////////////////////////////
 
 struct BeebWindowsState {
-    // This mutex must be taken when creating or destroying a window. The
-    // locking here is a bit careless - this only exists for the benefit of
-    // the audio thread, which needs to run through the windows list.
+    // This mutex must be taken when creating or destroying a window, or
+    // renaming one. The locking here is a bit careless - this only exists
+    // for the benefit of the audio thread, which needs to run through the
+    // windows list, and the HTTP server thread, which looks up windows by
+    // name.
     //
     // (All other accesses to the windows list are from the main thread only,
     // so no locking necessary.)
     Mutex windows_mutex;
     std::vector<BeebWindow *> windows;
 
+    // The BeebThreads whose audio goes to each sound device. Only
+    // modified with the relevant sound device locked, so the audio
+    // callback can read it without taking windows_mutex.
+    std::vector<BeebWindows::AudioSource> audio_sources;
+
     std::vector<std::unique_ptr<BeebKeymap>> beeb_keymaps;
     std::vector<BeebConfig> configs;
     std::string default_config_name;
@@ -354,13 +361,47 @@ void BeebWindows::HandleVBlank(VBlankMonitor *vblank_monitor,void *display_data,
 //////////////////////////////////////////////////////////////////////////
 
 void BeebWindows::ThreadFillAudioBuffer(uint32_t audio_device_id,float *mix_buffer,size_t mix_buffer_size) {
-    // Just hold the lock for the duration - this shouldn't take too
-    // long, and the only thing it will block is creation or
-    // destruction of windows...
-    std::lock_guard<Mutex> lock(g_->windows_mutex);
+    // SDL holds the device lock for the duration of the callback, so
+    // audio_sources won't change underfoot.
+    for(const AudioSource &source:g_->audio_sources) {
+        if(source.device==audio_device_id) {
+            source.beeb_thread->AudioThreadMixAudioBuffer(mix_buffer,mix_buffer_size);
+        }
+    }
+}
 
-    for(BeebWindow *window:g_->windows) {
-        window->ThreadFillAudioBuffer(audio_device_id,mix_buffer,mix_buffer_size);
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebWindows::AddAudioSource(uint32_t audio_device_id,std::shared_ptr<BeebThread> beeb_thread) {
+    if(audio_device_id==0) {
+        return;
+    }
+
+    AudioDeviceLock lock(audio_device_id);
+
+    AudioSource source;
+    source.device=audio_device_id;
+    source.beeb_thread=std::move(beeb_thread);
+    g_->audio_sources.push_back(std::move(source));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BeebWindows::RemoveAudioSource(uint32_t audio_device_id,const BeebThread *beeb_thread) {
+    if(audio_device_id==0) {
+        return;
+    }
+
+    AudioDeviceLock lock(audio_device_id);
+
+    auto &&it=std::find_if(g_->audio_sources.begin(),g_->audio_sources.end(),[&](const AudioSource &source) {
+        return source.device==audio_device_id&&source.beeb_thread.get()==beeb_thread;
+    });
+
+    if(it!=g_->audio_sources.end()) {
+        g_->audio_sources.erase(it);
     }
 }
 
@@ -556,7 +597,14 @@ void BeebWindows::ForEachConfig(const std::function<bool(const BeebConfig *,Beeb
 //////////////////////////////////////////////////////////////////////////
 
 void BeebWindows::SetBeebWindowName(BeebWindow *window,std::string name) {
-    window->SetName(GetUniqueBeebWindowName(std::move(name),window));
+    name=GetUniqueBeebWindowName(std::move(name),window);
+
+    {
+        std::lock_guard<Mutex> lock(g_->windows_mutex);
+
+        window->SetName(std::move(name));
+    }
+
     window->UpdateTitle();
 }
 
@@ -608,6 +656,21 @@ BeebWindow *BeebWindows::FindBeebWindowByName(const std::string &name) {
     return nullptr;
 }
 
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<BeebThread> BeebWindows::FindBeebThreadByName(const std::string &name) {
+    std::lock_guard<Mutex> lock(g_->windows_mutex);
+
+    for(BeebWindow *window:g_->windows) {
+        if(window->GetName()==name) {
+            return window->GetBeebThread();
+        }
+    }
+
+    return nullptr;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -17,6 +17,7 @@
 class BeebState;
 class VBlankMonitor;
 class BeebWindow;
+class BeebThread;
 class BBCMicro;
 class DiscImage;
 struct BeebWindowInitArguments;
@@ -71,8 +72,20 @@ namespace BeebWindows {
 
     void HandleVBlank(VBlankMonitor *vblank_monitor,void *display_data,uint64_t ticks);
 
+    struct AudioSource {
+        uint32_t device=0;
+        std::shared_ptr<BeebThread> beeb_thread;
+    };
+
+    // Mixes in the audio from each BeebThread added for the given device.
+    // Call from the SDL audio callback only.
     void ThreadFillAudioBuffer(uint32_t audio_device_id,float *mix_buffer,size_t mix_buffer_size);
 
+    // Add/remove a BeebThread whose audio goes to the given sound device.
+    // Takes the device lock, so don't call from the audio callback.
+    void AddAudioSource(uint32_t audio_device_id,std::shared_ptr<BeebThread> beeb_thread);
+    void RemoveAudioSource(uint32_t audio_device_id,const BeebThread *beeb_thread);
+
     void UpdateWindowTitles();
 
     // If the keymap is in use by any windows, they'll be reset to use
@@ -139,6 +152,9 @@ namespace BeebWindows {
 
     BeebWindow *FindBeebWindowByName(const std::string &name);
 
+    // Safe to call from any thread.
+    std::shared_ptr<BeebThread> FindBeebThreadByName(const std::string &name);
+
     const std::vector<uint8_t> &GetLastWindowPlacementData();
     void SetLastWindowPlacementData(std::vector<uint8_t> placement_data);
 
@@ -0,0 +1,201 @@
+#include <shared/system.h>
+#include "CaptureJob.h"
+#include <beeb/BBCMicro.h>
+#include <beeb/video.h>
+#include <beeb/sound.h>
+#include <beeb/TVOutput.h>
+#include <shared/debug.h>
+#include "BeebThread.h"
+#include "filters.h"
+#include <string.h>
+#include <miniz.h>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Number of units to emulate per TVOutput update.
+static const size_t NUM_RENDER_UNITS=32;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+CaptureJob::CaptureJob(std::unique_ptr<BBCMicro> beeb,
+                       size_t num_fields,
+                       size_t num_sound_units,
+                       FinishedFun finished_fun):
+    m_beeb(std::move(beeb)),
+    m_num_fields(num_fields),
+    m_num_sound_units(num_sound_units),
+    m_finished_fun(std::move(finished_fun)),
+    m_fields_rgba(std::make_shared<std::vector<uint8_t>>())
+{
+    ASSERT(m_beeb);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+CaptureJob::~CaptureJob() {
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CaptureJob::ThreadExecute() {
+    this->ThreadCapture();
+
+    // Don't bother keeping this around any longer than necessary...
+    m_beeb.reset();
+
+    if(m_finished_fun) {
+        m_finished_fun(this);
+        m_finished_fun=nullptr;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<const std::vector<uint8_t>> CaptureJob::GetFieldsRGBA() const {
+    return m_fields_rgba;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::vector<uint8_t> CaptureJob::GetFieldsPNG() const {
+    return GetPNG(*m_fields_rgba);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::vector<uint8_t> CaptureJob::GetPNG(const std::vector<uint8_t> &rgba) {
+    std::vector<uint8_t> png;
+
+    if(rgba.empty()) {
+        return png;
+    }
+
+    size_t png_size;
+    void *png_data=tdefl_write_image_to_png_file_in_memory_ex(rgba.data(),
+                                                              TV_TEXTURE_WIDTH,
+                                                              (int)(rgba.size()/(TV_TEXTURE_WIDTH*4)),
+                                                              4,
+                                                              &png_size,
+                                                              MZ_DEFAULT_LEVEL,
+                                                              MZ_FALSE);
+    if(png_data) {
+        png.resize(png_size);
+        memcpy(png.data(),png_data,png_size);
+
+        mz_free(png_data);
+        png_data=nullptr;
+    }
+
+    return png;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+const std::vector<int16_t> &CaptureJob::GetPCM() const {
+    return m_pcm;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CaptureJob::ThreadCapture() {
+    BBCMicro *beeb=m_beeb.get();
+
+    // Video output setting isn't copied by Clone.
+    beeb->SetVideoEnabled(m_num_fields>0,0);
+
+    std::unique_ptr<TVOutput> tv_output(new TVOutput);
+    tv_output->Init(0,8,16);
+
+    m_fields_rgba->reserve(m_num_fields*TV_TEXTURE_WIDTH*TV_TEXTURE_HEIGHT*4);
+    m_pcm.reserve(m_num_sound_units);
+
+    SoundDataUnit sunit;
+    VideoDataUnit vunits[NUM_RENDER_UNITS];
+
+    // Same mix as the live audio, before the volume settings are
+    // applied.
+    auto update=[&]() {
+        for(size_t i=0;i<NUM_RENDER_UNITS;++i) {
+            uint32_t result=beeb->Update(&vunits[i],&sunit);
+
+            if(result&BBCMicroUpdateResultFlag_AudioUnit) {
+                if(m_pcm.size()<m_num_sound_units) {
+                    float value=(SN_VOLUMES_TABLE[sunit.sn_output.ch[0]]+
+                                 SN_VOLUMES_TABLE[sunit.sn_output.ch[1]]+
+                                 SN_VOLUMES_TABLE[sunit.sn_output.ch[2]]+
+                                 SN_VOLUMES_TABLE[sunit.sn_output.ch[3]])*(1/4.f);
+
+                    m_pcm.push_back((int16_t)(value*32767.f));
+                }
+            }
+        }
+
+        tv_output->Update(vunits,NUM_RENDER_UNITS);
+    };
+
+    if(m_num_fields>0) {
+        // Discard whatever's left of the current field - it'll only be
+        // partly drawn.
+        while(!tv_output->IsInVerticalBlank()) {
+            update();
+        }
+
+        for(size_t i=0;i<m_num_fields;++i) {
+            while(tv_output->IsInVerticalBlank()) {
+                update();
+            }
+
+            while(!tv_output->IsInVerticalBlank()) {
+                update();
+            }
+
+            if(this->WasCanceled()) {
+                return;
+            }
+
+            this->AddField(tv_output->GetTexturePixels(nullptr));
+        }
+    }
+
+    while(m_pcm.size()<m_num_sound_units) {
+        if(this->WasCanceled()) {
+            return;
+        }
+
+        update();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The TVOutput was initialised so the bytes are R, G, B in order from
+// the bottom; alpha is always 0, and needs filling in.
+void CaptureJob::AddField(const uint32_t *tv_texture_pixels) {
+    size_t n=(size_t)TV_TEXTURE_WIDTH*TV_TEXTURE_HEIGHT;
+
+    size_t offset=m_fields_rgba->size();
+    m_fields_rgba->resize(offset+n*4);
+    uint8_t *dest=m_fields_rgba->data()+offset;
+
+    for(size_t i=0;i<n;++i) {
+        uint32_t pixel=tv_texture_pixels[i];
+
+        *dest++=(uint8_t)(pixel>>0);
+        *dest++=(uint8_t)(pixel>>8);
+        *dest++=(uint8_t)(pixel>>16);
+        *dest++=0xff;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,75 @@
+#ifndef HEADER_6C8B53DA25BA4A39867250EAAB2F94D6// -*- mode:c++ -*-
+#define HEADER_6C8B53DA25BA4A39867250EAAB2F94D6
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Runs a copy of a BBCMicro, capturing its video and audio output -
+// independently of any window, so it doesn't matter whether the window
+// is visible, or how fast the emulation is running.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class BBCMicro;
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include "JobQueue.h"
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class CaptureJob:
+    public JobQueue::Job
+{
+public:
+    // Called on the job thread when the capture is done.
+    typedef std::function<void(CaptureJob *job)> FinishedFun;
+
+    // Capture the next NUM_FIELDS complete fields, and NUM_SOUND_UNITS
+    // sound units from now (one unit per SOUND_CLOCK_HZ tick).
+    CaptureJob(std::unique_ptr<BBCMicro> beeb,
+               size_t num_fields,
+               size_t num_sound_units,
+               FinishedFun finished_fun);
+    ~CaptureJob();
+
+    void ThreadExecute() override;
+
+    // The fields, RGBA, one after the other - so it's a single image
+    // TV_TEXTURE_WIDTH pixels wide and TV_TEXTURE_HEIGHT*num_fields
+    // pixels high. Shared, so it can be sent as an HTTP response without
+    // a copy.
+    std::shared_ptr<const std::vector<uint8_t>> GetFieldsRGBA() const;
+
+    // The same, as a PNG file. Returns an empty vector if the PNG
+    // couldn't be created.
+    std::vector<uint8_t> GetFieldsPNG() const;
+
+    // Make a PNG file from RGBA data TV_TEXTURE_WIDTH pixels wide, as
+    // GetFieldsPNG does.
+    static std::vector<uint8_t> GetPNG(const std::vector<uint8_t> &rgba);
+
+    // The sound output, mixed down to mono signed 16-bit samples, at
+    // SOUND_CLOCK_HZ.
+    const std::vector<int16_t> &GetPCM() const;
+protected:
+private:
+    std::unique_ptr<BBCMicro> m_beeb;
+    size_t m_num_fields=0;
+    size_t m_num_sound_units=0;
+    FinishedFun m_finished_fun;
+
+    std::shared_ptr<std::vector<uint8_t>> m_fields_rgba;
+    std::vector<int16_t> m_pcm;
+
+    void ThreadCapture();
+    void AddField(const uint32_t *tv_texture_pixels);
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
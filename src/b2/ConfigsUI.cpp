@@ -175,6 +175,10 @@ void ConfigsUI::DoImGui() {
                     edited=true;
                 }
 
+                if(ImGui::Checkbox("Turbo disc",&editable_config->turbo_disc)) {
+                    edited=true;
+                }
+
                 if(occupied!=0xffff) {
                     {
                         ImGuiIDPusher ram_id_pusher("ram");
@@ -0,0 +1,418 @@
+#include <shared/system.h>
+#include "CycleProfilerUI.h"
+
+#if BBCMICRO_DEBUGGER
+
+#include "SettingsUI.h"
+#include "BeebWindow.h"
+#include "BeebThread.h"
+#include "dear_imgui.h"
+#include "native_ui.h"
+#include "load_save.h"
+#include "Messages.h"
+#include <beeb/BBCMicro.h>
+#include <beeb/CycleProfiler.h>
+#include <shared/debug.h>
+#include <shared/mutex.h>
+#include <inttypes.h>
+#include <algorithm>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const std::string RECENT_PATHS_PROFILES("profiles");
+
+// How often the emulation thread copies the counts for the UI.
+static const double COUNTS_UPDATE_INTERVAL_SECONDS=.25;
+
+static const size_t NUM_TOP_ADDRESSES=32;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Shared between the UI and the VSyncFn that runs on the BeebThread - the
+// same arrangement as the Emulator Profiler.
+struct CycleProfilerUIState {
+    Mutex mutex;
+
+    // Set by the UI.
+    bool profiling=false;
+    bool reset=false;
+
+    // Whether the VSyncFn is active.
+    bool vsync_fn_added=false;
+
+    // Set by the VSyncFn.
+    uint64_t counts_ticks=0;
+    bool new_counts=false;
+    const BBCMicroType *type=nullptr;
+    std::vector<CycleProfilerCounts> counts;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class CycleProfilerUI:
+    public SettingsUI
+{
+public:
+    explicit CycleProfilerUI(BeebWindow *beeb_window);
+    ~CycleProfilerUI();
+
+    void DoImGui() override;
+    bool OnClose() override;
+protected:
+private:
+    // Consecutive big pages with the same code are shown together.
+    struct Bank {
+        const BigPageMetadata *metadata=nullptr;
+        CycleProfilerCounts counts;
+    };
+
+    BeebWindow *m_beeb_window=nullptr;
+    std::shared_ptr<CycleProfilerUIState> m_state;
+
+    bool m_profiling=false;
+    const BBCMicroType *m_type=nullptr;
+    std::vector<CycleProfilerCounts> m_counts;
+
+    // Derived from m_counts when it's updated.
+    CycleProfilerCounts m_total;
+    std::vector<Bank> m_banks;
+    std::vector<uint32_t> m_top_indexes;
+
+    void SetProfiling(bool profiling);
+    void UpdateCounts();
+    void UpdateCountsSummary();
+    void DoBanksImGui();
+    void DoAddressesImGui();
+    void SaveCallgrind();
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+CycleProfilerUI::CycleProfilerUI(BeebWindow *beeb_window):
+    m_beeb_window(beeb_window),
+    m_state(std::make_shared<CycleProfilerUIState>())
+{
+    MUTEX_SET_NAME(m_state->mutex,"CycleProfilerUIState");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+CycleProfilerUI::~CycleProfilerUI() {
+    this->SetProfiling(false);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::DoImGui() {
+    this->UpdateCounts();
+
+    bool profiling=m_profiling;
+    if(ImGui::Checkbox("Profile",&profiling)) {
+        this->SetProfiling(profiling);
+    }
+
+    ImGui::SameLine();
+
+    if(ImGui::Button("Reset")) {
+        std::lock_guard<Mutex> lock(m_state->mutex);
+
+        m_state->reset=true;
+    }
+
+    ImGui::SameLine();
+
+    if(ImGui::Button("Save Callgrind...")) {
+        this->SaveCallgrind();
+    }
+
+    if(!m_type) {
+        ImGui::TextUnformatted("No profile.");
+        return;
+    }
+
+    ImGui::Text("Cycles: %" PRIu64,m_total.num_cycles);
+    ImGui::Text("Instructions: %" PRIu64,m_total.num_instructions);
+    if(m_total.num_instructions>0) {
+        ImGui::Text("Cycles/instruction: %.2f",(double)m_total.num_cycles/m_total.num_instructions);
+    }
+
+    if(ImGui::CollapsingHeader("Banks",ImGuiTreeNodeFlags_DefaultOpen)) {
+        this->DoBanksImGui();
+    }
+
+    if(ImGui::CollapsingHeader("Hottest Addresses",ImGuiTreeNodeFlags_DefaultOpen)) {
+        this->DoAddressesImGui();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool CycleProfilerUI::OnClose() {
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::SetProfiling(bool profiling) {
+    m_profiling=profiling;
+
+    bool add_vsync_fn=false;
+    {
+        std::lock_guard<Mutex> lock(m_state->mutex);
+
+        m_state->profiling=profiling;
+
+        if(m_state->profiling&&!m_state->vsync_fn_added) {
+            m_state->vsync_fn_added=true;
+            add_vsync_fn=true;
+        }
+    }
+
+    if(add_vsync_fn) {
+        std::shared_ptr<CycleProfilerUIState> state=m_state;
+
+        m_beeb_window->GetBeebThread()->AddVSyncFn([state](BBCMicro *beeb)->bool {
+            std::lock_guard<Mutex> lock(state->mutex);
+
+            if(!state->profiling) {
+                beeb->SetCycleProfiling(false);
+                state->vsync_fn_added=false;
+                return false;
+            }
+
+            if(!beeb->IsCycleProfiling()) {
+                beeb->SetCycleProfiling(true);
+            }
+
+            CycleProfiler *profiler=beeb->GetCycleProfiler();
+
+            if(state->reset) {
+                profiler->Reset();
+                state->reset=false;
+            }
+
+            uint64_t now_ticks=GetCurrentTickCount();
+            if(GetSecondsFromTicks(now_ticks-state->counts_ticks)>=COUNTS_UPDATE_INTERVAL_SECONDS) {
+                state->type=beeb->GetType();
+                state->counts=profiler->GetCounts();
+                state->counts_ticks=now_ticks;
+                state->new_counts=true;
+            }
+
+            return true;
+        });
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::UpdateCounts() {
+    bool new_counts=false;
+
+    {
+        std::lock_guard<Mutex> lock(m_state->mutex);
+
+        if(m_state->new_counts) {
+            m_type=m_state->type;
+            m_counts.swap(m_state->counts);
+            m_state->new_counts=false;
+            new_counts=true;
+        }
+    }
+
+    if(new_counts) {
+        this->UpdateCountsSummary();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::UpdateCountsSummary() {
+    ASSERT(m_counts.size()==(size_t)NUM_BIG_PAGES*CycleProfiler::NUM_BIG_PAGE_COUNTS);
+
+    m_total=CycleProfilerCounts();
+    m_banks.clear();
+    m_top_indexes.clear();
+
+    for(uint8_t big_page=0;big_page<NUM_BIG_PAGES;++big_page) {
+        const BigPageMetadata *metadata=&m_type->big_pages_metadata[big_page];
+
+        if(m_banks.empty()||m_banks.back().metadata->code!=metadata->code) {
+            m_banks.emplace_back();
+            m_banks.back().metadata=metadata;
+        }
+
+        Bank *bank=&m_banks.back();
+
+        for(size_t offset=0;offset<CycleProfiler::NUM_BIG_PAGE_COUNTS;++offset) {
+            size_t index=big_page*CycleProfiler::NUM_BIG_PAGE_COUNTS+offset;
+            const CycleProfilerCounts *counts=&m_counts[index];
+
+            if(counts->num_cycles>0) {
+                bank->counts.num_cycles+=counts->num_cycles;
+                bank->counts.num_instructions+=counts->num_instructions;
+                m_top_indexes.push_back((uint32_t)index);
+            }
+        }
+
+        m_total.num_cycles+=bank->counts.num_cycles;
+        m_total.num_instructions+=bank->counts.num_instructions;
+    }
+
+    m_banks.erase(std::remove_if(m_banks.begin(),m_banks.end(),[](const Bank &bank) {
+        return bank.counts.num_cycles==0;
+    }),m_banks.end());
+
+    std::sort(m_banks.begin(),m_banks.end(),[](const Bank &a,const Bank &b) {
+        return a.counts.num_cycles>b.counts.num_cycles;
+    });
+
+    size_t n=std::min(m_top_indexes.size(),NUM_TOP_ADDRESSES);
+
+    std::partial_sort(m_top_indexes.begin(),
+                      m_top_indexes.begin()+(ptrdiff_t)n,
+                      m_top_indexes.end(),
+                      [this](uint32_t a,uint32_t b) {
+                          return m_counts[a].num_cycles>m_counts[b].num_cycles;
+                      });
+
+    m_top_indexes.resize(n);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::DoBanksImGui() {
+    if(m_banks.empty()) {
+        ImGui::TextUnformatted("No cycles.");
+        return;
+    }
+
+    ImGui::Columns(4,"banks",true);
+
+    ImGui::TextUnformatted("Bank");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Cycles");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Instructions");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Time");
+    ImGui::NextColumn();
+
+    ImGui::Separator();
+
+    for(const Bank &bank:m_banks) {
+        ImGui::Text("%c: %s",bank.metadata->code,bank.metadata->description.c_str());
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,bank.counts.num_cycles);
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,bank.counts.num_instructions);
+        ImGui::NextColumn();
+
+        float fraction=m_total.num_cycles>0?(float)((double)bank.counts.num_cycles/m_total.num_cycles):0.f;
+        char overlay[20];
+        snprintf(overlay,sizeof overlay,"%.1f%%",fraction*100.f);
+        ImGui::ProgressBar(fraction,ImVec2(-1.f,0.f),overlay);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::DoAddressesImGui() {
+    if(m_top_indexes.empty()) {
+        ImGui::TextUnformatted("No cycles.");
+        return;
+    }
+
+    ImGui::Columns(5,"addresses",true);
+
+    ImGui::TextUnformatted("Address");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Cycles");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Instructions");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Cycles/instruction");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Time");
+    ImGui::NextColumn();
+
+    ImGui::Separator();
+
+    for(uint32_t index:m_top_indexes) {
+        const CycleProfilerCounts *counts=&m_counts[index];
+        const BigPageMetadata *metadata=&m_type->big_pages_metadata[index/CycleProfiler::NUM_BIG_PAGE_COUNTS];
+        size_t addr=metadata->addr+index%CycleProfiler::NUM_BIG_PAGE_COUNTS;
+
+        ImGui::Text("%c%c$%04zx",metadata->code,ADDRESS_PREFIX_SEPARATOR,addr);
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,counts->num_cycles);
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,counts->num_instructions);
+        ImGui::NextColumn();
+
+        if(counts->num_instructions>0) {
+            ImGui::Text("%.2f",(double)counts->num_cycles/counts->num_instructions);
+        }
+        ImGui::NextColumn();
+
+        ImGui::Text("%.2f%%",m_total.num_cycles>0?100.*counts->num_cycles/m_total.num_cycles:0.);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfilerUI::SaveCallgrind() {
+    if(!m_type) {
+        return;
+    }
+
+    SaveFileDialog fd(RECENT_PATHS_PROFILES);
+
+    fd.AddFilter("Callgrind files",{".out"});
+    fd.AddAllFilesFilter();
+
+    std::string path;
+    if(fd.Open(&path)) {
+        fd.AddLastPathToRecentPaths();
+
+        Messages msg(m_beeb_window->GetMessageList());
+        if(SaveTextFile(GetCycleProfileCallgrind(m_counts,m_type),path,&msg)) {
+            msg.i.f("Saved cycle profile: %s\n",path.c_str());
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<SettingsUI> CreateCycleProfilerUI(BeebWindow *beeb_window) {
+    return std::make_unique<CycleProfilerUI>(beeb_window);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
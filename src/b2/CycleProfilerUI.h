@@ -0,0 +1,26 @@
+#ifndef HEADER_6163352527FA4268A700365D14324A05// -*- mode:c++ -*-
+#define HEADER_6163352527FA4268A700365D14324A05
+
+#include "conf.h"
+
+#if BBCMICRO_DEBUGGER
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+
+class BeebWindow;
+class SettingsUI;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<SettingsUI> CreateCycleProfilerUI(BeebWindow *beeb_window);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
+
+#endif
@@ -5,6 +5,7 @@
 #include "dear_imgui.h"
 #include <shared/debug.h>
 #include "SettingsUI.h"
+#include "VBlankMonitor.h"
 #include <inttypes.h>
 
 //////////////////////////////////////////////////////////////////////////
@@ -171,6 +172,28 @@ static float GetPercentage(void *data_,int idx) {
     return (float)(emu_us/real_us*100.);
 }
 
+static float GetPacingHistogramPercentage(void *data_,int idx) {
+    auto data=(const uint64_t *)data_;
+
+    ASSERT(idx>=0&&(size_t)idx<VBlankPacingStats::NUM_BUCKETS);
+
+    uint64_t total=0;
+    for(size_t i=0;i<VBlankPacingStats::NUM_BUCKETS;++i) {
+        total+=data[i];
+    }
+
+    if(total==0) {
+        return 0.f;
+    } else {
+        return (float)((double)data[idx]/total*100.);
+    }
+}
+
+static void PacingHistogramUI(const char *name,const uint64_t *buckets,uint64_t max_us) {
+    ImGui::Text("%s (%" PRIu64 " usec/bar; max=%" PRIu64 " usec)",name,VBlankPacingStats::BUCKET_US,max_us);
+    ImGuiPlotHistogram("",&GetPacingHistogramPercentage,(void *)buckets,(int)VBlankPacingStats::NUM_BUCKETS,0,nullptr,0.f,100.f,ImVec2(0,100));
+}
+
 #if MUTEX_DEBUGGING
 static bool EverLocked(const MutexMetadata *m) {
     if(m->num_locks>0) {
@@ -217,6 +240,18 @@ void DataRateUI::DoImGui() {
     ImGui::TextUnformatted("Video Data Availability (mark=50%)");
     ImGuiPlotLines("",&GetPercentage,&vblank_records,(int)vblank_records.size(),0,nullptr,0.f,200.f,ImVec2(0,100),ImVec2(0,50));
 
+    VBlankPacingStats pacing_stats;
+    if(m_beeb_window->GetVBlankPacingStats(&pacing_stats)) {
+        ImGui::Separator();
+
+        ImGui::Text("VBlank Pacing: %" PRIu64 " usec interval; %" PRIu64 " vblanks; %" PRIu64 " missed",
+                    pacing_stats.interval_us,
+                    pacing_stats.num_vblanks,
+                    pacing_stats.num_missed);
+        PacingHistogramUI("Latency",pacing_stats.latency,pacing_stats.max_latency_us);
+        PacingHistogramUI("Jitter",pacing_stats.jitter,pacing_stats.max_jitter_us);
+    }
+
     if(!!g_all_root_timer_defs&&!g_all_root_timer_defs->empty()) {
         ImGui::Separator();
         for(TimerDef *def:*g_all_root_timer_defs) {
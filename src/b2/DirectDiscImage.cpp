@@ -3,9 +3,9 @@
 #include "misc.h"
 #include "load_save.h"
 #include "DirectDiscImage.h"
-#include "native_ui.h"
 #include "Messages.h"
 #include <limits.h>
+#include <string.h>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -90,12 +90,8 @@ std::string DirectDiscImage::GetDescription() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-// TODO - basically the same as MemoryDiscImage.
-void DirectDiscImage::AddFileDialogFilter(FileDialog *fd) const {
-    if(const char *ext=GetExtensionFromDiscGeometry(m_geometry)) {
-        std::string pattern=std::string("*")+ext;
-        fd->AddFilter("BBC disc image",{pattern});
-    }
+const char *DirectDiscImage::GetFileExtension() const {
+    return GetExtensionFromDiscGeometry(m_geometry);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -174,6 +170,63 @@ bool DirectDiscImage::Write(uint8_t side,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool DirectDiscImage::ReadSector(uint8_t *buf,
+                                 size_t size,
+                                 uint8_t side,
+                                 uint8_t track,
+                                 uint8_t sector) const
+{
+    if(size>m_geometry.bytes_per_sector) {
+        return false;
+    }
+
+    FILE *fp=this->fopenAndSeek("rb",side,track,sector,0);
+    if(!fp) {
+        return false;
+    }
+
+    // As with Read, anything past the end of a truncated file is 0.
+    size_t n=fread(buf,1,size,fp);
+    memset(buf+n,0,size-n);
+
+    fclose(fp);
+    fp=nullptr;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool DirectDiscImage::WriteSector(uint8_t side,
+                                  uint8_t track,
+                                  uint8_t sector,
+                                  const uint8_t *buf,
+                                  size_t size)
+{
+    if(size>m_geometry.bytes_per_sector) {
+        return false;
+    }
+
+    FILE *fp=this->fopenAndSeek("r+b",side,track,sector,0);
+    if(!fp) {
+        return false;
+    }
+
+    bool good=false;
+    if(fwrite(buf,1,size,fp)==size) {
+        good=true;
+    }
+
+    fclose(fp);
+    fp=nullptr;
+
+    return good;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 // TDOO - same as MemoryDiscImage.
 bool DirectDiscImage::GetDiscSectorSize(size_t *size,
                                         uint8_t side,
@@ -46,12 +46,14 @@ public:
     std::string GetLoadMethod() const override;
     std::string GetDescription() const override;
 
-    void AddFileDialogFilter(FileDialog *fd) const override;
+    const char *GetFileExtension() const override;
 
     bool SaveToFile(const std::string &file_name,Messages *msg) const override;
 
     bool Read(uint8_t *value,uint8_t side,uint8_t track,uint8_t sector,size_t offset) const override;
     bool Write(uint8_t side,uint8_t track,uint8_t sector,size_t offset,uint8_t value) override;
+    bool ReadSector(uint8_t *buf,size_t size,uint8_t side,uint8_t track,uint8_t sector) const override;
+    bool WriteSector(uint8_t side,uint8_t track,uint8_t sector,const uint8_t *buf,size_t size) override;
 
     bool GetDiscSectorSize(size_t *size,uint8_t side,uint8_t track,uint8_t sector,bool double_density) const override;
     bool IsWriteProtected() const override;
@@ -7,7 +7,68 @@
 #include <beeb/video.h>
 #include <beeb/sound.h>
 #include <shared/debug.h>
+#include <shared/sha1.h>
+#include <shared/path.h>
+#include <shared/mutex.h>
+#include <beeb/TVOutput.h>
+#include "load_save.h"
+#include "misc.h"
 #include <SDL.h>
+#include <stdio.h>
+#include <miniz.h>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Bump this if the thumbnail generation changes in a way that would make
+// existing cached thumbnails look different.
+static const uint32_t THUMBNAIL_CACHE_VERSION=3;
+
+// Number of units to emulate per TVOutput update when rendering.
+static const size_t NUM_RENDER_UNITS=32;
+
+// The cache folder is emptied when it would get bigger than this.
+// Compressed, a thumbnail is typically a few tens of KB.
+static const uint64_t MAX_THUMBNAIL_CACHE_SIZE=64*1024*1024;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static Mutex g_thumbnail_cache_mutex;
+static bool g_thumbnail_cache_size_known=false;
+static uint64_t g_thumbnail_cache_size=0;
+
+// Make room for SIZE more bytes in the cache folder, emptying it if
+// necessary. The size on disk is only checked once per run, then kept up
+// to date from here - so another b2 running at the same time can make it
+// go over a bit, but not for long.
+static void MakeThumbnailCacheRoom(const std::string &folder,uint64_t size) {
+    std::lock_guard<Mutex> lock(g_thumbnail_cache_mutex);
+
+    if(!g_thumbnail_cache_size_known) {
+        PathGlob(folder,[](const std::string &path,bool is_folder) {
+            size_t file_size;
+            bool can_write;
+            if(!is_folder&&GetFileDetails(&file_size,&can_write,path.c_str())) {
+                g_thumbnail_cache_size+=file_size;
+            }
+        });
+
+        g_thumbnail_cache_size_known=true;
+    }
+
+    if(g_thumbnail_cache_size+size>MAX_THUMBNAIL_CACHE_SIZE) {
+        PathGlob(folder,[](const std::string &path,bool is_folder) {
+            if(!is_folder) {
+                remove(path.c_str());
+            }
+        });
+
+        g_thumbnail_cache_size=0;
+    }
+
+    g_thumbnail_cache_size+=size;
+}
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -32,43 +93,238 @@ bool GenerateThumbnailJob::Init(std::shared_ptr<const BeebState> beeb_state,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+JobPriority GenerateThumbnailJob::GetPriority() const {
+    return JobPriority_Interactive;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void GenerateThumbnailJob::ThreadExecute() {
+    m_thumbnail_pixels.resize(THUMBNAIL_WIDTH*THUMBNAIL_HEIGHT);
+
+    this->ThreadGenerateThumbnail();
+
+    // Don't bother keeping these around any longer than necessary...
+    m_beeb.reset();
+    m_beeb_state.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+const void *GenerateThumbnailJob::GetThumbnailPixels() const {
+    return m_thumbnail_pixels.data();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void GenerateThumbnailJob::ThreadGenerateThumbnail() {
     if(!m_beeb) {
+        if(const void *tv_texture_data=m_beeb_state->GetTVTextureData()) {
+            // The picture's already there.
+            this->Downscale((const uint32_t *)tv_texture_data);
+            return;
+        }
+
         m_beeb=m_beeb_state->CloneBBCMicro();
     }
 
+    std::string cache_file_name=this->GetCacheFileName();
+    if(!cache_file_name.empty()) {
+        if(this->LoadCachedThumbnail(cache_file_name)) {
+            return;
+        }
+    }
+
+    if(this->WasCanceled()) {
+        return;
+    }
+
+    // Allocated here rather than being a member, as most of the time
+    // it won't be needed.
+    std::unique_ptr<TVOutput> tv_output(new TVOutput);
+    tv_output->Init(m_rshift,m_gshift,m_bshift);
+
     // Discard the first frame - it'll probably be junk.
     BBCMicro *beeb=m_beeb.get();
 
     SoundDataUnit sunit;
-    VideoDataUnit vunits[2];
+    VideoDataUnit vunits[NUM_RENDER_UNITS];
 
+    // Overshooting the start of the vertical blank by a few units is
+    // harmless, as nothing is drawn then.
     for(int i=0;i<m_num_frames;++i) {
-        while(m_tv_output.IsInVerticalBlank()) {
-            beeb->Update(&vunits[0],&sunit);
-            beeb->Update(&vunits[1],&sunit);
+        while(tv_output->IsInVerticalBlank()) {
+            for(size_t j=0;j<NUM_RENDER_UNITS;++j) {
+                beeb->Update(&vunits[j],&sunit);
+            }
 
-            m_tv_output.Update(vunits,2);
+            tv_output->Update(vunits,NUM_RENDER_UNITS);
         }
 
-        while(!m_tv_output.IsInVerticalBlank()) {
-            beeb->Update(&vunits[0],&sunit);
-            beeb->Update(&vunits[1],&sunit);
+        while(!tv_output->IsInVerticalBlank()) {
+            for(size_t j=0;j<NUM_RENDER_UNITS;++j) {
+                beeb->Update(&vunits[j],&sunit);
+            }
 
-            m_tv_output.Update(vunits,2);
+            tv_output->Update(vunits,NUM_RENDER_UNITS);
         }
     }
 
-    // Don't bother keeping these around any longer than necessary...
-    m_beeb.reset();
-    m_beeb_state.reset();
+    this->Downscale(tv_output->GetTexturePixels(nullptr));
+
+    if(!cache_file_name.empty()) {
+        this->SaveCachedThumbnail(cache_file_name);
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-const void *GenerateThumbnailJob::GetTexturePixels() const {
-    return m_tv_output.GetTexturePixels(nullptr);
+// The hash covers the thumbnail settings and the whole emulated state
+// that could make a difference to the picture - see BBCMicro::UpdateHash.
+// Returns an empty string, meaning don't cache, if there's a disc image
+// that can't be hashed.
+std::string GenerateThumbnailJob::GetCacheFileName() const {
+    SHA1 hasher;
+
+    hasher.Update(&THUMBNAIL_CACHE_VERSION,sizeof THUMBNAIL_CACHE_VERSION);
+
+    uint32_t params[]={
+        (uint32_t)THUMBNAIL_WIDTH,
+        (uint32_t)THUMBNAIL_HEIGHT,
+        (uint32_t)m_num_frames,
+        m_rshift,
+        m_gshift,
+        m_bshift,
+    };
+    hasher.Update(params,sizeof params);
+
+    if(!m_beeb->UpdateHash(&hasher)) {
+        return std::string();
+    }
+
+    char digest_str[SHA1::DIGEST_STR_SIZE];
+    hasher.Finish(nullptr,digest_str);
+
+    return GetCachePath(PathJoined("thumbnails",std::string(digest_str)+".bin"));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool GenerateThumbnailJob::LoadCachedThumbnail(const std::string &file_name) {
+    FILE *f=fopenUTF8(file_name.c_str(),"rb");
+    if(!f) {
+        return false;
+    }
+
+    std::vector<uint8_t> compressed;
+    uint8_t buf[16384];
+    size_t num_read;
+    while((num_read=fread(buf,1,sizeof buf,f))>0) {
+        compressed.insert(compressed.end(),buf,buf+num_read);
+    }
+
+    bool good=!ferror(f);
+
+    fclose(f);
+    f=nullptr;
+
+    if(!good) {
+        return false;
+    }
+
+    // Too much data doesn't fit, and makes mz_uncompress fail; make sure
+    // there wasn't too little either.
+    mz_ulong size=(mz_ulong)(m_thumbnail_pixels.size()*sizeof m_thumbnail_pixels[0]);
+    mz_ulong num_uncompressed=size;
+    if(mz_uncompress((unsigned char *)m_thumbnail_pixels.data(),
+                     &num_uncompressed,
+                     compressed.data(),
+                     (mz_ulong)compressed.size())!=MZ_OK)
+    {
+        return false;
+    }
+
+    return num_uncompressed==size;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Compressed with miniz, and written to a temp file then renamed, so
+// another job generating the same thumbnail can't read a partial file.
+// Errors are ignored - the cache is only an optimization.
+void GenerateThumbnailJob::SaveCachedThumbnail(const std::string &file_name) const {
+    std::string folder=PathGetFolder(file_name);
+    if(!PathCreateFolder(folder)) {
+        return;
+    }
+
+    mz_ulong size=(mz_ulong)(m_thumbnail_pixels.size()*sizeof m_thumbnail_pixels[0]);
+    mz_ulong compressed_size=mz_compressBound(size);
+    std::vector<uint8_t> compressed(compressed_size);
+    if(mz_compress(compressed.data(),
+                   &compressed_size,
+                   (const unsigned char *)m_thumbnail_pixels.data(),
+                   size)!=MZ_OK)
+    {
+        return;
+    }
+
+    MakeThumbnailCacheRoom(folder,compressed_size);
+
+    std::string temp_file_name=strprintf("%s.%p.tmp",file_name.c_str(),(const void *)this);
+
+    FILE *f=fopenUTF8(temp_file_name.c_str(),"wb");
+    if(!f) {
+        return;
+    }
+
+    bool good=fwrite(compressed.data(),1,compressed_size,f)==compressed_size;
+
+    if(fclose(f)!=0) {
+        good=false;
+    }
+    f=nullptr;
+
+    if(good) {
+        if(rename(temp_file_name.c_str(),file_name.c_str())==0) {
+            return;
+        }
+    }
+
+    remove(temp_file_name.c_str());
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Average each 2x2 block. Each channel is 8 bits, wherever it is, so
+// alternate bytes can be summed in parallel without overflowing into
+// the next.
+void GenerateThumbnailJob::Downscale(const uint32_t *tv_texture_pixels) {
+    static_assert(TV_TEXTURE_WIDTH==THUMBNAIL_WIDTH*2,"");
+    static_assert(TV_TEXTURE_HEIGHT==THUMBNAIL_HEIGHT*2,"");
+
+    uint32_t *dest=m_thumbnail_pixels.data();
+
+    for(int y=0;y<THUMBNAIL_HEIGHT;++y) {
+        const uint32_t *src0=tv_texture_pixels+(y*2+0)*TV_TEXTURE_WIDTH;
+        const uint32_t *src1=tv_texture_pixels+(y*2+1)*TV_TEXTURE_WIDTH;
+
+        for(int x=0;x<THUMBNAIL_WIDTH;++x) {
+            uint32_t a=src0[x*2+0],b=src0[x*2+1],c=src1[x*2+0],d=src1[x*2+1];
+
+            uint32_t even=((a&0x00ff00ff)+(b&0x00ff00ff)+(c&0x00ff00ff)+(d&0x00ff00ff))>>2&0x00ff00ff;
+            uint32_t odd=((a>>8&0x00ff00ff)+(b>>8&0x00ff00ff)+(c>>8&0x00ff00ff)+(d>>8&0x00ff00ff))>>2&0x00ff00ff;
+
+            *dest++=even|odd<<8;
+        }
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -81,7 +337,9 @@ bool GenerateThumbnailJob::Init(std::unique_ptr<BBCMicro> *beeb,
 {
     ASSERT(!!beeb!=!!beeb_state);
 
-    m_tv_output.Init(pixel_format->Rshift,pixel_format->Gshift,pixel_format->Bshift);
+    m_rshift=pixel_format->Rshift;
+    m_gshift=pixel_format->Gshift;
+    m_bshift=pixel_format->Bshift;
 
     if(beeb) {
         m_beeb=std::move(*beeb);
@@ -16,8 +16,9 @@ struct SDL_PixelFormat;
 
 #include <beeb/conf.h>
 #include <memory>
+#include <vector>
+#include <string>
 #include "JobQueue.h"
-#include <beeb/TVOutput.h>
 #include "BeebConfig.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -37,15 +38,31 @@ public:
               int num_frames,
               const SDL_PixelFormat *pixel_format);
     
+    // Thumbnails are for the UI, so they go ahead of background jobs.
+    JobPriority GetPriority() const override;
+
+    // If the state has a TV texture, that's just downscaled. Otherwise,
+    // the result is looked for in the on-disk thumbnail cache, keyed by a
+    // hash of the BBCMicro's state, and only emulated (and then cached) if
+    // not found.
     void ThreadExecute() override;
 
-    const void *GetTexturePixels() const;
+    // THUMBNAIL_WIDTH*THUMBNAIL_HEIGHT pixels, in the pixel format
+    // supplied to Init.
+    const void *GetThumbnailPixels() const;
 private:
     std::shared_ptr<const BeebState> m_beeb_state;
     std::unique_ptr<BBCMicro> m_beeb;
-    TVOutput m_tv_output;
+    uint32_t m_rshift=0,m_gshift=0,m_bshift=0;
     int m_num_frames=2;
-    
+    std::vector<uint32_t> m_thumbnail_pixels;
+
+    void ThreadGenerateThumbnail();
+    std::string GetCacheFileName() const;
+    bool LoadCachedThumbnail(const std::string &file_name);
+    void SaveCachedThumbnail(const std::string &file_name) const;
+    void Downscale(const uint32_t *tv_texture_pixels);
+
     bool Init(std::unique_ptr<BBCMicro> *beeb,
               std::shared_ptr<const BeebState> *beeb_state,
               int num_frames,
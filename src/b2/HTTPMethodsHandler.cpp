@@ -19,6 +19,8 @@
 #include "Messages.h"
 #include <shared/path.h>
 #include "DiscGeometry.h"
+#include "CaptureJob.h"
+#include <beeb/sound.h>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -26,11 +28,32 @@
 // somewhat arbitrary limit here...
 static const uint64_t MAX_PEEK_SIZE=4*1024*1024;
 
+// Limits for frame and audio captures. A field is ~1.6 MBytes as RGBA.
+static const uint32_t MAX_NUM_CAPTURE_FIELDS=50;
+static const uint32_t MAX_CAPTURE_MS=60000;
+
+static const std::string PNG_CONTENT_TYPE="image/png";
 static const std::string PRG_CONTENT_TYPE="application/x-c64-program";
 static const std::string PRG_EXTENSION=".prg";
 
 static const std::string HTTP_DISC_IMAGE_LOAD_METHOD="http";
 
+// Sizes of the ops in a batch request body, excluding the type byte and
+// any poke data.
+static const size_t BATCH_PEEK_SIZE=8;
+static const size_t BATCH_POKE_SIZE=8;
+static const size_t BATCH_CALL_SIZE=6;
+static const size_t BATCH_KEY_SIZE=2;
+
+// Sizes of the steps in a script request body, excluding the type byte
+// and any paste text.
+static const size_t SCRIPT_KEY_SIZE=2;
+static const size_t SCRIPT_PASTE_SIZE=4;
+static const size_t SCRIPT_WAIT_CYCLES_SIZE=4;
+static const size_t SCRIPT_WAIT_PC_SIZE=2;
+static const size_t SCRIPT_WAIT_BYTE_SIZE=4;
+static const size_t SCRIPT_WAIT_OSWORD_SIZE=1;
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
@@ -59,6 +82,262 @@ static std::vector<std::string> GetPathParts(const std::string &path) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+static uint32_t GetLE(const uint8_t *p,size_t n) {
+    uint32_t value=0;
+
+    for(size_t i=0;i<n;++i) {
+        value|=(uint32_t)p[i]<<(i*8);
+    }
+
+    return value;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Parse batch request body. See the HTTP API docs for the format.
+//
+// Returns false and fills in *ERROR if the body is bad.
+static bool GetBatchOps(std::vector<BeebThread::BatchOp> *ops,
+                        std::string *error,
+                        const std::vector<uint8_t> &body)
+{
+    uint64_t total_num_peek_bytes=0;
+    bool got_call=false;
+    size_t i=0;
+
+    while(i<body.size()) {
+        BeebThread::BatchOp op;
+        op.type=(BeebThreadBatchOpType)body[i++];
+
+        size_t op_size;
+        switch(op.type) {
+        case BeebThreadBatchOpType_Peek:
+            op_size=BATCH_PEEK_SIZE;
+            break;
+
+        case BeebThreadBatchOpType_Poke:
+            op_size=BATCH_POKE_SIZE;
+            break;
+
+        case BeebThreadBatchOpType_Call:
+            op_size=BATCH_CALL_SIZE;
+            break;
+
+        case BeebThreadBatchOpType_Key:
+            op_size=BATCH_KEY_SIZE;
+            break;
+
+        default:
+            *error=strprintf("offset %zu: bad op type: %u",i-1,(unsigned)op.type);
+            return false;
+        }
+
+        if(body.size()-i<op_size) {
+            *error=strprintf("offset %zu: truncated %s op",i-1,GetBeebThreadBatchOpTypeEnumName(op.type));
+            return false;
+        }
+
+        const uint8_t *p=&body[i];
+        i+=op_size;
+
+        switch(op.type) {
+        case BeebThreadBatchOpType_Peek:
+            op.addr=GetLE(p+0,4);
+            op.num_bytes=GetLE(p+4,4);
+
+            total_num_peek_bytes+=op.num_bytes;
+            if(total_num_peek_bytes>MAX_PEEK_SIZE) {
+                *error=strprintf("total peek size is too large: %" PRIu64,total_num_peek_bytes);
+                return false;
+            }
+            break;
+
+        case BeebThreadBatchOpType_Poke:
+            {
+                op.addr=GetLE(p+0,4);
+                uint32_t num_bytes=GetLE(p+4,4);
+
+                if(body.size()-i<num_bytes) {
+                    *error=strprintf("offset %zu: truncated poke data",i);
+                    return false;
+                }
+
+                op.values.assign(body.begin()+(ptrdiff_t)i,body.begin()+(ptrdiff_t)(i+num_bytes));
+                i+=num_bytes;
+            }
+            break;
+
+        case BeebThreadBatchOpType_Call:
+            if(got_call) {
+                // There's only one pending call at a time.
+                *error="more than one call";
+                return false;
+            }
+            got_call=true;
+
+            op.addr=GetLE(p+0,2);
+            op.a=p[2];
+            op.x=p[3];
+            op.y=p[4];
+            op.c=!!p[5];
+            break;
+
+        case BeebThreadBatchOpType_Key:
+            if(p[0]&0x80) {
+                *error=strprintf("bad key: %u",p[0]);
+                return false;
+            }
+
+            op.key=(BeebKey)p[0];
+            op.state=!!p[1];
+            break;
+        }
+
+        ops->push_back(std::move(op));
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Parse script request body. See the HTTP API docs for the format.
+//
+// Returns false and fills in *ERROR if the body is bad.
+static bool GetScriptSteps(std::vector<BeebThread::ScriptStep> *steps,
+                           std::string *error,
+                           const std::vector<uint8_t> &body)
+{
+    size_t i=0;
+
+    while(i<body.size()) {
+        BeebThread::ScriptStep step;
+        step.type=(BeebThreadScriptStepType)body[i++];
+
+        size_t step_size;
+        switch(step.type) {
+        case BeebThreadScriptStepType_Key:
+            step_size=SCRIPT_KEY_SIZE;
+            break;
+
+        case BeebThreadScriptStepType_Paste:
+            step_size=SCRIPT_PASTE_SIZE;
+            break;
+
+        case BeebThreadScriptStepType_WaitCycles:
+            step_size=SCRIPT_WAIT_CYCLES_SIZE;
+            break;
+
+        case BeebThreadScriptStepType_WaitPC:
+            step_size=SCRIPT_WAIT_PC_SIZE;
+            break;
+
+        case BeebThreadScriptStepType_WaitByte:
+            step_size=SCRIPT_WAIT_BYTE_SIZE;
+            break;
+
+        case BeebThreadScriptStepType_WaitOSWORD:
+            step_size=SCRIPT_WAIT_OSWORD_SIZE;
+            break;
+
+        default:
+            *error=strprintf("offset %zu: bad step type: %u",i-1,(unsigned)step.type);
+            return false;
+        }
+
+        if(body.size()-i<step_size) {
+            *error=strprintf("offset %zu: truncated %s step",i-1,GetBeebThreadScriptStepTypeEnumName(step.type));
+            return false;
+        }
+
+        const uint8_t *p=&body[i];
+        i+=step_size;
+
+        switch(step.type) {
+        case BeebThreadScriptStepType_Key:
+            if(p[0]&0x80) {
+                *error=strprintf("bad key: %u",p[0]);
+                return false;
+            }
+
+            step.key=(BeebKey)p[0];
+            step.state=!!p[1];
+            break;
+
+        case BeebThreadScriptStepType_Paste:
+            {
+                uint32_t num_bytes=GetLE(p+0,4);
+
+                if(body.size()-i<num_bytes) {
+                    *error=strprintf("offset %zu: truncated paste text",i);
+                    return false;
+                }
+
+                step.text.assign(body.begin()+(ptrdiff_t)i,body.begin()+(ptrdiff_t)(i+num_bytes));
+                i+=num_bytes;
+
+                FixBBCASCIINewlines(&step.text);
+            }
+            break;
+
+        case BeebThreadScriptStepType_WaitCycles:
+            step.num_2MHz_cycles=GetLE(p+0,4);
+            break;
+
+        case BeebThreadScriptStepType_WaitPC:
+            step.addr=(uint16_t)GetLE(p+0,2);
+            break;
+
+        case BeebThreadScriptStepType_WaitByte:
+            step.addr=(uint16_t)GetLE(p+0,2);
+            if(step.addr>=0x8000) {
+                *error=strprintf("byte address not in main RAM: 0x%04x",step.addr);
+                return false;
+            }
+
+            step.value=p[2];
+            step.mask=p[3];
+            break;
+
+        case BeebThreadScriptStepType_WaitOSWORD:
+            step.value=p[0];
+            break;
+        }
+
+        steps->push_back(std::move(step));
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Shared by a stream request's vsync fn. The response is finished when
+// this is destroyed, either because the client went away or because the
+// BeebThread stopped.
+struct HTTPStream {
+    HTTPServer *server=nullptr;
+    HTTPResponseData response_data;
+    std::vector<BeebThread::BatchOp> peeks;
+
+    HTTPStream()=default;
+
+    ~HTTPStream() {
+        if(this->server) {
+            this->server->SendResponseChunk(this->response_data,{});
+        }
+    }
+
+    HTTPStream(const HTTPStream &)=delete;
+    HTTPStream &operator=(const HTTPStream &)=delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 class BeebThreadPeekMessage:
     public BeebThread::CustomMessage
 {
@@ -101,6 +380,120 @@ private:
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Takes a copy of the BBCMicro and hands it to a CaptureJob, so the
+// emulator isn't held up while the capture runs.
+class BeebThreadCaptureMessage:
+    public BeebThread::CustomMessage
+{
+public:
+    typedef std::function<HTTPResponse(CaptureJob *)> GetResponseFun;
+
+    BeebThreadCaptureMessage(size_t num_fields,
+                             size_t num_sound_units,
+                             GetResponseFun get_response_fun,
+                             HTTPServer *server,
+                             HTTPRequest &&request):
+    m_num_fields(num_fields),
+    m_num_sound_units(num_sound_units),
+    m_get_response_fun(std::move(get_response_fun)),
+    m_server(server),
+    m_response_data(request.response_data)
+    {
+    }
+
+    void ThreadHandleMessage(BBCMicro *beeb) override {
+        std::unique_ptr<BBCMicro> clone=beeb->Clone();
+        if(!clone) {
+            HTTPResponse response=HTTPResponse::ServiceUnavailable();
+            response.content_type=HTTP_TEXT_CONTENT_TYPE;
+            response.content_str=strprintf("Can't capture, due to: %s\n",GetCloneImpedimentsDescription(beeb->GetCloneImpediments()).c_str());
+            m_server->SendResponse(m_response_data,response);
+            return;
+        }
+
+        auto finished_fun=[server=m_server,
+                           response_data=m_response_data,
+                           get_response_fun=std::move(m_get_response_fun)](CaptureJob *job)
+        {
+            if(job->WasCanceled()) {
+                server->SendResponse(response_data,HTTPResponse::ServiceUnavailable());
+                return;
+            }
+
+            server->SendResponse(response_data,get_response_fun(job));
+        };
+
+        BeebWindows::AddJob(std::make_shared<CaptureJob>(std::move(clone),
+                                                         m_num_fields,
+                                                         m_num_sound_units,
+                                                         std::move(finished_fun)));
+    }
+protected:
+private:
+    size_t m_num_fields=0;
+    size_t m_num_sound_units=0;
+    GetResponseFun m_get_response_fun;
+    HTTPServer *m_server=nullptr;
+    HTTPResponseData m_response_data;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The rgba data goes out as is, without a copy - at up to 50 fields of
+// 400 KB or so, it's worth avoiding.
+static HTTPResponse GetFrameResponse(const std::string &format,std::shared_ptr<const std::vector<uint8_t>> rgba) {
+    if(format=="png") {
+        std::vector<uint8_t> png=CaptureJob::GetPNG(*rgba);
+        if(png.empty()) {
+            return HTTPResponse::ServiceUnavailable();
+        }
+
+        return HTTPResponse(PNG_CONTENT_TYPE,std::move(png));
+    } else {
+        ASSERT(format=="rgba");
+        return HTTPResponse(HTTP_OCTET_STREAM_CONTENT_TYPE,std::move(rgba));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Makes the response from a copy of a window's TV output, so the UI thread
+// isn't held up by the PNG encoding.
+class FrameResponseJob:
+    public JobQueue::Job
+{
+public:
+    FrameResponseJob(std::vector<uint8_t> rgba,
+                     std::string format,
+                     HTTPServer *server,
+                     HTTPResponseData response_data):
+    m_rgba(std::make_shared<std::vector<uint8_t>>(std::move(rgba))),
+    m_format(std::move(format)),
+    m_server(server),
+    m_response_data(std::move(response_data))
+    {
+    }
+
+    JobPriority GetPriority() const override {
+        return JobPriority_Interactive;
+    }
+
+    void ThreadExecute() override {
+        m_server->SendResponse(m_response_data,GetFrameResponse(m_format,m_rgba));
+    }
+protected:
+private:
+    std::shared_ptr<const std::vector<uint8_t>> m_rgba;
+    std::string m_format;
+    HTTPServer *m_server=nullptr;
+    HTTPResponseData m_response_data;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 class HTTPMethodsHandler:
     public HTTPHandler
 {
@@ -112,6 +505,19 @@ public:
     bool ThreadHandleRequest(HTTPResponse *response,HTTPServer *server,HTTPRequest &&request) {
         (void)response;
 
+        // Requests that only need the BeebThread are handled here and now,
+        // rather than waiting for the UI thread to get round to them.
+        {
+            std::vector<std::string> path_parts=GetPathParts(request.url_path);
+            if(!path_parts.empty()) {
+                auto it=m_beeb_thread_request_handlers.find(path_parts[0]);
+                if(it!=m_beeb_thread_request_handlers.end()) {
+                    (this->*it->second)(server,std::move(request),path_parts,0);
+                    return false;
+                }
+            }
+        }
+
         auto data=new HandleRequestData{};
 
         data->server=server;
@@ -130,14 +536,26 @@ public:
     }
 protected:
 private:
-    const std::map<std::string,void (HTTPMethodsHandler::*)(HTTPServer *,HTTPRequest &&,const std::vector<std::string> &,size_t)> m_request_handlers={
+    typedef void (HTTPMethodsHandler::*RequestHandlerFn)(HTTPServer *,HTTPRequest &&,const std::vector<std::string> &,size_t);
+
+    // Handled on the UI thread.
+    const std::map<std::string,RequestHandlerFn> m_request_handlers={
         {"reset",&HTTPMethodsHandler::HandleResetRequest},
         {"paste",&HTTPMethodsHandler::HandlePasteRequest},
+        {"mount",&HTTPMethodsHandler::HandleMountRequest},
+        {"run",&HTTPMethodsHandler::HandleRunRequest},
+    };
+
+    // Handled on the HTTP server thread.
+    const std::map<std::string,RequestHandlerFn> m_beeb_thread_request_handlers={
         {"poke",&HTTPMethodsHandler::HandlePokeRequest},
         {"peek",&HTTPMethodsHandler::HandlePeekRequest},
         {"call",&HTTPMethodsHandler::HandleCallRequest},
-        {"mount",&HTTPMethodsHandler::HandleMountRequest},
-        {"run",&HTTPMethodsHandler::HandleRunRequest},
+        {"batch",&HTTPMethodsHandler::HandleBatchRequest},
+        {"stream",&HTTPMethodsHandler::HandleStreamRequest},
+        {"script",&HTTPMethodsHandler::HandleScriptRequest},
+        {"frame",&HTTPMethodsHandler::HandleFrameRequest},
+        {"audio",&HTTPMethodsHandler::HandleAudioRequest},
     };
 
     // Parse path parts.
@@ -256,6 +674,15 @@ private:
                         return false;
                     }
                 }
+            } else if(strcmp(fmt,"beeb_thread")==0) {
+                auto ptr=va_arg(v,std::shared_ptr<BeebThread> *);
+                if(value) {
+                    *ptr=BeebWindows::FindBeebThreadByName(*value);
+                    if(!*ptr) {
+                        server->SendResponse(request,HTTPResponse::NotFound(request));
+                        return false;
+                    }
+                }
             } else {
                 ASSERT(false);
                 server->SendResponse(request,HTTPResponse());
@@ -301,7 +728,7 @@ private:
 //        message->reload_config=true;
 //        message->run=true;
 
-        this->SendMessage(beeb_window,server,request,std::move(reset_message));
+        this->SendMessage(beeb_window->GetBeebThread(),server,request,std::move(reset_message));
     }
 
     void HandlePasteRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
@@ -332,30 +759,30 @@ private:
 
         FixBBCASCIINewlines(&ascii);
 
-        this->SendMessage(beeb_window,server,request,std::make_shared<BeebThread::StartPasteMessage>(std::move(ascii)));
+        this->SendMessage(beeb_window->GetBeebThread(),server,request,std::make_shared<BeebThread::StartPasteMessage>(std::move(ascii)));
     }
 
     void HandlePokeRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
-        BeebWindow *beeb_window;
+        std::shared_ptr<BeebThread> beeb_thread;
         uint32_t addr;
         if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
-                                          "window",nullptr,&beeb_window,
+                                          "beeb_thread",nullptr,&beeb_thread,
                                           "x32",nullptr,&addr,
                                           nullptr))
         {
             return;
         }
 
-        this->SendMessage(beeb_window,server,request,std::make_shared<BeebThread::DebugSetBytesMessage>(addr,0,std::move(request.body)));
+        this->SendMessage(beeb_thread,server,request,std::make_shared<BeebThread::DebugSetBytesMessage>(addr,0,std::move(request.body)));
     }
 
     void HandlePeekRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
-        BeebWindow *beeb_window;
+        std::shared_ptr<BeebThread> beeb_thread;
         uint32_t begin;
         uint64_t end;
         bool end_is_len;
         if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
-                                          "window",nullptr,&beeb_window,
+                                          "beeb_thread",nullptr,&beeb_thread,
                                           "x32",nullptr,&begin,
                                           "x64/len",nullptr,&end,&end_is_len,
                                           nullptr))
@@ -377,20 +804,20 @@ private:
             }
         }
 
-        beeb_window->GetBeebThread()->Send(std::make_unique<BeebThreadPeekMessage>(begin,
-                                                                                   0,//dpo
-                                                                                   end-begin,
-                                                                                   server,
-                                                                                   std::move(request)));
+        beeb_thread->Send(std::make_unique<BeebThreadPeekMessage>(begin,
+                                                                  0,//dpo
+                                                                  end-begin,
+                                                                  server,
+                                                                  std::move(request)));
     }
 
     void HandleCallRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
-        BeebWindow *beeb_window;
+        std::shared_ptr<BeebThread> beeb_thread;
         uint16_t addr;
         uint8_t a=0,x=0,y=0;
         bool c=false;
         if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
-                                          "window",nullptr,&beeb_window,
+                                          "beeb_thread",nullptr,&beeb_thread,
                                           "x16",nullptr,&addr,
                                           "u8","a",&a,
                                           "u8","x",&x,
@@ -401,7 +828,219 @@ private:
             return;
         }
 
-        this->SendMessage(beeb_window,server,request,std::make_shared<BeebThread::DebugAsyncCallMessage>(addr,a,x,y,c));
+        this->SendMessage(beeb_thread,server,request,std::make_shared<BeebThread::DebugAsyncCallMessage>(addr,a,x,y,c));
+    }
+
+    void HandleBatchRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
+        std::shared_ptr<BeebThread> beeb_thread;
+        if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
+                                          "beeb_thread",nullptr,&beeb_thread,
+                                          nullptr))
+        {
+            return;
+        }
+
+        std::vector<BeebThread::BatchOp> ops;
+        std::string error;
+        if(!GetBatchOps(&ops,&error,request.body)) {
+            server->SendResponse(request,HTTPResponse::BadRequest(request,"%s",error.c_str()));
+            return;
+        }
+
+        auto results_fun=[server,response_data=request.response_data](uint64_t num_2MHz_cycles,
+                                                                      std::vector<uint8_t> peek_data)
+        {
+            (void)num_2MHz_cycles;
+
+            server->SendResponse(response_data,HTTPResponse(HTTP_OCTET_STREAM_CONTENT_TYPE,std::move(peek_data)));
+        };
+
+        // The results fun sends the response on success.
+        auto completion_fun=[server,response_data=request.response_data](bool success,
+                                                                         std::string message)
+        {
+            if(!success) {
+                HTTPResponse response=HTTPResponse::ServiceUnavailable();
+
+                if(!message.empty()) {
+                    response.content_type=HTTP_TEXT_CONTENT_TYPE;
+                    response.content_str=std::move(message);
+                }
+
+                server->SendResponse(response_data,response);
+            }
+        };
+
+        beeb_thread->Send(std::make_shared<BeebThread::BatchMessage>(std::move(ops),std::move(results_fun)),
+                          std::move(completion_fun));
+    }
+
+    void HandleStreamRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
+        std::shared_ptr<BeebThread> beeb_thread;
+        if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
+                                          "beeb_thread",nullptr,&beeb_thread,
+                                          nullptr))
+        {
+            return;
+        }
+
+        auto stream=std::make_shared<HTTPStream>();
+
+        std::string error;
+        if(!GetBatchOps(&stream->peeks,&error,request.body)) {
+            server->SendResponse(request,HTTPResponse::BadRequest(request,"%s",error.c_str()));
+            return;
+        }
+
+        for(const BeebThread::BatchOp &op:stream->peeks) {
+            if(op.type!=BeebThreadBatchOpType_Peek) {
+                server->SendResponse(request,HTTPResponse::BadRequest(request,"stream may only peek"));
+                return;
+            }
+        }
+
+        stream->server=server;
+        stream->response_data=request.response_data;
+
+        server->StartChunkedResponse(stream->response_data,HTTP_OCTET_STREAM_CONTENT_TYPE);
+
+        beeb_thread->AddVSyncFn([stream](BBCMicro *beeb)->bool {
+            std::vector<uint8_t> data;
+
+            uint64_t num_2MHz_cycles=*beeb->GetNum2MHzCycles();
+            for(size_t i=0;i<8;++i) {
+                data.push_back((uint8_t)(num_2MHz_cycles>>(i*8)));
+            }
+
+            for(const BeebThread::BatchOp &op:stream->peeks) {
+                size_t offset=data.size();
+                data.resize(offset+op.num_bytes);
+                beeb->DebugGetBytes(data.data()+offset,op.num_bytes,{(uint16_t)op.addr},0);
+            }
+
+            return stream->server->SendResponseChunk(stream->response_data,std::move(data));
+        });
+    }
+
+    void HandleScriptRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
+        std::shared_ptr<BeebThread> beeb_thread;
+        if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
+                                          "beeb_thread",nullptr,&beeb_thread,
+                                          nullptr))
+        {
+            return;
+        }
+
+        std::vector<BeebThread::ScriptStep> steps;
+        std::string error;
+        if(!GetScriptSteps(&steps,&error,request.body)) {
+            server->SendResponse(request,HTTPResponse::BadRequest(request,"%s",error.c_str()));
+            return;
+        }
+
+        this->SendMessage(beeb_thread,server,request,std::make_shared<BeebThread::RunScriptMessage>(std::move(steps)));
+    }
+
+    void HandleFrameRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
+        std::shared_ptr<BeebThread> beeb_thread;
+        uint32_t n=1;
+        std::string format="png";
+        if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
+                                          "beeb_thread",nullptr,&beeb_thread,
+                                          "u32","n",&n,
+                                          "std::string","format",&format,
+                                          nullptr))
+        {
+            return;
+        }
+
+        if(n>MAX_NUM_CAPTURE_FIELDS) {
+            server->SendResponse(request,HTTPResponse::BadRequest(request,"bad field count: %" PRIu32,n));
+            return;
+        }
+
+        if(format!="png"&&format!="rgba") {
+            server->SendResponse(request,HTTPResponse::BadRequest(request,"bad format: %s",format.c_str()));
+            return;
+        }
+
+        if(n==0) {
+            // The field as it currently stands, from the window's TV
+            // output. The TVOutput belongs to the UI thread, and isn't
+            // updated while video output is off, so this is only done
+            // when asked for.
+            auto data=new HandleRequestData{};
+
+            data->server=server;
+            data->request=std::move(request);
+
+            PushFunctionMessage([data,name=path_parts[command_index+1],format]() {
+                HTTPServer *server=data->server;
+                HTTPRequest request=std::move(data->request);
+
+                delete data;
+
+                BeebWindow *beeb_window=BeebWindows::FindBeebWindowByName(name);
+                if(!beeb_window) {
+                    server->SendResponse(request,HTTPResponse::NotFound(request));
+                    return;
+                }
+
+                BeebWindows::AddJob(std::make_shared<FrameResponseJob>(beeb_window->GetTVOutputRGBA(),
+                                                                       format,
+                                                                       server,
+                                                                       request.response_data));
+            });
+        } else {
+            // The next N complete fields, from a copy of the BBC run
+            // separately from the window.
+            auto get_response_fun=[format](CaptureJob *job) {
+                return GetFrameResponse(format,job->GetFieldsRGBA());
+            };
+
+            beeb_thread->Send(std::make_shared<BeebThreadCaptureMessage>(n,
+                                                                         0,
+                                                                         std::move(get_response_fun),
+                                                                         server,
+                                                                         std::move(request)));
+        }
+    }
+
+    void HandleAudioRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
+        std::shared_ptr<BeebThread> beeb_thread;
+        uint32_t ms=1000;
+        if(!this->ParseArgsOrSendResponse(server,request,path_parts,command_index,
+                                          "beeb_thread",nullptr,&beeb_thread,
+                                          "u32","ms",&ms,
+                                          nullptr))
+        {
+            return;
+        }
+
+        if(ms<1||ms>MAX_CAPTURE_MS) {
+            server->SendResponse(request,HTTPResponse::BadRequest(request,"bad duration: %" PRIu32,ms));
+            return;
+        }
+
+        auto get_response_fun=[](CaptureJob *job) {
+            const std::vector<int16_t> &pcm=job->GetPCM();
+
+            // Little-endian, regardless of host.
+            std::vector<uint8_t> data;
+            data.reserve(pcm.size()*2);
+            for(int16_t sample:pcm) {
+                data.push_back((uint8_t)sample);
+                data.push_back((uint8_t)((uint16_t)sample>>8));
+            }
+
+            return HTTPResponse(HTTP_OCTET_STREAM_CONTENT_TYPE,std::move(data));
+        };
+
+        beeb_thread->Send(std::make_shared<BeebThreadCaptureMessage>(0,
+                                                                     (size_t)SOUND_CLOCKS_FROM_MS((uint64_t)ms),
+                                                                     std::move(get_response_fun),
+                                                                     server,
+                                                                     std::move(request)));
     }
 
     void HandleMountRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
@@ -422,12 +1061,12 @@ private:
             return;
         }
 
-        std::shared_ptr<DiscImage> disc_image=LoadDiscImageFromRequestOrSendResponse(server,request,name);
+        std::shared_ptr<DiscImage> disc_image=LoadDiscImageFromRequestOrSendResponse(server,&request,name);
         if(!disc_image) {
             return;
         }
 
-        this->SendMessage(beeb_window,server,request,std::make_shared<BeebThread::LoadDiscMessage>((int)drive,std::move(disc_image),true));
+        this->SendMessage(beeb_window->GetBeebThread(),server,request,std::make_shared<BeebThread::LoadDiscMessage>((int)drive,std::move(disc_image),true));
     }
 
     void HandleRunRequest(HTTPServer *server,HTTPRequest &&request,const std::vector<std::string> &path_parts,size_t command_index) {
@@ -453,14 +1092,14 @@ private:
                 request.body.erase(request.body.begin(),request.body.begin()+2);
 
                 beeb_window->GetBeebThread()->Send(std::make_shared<BeebThread::DebugSetBytesMessage>(addr,0,std::move(request.body)));
-                this->SendMessage(beeb_window,server,request,std::make_shared<BeebThread::DebugAsyncCallMessage>((uint16_t)addr,0,0,0,false));
+                this->SendMessage(beeb_window->GetBeebThread(),server,request,std::make_shared<BeebThread::DebugAsyncCallMessage>((uint16_t)addr,0,0,0,false));
                 return;
             }
         }
 
         // BBC disc image.
         {
-            std::shared_ptr<DiscImage> disc_image=this->LoadDiscImageFromRequestOrSendResponse(server,request,name);
+            std::shared_ptr<DiscImage> disc_image=this->LoadDiscImageFromRequestOrSendResponse(server,&request,name);
             if(!disc_image) {
                 return;
             }
@@ -469,7 +1108,7 @@ private:
 
             auto message=std::make_shared<BeebThread::HardResetAndReloadConfigMessage>(BeebThreadHardResetFlag_Run|
                                                                                        BeebThreadHardResetFlag_Boot);
-            this->SendMessage(beeb_window,server,request,std::move(message));
+            this->SendMessage(beeb_window->GetBeebThread(),server,request,std::move(message));
             return;
         }
 
@@ -477,35 +1116,36 @@ private:
         server->SendResponse(request,HTTPResponse::BadRequest(request));
     }
 
-    std::shared_ptr<DiscImage> LoadDiscImageFromRequestOrSendResponse(HTTPServer *server,const HTTPRequest &request,const std::string &name) {
+    // The request body is moved into the disc image, so it isn't copied.
+    std::shared_ptr<DiscImage> LoadDiscImageFromRequestOrSendResponse(HTTPServer *server,HTTPRequest *request,const std::string &name) {
         auto message_list=std::make_shared<MessageList>();
         Messages messages(message_list);
 
         DiscGeometry geometry;
 
         if(FindDiscGeometryFromMIMEType(&geometry,
-                                        request.content_type.c_str(),
-                                        request.body.size(),
+                                        request->content_type.c_str(),
+                                        request->body.size(),
                                         &messages))
         {
             // ok...
         } else if(!name.empty()&&
                   FindDiscGeometryFromFileDetails(&geometry,
                                                   name.c_str(),
-                                                  request.body.size(),
+                                                  request->body.size(),
                                                   &messages))
         {
             // ok...
         } else {
-            this->SendMessagesResponse(server,request,message_list);
+            this->SendMessagesResponse(server,*request,message_list);
             return nullptr;
         }
 
         message_list->ClearMessages();
 
-        std::shared_ptr<DiscImage> disc_image=MemoryDiscImage::LoadFromBuffer(name,HTTP_DISC_IMAGE_LOAD_METHOD,request.body.data(),request.body.size(),geometry,&messages);
+        std::shared_ptr<DiscImage> disc_image=MemoryDiscImage::LoadFromBuffer(name,HTTP_DISC_IMAGE_LOAD_METHOD,std::move(request->body),geometry,&messages);
         if(!disc_image) {
-            this->SendMessagesResponse(server,request,message_list);
+            this->SendMessagesResponse(server,*request,message_list);
             return nullptr;
         }
 
@@ -523,7 +1163,7 @@ private:
         if(!path_parts.empty()) {
             auto it=m_request_handlers.find(path_parts[0]);
             if(it==m_request_handlers.end()) {
-                server->SendResponse(request,HTTPResponse::BadRequest(request,"Unknown request type: %s",path_parts[2].c_str()));
+                server->SendResponse(request,HTTPResponse::BadRequest(request,"Unknown request type: %s",path_parts[0].c_str()));
                 return;
             }
 
@@ -547,7 +1187,7 @@ private:
         server->SendResponse(request,HTTPResponse::BadRequest(request,"%s",text.c_str()));
     }
 
-    void SendMessage(BeebWindow *beeb_window,
+    void SendMessage(const std::shared_ptr<BeebThread> &beeb_thread,
                      HTTPServer *server,
                      const HTTPRequest &request,
                      std::shared_ptr<BeebThread::Message> message)
@@ -571,7 +1211,6 @@ private:
             server->SendResponse(response_data,response);
         };
 
-        std::shared_ptr<BeebThread> beeb_thread=beeb_window->GetBeebThread();
         beeb_thread->Send(std::move(message),std::move(completion_fun));
     }
 };
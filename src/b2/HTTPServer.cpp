@@ -31,6 +31,8 @@ LOG_TAGGED_DEFINE(HTTP,"http","HTTP  ",&log_printer_stdout_and_debugger,false)
 static const std::string CONTENT_TYPE="Content-Type";
 static const std::string CHARSET_PREFIX="charset:";
 static const std::string CONTENT_LENGTH="Content-Length";
+static const std::string TRANSFER_ENCODING="Transfer-Encoding";
+static const std::string CHUNKED="chunked";
 const std::string HTTP_OCTET_STREAM_CONTENT_TYPE="application/octet-stream";
 const std::string HTTP_TEXT_CONTENT_TYPE="text/plain";
 static const std::string DEFAULT_CONTENT_TYPE=HTTP_OCTET_STREAM_CONTENT_TYPE;
@@ -40,6 +42,21 @@ const std::string HTTP_UTF8_CHARSET="utf-8";
 const std::string EXPECT="Expect";
 const std::string EXPECT_CONTINUE="100-continue";
 const std::string CONTINUE_RESPONSE="100 Continue\r\n";
+static const std::string CRLF="\r\n";
+static const std::string LAST_CHUNK="0\r\n\r\n";
+
+// If there's more than this much chunk data waiting to be written, the
+// client isn't keeping up. Drop chunks until it catches up.
+static const size_t MAX_NUM_PENDING_CHUNK_BYTES=4*1024*1024;
+
+// Size of each connection's read buffer. Large enough that a disc image
+// upload doesn't take thousands of read callbacks.
+static const size_t READ_BUFFER_SIZE=64*1024;
+
+// Request bodies up to this size are allocated in one go, going by the
+// Content-Length header, rather than growing as the data arrives. Beyond
+// that the header isn't trusted.
+static const uint64_t MAX_BODY_RESERVE_SIZE=64*1024*1024;
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -109,12 +126,12 @@ static HTTPResponse CreateErrorResponse(const HTTPRequest &request,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Add bufs referring to the container's data, which must stay put until
+// the write completes.
 template<class ContType>
-static std::vector<uv_buf_t> GetBufs(ContType *cont) {
-    size_t num_left=cont->size()*sizeof *cont->data();
-    auto p=const_cast<char *>(reinterpret_cast<const char *>(cont->data()));
-
-    std::vector<uv_buf_t> bufs;
+static void AddBufs(std::vector<uv_buf_t> *bufs,const ContType &cont) {
+    size_t num_left=cont.size()*sizeof *cont.data();
+    auto p=const_cast<char *>(reinterpret_cast<const char *>(cont.data()));
 
     while(num_left>0) {
         size_t n=num_left;
@@ -122,13 +139,17 @@ static std::vector<uv_buf_t> GetBufs(ContType *cont) {
             n=UINT_MAX;
         }
 
-        bufs.push_back(uv_buf_init(p,(unsigned)n));
+        bufs->push_back(uv_buf_init(p,(unsigned)n));
 
         p+=n;
         num_left-=n;
     }
+}
 
-    return bufs;
+// A paused parser is fine - HandleMessageComplete pauses it so that any
+// pipelined request is left in the buffer until the response has gone.
+static bool IsParserOK(const http_parser *parser) {
+    return parser->http_errno==HPE_OK||parser->http_errno==HPE_PAUSED;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -335,6 +356,16 @@ HTTPResponse::HTTPResponse(std::string content_type,std::string content):
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+HTTPResponse::HTTPResponse(std::string content_type_,std::shared_ptr<const std::vector<uint8_t>> content):
+    status("200 OK"),
+    content_shared(std::move(content)),
+    content_type(content_type_.empty()?DEFAULT_CONTENT_TYPE:std::move(content_type_))
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 HTTPResponse::HTTPResponse(std::string status_,std::string content_type_,std::vector<uint8_t> content):
     status(std::move(status_)),
     content_vec(std::move(content)),
@@ -390,6 +421,8 @@ public:
     bool Start(int port) override;
     void SetHandler(HTTPHandler *handler) override;
     void SendResponse(const HTTPResponseData &response_data,HTTPResponse response) override;
+    void StartChunkedResponse(const HTTPResponseData &response_data,std::string content_type) override;
+    bool SendResponseChunk(const HTTPResponseData &response_data,std::vector<uint8_t> data) override;
 protected:
 private:
     struct Connection {
@@ -402,11 +435,9 @@ private:
         std::string key;
         std::string *value=nullptr;
 
-        // Should this be std::vector<HTTPRequest>, or some similar equivalent?
-        // My notes say yes, but I'm not so sure any more - pipelining ain't so
-        // good for non-idempotent requests, and the Wikipedia article sounds a
-        // not-very-positive note...
-        // (https://en.wikipedia.org/wiki/HTTP_pipelining)
+        // Pipelined requests are handled one at a time: the parser is
+        // paused at the end of each request, leaving anything after it in
+        // read_buf until the response has been written.
         HTTPRequest request;
 
         bool keep_alive=false;
@@ -416,22 +447,69 @@ private:
         std::string response_prefix;
         std::vector<uint8_t> response_body_data;
         std::string response_body_str;
+        std::shared_ptr<const std::vector<uint8_t>> response_body_shared;
         uv_write_t write_response_req={};
 
+        // Set while a chunked response is in progress. Each chunk is a
+        // separate write.
+        bool chunked_response=false;
+        size_t num_pending_chunk_bytes=0;
+
         size_t num_read=0;
-        char read_buf[100];
+        char read_buf[READ_BUFFER_SIZE];
+    };
+
+    struct ChunkWrite {
+        uv_write_t req={};
+        Connection *conn=nullptr;
+        std::string prefix;
+        std::vector<uint8_t> data;
+        bool last=false;
+    };
+
+    // A response or chunk queued from another thread.
+    struct PendingSend {
+        uint64_t tick_count=0;
+        uint64_t connection_id=0;
+        bool dump=false;
+
+        // If set, this is a chunk for a chunked response in progress;
+        // otherwise, it's the start of a response.
+        bool is_chunk=false;
+
+        // Response start: whether the response is chunked.
+        bool chunked=false;
+        HTTPResponse response;
+
+        // Chunk: the data. Empty for the last chunk.
+        std::vector<uint8_t> chunk_data;
     };
 
     struct ThreadData {
         uv_tcp_t listen_tcp{};
         uint64_t next_connection_id=1;
         std::map<uint64_t,Connection *> connection_by_id;
+
+        // Swapped with SharedData::pending_sends, so the buffers get
+        // reused.
+        std::vector<PendingSend> sends;
     };
 
     struct SharedData {
         Mutex mutex;
         uv_loop_t *loop=nullptr;
         HTTPHandler *handler=nullptr;
+
+        // Everything queued for the loop thread goes through this one
+        // async handle, in order. uv_async_send coalesces, so a burst of
+        // responses wakes the loop once.
+        uv_async_t send_async{};
+        std::vector<PendingSend> pending_sends;
+
+        // IDs of connections that can take chunks. Added when the chunked
+        // response is started; removed when the last chunk is sent, or the
+        // connection is closed.
+        std::set<uint64_t> chunked_connection_ids;
     };
 
     SharedData m_sd;
@@ -441,11 +519,15 @@ private:
     void ThreadMain(int port);
     void CloseConnection(Connection *conn);
     void ResetRequest(Connection *conn);
+    void ContinueConnection(Connection *conn);
     void StartReading(Connection *conn);
     bool StopReading(Connection *conn);
-    void SendResponse(Connection *conn,bool dump,HTTPResponse &&response,bool interim);
+    bool Parse(Connection *conn,size_t total_num_read);
+    void SendResponse(Connection *conn,bool dump,HTTPResponse &&response,bool interim,bool chunked);
+    void SendChunk(Connection *conn,std::vector<uint8_t> data);
+    void AddPendingSend(PendingSend &&send);
 
-    static void SendResponseAsyncCallback(uv_async_t *send_response_async);
+    static void SendAsyncCallback(uv_async_t *send_async);
     static void StopAsyncCallback(uv_async_t *stop_async);
     static int HandleMessageBegin(http_parser *parser);
     static int HandleURL(http_parser *parser,const char *at,size_t length);
@@ -459,6 +541,7 @@ private:
     static void HandleRead(uv_stream_t *stream,ssize_t num_read,const uv_buf_t *buf);
     static void HandleConnectionClose(uv_handle_t *handle);
     static void HandleResponseWritten(uv_write_t *req,int status);
+    static void HandleChunkWritten(uv_write_t *req,int status);
 };
 
 
@@ -524,33 +607,86 @@ void HTTPServerImpl::SetHandler(HTTPHandler *handler) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-struct SendResponseData {
-    uint64_t tick_count=0;
-    uint64_t connection_id=0;
-    bool dump=false;
-    HTTPResponse response;
-};
-
 void HTTPServerImpl::SendResponse(const HTTPResponseData &response_data,HTTPResponse response) {
+    PendingSend send;
+
+    send.connection_id=response_data.connection_id;
+    send.dump=response_data.dump;
+    send.response=std::move(response);
+
+    std::lock_guard<Mutex> sd_lock(m_sd.mutex);
+
+    this->AddPendingSend(std::move(send));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void HTTPServerImpl::StartChunkedResponse(const HTTPResponseData &response_data,std::string content_type) {
     std::lock_guard<Mutex> sd_lock(m_sd.mutex);
 
     if(!m_sd.loop) {
         return;
     }
 
-    auto data=new SendResponseData{};
+    m_sd.chunked_connection_ids.insert(response_data.connection_id);
+
+    PendingSend send;
+
+    send.connection_id=response_data.connection_id;
+    send.dump=response_data.dump;
+    send.chunked=true;
+    send.response=HTTPResponse::OK();
+    send.response.content_type=std::move(content_type);
+
+    this->AddPendingSend(std::move(send));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool HTTPServerImpl::SendResponseChunk(const HTTPResponseData &response_data,std::vector<uint8_t> data) {
+    std::lock_guard<Mutex> sd_lock(m_sd.mutex);
+
+    if(!m_sd.loop) {
+        return false;
+    }
+
+    auto &&it=m_sd.chunked_connection_ids.find(response_data.connection_id);
+    if(it==m_sd.chunked_connection_ids.end()) {
+        return false;
+    }
 
-    data->tick_count=GetCurrentTickCount();
-    data->connection_id=response_data.connection_id;
-    data->dump=response_data.dump;
-    data->response=std::move(response);
+    if(data.empty()) {
+        // Last chunk.
+        m_sd.chunked_connection_ids.erase(it);
+    }
+
+    PendingSend send;
+
+    send.connection_id=response_data.connection_id;
+    send.is_chunk=true;
+    send.chunk_data=std::move(data);
 
-    auto send_response_async=new uv_async_t{};
-    send_response_async->data=data;
+    this->AddPendingSend(std::move(send));
 
-    uv_async_init(m_sd.loop,send_response_async,&SendResponseAsyncCallback);
-    uv_async_send(send_response_async);
-    send_response_async=nullptr;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// m_sd.mutex must be locked.
+void HTTPServerImpl::AddPendingSend(PendingSend &&send) {
+    if(!m_sd.loop) {
+        return;
+    }
+
+    send.tick_count=GetCurrentTickCount();
+
+    m_sd.pending_sends.push_back(std::move(send));
+
+    uv_async_send(&m_sd.send_async);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -579,6 +715,14 @@ void HTTPServerImpl::ThreadMain(int port) {
 
     m_td.listen_tcp.data=this;
 
+    rc=uv_async_init(&loop,&m_sd.send_async,&SendAsyncCallback);
+    if(rc!=0) {
+        PrintLibUVError(rc,"uv_async_init failed");
+        goto done;
+    }
+
+    m_sd.send_async.data=this;
+
     {
         struct sockaddr_in addr;
         uv_ip4_addr("127.0.0.1",port,&addr);
@@ -606,6 +750,7 @@ done:
     {
         std::lock_guard<Mutex> sd_lock(m_sd.mutex);
         m_sd.loop=nullptr;
+        m_sd.pending_sends.clear();
     }
 
     if(loop.data) {
@@ -624,6 +769,12 @@ void HTTPServerImpl::CloseConnection(Connection *conn) {
 
     m_td.connection_by_id.erase(conn->id);
 
+    {
+        std::lock_guard<Mutex> sd_lock(m_sd.mutex);
+
+        m_sd.chunked_connection_ids.erase(conn->id);
+    }
+
     uv_close((uv_handle_t *)&conn->tcp,&HandleConnectionClose);
 }
 
@@ -637,12 +788,33 @@ void HTTPServerImpl::ResetRequest(Connection *conn) {
     conn->request.response_data.connection_id=conn->id;
     conn->response_body_data.clear();
     conn->response_body_str.clear();
+    conn->response_body_shared.reset();
     conn->response_prefix.clear();
 }
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Get ready for the next request on a keep-alive connection. It might
+// already be in the read buffer.
+void HTTPServerImpl::ContinueConnection(Connection *conn) {
+    this->ResetRequest(conn);
+
+    http_parser_pause(&conn->parser,0);
+
+    if(conn->num_read>0) {
+        if(!this->Parse(conn,conn->num_read)) {
+            // Either a complete request, now being handled, or an error.
+            return;
+        }
+    }
+
+    this->StartReading(conn);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void HTTPServerImpl::StartReading(Connection *conn) {
     int rc=uv_read_start((uv_stream_t *)&conn->tcp,&HandleReadAlloc,&HandleRead);
     if(rc!=0) {
@@ -669,7 +841,7 @@ bool HTTPServerImpl::StopReading(Connection *conn) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void HTTPServerImpl::SendResponse(Connection *conn,bool dump,HTTPResponse &&response,bool interim) {
+void HTTPServerImpl::SendResponse(Connection *conn,bool dump,HTTPResponse &&response,bool interim,bool chunked) {
     int rc;
 
     if(!this->StopReading(conn)) {
@@ -682,6 +854,7 @@ void HTTPServerImpl::SendResponse(Connection *conn,bool dump,HTTPResponse &&resp
     std::map<std::string,std::string> headers;
 
     conn->interim_response=interim;
+    conn->chunked_response=chunked;
 
     if(response.content_type.empty()) {
         headers[CONTENT_TYPE]=DEFAULT_CONTENT_TYPE;
@@ -690,14 +863,23 @@ void HTTPServerImpl::SendResponse(Connection *conn,bool dump,HTTPResponse &&resp
     }
 
     std::vector<uv_buf_t> body_bufs;
-    if(!response.content_vec.empty()) {
+    if(chunked) {
+        ASSERT(response.content_vec.empty());
+        ASSERT(response.content_str.empty());
+        ASSERT(!response.content_shared);
+        headers[TRANSFER_ENCODING]=CHUNKED;
+    } else if(response.content_shared&&!response.content_shared->empty()) {
+        conn->response_body_shared=std::move(response.content_shared);
+        headers[CONTENT_LENGTH]=std::to_string(conn->response_body_shared->size());
+        AddBufs(&body_bufs,*conn->response_body_shared);
+    } else if(!response.content_vec.empty()) {
         conn->response_body_data=std::move(response.content_vec);
         headers[CONTENT_LENGTH]=std::to_string(conn->response_body_data.size());
-        body_bufs=GetBufs(&conn->response_body_data);
+        AddBufs(&body_bufs,conn->response_body_data);
     } else if(!response.content_str.empty()) {
         conn->response_body_str=std::move(response.content_str);
         headers[CONTENT_LENGTH]=std::to_string(conn->response_body_str.size());
-        body_bufs=GetBufs(&conn->response_body_str);
+        AddBufs(&body_bufs,conn->response_body_str);
     } else {
         headers[CONTENT_LENGTH]="0";
     }
@@ -715,7 +897,8 @@ void HTTPServerImpl::SendResponse(Connection *conn,bool dump,HTTPResponse &&resp
     }
     conn->response_prefix+="\r\n";
 
-    std::vector<uv_buf_t> bufs=GetBufs(&conn->response_prefix);
+    std::vector<uv_buf_t> bufs;
+    AddBufs(&bufs,conn->response_prefix);
     bufs.insert(bufs.end(),body_bufs.begin(),body_bufs.end());
 
     if(dump) {
@@ -737,23 +920,86 @@ void HTTPServerImpl::SendResponse(Connection *conn,bool dump,HTTPResponse &&resp
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void HTTPServerImpl::SendResponseAsyncCallback(uv_async_t *send_response_async) {
-    auto data=(SendResponseData *)send_response_async->data;
-    auto server=(HTTPServerImpl *)send_response_async->loop->data;
+void HTTPServerImpl::SendAsyncCallback(uv_async_t *send_async) {
+    auto server=(HTTPServerImpl *)send_async->data;
+    std::vector<PendingSend> *sends=&server->m_td.sends;
 
-    LOGF(HTTP,"%s: latency = %.3f sec\n",__func__,GetSecondsFromTicks(GetCurrentTickCount()-data->tick_count));
+    ASSERT(sends->empty());
+    {
+        std::lock_guard<Mutex> sd_lock(server->m_sd.mutex);
+
+        sends->swap(server->m_sd.pending_sends);
+    }
 
-    auto &&it=server->m_td.connection_by_id.find(data->connection_id);
-    if(it!=server->m_td.connection_by_id.end()) {
-        Connection *conn=it->second;
+    for(PendingSend &send:*sends) {
+        auto &&it=server->m_td.connection_by_id.find(send.connection_id);
 
-        server->SendResponse(conn,data->dump,std::move(data->response),false);
+        if(send.is_chunk) {
+            if(it!=server->m_td.connection_by_id.end()) {
+                Connection *conn=it->second;
+
+                if(conn->chunked_response) {
+                    server->SendChunk(conn,std::move(send.chunk_data));
+                }
+            }
+        } else {
+            LOGF(HTTP,"%s: latency = %.3f sec\n",__func__,GetSecondsFromTicks(GetCurrentTickCount()-send.tick_count));
+
+            if(it!=server->m_td.connection_by_id.end()) {
+                Connection *conn=it->second;
+
+                server->SendResponse(conn,send.dump,std::move(send.response),false,send.chunked);
+            } else if(send.chunked) {
+                // Connection went away before the response could start.
+                std::lock_guard<Mutex> sd_lock(server->m_sd.mutex);
+
+                server->m_sd.chunked_connection_ids.erase(send.connection_id);
+            }
+        }
     }
 
-    delete data;
-    data=nullptr;
+    sends->clear();
+}
 
-    uv_close((uv_handle_t *)send_response_async,&ScalarDeleteCloseCallback<uv_async_t>);
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void HTTPServerImpl::SendChunk(Connection *conn,std::vector<uint8_t> data) {
+    bool last=data.empty();
+
+    if(!last&&conn->num_pending_chunk_bytes>MAX_NUM_PENDING_CHUNK_BYTES) {
+        LOGF(HTTP,"%s: dropping %zu byte chunk for connection ID %" PRIu64 "\n",__func__,data.size(),conn->id);
+        return;
+    }
+
+    auto cw=new ChunkWrite;
+
+    cw->req.data=cw;
+    cw->conn=conn;
+    cw->last=last;
+
+    std::vector<uv_buf_t> bufs;
+    if(last) {
+        AddBufs(&bufs,LAST_CHUNK);
+    } else {
+        cw->data=std::move(data);
+        cw->prefix=strprintf("%zx\r\n",cw->data.size());
+
+        AddBufs(&bufs,cw->prefix);
+        AddBufs(&bufs,cw->data);
+        AddBufs(&bufs,CRLF);
+    }
+
+    conn->num_pending_chunk_bytes+=cw->data.size();
+
+    int rc=uv_write(&cw->req,(uv_stream_t *)&conn->tcp,bufs.data(),(unsigned)bufs.size(),&HandleChunkWritten);
+    if(rc!=0) {
+        PrintLibUVError(rc,"uv_write failed");
+        conn->num_pending_chunk_bytes-=cw->data.size();
+        delete cw;
+        this->CloseConnection(conn);
+        return;
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -774,7 +1020,12 @@ void HTTPServerImpl::StopAsyncCallback(uv_async_t *stop_async) {
         server->CloseConnection(server->m_td.connection_by_id.begin()->second);
     }
 
-    uv_close((uv_handle_t *)&server->m_td.listen_tcp,&EmptyCloseCallback);
+    // The listen socket is already closed if the bind failed.
+    if(!uv_is_closing((uv_handle_t *)&server->m_td.listen_tcp)) {
+        uv_close((uv_handle_t *)&server->m_td.listen_tcp,&EmptyCloseCallback);
+    }
+
+    uv_close((uv_handle_t *)&server->m_sd.send_async,&EmptyCloseCallback);
     uv_close((uv_handle_t *)stop_async,&ScalarDeleteCloseCallback<uv_async_t>);
 }
 
@@ -919,6 +1170,12 @@ int HTTPServerImpl::HandleHeadersComplete(http_parser *parser) {
         }
     }
 
+    // http_parser sets content_length to ULLONG_MAX if there's no
+    // Content-Length header.
+    if(parser->content_length>0&&parser->content_length<=MAX_BODY_RESERVE_SIZE) {
+        conn->request.body.reserve((size_t)parser->content_length);
+    }
+
     if(const std::string *dump=conn->request.GetHeaderValue(DUMP)) {
         conn->request.response_data.dump=*dump=="1";
     }
@@ -927,7 +1184,7 @@ int HTTPServerImpl::HandleHeadersComplete(http_parser *parser) {
         auto &&it=conn->request.headers.find(EXPECT);
         if(it!=conn->request.headers.end()) {
             if(it->second==EXPECT_CONTINUE) {
-                conn->server->SendResponse(conn,conn->request.response_data.dump,HTTPResponse("100 Continue"),true);
+                conn->server->SendResponse(conn,conn->request.response_data.dump,HTTPResponse("100 Continue"),true,false);
             }
         }
     }
@@ -962,6 +1219,9 @@ int HTTPServerImpl::HandleMessageComplete(http_parser *parser) {
 
     conn->keep_alive=!!http_should_keep_alive(parser);
 
+    // Leave any pipelined request in the buffer for later.
+    http_parser_pause(parser,1);
+
     if(!conn->server->StopReading(conn)) {
         return -1;
     }
@@ -1029,7 +1289,7 @@ int HTTPServerImpl::HandleMessageComplete(http_parser *parser) {
     }
 
     if(send_response) {
-        conn->server->SendResponse(conn,conn->request.response_data.dump,std::move(response),false);
+        conn->server->SendResponse(conn,conn->request.response_data.dump,std::move(response),false,false);
     }
 
     //conn->status="404 Not Found";
@@ -1136,26 +1396,40 @@ void HTTPServerImpl::HandleRead(uv_stream_t *stream,ssize_t num_read,const uv_bu
         ASSERT((size_t)num_read<=sizeof conn->read_buf);
         size_t total_num_read=conn->num_read+(size_t)num_read;
         ASSERT(total_num_read<=sizeof conn->read_buf);
-        size_t num_consumed=http_parser_execute(&conn->parser,&conn->parser_settings,conn->read_buf,total_num_read);
-        if(num_consumed==0) {
-            if(conn->parser.http_errno==0) {
-                // Is this even possible?
-                conn->parser.http_errno=HPE_UNKNOWN;
-            }
-        }
+        conn->server->Parse(conn,total_num_read);
+    }
 
-        if(conn->parser.http_errno!=0) {
-            LOGF(HTTP,"HTTP error: %s\n",http_errno_description((http_errno)conn->parser.http_errno));
-            conn->server->SendResponse(conn,conn->request.response_data.dump,CreateErrorResponse(conn->request,"400 Bad Request"),false);
-            //CloseConnection(conn);
-        } else {
-            ASSERT(num_consumed<=total_num_read);
-            memmove(conn->read_buf,conn->read_buf+num_consumed,total_num_read-num_consumed);
-            conn->num_read=total_num_read-num_consumed;
+    LOGF(HTTP,"%s: finish.\n",__func__);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Parse the first TOTAL_NUM_READ bytes of the read buffer. Returns true if
+// the parser wants more data; false if there's a complete request being
+// handled, or an error.
+bool HTTPServerImpl::Parse(Connection *conn,size_t total_num_read) {
+    size_t num_consumed=http_parser_execute(&conn->parser,&conn->parser_settings,conn->read_buf,total_num_read);
+    if(num_consumed==0) {
+        if(conn->parser.http_errno==0) {
+            // Is this even possible?
+            conn->parser.http_errno=HPE_UNKNOWN;
         }
     }
 
-    LOGF(HTTP,"%s: finish.\n",__func__);
+    if(!IsParserOK(&conn->parser)) {
+        LOGF(HTTP,"HTTP error: %s\n",http_errno_description((http_errno)conn->parser.http_errno));
+        conn->num_read=0;
+        this->SendResponse(conn,conn->request.response_data.dump,CreateErrorResponse(conn->request,"400 Bad Request"),false,false);
+        //CloseConnection(conn);
+        return false;
+    }
+
+    ASSERT(num_consumed<=total_num_read);
+    memmove(conn->read_buf,conn->read_buf+num_consumed,total_num_read-num_consumed);
+    conn->num_read=total_num_read-num_consumed;
+
+    return conn->parser.http_errno!=HPE_PAUSED;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -1188,12 +1462,54 @@ void HTTPServerImpl::HandleResponseWritten(uv_write_t *req,int status) {
         return;
     }
 
-    if(conn->interim_response) {
-        conn->server->StartReading(conn);
-    } else {
-        if(conn->keep_alive&&conn->parser.http_errno==0) {
-            conn->server->ResetRequest(conn);
+    if(conn->chunked_response) {
+        // Carry on with the chunks. HandleChunkWritten will deal with the
+        // connection when the last one has been written.
+    } else if(conn->interim_response) {
+        // If the request has been completed in the meantime, the parser
+        // is paused, and reading resumes once the response is written.
+        if(conn->parser.http_errno!=HPE_PAUSED) {
             conn->server->StartReading(conn);
+        }
+    } else {
+        if(conn->keep_alive&&IsParserOK(&conn->parser)) {
+            conn->server->ContinueConnection(conn);
+        } else {
+            conn->server->CloseConnection(conn);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void HTTPServerImpl::HandleChunkWritten(uv_write_t *req,int status) {
+    auto cw=(ChunkWrite *)req->data;
+    Connection *conn=cw->conn;
+    bool last=cw->last;
+
+    ASSERT(req==&cw->req);
+    ASSERT(conn->num_pending_chunk_bytes>=cw->data.size());
+    conn->num_pending_chunk_bytes-=cw->data.size();
+
+    delete cw;
+    cw=nullptr;
+
+    if(status!=0) {
+        // If an earlier write failed, the connection is already closing,
+        // and this write will have been canceled.
+        if(conn->server->m_td.connection_by_id.count(conn->id)!=0) {
+            PrintLibUVError(status,"%s status",__func__);
+            conn->server->CloseConnection(conn);
+        }
+        return;
+    }
+
+    if(last) {
+        conn->chunked_response=false;
+
+        if(conn->keep_alive&&IsParserOK(&conn->parser)) {
+            conn->server->ContinueConnection(conn);
         } else {
             conn->server->CloseConnection(conn);
         }
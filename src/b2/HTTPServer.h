@@ -81,6 +81,12 @@ public:
     std::vector<uint8_t> content_vec;
     std::string content_str;
 
+    // Sent straight from the buffer, without copying. The buffer must
+    // not be modified while the response is outstanding - which, in
+    // practice, means not at all, since there's no way of telling when
+    // it's done.
+    std::shared_ptr<const std::vector<uint8_t>> content_shared;
+
     // if content is non-empty but content_type is "", the assumed
     // content type is application/octet-stream.
     std::string content_type;
@@ -106,6 +112,7 @@ public:
     // status of 200 OK.
     HTTPResponse(std::string content_type,std::vector<uint8_t> content);
     HTTPResponse(std::string content_type,std::string content);
+    HTTPResponse(std::string content_type,std::shared_ptr<const std::vector<uint8_t>> content);
 
     HTTPResponse(std::string status,std::string content_type,std::vector<uint8_t> content);
     HTTPResponse(std::string status,std::string content_type,std::string content);
@@ -147,6 +154,15 @@ public:
 
     void SendResponse(const HTTPRequest &request,HTTPResponse response);
     virtual void SendResponse(const HTTPResponseData &response_data,HTTPResponse response)=0;
+
+    // Start a response with a chunked body, for streaming. Send the
+    // chunks with SendResponseChunk, and finish with an empty chunk.
+    //
+    // SendResponseChunk returns false if the connection has gone away,
+    // at which point the caller should stop. If the client isn't keeping
+    // up, chunks are dropped.
+    virtual void StartChunkedResponse(const HTTPResponseData &response_data,std::string content_type)=0;
+    virtual bool SendResponseChunk(const HTTPResponseData &response_data,std::vector<uint8_t> data)=0;
 protected:
 private:
 };
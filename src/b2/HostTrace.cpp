@@ -0,0 +1,349 @@
+#include <shared/system.h>
+#include "HostTrace.h"
+#include <shared/debug.h>
+#include <shared/mutex.h>
+#include <memory>
+#include <map>
+#include <typeindex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <inttypes.h>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#include <stdlib.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct ThreadBuffer {
+    Mutex mutex;
+    size_t tid=0;
+    std::string name;
+
+    // Ring buffer. Empty until the first event.
+    std::vector<HostTraceEvent> events;
+    size_t event_index=0;
+    bool events_wrapped=false;
+};
+
+struct Registry {
+    Mutex mutex;
+    size_t next_tid=1;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+struct TypeNames {
+    Mutex mutex;
+    std::map<std::type_index,std::string> name_by_type;
+};
+
+// Removes the thread's buffer from the registry when the thread exits.
+struct ThreadBufferRef {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadBufferRef();
+};
+
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static thread_local ThreadBufferRef g_thread_buffer_ref;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Never destroyed, as threads can keep going during static destruction.
+static Registry *GetRegistry() {
+    static Registry *registry=new Registry;
+
+    return registry;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Never destroyed, for the same reason, and so the names stay valid.
+static TypeNames *GetTypeNames() {
+    static TypeNames *type_names=new TypeNames;
+
+    return type_names;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+ThreadBufferRef::~ThreadBufferRef() {
+    if(!this->buffer) {
+        return;
+    }
+
+    Registry *registry=GetRegistry();
+    std::lock_guard<Mutex> lock(registry->mutex);
+
+    for(auto it=registry->buffers.begin();it!=registry->buffers.end();++it) {
+        if(*it==this->buffer) {
+            registry->buffers.erase(it);
+            break;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static ThreadBuffer *GetThreadBuffer() {
+    if(!g_thread_buffer_ref.buffer) {
+        auto buffer=std::make_shared<ThreadBuffer>();
+        MUTEX_SET_NAME(buffer->mutex,"HostTrace ThreadBuffer");
+
+        Registry *registry=GetRegistry();
+        std::lock_guard<Mutex> lock(registry->mutex);
+
+        buffer->tid=registry->next_tid++;
+        registry->buffers.push_back(buffer);
+
+        g_thread_buffer_ref.buffer=std::move(buffer);
+    }
+
+    return g_thread_buffer_ref.buffer.get();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void PRINTF_LIKE(2,3) AppendF(std::string *str,const char *fmt,...) {
+    char buf[500];
+
+    va_list v;
+    va_start(v,fmt);
+    int n=vsnprintf(buf,sizeof buf,fmt,v);
+    va_end(v);
+
+    ASSERT(n>=0&&(size_t)n<sizeof buf);
+    (void)n;
+
+    str->append(buf);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void AppendJSONString(std::string *str,const char *value) {
+    str->push_back('"');
+
+    for(const char *c=value;*c!=0;++c) {
+        if(*c=='"'||*c=='\\') {
+            str->push_back('\\');
+            str->push_back(*c);
+        } else if((unsigned char)*c<32) {
+            AppendF(str,"\\u%04x",(unsigned char)*c);
+        } else {
+            str->push_back(*c);
+        }
+    }
+
+    str->push_back('"');
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SetHostTraceThreadName(const char *name) {
+    ThreadBuffer *buffer=GetThreadBuffer();
+    std::lock_guard<Mutex> lock(buffer->mutex);
+
+    buffer->name=name;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void AddHostTraceEvent(const HostTraceEvent &event) {
+    ThreadBuffer *buffer=GetThreadBuffer();
+    std::lock_guard<Mutex> lock(buffer->mutex);
+
+    if(buffer->events.empty()) {
+        buffer->events.resize(HOST_TRACE_MAX_NUM_EVENTS);
+    }
+
+    buffer->events[buffer->event_index]=event;
+
+    ++buffer->event_index;
+    if(buffer->event_index==buffer->events.size()) {
+        buffer->event_index=0;
+        buffer->events_wrapped=true;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::vector<HostTraceThread> GetHostTraceThreads() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        Registry *registry=GetRegistry();
+        std::lock_guard<Mutex> lock(registry->mutex);
+
+        buffers=registry->buffers;
+    }
+
+    std::vector<HostTraceThread> threads;
+    threads.reserve(buffers.size());
+
+    for(const std::shared_ptr<ThreadBuffer> &buffer:buffers) {
+        threads.emplace_back();
+        HostTraceThread *thread=&threads.back();
+
+        std::lock_guard<Mutex> lock(buffer->mutex);
+
+        if(buffer->name.empty()) {
+            AppendF(&thread->name,"Thread %zu",buffer->tid);
+        } else {
+            thread->name=buffer->name;
+        }
+
+        if(buffer->events_wrapped) {
+            thread->events.insert(thread->events.end(),buffer->events.begin()+(ptrdiff_t)buffer->event_index,buffer->events.end());
+        }
+
+        thread->events.insert(thread->events.end(),buffer->events.begin(),buffer->events.begin()+(ptrdiff_t)buffer->event_index);
+    }
+
+    return threads;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::string GetHostTraceChromeTrace(const std::vector<HostTraceThread> &threads) {
+    std::string json;
+
+    uint64_t base_ticks=UINT64_MAX;
+    for(const HostTraceThread &thread:threads) {
+        if(!thread.events.empty()&&thread.events[0].begin_ticks<base_ticks) {
+            base_ticks=thread.events[0].begin_ticks;
+        }
+    }
+
+    double us_per_tick=GetSecondsFromTicks(1)*1e6;
+
+    json+="{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json+="{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"b2\"}}";
+
+    for(size_t tid=1;tid<=threads.size();++tid) {
+        const HostTraceThread *thread=&threads[tid-1];
+
+        AppendF(&json,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":",tid);
+        AppendJSONString(&json,thread->name.c_str());
+        json+="}}";
+
+        AppendF(&json,",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"sort_index\":%zu}}",tid,tid);
+
+        for(const HostTraceEvent &e:thread->events) {
+            json+=",\n{\"name\":";
+            AppendJSONString(&json,e.name);
+            AppendF(&json,",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                    tid,
+                    (e.begin_ticks-base_ticks)*us_per_tick,
+                    (e.end_ticks-e.begin_ticks)*us_per_tick);
+
+            const char *sep="";
+
+            if(e.begin_cycle!=HOST_TRACE_NO_CYCLE) {
+                AppendF(&json,"\"cycle\":%" PRIu64,e.begin_cycle);
+                sep=",";
+
+                if(e.end_cycle!=HOST_TRACE_NO_CYCLE) {
+                    AppendF(&json,",\"num_cycles\":%" PRId64,(int64_t)(e.end_cycle-e.begin_cycle));
+                }
+            }
+
+            if(e.detail) {
+                AppendF(&json,"%s\"detail\":",sep);
+                AppendJSONString(&json,e.detail);
+            }
+
+            json+="}}";
+        }
+    }
+
+    json+="\n]}\n";
+
+    return json;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+HostTraceScope::HostTraceScope(const char *name,uint64_t begin_cycle) {
+    m_event.name=name;
+    m_event.begin_cycle=begin_cycle;
+    m_event.begin_ticks=GetCurrentTickCount();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+HostTraceScope::~HostTraceScope() {
+    m_event.end_ticks=GetCurrentTickCount();
+
+    AddHostTraceEvent(m_event);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void HostTraceScope::SetDetail(const char *detail) {
+    m_event.detail=detail;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void HostTraceScope::SetEndCycle(uint64_t end_cycle) {
+    m_event.end_cycle=end_cycle;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+const char *GetHostTraceTypeName(const std::type_info &type) {
+    TypeNames *type_names=GetTypeNames();
+
+    std::lock_guard<Mutex> lock(type_names->mutex);
+
+    auto it=type_names->name_by_type.find(type);
+    if(it==type_names->name_by_type.end()) {
+        std::string name;
+
+#ifdef __GNUC__
+        int status;
+        char *demangled=abi::__cxa_demangle(type.name(),nullptr,nullptr,&status);
+        if(status==0&&demangled) {
+            name=demangled;
+        } else {
+            name=type.name();
+        }
+
+        free(demangled);
+#else
+        // Already readable.
+        name=type.name();
+#endif
+
+        it=type_names->name_by_type.insert({type,std::move(name)}).first;
+    }
+
+    return it->second.c_str();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,104 @@
+#ifndef HEADER_40971E21E9C3452C94030A635801A20D// -*- mode:c++ -*-
+#define HEADER_40971E21E9C3452C94030A635801A20D
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Always-on record of what the host threads have been doing recently -
+// BeebThread run slices and messages, audio callbacks, vblank handling,
+// jobs, and so on - that can be saved in Chrome trace event format, for
+// chrome://tracing or Perfetto, and attached to a bug report.
+//
+// Each thread records into its own ring buffer, allocated the first time
+// it records anything, so only the most recent HOST_TRACE_MAX_NUM_EVENTS
+// events per thread are kept. A thread's buffer goes away when the
+// thread exits.
+//
+// Recording an event costs a couple of clock reads and an uncontended
+// mutex lock. That's fine for things that happen a few thousand times a
+// second, but no good for anything per-cycle - see SubsystemProfiler.h
+// for that.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+#include <typeinfo>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static constexpr size_t HOST_TRACE_MAX_NUM_EVENTS=1<<15;
+
+// Cycle count for events that don't have one.
+static constexpr uint64_t HOST_TRACE_NO_CYCLE=UINT64_MAX;
+
+struct HostTraceEvent {
+    // Static strings - only the pointers are stored.
+    const char *name=nullptr;
+    const char *detail=nullptr;
+
+    uint64_t begin_ticks=0;
+    uint64_t end_ticks=0;
+
+    // Emulated 2 MHz cycle counts at the start and end, if relevant.
+    uint64_t begin_cycle=HOST_TRACE_NO_CYCLE;
+    uint64_t end_cycle=HOST_TRACE_NO_CYCLE;
+};
+
+struct HostTraceThread {
+    std::string name;
+
+    // Oldest first.
+    std::vector<HostTraceEvent> events;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Name the current thread in the trace. SetCurrentThreadName does this
+// too, via the callback set up in main. Threads with no name are
+// numbered.
+void SetHostTraceThreadName(const char *name);
+
+void AddHostTraceEvent(const HostTraceEvent &event);
+
+// Copy of the events for all current threads, in the order the threads
+// started recording.
+std::vector<HostTraceThread> GetHostTraceThreads();
+
+// Chrome trace event format JSON. Timestamps are relative to the
+// earliest event.
+std::string GetHostTraceChromeTrace(const std::vector<HostTraceThread> &threads);
+
+// Readable name for TYPE, suitable for HostTraceScope::SetDetail. Each
+// type's name is demangled the first time it's asked for, then kept
+// forever.
+const char *GetHostTraceTypeName(const std::type_info &type);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Records an event covering its own lifetime.
+class HostTraceScope {
+public:
+    explicit HostTraceScope(const char *name,uint64_t begin_cycle=HOST_TRACE_NO_CYCLE);
+    ~HostTraceScope();
+
+    HostTraceScope(const HostTraceScope &)=delete;
+    HostTraceScope &operator=(const HostTraceScope &)=delete;
+    HostTraceScope(HostTraceScope &&)=delete;
+    HostTraceScope &operator=(HostTraceScope &&)=delete;
+
+    void SetDetail(const char *detail);
+    void SetEndCycle(uint64_t end_cycle);
+protected:
+private:
+    HostTraceEvent m_event;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -1,6 +1,15 @@
 #include <shared/system.h>
 #include "JobQueue.h"
+#include <shared/debug.h>
+#include "HostTrace.h"
 #include <functional>
+#include <string>
+#include <typeinfo>
+#include <algorithm>
+
+#include <shared/enum_def.h>
+#include "JobQueue.inl"
+#include <shared/enum_end.h>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -33,6 +42,10 @@ bool JobQueue::Job::IsFinished() const {
 
 void JobQueue::Job::Cancel() {
     m_canceled.store(true,std::memory_order_release);
+
+    if(JobQueue *job_queue=m_job_queue.load(std::memory_order_acquire)) {
+        job_queue->RemoveCanceledJob(this);
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -45,6 +58,13 @@ bool JobQueue::Job::WasCanceled() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+JobPriority JobQueue::Job::GetPriority() const {
+    return JobPriority_Background;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool JobQueue::Job::HasImGui() const {
     return false;
 }
@@ -59,7 +79,8 @@ void JobQueue::Job::DoImGui() {
 //////////////////////////////////////////////////////////////////////////
 
 JobQueue::JobQueue() {
-    MUTEX_SET_NAME(m_jobs_mutex,"Jobs");
+    MUTEX_SET_NAME(m_wake_mutex,"JobQueue wake");
+    MUTEX_SET_NAME(m_dependencies_mutex,"JobQueue dependencies");
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -67,25 +88,47 @@ JobQueue::JobQueue() {
 
 JobQueue::~JobQueue() {
     {
-        std::lock_guard<Mutex> lock(m_jobs_mutex);
+        std::lock_guard<Mutex> lock(m_wake_mutex);
 
-        for(auto &&thread:m_threads) {
-            if(!!thread.job) {
-                thread.job->Cancel();
-            }
+        m_quit=true;
+    }
+
+    for(const std::unique_ptr<ThreadData> &td:m_threads) {
+        std::lock_guard<Mutex> lock(td->mutex);
+
+        // Set the flags directly - Cancel would try to remove the queued
+        // jobs, and td->mutex is already locked.
+        if(!!td->job) {
+            td->job->m_canceled.store(true,std::memory_order_release);
         }
 
-        for(auto &&job:m_jobs) {
-            job->Cancel();
+        for(const std::deque<std::shared_ptr<Job>> &jobs:td->jobs) {
+            for(const std::shared_ptr<Job> &job:jobs) {
+                job->m_canceled.store(true,std::memory_order_release);
+            }
         }
+    }
 
-        m_quit=true;
+    m_wake_cv.notify_all();
+
+    for(const std::unique_ptr<ThreadData> &td:m_threads) {
+        if(td->thread.joinable()) {
+            td->thread.join();
+        }
     }
 
-    m_jobs_cv.notify_all();
+    // Mark anything left over as finished, so nobody waits on it
+    // forever.
+    for(const std::unique_ptr<ThreadData> &td:m_threads) {
+        for(std::deque<std::shared_ptr<Job>> &jobs:td->jobs) {
+            while(!jobs.empty()) {
+                std::shared_ptr<Job> job=std::move(jobs.front());
+                jobs.pop_front();
 
-    for(auto &&thread:m_threads) {
-        thread.thread.join();
+                job->m_job_queue.store(nullptr,std::memory_order_release);
+                this->FinishJob(job);
+            }
+        }
     }
 }
 
@@ -101,12 +144,23 @@ bool JobQueue::Init(unsigned num_threads) {
         num_threads=1;          // got to do something.
     }
 
+    // Create all the ThreadData first - each thread looks at all of them.
     m_threads.resize(num_threads);
 
     for(unsigned i=0;i<num_threads;++i) {
-        ThreadData *td=&m_threads[i];
+        m_threads[i]=std::make_unique<ThreadData>();
+
+        ThreadData *td=m_threads[i].get();
 
+        td->job_queue=this;
         td->index=i;
+        MUTEX_SET_NAME(td->mutex,"JobQueue thread "+std::to_string(i));
+    }
+
+    std::lock_guard<Mutex> lock(m_wake_mutex);
+
+    for(unsigned i=0;i<num_threads;++i) {
+        ThreadData *td=m_threads[i].get();
 
         try {
             td->thread=std::thread(std::bind(&JobQueue::ThreadFunc,this,td));
@@ -122,13 +176,29 @@ bool JobQueue::Init(unsigned num_threads) {
 //////////////////////////////////////////////////////////////////////////
 
 void JobQueue::AddJob(std::shared_ptr<Job> job) {
-    {
-        std::lock_guard<Mutex> lock(m_jobs_mutex);
+    this->AddJob(std::move(job),{});
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void JobQueue::AddJob(std::shared_ptr<Job> job,const std::vector<std::shared_ptr<Job>> &dependencies) {
+    if(!dependencies.empty()) {
+        std::lock_guard<Mutex> lock(m_dependencies_mutex);
 
-        m_jobs.push_back(std::move(job));
+        for(const std::shared_ptr<Job> &dependency:dependencies) {
+            if(!dependency->IsFinished()) {
+                job->m_num_blockers.fetch_add(1,std::memory_order_acq_rel);
+                dependency->m_dependents.push_back(job);
+            }
+        }
     }
 
-    m_jobs_cv.notify_one();
+    // Remove the not-added-yet blocker. If there are unfinished
+    // dependencies, whichever finishes last will queue the job.
+    if(job->m_num_blockers.fetch_sub(1,std::memory_order_acq_rel)==1) {
+        this->QueueJob(std::move(job));
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -137,18 +207,20 @@ void JobQueue::AddJob(std::shared_ptr<Job> job) {
 std::vector<std::shared_ptr<JobQueue::Job>> JobQueue::GetJobs() const {
     std::vector<std::shared_ptr<Job>> jobs;
 
-    std::lock_guard<Mutex> lock(m_jobs_mutex);
-
-    for(const ThreadData &thread:m_threads) {
-        std::shared_ptr<Job> job=thread.job;
+    for(const std::unique_ptr<ThreadData> &td:m_threads) {
+        std::lock_guard<Mutex> lock(td->mutex);
 
-        if(!!job) {
-            jobs.emplace_back(std::move(job));
+        if(!!td->job) {
+            jobs.push_back(td->job);
         }
     }
 
-    if(!m_jobs.empty()) {
-        jobs.insert(jobs.end(),m_jobs.begin(),m_jobs.end());
+    for(const std::unique_ptr<ThreadData> &td:m_threads) {
+        std::lock_guard<Mutex> lock(td->mutex);
+
+        for(const std::deque<std::shared_ptr<Job>> &td_jobs:td->jobs) {
+            jobs.insert(jobs.end(),td_jobs.begin(),td_jobs.end());
+        }
     }
 
     return jobs;
@@ -157,43 +229,209 @@ std::vector<std::shared_ptr<JobQueue::Job>> JobQueue::GetJobs() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void JobQueue::ThreadFunc(ThreadData *td) {
-    SetCurrentThreadNamef("JobQueue%zu",td->index);
-
-    for(;;) {
-        std::unique_lock<Mutex> lock(m_jobs_mutex);
+void JobQueue::QueueJob(std::shared_ptr<Job> job) {
+    ASSERT(!m_threads.empty());
 
-        td->job=nullptr;
+    {
+        std::unique_lock<Mutex> lock(m_wake_mutex);
 
         if(m_quit) {
+            lock.unlock();
+
+            job->Cancel();
+            this->FinishJob(job);
+            return;
+        }
+    }
+
+    // Jobs added by a job go on that job's thread's queue.
+    ThreadData *td=nullptr;
+    {
+        std::thread::id id=std::this_thread::get_id();
+
+        for(const std::unique_ptr<ThreadData> &thread_td:m_threads) {
+            if(thread_td->thread.get_id()==id) {
+                td=thread_td.get();
+                break;
+            }
+        }
+    }
+
+    if(!td) {
+        size_t index=m_next_thread_index.fetch_add(1,std::memory_order_relaxed);
+        td=m_threads[index%m_threads.size()].get();
+    }
+
+    JobPriority priority=job->GetPriority();
+    ASSERT(priority>=0&&priority<JobPriority_Count);
+
+    {
+        std::lock_guard<Mutex> lock(td->mutex);
+
+        job->m_job_queue.store(this,std::memory_order_release);
+        td->jobs[priority].push_back(std::move(job));
+
+        std::lock_guard<Mutex> wake_lock(m_wake_mutex);
+
+        m_num_queued_jobs.fetch_add(1,std::memory_order_acq_rel);
+    }
+
+    m_wake_cv.notify_one();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void JobQueue::RemoveCanceledJob(Job *job) {
+    std::shared_ptr<Job> removed_job;
+
+    for(const std::unique_ptr<ThreadData> &td:m_threads) {
+        std::lock_guard<Mutex> lock(td->mutex);
+
+        for(std::deque<std::shared_ptr<Job>> &jobs:td->jobs) {
+            auto it=std::find_if(jobs.begin(),jobs.end(),[job](const std::shared_ptr<Job> &queued_job) {
+                return queued_job.get()==job;
+            });
+
+            if(it!=jobs.end()) {
+                removed_job=std::move(*it);
+                jobs.erase(it);
+
+                m_num_queued_jobs.fetch_sub(1,std::memory_order_acq_rel);
+                break;
+            }
+        }
+
+        if(!!removed_job) {
             break;
         }
+    }
+
+    // If it wasn't found, a thread has taken it already.
+    if(!!removed_job) {
+        removed_job->m_job_queue.store(nullptr,std::memory_order_release);
+        this->FinishJob(removed_job);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Find the highest priority job to run - oldest from this thread's own
+// queue if possible, otherwise newest from another thread's queue.
+std::shared_ptr<JobQueue::Job> JobQueue::TakeJob(ThreadData *td) {
+    std::shared_ptr<Job> job;
+
+    for(int priority=0;priority<JobPriority_Count;++priority) {
+        {
+            std::lock_guard<Mutex> lock(td->mutex);
+
+            std::deque<std::shared_ptr<Job>> *jobs=&td->jobs[priority];
+            if(!jobs->empty()) {
+                job=std::move(jobs->front());
+                jobs->pop_front();
+                m_num_queued_jobs.fetch_sub(1,std::memory_order_acq_rel);
+            }
+        }
+
+        for(size_t i=1;!job&&i<m_threads.size();++i) {
+            ThreadData *other_td=m_threads[(td->index+i)%m_threads.size()].get();
 
-        if(m_jobs.empty()) {
-            m_jobs_cv.wait(lock);
+            std::lock_guard<Mutex> lock(other_td->mutex);
+
+            std::deque<std::shared_ptr<Job>> *jobs=&other_td->jobs[priority];
+            if(!jobs->empty()) {
+                job=std::move(jobs->back());
+                jobs->pop_back();
+                m_num_queued_jobs.fetch_sub(1,std::memory_order_acq_rel);
+            }
         }
 
-        if(!m_jobs.empty()) {
-            td->job=m_jobs.front();
-            m_jobs.erase(m_jobs.begin());
+        if(!!job) {
+            job->m_job_queue.store(nullptr,std::memory_order_release);
 
-            // take a copy of td->job, since it will be used with the
-            // mutex unlocked.
-            std::shared_ptr<Job> job=td->job;
+            std::lock_guard<Mutex> lock(td->mutex);
 
-            lock.unlock();
+            td->job=job;
 
-            if(job->WasCanceled()) {
-                // nothing to do...
-            } else {
-                job->m_running.store(true,std::memory_order_release);
+            return job;
+        }
+    }
 
-                job->ThreadExecute();
+    return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void JobQueue::FinishJob(const std::shared_ptr<Job> &job) {
+    std::vector<std::shared_ptr<Job>> dependents;
 
-                job->m_running.store(false,std::memory_order_release);
+    {
+        std::lock_guard<Mutex> lock(m_dependencies_mutex);
+
+        job->m_finished.store(true,std::memory_order_release);
+
+        dependents.swap(job->m_dependents);
+    }
+
+    for(std::shared_ptr<Job> &dependent:dependents) {
+        if(dependent->m_num_blockers.fetch_sub(1,std::memory_order_acq_rel)==1) {
+            this->QueueJob(std::move(dependent));
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void JobQueue::ThreadFunc(ThreadData *td) {
+    SetCurrentThreadNamef("JobQueue%zu",td->index);
+
+    {
+        // Init holds this while it creates the threads. Once it's
+        // available, all the ThreadData is ready.
+        std::lock_guard<Mutex> lock(m_wake_mutex);
+    }
+
+    for(;;) {
+        std::shared_ptr<Job> job=this->TakeJob(td);
+
+        if(!job) {
+            std::unique_lock<Mutex> lock(m_wake_mutex);
+
+            if(m_quit) {
+                break;
             }
 
-            job->m_finished.store(true,std::memory_order_release);
+            if(m_num_queued_jobs.load(std::memory_order_acquire)==0) {
+                m_wake_cv.wait(lock);
+            }
+
+            continue;
         }
+
+        if(job->WasCanceled()) {
+            // nothing to do...
+        } else {
+            job->m_running.store(true,std::memory_order_release);
+
+            {
+                HostTraceScope hts("Job");
+                hts.SetDetail(GetHostTraceTypeName(typeid(*job)));
+
+                job->ThreadExecute();
+            }
+
+            job->m_running.store(false,std::memory_order_release);
+        }
+
+        {
+            std::lock_guard<Mutex> lock(td->mutex);
+
+            td->job=nullptr;
+        }
+
+        this->FinishJob(job);
     }
 }
@@ -7,11 +7,25 @@
 #include <thread>
 #include <shared/mutex.h>
 #include <vector>
+#include <deque>
+#include <memory>
 #include <atomic>
 
+#include <shared/enum_decl.h>
+#include "JobQueue.inl"
+#include <shared/enum_end.h>
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Each thread has its own queue of jobs per priority. Jobs added from a
+// job thread go on that thread's queue, so a job can fan out sub-jobs
+// cheaply; jobs added from anywhere else are shared out round robin. A
+// thread with nothing to do takes jobs from the other threads' queues.
+//
+// Canceling a job that hasn't started yet removes it from its queue, and
+// it finishes without running.
+
 class JobQueue {
 public:
     class Job {
@@ -25,13 +39,16 @@ public:
         void Cancel();
         bool WasCanceled() const;
 
+        // Default impl returns JobPriority_Background.
+        virtual JobPriority GetPriority() const;
+
         // Default impl returns false.
         virtual bool HasImGui() const;
 
         // Do whatever. No need to call base class. Default impl does
         // nothing.
         virtual void DoImGui();
-    
+
         virtual void ThreadExecute()=0;
     protected:
         Job(const Job &)=delete;
@@ -42,7 +59,19 @@ public:
         mutable std::atomic<bool> m_running{false};
         mutable std::atomic<bool> m_canceled{false};
         mutable std::atomic<bool> m_finished{false};
-    
+
+        // Number of things stopping this job from being queued: 1 for
+        // not having been added yet, plus 1 per unfinished dependency.
+        std::atomic<size_t> m_num_blockers{1};
+
+        // Jobs waiting on this one. Protected by the job queue's
+        // dependencies mutex.
+        std::vector<std::shared_ptr<Job>> m_dependents;
+
+        // The queue the job is waiting on, if any. The queue must outlive
+        // any Cancel call made while it's set.
+        std::atomic<JobQueue *> m_job_queue{nullptr};
+
         friend class JobQueue;
     };
 
@@ -53,23 +82,47 @@ public:
 
     void AddJob(std::shared_ptr<Job> job);
 
-    // Get all jobs, running and waiting.
+    // The job won't start until all of its dependencies have finished
+    // (whether canceled or not). The dependencies must have been, or will
+    // be, added to this queue.
+    void AddJob(std::shared_ptr<Job> job,const std::vector<std::shared_ptr<Job>> &dependencies);
+
+    // Get all jobs, running and waiting. Jobs still waiting for their
+    // dependencies aren't included.
     std::vector<std::shared_ptr<Job>> GetJobs() const;
 protected:
 private:
     struct ThreadData {
+        JobQueue *job_queue=nullptr;
         std::thread thread;
+        size_t index=0;
+
+        // Protects job and jobs.
+        mutable Mutex mutex;
+
         std::shared_ptr<Job> job;
-        size_t index;
+        std::deque<std::shared_ptr<Job>> jobs[JobPriority_Count];
     };
-    
-    std::vector<ThreadData> m_threads;
-    
-    mutable Mutex m_jobs_mutex;
-    ConditionVariable m_jobs_cv;
-    std::vector<std::shared_ptr<Job>> m_jobs;
+
+    std::vector<std::unique_ptr<ThreadData>> m_threads;
+    std::atomic<size_t> m_next_thread_index{0};
+
+    // Number of jobs on the threads' queues. Only modified with the
+    // relevant ThreadData mutex locked, along with the queue edit, and
+    // only incremented with m_wake_mutex locked too, so a thread can check
+    // it's zero before sleeping without missing a wakeup.
+    std::atomic<size_t> m_num_queued_jobs{0};
+
+    Mutex m_wake_mutex;
+    ConditionVariable m_wake_cv;
     bool m_quit=false;
 
+    Mutex m_dependencies_mutex;
+
+    void QueueJob(std::shared_ptr<Job> job);
+    void RemoveCanceledJob(Job *job);
+    std::shared_ptr<Job> TakeJob(ThreadData *td);
+    void FinishJob(const std::shared_ptr<Job> &job);
     void ThreadFunc(ThreadData *td);
 };
 
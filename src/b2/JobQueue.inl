@@ -0,0 +1,19 @@
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Jobs of higher priority are always started before jobs of lower
+// priority. (Running jobs aren't interrupted though.)
+#define ENAME JobPriority
+EBEGIN()
+// Results are wanted now - e.g., thumbnails for the UI.
+EPN(Interactive)
+
+// Results are wanted eventually - e.g., video export.
+EPN(Background)
+
+EPN(Count)
+EEND()
+#undef ENAME
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
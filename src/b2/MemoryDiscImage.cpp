@@ -4,6 +4,8 @@
 #include "MemoryDiscImage.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include "download.h"
 #include "misc.h"
 #include <shared/sha1.h>
@@ -12,7 +14,6 @@
 #include "load_save.h"
 #include "Messages.h"
 #include <inttypes.h>
-#include "native_ui.h"
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -88,18 +89,35 @@ std::shared_ptr<MemoryDiscImage> MemoryDiscImage::LoadFromBuffer(
     const DiscGeometry &geometry,
     Messages *msg)
 {
-    if(data_size==0) {
+    return LoadFromBuffer(std::move(path),
+                          std::move(load_method),
+                          std::vector<uint8_t>((const uint8_t *)data,(const uint8_t *)data+data_size),
+                          geometry,
+                          msg);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::shared_ptr<MemoryDiscImage> MemoryDiscImage::LoadFromBuffer(
+    std::string path,
+    std::string load_method,
+    std::vector<uint8_t> data,
+    const DiscGeometry &geometry,
+    Messages *msg)
+{
+    if(data.empty()) {
         msg->e.f("%s: disc image is empty\n",path.c_str());
         return nullptr;
     }
 
-    if(data_size%geometry.bytes_per_sector!=0) {
+    if(data.size()%geometry.bytes_per_sector!=0) {
         msg->e.f("%s: not a multiple of sector size (%zu)\n",
                  path.c_str(),geometry.bytes_per_sector);
         return nullptr;
     }
 
-    return std::shared_ptr<MemoryDiscImage>(new MemoryDiscImage(std::move(path),std::move(load_method),data,data_size,geometry));
+    return std::shared_ptr<MemoryDiscImage>(new MemoryDiscImage(std::move(path),std::move(load_method),std::move(data),geometry));
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -241,7 +259,7 @@ std::shared_ptr<MemoryDiscImage> MemoryDiscImage::LoadFromFile(
         method=LOAD_METHOD_FILE;
     }
 
-    return LoadFromBuffer(path,method,data.data(),data.size(),geometry,msg);
+    return LoadFromBuffer(path,method,std::move(data),geometry,msg);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -257,13 +275,12 @@ MemoryDiscImage::MemoryDiscImage():
 
 MemoryDiscImage::MemoryDiscImage(std::string path,
                                  std::string load_method,
-                                 const void *data,
-                                 size_t data_size,
+                                 std::vector<uint8_t> data,
                                  const DiscGeometry &geometry):
     m_data(new Data),
     m_load_method(std::move(load_method))
 {
-    m_data->data.assign((const uint8_t *)data,(const uint8_t *)data+data_size);
+    m_data->data=std::move(data);
     m_data->geometry=geometry;
     this->SetName(std::move(path));
 }
@@ -361,10 +378,8 @@ std::string MemoryDiscImage::GetDescription() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void MemoryDiscImage::AddFileDialogFilter(FileDialog *fd) const {
-    if(const char *ext=GetExtensionFromDiscGeometry(m_data->geometry)) {
-        fd->AddFilter("BBC disc image",{ext});
-    }
+const char *MemoryDiscImage::GetFileExtension() const {
+    return GetExtensionFromDiscGeometry(m_data->geometry);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -444,6 +459,72 @@ bool MemoryDiscImage::Write(uint8_t side,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool MemoryDiscImage::ReadSector(uint8_t *buf,
+                                 size_t size,
+                                 uint8_t side,
+                                 uint8_t track,
+                                 uint8_t sector) const
+{
+    if(size>m_data->geometry.bytes_per_sector) {
+        return false;
+    }
+
+    std::lock_guard<Mutex> lock(m_data->mut);
+
+    size_t index;
+    if(!m_data->geometry.GetIndex(&index,side,track,sector,0)) {
+        return false;
+    }
+
+    size_t n=0;
+    if(index<m_data->data.size()) {
+        n=std::min(size,m_data->data.size()-index);
+        memcpy(buf,m_data->data.data()+index,n);
+    }
+
+    memset(buf+n,FILL_BYTE,size-n);
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool MemoryDiscImage::WriteSector(uint8_t side,
+                                  uint8_t track,
+                                  uint8_t sector,
+                                  const uint8_t *buf,
+                                  size_t size)
+{
+    if(size>m_data->geometry.bytes_per_sector) {
+        return false;
+    }
+
+    size_t index;
+    if(!m_data->geometry.GetIndex(&index,side,track,sector,0)) {
+        return false;
+    }
+
+    this->MakeDataUnique();
+
+    std::lock_guard<Mutex> lock(m_data->mut);
+
+    if(index+size>m_data->data.size()) {
+        // Same rounding as Write.
+        m_data->data.resize((index+m_data->geometry.bytes_per_sector)/m_data->geometry.bytes_per_sector*m_data->geometry.bytes_per_sector,FILL_BYTE);
+    }
+
+    if(memcmp(m_data->data.data()+index,buf,size)!=0) {
+        memcpy(m_data->data.data()+index,buf,size);
+        m_data->hash.clear();
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool MemoryDiscImage::GetDiscSectorSize(size_t *size,
                                         uint8_t side,
                                         uint8_t track,
@@ -9,7 +9,6 @@
 #include "DiscGeometry.h"
 
 class Messages;
-class FileDialog;
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -25,6 +24,9 @@ public:
 
     static std::shared_ptr<MemoryDiscImage> LoadFromBuffer(std::string path,std::string load_method,const void *data,size_t data_size,const DiscGeometry &geometry,Messages *msg);
 
+    // Takes ownership of the data without copying it.
+    static std::shared_ptr<MemoryDiscImage> LoadFromBuffer(std::string path,std::string load_method,std::vector<uint8_t> data,const DiscGeometry &geometry,Messages *msg);
+
     // If the load succeeds, the method will be LOAD_METHOD_FILE or
     // LOAD_METHOD_ZIP.
     static std::shared_ptr<MemoryDiscImage> LoadFromFile(std::string path,Messages *msg);
@@ -47,12 +49,14 @@ public:
     std::string GetName() const override;
     std::string GetLoadMethod() const override;
     std::string GetDescription() const override;
-    void AddFileDialogFilter(FileDialog *fd) const override;
+    const char *GetFileExtension() const override;
     bool SaveToFile(const std::string &file_name,Messages *msg) const override;
     //void SetNameAndLoadMethod(std::string name,std::string load_method);
 
     bool Read(uint8_t *value,uint8_t side,uint8_t track,uint8_t sector,size_t offset) const override;
     bool Write(uint8_t side,uint8_t track,uint8_t sector,size_t offset,uint8_t value) override;
+    bool ReadSector(uint8_t *buf,size_t size,uint8_t side,uint8_t track,uint8_t sector) const override;
+    bool WriteSector(uint8_t side,uint8_t track,uint8_t sector,const uint8_t *buf,size_t size) override;
     bool GetDiscSectorSize(size_t *size,uint8_t side,uint8_t track,uint8_t sector,bool double_density) const override;
     bool IsWriteProtected() const override;
 protected:
@@ -64,7 +68,7 @@ private:
     std::string m_load_method;
 
     MemoryDiscImage();
-    MemoryDiscImage(std::string path,std::string load_method,const void *data,size_t data_size,const DiscGeometry &geometry);
+    MemoryDiscImage(std::string path,std::string load_method,std::vector<uint8_t> data,const DiscGeometry &geometry);
 
     // doesn't add a new ref - caller must arrange this.
     MemoryDiscImage(Data *data,std::string name,std::string load_method);
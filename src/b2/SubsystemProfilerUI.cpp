@@ -0,0 +1,537 @@
+#include <shared/system.h>
+#include "SubsystemProfilerUI.h"
+#include "SettingsUI.h"
+#include "BeebWindow.h"
+#include "BeebThread.h"
+#include "dear_imgui.h"
+#include "native_ui.h"
+#include "load_save.h"
+#include "Messages.h"
+#include <beeb/BBCMicro.h>
+#include <beeb/SubsystemProfiler.h>
+#include <shared/debug.h>
+#include <shared/mutex.h>
+#include <inttypes.h>
+#include <math.h>
+#include <algorithm>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const std::string RECENT_PATHS_PROFILES("profiles");
+
+// How often the emulation thread copies the profile for the UI.
+static const double PROFILE_UPDATE_INTERVAL_SECONDS=.25;
+
+static const size_t NUM_TOP_MMIO_ADDRESSES=16;
+static const size_t NUM_TOP_EXECUTION_ADDRESSES=32;
+
+// Size of each page in the heat map.
+static const float HEAT_MAP_CELL_SIZE=12.f;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Shared between the UI and the VSyncFn that runs on the BeebThread.
+//
+// The VSyncFn enables profiling on whichever BBCMicro the thread has -
+// it gets replaced on hard reset, and so on - and copies out the results
+// every so often. When the UI no longer wants profiling, it disables it
+// and removes itself.
+struct SubsystemProfilerUIState {
+    Mutex mutex;
+
+    // Set by the UI.
+    bool profiling=false;
+    bool reset=false;
+    bool events_wanted=false;
+
+    // Whether the VSyncFn is active.
+    bool vsync_fn_added=false;
+
+    // Set by the VSyncFn.
+    uint64_t profile_ticks=0;
+    bool new_profile=false;
+    SubsystemProfile profile;
+    bool new_events=false;
+    std::vector<SubsystemProfilerEvent> events;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class SubsystemProfilerUI:
+    public SettingsUI
+{
+public:
+    explicit SubsystemProfilerUI(BeebWindow *beeb_window);
+    ~SubsystemProfilerUI();
+
+    void DoImGui() override;
+    bool OnClose() override;
+protected:
+private:
+    BeebWindow *m_beeb_window=nullptr;
+    std::shared_ptr<SubsystemProfilerUIState> m_state;
+
+    bool m_profiling=false;
+    bool m_has_profile=false;
+    SubsystemProfile m_profile;
+
+    // Derived from m_profile when it's updated.
+    double m_total_ticks=0.;
+    std::vector<uint16_t> m_top_mmio_addresses;
+    std::vector<uint16_t> m_top_execution_addresses;
+    uint64_t m_page_num_executions[256]={};
+    uint64_t m_max_page_num_executions=0;
+
+    // Path to save the Chrome trace to, once the events arrive.
+    std::string m_chrome_trace_path;
+
+    void SetProfiling(bool profiling);
+    void UpdateProfile();
+    void UpdateProfileSummary();
+    void DoSubsystemsImGui();
+    void DoMMIOImGui();
+    void DoExecutionsImGui();
+    void SaveJSON();
+    void SaveChromeTrace();
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+SubsystemProfilerUI::SubsystemProfilerUI(BeebWindow *beeb_window):
+    m_beeb_window(beeb_window),
+    m_state(std::make_shared<SubsystemProfilerUIState>())
+{
+    MUTEX_SET_NAME(m_state->mutex,"SubsystemProfilerUIState");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+SubsystemProfilerUI::~SubsystemProfilerUI() {
+    this->SetProfiling(false);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::DoImGui() {
+    this->UpdateProfile();
+
+    bool profiling=m_profiling;
+    if(ImGui::Checkbox("Profile",&profiling)) {
+        this->SetProfiling(profiling);
+    }
+
+    ImGui::SameLine();
+
+    if(ImGui::Button("Reset")) {
+        std::lock_guard<Mutex> lock(m_state->mutex);
+
+        m_state->reset=true;
+    }
+
+    ImGui::SameLine();
+
+    if(ImGui::Button("Save JSON...")) {
+        this->SaveJSON();
+    }
+
+    ImGui::SameLine();
+
+    if(ImGui::Button("Save Chrome Trace...")) {
+        this->SaveChromeTrace();
+    }
+
+    if(!m_has_profile) {
+        ImGui::TextUnformatted("No profile.");
+        return;
+    }
+
+    ImGui::Text("Cycles: %" PRIu64 " (%" PRIu64 " timed, 1 in %" PRIu32 ")",
+                m_profile.num_cycles,
+                m_profile.num_sampled_cycles,
+                m_profile.sample_interval);
+
+    if(m_profile.num_cycles>0) {
+        double ns_per_cycle=GetSecondsFromTicks(1)*m_total_ticks/m_profile.num_cycles*1e9;
+        ImGui::Text("Host time: %.1f ns/cycle (%.2f MHz)",ns_per_cycle,ns_per_cycle>0.?1e3/ns_per_cycle:0.);
+    }
+
+    ImGui::Text("Clock read overhead: %.1f ns",GetSecondsFromTicks(m_profile.overhead_ticks)*1e9);
+
+    if(ImGui::CollapsingHeader("Subsystems",ImGuiTreeNodeFlags_DefaultOpen)) {
+        this->DoSubsystemsImGui();
+    }
+
+    if(ImGui::CollapsingHeader("MMIO")) {
+        this->DoMMIOImGui();
+    }
+
+    if(ImGui::CollapsingHeader("Instruction Addresses")) {
+        this->DoExecutionsImGui();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool SubsystemProfilerUI::OnClose() {
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::SetProfiling(bool profiling) {
+    m_profiling=profiling;
+
+    bool add_vsync_fn=false;
+    {
+        std::lock_guard<Mutex> lock(m_state->mutex);
+
+        m_state->profiling=profiling;
+
+        if(m_state->profiling&&!m_state->vsync_fn_added) {
+            m_state->vsync_fn_added=true;
+            add_vsync_fn=true;
+        }
+    }
+
+    if(add_vsync_fn) {
+        std::shared_ptr<SubsystemProfilerUIState> state=m_state;
+
+        m_beeb_window->GetBeebThread()->AddVSyncFn([state](BBCMicro *beeb)->bool {
+            std::lock_guard<Mutex> lock(state->mutex);
+
+            if(!state->profiling) {
+                beeb->SetProfiling(false);
+                state->vsync_fn_added=false;
+                return false;
+            }
+
+            if(!beeb->IsProfiling()) {
+                beeb->SetProfiling(true);
+            }
+
+            SubsystemProfiler *profiler=beeb->GetProfiler();
+
+            if(state->reset) {
+                profiler->Reset();
+                state->reset=false;
+            }
+
+            if(state->events_wanted) {
+                profiler->GetEvents(&state->events);
+                state->events_wanted=false;
+                state->new_events=true;
+            }
+
+            uint64_t now_ticks=GetCurrentTickCount();
+            if(GetSecondsFromTicks(now_ticks-state->profile_ticks)>=PROFILE_UPDATE_INTERVAL_SECONDS) {
+                state->profile=profiler->GetProfile();
+                state->profile_ticks=now_ticks;
+                state->new_profile=true;
+            }
+
+            return true;
+        });
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::UpdateProfile() {
+    std::vector<SubsystemProfilerEvent> events;
+    bool new_profile=false;
+
+    {
+        std::lock_guard<Mutex> lock(m_state->mutex);
+
+        if(m_state->new_events) {
+            events.swap(m_state->events);
+            m_state->new_events=false;
+        }
+
+        if(m_state->new_profile) {
+            m_profile=m_state->profile;
+            m_state->new_profile=false;
+            new_profile=true;
+        }
+    }
+
+    if(new_profile) {
+        m_has_profile=true;
+        this->UpdateProfileSummary();
+    }
+
+    if(!events.empty()&&!m_chrome_trace_path.empty()) {
+        Messages msg(m_beeb_window->GetMessageList());
+
+        std::string json=GetSubsystemProfilerEventsChromeTrace(events);
+        if(SaveTextFile(json,m_chrome_trace_path,&msg)) {
+            msg.i.f("Saved %zu profiler events: %s\n",events.size(),m_chrome_trace_path.c_str());
+        }
+
+        m_chrome_trace_path.clear();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::UpdateProfileSummary() {
+    m_total_ticks=0.;
+    for(const SubsystemProfilerCounts &counts:m_profile.subsystems) {
+        m_total_ticks+=counts.GetEstimatedTicks();
+    }
+
+    m_top_mmio_addresses.clear();
+    for(size_t i=0;i<SUBSYSTEM_PROFILER_NUM_MMIO_ADDRESSES;++i) {
+        if(m_profile.mmio[i].num_calls>0) {
+            m_top_mmio_addresses.push_back((uint16_t)(0xfc00+i));
+        }
+    }
+
+    std::sort(m_top_mmio_addresses.begin(),m_top_mmio_addresses.end(),[this](uint16_t a,uint16_t b) {
+        return m_profile.mmio[a-0xfc00].GetEstimatedTicks()>m_profile.mmio[b-0xfc00].GetEstimatedTicks();
+    });
+
+    if(m_top_mmio_addresses.size()>NUM_TOP_MMIO_ADDRESSES) {
+        m_top_mmio_addresses.resize(NUM_TOP_MMIO_ADDRESSES);
+    }
+
+    m_top_execution_addresses.clear();
+    m_max_page_num_executions=0;
+    for(size_t page=0;page<256;++page) {
+        m_page_num_executions[page]=0;
+
+        for(size_t offset=0;offset<256;++offset) {
+            size_t addr=page<<8|offset;
+            uint64_t n=m_profile.num_executions[addr];
+
+            if(n>0) {
+                m_page_num_executions[page]+=n;
+                m_top_execution_addresses.push_back((uint16_t)addr);
+            }
+        }
+
+        m_max_page_num_executions=std::max(m_max_page_num_executions,m_page_num_executions[page]);
+    }
+
+    {
+        size_t n=std::min(m_top_execution_addresses.size(),NUM_TOP_EXECUTION_ADDRESSES);
+
+        std::partial_sort(m_top_execution_addresses.begin(),
+                          m_top_execution_addresses.begin()+(ptrdiff_t)n,
+                          m_top_execution_addresses.end(),
+                          [this](uint16_t a,uint16_t b) {
+                              return m_profile.num_executions[a]>m_profile.num_executions[b];
+                          });
+
+        m_top_execution_addresses.resize(n);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::DoSubsystemsImGui() {
+    ImGui::Columns(5,"subsystems",true);
+
+    ImGui::TextUnformatted("Subsystem");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Calls");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Calls/cycle");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("ns/call");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Time");
+    ImGui::NextColumn();
+
+    ImGui::Separator();
+
+    double seconds_per_tick=GetSecondsFromTicks(1);
+
+    for(int i=0;i<BBCMicroSubsystem_Count;++i) {
+        const SubsystemProfilerCounts &counts=m_profile.subsystems[i];
+        double ticks=counts.GetEstimatedTicks();
+
+        ImGui::TextUnformatted(GetBBCMicroSubsystemEnumName(i));
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,counts.num_calls);
+        ImGui::NextColumn();
+
+        ImGui::Text("%.3f",m_profile.num_cycles>0?(double)counts.num_calls/m_profile.num_cycles:0.);
+        ImGui::NextColumn();
+
+        if(counts.num_calls>0) {
+            ImGui::Text("%.2f",ticks*seconds_per_tick/counts.num_calls*1e9);
+        }
+        ImGui::NextColumn();
+
+        float fraction=m_total_ticks>0.?(float)(ticks/m_total_ticks):0.f;
+        char overlay[20];
+        snprintf(overlay,sizeof overlay,"%.1f%%",fraction*100.f);
+        ImGui::ProgressBar(fraction,ImVec2(-1.f,0.f),overlay);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::DoMMIOImGui() {
+    if(m_top_mmio_addresses.empty()) {
+        ImGui::TextUnformatted("No MMIO accesses.");
+        return;
+    }
+
+    ImGui::Columns(3,"mmio",true);
+
+    ImGui::TextUnformatted("Address");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Calls");
+    ImGui::NextColumn();
+    ImGui::TextUnformatted("Time");
+    ImGui::NextColumn();
+
+    ImGui::Separator();
+
+    for(uint16_t addr:m_top_mmio_addresses) {
+        const SubsystemProfilerCounts &counts=m_profile.mmio[addr-0xfc00];
+
+        ImGui::Text("$%04x",addr);
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,counts.num_calls);
+        ImGui::NextColumn();
+
+        ImGui::Text("%.2f%%",m_total_ticks>0.?100.*counts.GetEstimatedTicks()/m_total_ticks:0.);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::DoExecutionsImGui() {
+    if(m_max_page_num_executions==0) {
+        ImGui::TextUnformatted("No instructions.");
+        return;
+    }
+
+    // One cell per page, brightness on a log scale.
+    ImGui::TextUnformatted("Instructions per page:");
+
+    ImDrawList *draw_list=ImGui::GetWindowDrawList();
+    ImVec2 pos=ImGui::GetCursorScreenPos();
+    double log_max=log((double)m_max_page_num_executions+1.);
+
+    for(size_t page=0;page<256;++page) {
+        ImVec2 cell_pos(pos.x+(float)(page&15)*HEAT_MAP_CELL_SIZE,pos.y+(float)(page>>4)*HEAT_MAP_CELL_SIZE);
+        uint64_t n=m_page_num_executions[page];
+        auto level=(int)(255.*log((double)n+1.)/log_max);
+
+        draw_list->AddRectFilled(cell_pos,
+                                 ImVec2(cell_pos.x+HEAT_MAP_CELL_SIZE-1.f,cell_pos.y+HEAT_MAP_CELL_SIZE-1.f),
+                                 IM_COL32(level,level/2,0,255));
+    }
+
+    ImVec2 size(16*HEAT_MAP_CELL_SIZE,16*HEAT_MAP_CELL_SIZE);
+    ImGui::InvisibleButton("heat_map",size);
+    if(ImGui::IsItemHovered()) {
+        ImVec2 mouse_pos=ImGui::GetMousePos();
+        auto x=(size_t)((mouse_pos.x-pos.x)/HEAT_MAP_CELL_SIZE);
+        auto y=(size_t)((mouse_pos.y-pos.y)/HEAT_MAP_CELL_SIZE);
+
+        if(x<16&&y<16) {
+            size_t page=y*16+x;
+            ImGui::SetTooltip("$%02zx00-$%02zxff: %" PRIu64,page,page,m_page_num_executions[page]);
+        }
+    }
+
+    ImGui::TextUnformatted("Hottest addresses:");
+
+    ImGui::Columns(2,"executions",true);
+
+    for(uint16_t addr:m_top_execution_addresses) {
+        ImGui::Text("$%04x",addr);
+        ImGui::NextColumn();
+
+        ImGui::Text("%" PRIu64,m_profile.num_executions[addr]);
+        ImGui::NextColumn();
+    }
+
+    ImGui::Columns(1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::SaveJSON() {
+    if(!m_has_profile) {
+        return;
+    }
+
+    SaveFileDialog fd(RECENT_PATHS_PROFILES);
+
+    fd.AddFilter("JSON files",{".json"});
+    fd.AddAllFilesFilter();
+
+    std::string path;
+    if(fd.Open(&path)) {
+        fd.AddLastPathToRecentPaths();
+
+        Messages msg(m_beeb_window->GetMessageList());
+        if(SaveTextFile(GetSubsystemProfileJSON(m_profile),path,&msg)) {
+            msg.i.f("Saved profile: %s\n",path.c_str());
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfilerUI::SaveChromeTrace() {
+    if(!m_profiling) {
+        return;
+    }
+
+    SaveFileDialog fd(RECENT_PATHS_PROFILES);
+
+    fd.AddFilter("JSON files",{".json"});
+    fd.AddAllFilesFilter();
+
+    std::string path;
+    if(fd.Open(&path)) {
+        fd.AddLastPathToRecentPaths();
+
+        // The events are collected at the next vsync, and saved once
+        // they arrive.
+        m_chrome_trace_path=path;
+
+        std::lock_guard<Mutex> lock(m_state->mutex);
+        m_state->events_wanted=true;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<SettingsUI> CreateSubsystemProfilerUI(BeebWindow *beeb_window) {
+    return std::make_unique<SubsystemProfilerUI>(beeb_window);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,20 @@
+#ifndef HEADER_ECC1ED83977E47648C888139563B5DD0// -*- mode:c++ -*-
+#define HEADER_ECC1ED83977E47648C888139563B5DD0
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+
+class BeebWindow;
+class SettingsUI;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<SettingsUI> CreateSubsystemProfilerUI(BeebWindow *beeb_window);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
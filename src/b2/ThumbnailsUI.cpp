@@ -20,11 +20,23 @@
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 
+static const int ATLAS_WIDTH=2048;
+static const int ATLAS_HEIGHT=2048;
+
+static const int ATLAS_NUM_COLUMNS=ATLAS_WIDTH/THUMBNAIL_WIDTH;
+static const int ATLAS_NUM_ROWS=ATLAS_HEIGHT/THUMBNAIL_HEIGHT;
+static const size_t ATLAS_NUM_CELLS=(size_t)(ATLAS_NUM_COLUMNS*ATLAS_NUM_ROWS);
+
+////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////
+
 struct ThumbnailsUI::Thumbnail {
     ThumbnailState state=ThumbnailState_Start;
     std::shared_ptr<GenerateThumbnailJob> job;
     bool in_use=false;
-    SDLUniquePtr<SDL_Texture> texture;
+    bool has_cell=false;
+    size_t atlas_index=0;
+    size_t cell_index=0;
     std::string error;
 };
 
@@ -62,7 +74,7 @@ size_t ThumbnailsUI::GetNumThumbnails() const {
 ////////////////////////////////////////////////////////////////////////////
 
 size_t ThumbnailsUI::GetNumTextures() const {
-    return m_textures.size();
+    return m_atlases.size();
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -100,23 +112,30 @@ void ThumbnailsUI::Thumbnail(const std::shared_ptr<const BeebState> &beeb_state)
                 break;
             }
 
-            const void *texture_data=job->GetTexturePixels();
-            ASSERT(texture_data);
+            const void *pixels=job->GetThumbnailPixels();
+            ASSERT(pixels);
 
-            SDLUniquePtr<SDL_Texture> texture=this->GetTexture();
-            if(!texture) {
+            size_t atlas_index,cell_index;
+            if(!this->AllocCell(&atlas_index,&cell_index)) {
                 t->state=ThumbnailState_Error;
                 t->error=std::string("Failed to create texture: ")+SDL_GetError();
                 break;
             }
 
-            if(SDL_UpdateTexture(texture.get(),nullptr,texture_data,TV_TEXTURE_WIDTH*4)<0) {
+            SDL_Rect rect;
+            this->GetCellRect(&rect,cell_index);
+
+            if(SDL_UpdateTexture(m_atlases[atlas_index].texture.get(),&rect,pixels,THUMBNAIL_WIDTH*4)<0) {
+                this->FreeCell(atlas_index,cell_index);
+
                 t->state=ThumbnailState_Error;
                 t->error=std::string("Failed to initialise texture: ")+SDL_GetError();
                 break;
             }
 
-            t->texture=std::move(texture);
+            t->has_cell=true;
+            t->atlas_index=atlas_index;
+            t->cell_index=cell_index;
             t->state=ThumbnailState_Ready;
         }
             break;
@@ -140,16 +159,23 @@ void ThumbnailsUI::Thumbnail(const std::shared_ptr<const BeebState> &beeb_state)
 
             ImGuiIDPusher pusher(t);
 
-            ImGui::Image(t->texture.get(),this->GetThumbnailSize());
+            SDL_Texture *texture=m_atlases[t->atlas_index].texture.get();
+
+            // Inset by half a texel so that filtering doesn't pick up
+            // the neighbouring cells.
+            SDL_Rect rect;
+            this->GetCellRect(&rect,t->cell_index);
+            ImVec2 uv0((rect.x+.5f)/ATLAS_WIDTH,(rect.y+.5f)/ATLAS_HEIGHT);
+            ImVec2 uv1((rect.x+rect.w-.5f)/ATLAS_WIDTH,(rect.y+rect.h-.5f)/ATLAS_HEIGHT);
+
+            ImGui::Image(texture,this->GetThumbnailSize(),uv0,uv1);
 
             if(ImGui::IsItemClicked()) {
                 ImGui::OpenPopup(THUMBNAIL_POPUP);
             }
 
             if(ImGui::BeginPopup(THUMBNAIL_POPUP)) {
-                int w,h;
-                SDL_QueryTexture(t->texture.get(),nullptr,nullptr,&w,&h);
-                ImGui::Image(t->texture.get(),ImVec2((float)w,(float)h));
+                ImGui::Image(texture,ImVec2((float)TV_TEXTURE_WIDTH,(float)TV_TEXTURE_HEIGHT),uv0,uv1);
                 ImGui::EndPopup();
             }
         }
@@ -179,8 +205,8 @@ void ThumbnailsUI::Update() {
                 t->job->Cancel();
             }
 
-            if(!!t->texture) {
-                this->ReturnTexture(std::move(t->texture));
+            if(t->has_cell) {
+                this->FreeCell(t->atlas_index,t->cell_index);
             }
 
             m_thumbnails.erase(it);
@@ -188,35 +214,73 @@ void ThumbnailsUI::Update() {
 
         it=next_it;
     }
+
+    // Atlases can only be discarded from the end, as thumbnails refer to
+    // them by index.
+    while(!m_atlases.empty()&&m_atlases.back().free_cells.size()==ATLAS_NUM_CELLS) {
+        m_atlases.pop_back();
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 
-SDLUniquePtr<SDL_Texture> ThumbnailsUI::GetTexture() {
-    SDLUniquePtr<SDL_Texture> texture;
+bool ThumbnailsUI::AllocCell(size_t *atlas_index,size_t *cell_index) {
+    for(size_t i=0;i<m_atlases.size();++i) {
+        Atlas *atlas=&m_atlases[i];
 
-    if(m_textures.empty()) {
-        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY,"linear");
-        texture=SDLUniquePtr<SDL_Texture>(SDL_CreateTexture(m_renderer,
-                                                            m_pixel_format->format,
-                                                            SDL_TEXTUREACCESS_STATIC,
-                                                            TV_TEXTURE_WIDTH,
-                                                            TV_TEXTURE_HEIGHT));
-        if(!texture) {
-            return nullptr;
+        if(!atlas->free_cells.empty()) {
+            *atlas_index=i;
+            *cell_index=atlas->free_cells.back();
+            atlas->free_cells.pop_back();
+            return true;
         }
-    } else {
-        texture=std::move(m_textures.back());
-        m_textures.pop_back();
     }
 
-    return texture;
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY,"linear");
+    SDLUniquePtr<SDL_Texture> texture(SDL_CreateTexture(m_renderer,
+                                                        m_pixel_format->format,
+                                                        SDL_TEXTUREACCESS_STATIC,
+                                                        ATLAS_WIDTH,
+                                                        ATLAS_HEIGHT));
+    if(!texture) {
+        return false;
+    }
+
+    Atlas atlas;
+    atlas.texture=std::move(texture);
+
+    // Cell 0 is the one that's being allocated.
+    for(size_t i=ATLAS_NUM_CELLS-1;i>0;--i) {
+        atlas.free_cells.push_back(i);
+    }
+
+    *atlas_index=m_atlases.size();
+    *cell_index=0;
+
+    m_atlases.push_back(std::move(atlas));
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////
+
+void ThumbnailsUI::FreeCell(size_t atlas_index,size_t cell_index) {
+    ASSERT(atlas_index<m_atlases.size());
+    ASSERT(cell_index<ATLAS_NUM_CELLS);
+
+    m_atlases[atlas_index].free_cells.push_back(cell_index);
 }
 
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 
-void ThumbnailsUI::ReturnTexture(SDLUniquePtr<SDL_Texture> texture) {
-    m_textures.push_back(std::move(texture));
+void ThumbnailsUI::GetCellRect(SDL_Rect *rect,size_t cell_index) const {
+    ASSERT(cell_index<ATLAS_NUM_CELLS);
+
+    rect->x=(int)(cell_index%ATLAS_NUM_COLUMNS)*THUMBNAIL_WIDTH;
+    rect->y=(int)(cell_index/ATLAS_NUM_COLUMNS)*THUMBNAIL_HEIGHT;
+    rect->w=THUMBNAIL_WIDTH;
+    rect->h=THUMBNAIL_HEIGHT;
 }
@@ -7,6 +7,7 @@
 class BeebState;
 struct SDL_Renderer;
 struct SDL_PixelFormat;
+struct SDL_Rect;
 
 #include <memory>
 #include <map>
@@ -38,14 +39,22 @@ protected:
 private:
     struct Thumbnail;
 
+    // Thumbnails are packed into shared textures, in a grid of fixed-size
+    // cells.
+    struct Atlas {
+        SDLUniquePtr<SDL_Texture> texture;
+        std::vector<size_t> free_cells;
+    };
+
     SDL_Renderer *m_renderer;
     const SDL_PixelFormat *m_pixel_format;
     
     std::map<std::shared_ptr<const BeebState>,struct Thumbnail> m_thumbnails;
-    std::vector<SDLUniquePtr<SDL_Texture>> m_textures;
+    std::vector<Atlas> m_atlases;
 
-    SDLUniquePtr<SDL_Texture> GetTexture();
-    void ReturnTexture(SDLUniquePtr<SDL_Texture> texture);
+    bool AllocCell(size_t *atlas_index,size_t *cell_index);
+    void FreeCell(size_t atlas_index,size_t cell_index);
+    void GetCellRect(SDL_Rect *rect,size_t cell_index) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////
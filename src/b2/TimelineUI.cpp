@@ -11,6 +11,7 @@
 #include <IconsFontAwesome5.h>
 #include "ThumbnailsUI.h"
 #include "VideoWriter.h"
+#include <atomic>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -125,6 +126,10 @@ public:
             break;
         }
 
+        if(timeline_state.state!=BeebThreadTimelineState_Record&&timeline_duration>0) {
+            this->DoSeekImGui(beeb_thread.get(),timeline_state);
+        }
+
         const ImVec2 THUMBNAIL_SIZE=m_thumbnails.GetThumbnailSize();
         const float GAP_HEIGHT=20;
 
@@ -279,6 +284,64 @@ private:
     BeebWindow *m_beeb_window=nullptr;
     ThumbnailsUI m_thumbnails;
     bool m_follow=true;
+
+    // Seek position, as a fraction of the timeline duration.
+    float m_seek_fraction=0.f;
+    bool m_seek_dragging=false;
+    bool m_seek_pending=false;
+
+    // Set while a seek is in progress. Only one seek is sent at once, so
+    // the Beeb thread never has a backlog of stale positions to get
+    // through.
+    std::shared_ptr<std::atomic<bool>> m_seek_busy=std::make_shared<std::atomic<bool>>(false);
+
+    void DoSeekImGui(BeebThread *beeb_thread,const BeebThread::TimelineState &timeline_state) {
+        const uint64_t timeline_duration=timeline_state.end_2MHz_cycles-timeline_state.begin_2MHz_cycles;
+
+        if(!m_seek_dragging&&!m_seek_pending) {
+            if(timeline_state.state==BeebThreadTimelineState_Replay&&
+               timeline_state.current_2MHz_cycles>=timeline_state.begin_2MHz_cycles)
+            {
+                double fraction=(double)(timeline_state.current_2MHz_cycles-timeline_state.begin_2MHz_cycles)/timeline_duration;
+                if(fraction>1.) {
+                    fraction=1.;
+                }
+
+                m_seek_fraction=(float)fraction;
+            }
+        }
+
+        if(ImGui::SliderFloat("Position",&m_seek_fraction,0.f,1.f,"")) {
+            m_seek_pending=true;
+        }
+
+        m_seek_dragging=ImGui::IsItemActive();
+
+        uint64_t seek_offset_2MHz_cycles=(uint64_t)(m_seek_fraction*(double)timeline_duration);
+        if(seek_offset_2MHz_cycles>timeline_duration) {
+            seek_offset_2MHz_cycles=timeline_duration;
+        }
+
+        ImGui::SameLine();
+        ImGui::TextUnformatted(Get2MHzCyclesString(seek_offset_2MHz_cycles).c_str());
+
+        if(m_seek_pending) {
+            if(!m_seek_busy->load(std::memory_order_acquire)) {
+                m_seek_busy->store(true,std::memory_order_release);
+
+                auto message=std::make_shared<BeebThread::SeekMessage>(timeline_state.begin_2MHz_cycles+seek_offset_2MHz_cycles,
+                                                                       true);
+                beeb_thread->Send(std::move(message),
+                                  [busy=m_seek_busy](bool success,std::string message) {
+                                      (void)success,(void)message;
+
+                                      busy->store(false,std::memory_order_release);
+                                  });
+
+                m_seek_pending=false;
+            }
+        }
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////
@@ -31,6 +31,15 @@ VBlankMonitor::~VBlankMonitor() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool VBlankMonitor::GetPacingStats(void *display_data,VBlankPacingStats *stats) const {
+    (void)display_data,(void)stats;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 std::unique_ptr<VBlankMonitor> CreateVBlankMonitor(VBlankMonitor::Handler *handler,
                                                    bool force_default,
                                                    Messages *messages)
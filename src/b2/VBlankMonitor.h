@@ -5,6 +5,8 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include <memory>
+#include <stdint.h>
+#include <stddef.h>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -14,6 +16,33 @@ class Messages;
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Timing of the vblank notifications, for monitors that do their own
+// pacing.
+//
+// latency is how late each vblank was, relative to its deadline. jitter
+// is how far each gap between vblanks was from the nominal interval.
+// Histogram bucket i counts values in [i*BUCKET_US,(i+1)*BUCKET_US)
+// microseconds; the last bucket counts anything larger too.
+struct VBlankPacingStats {
+    static constexpr size_t NUM_BUCKETS=50;
+    static constexpr uint64_t BUCKET_US=20;
+
+    uint64_t interval_us=0;
+    uint64_t num_vblanks=0;
+
+    // Deadlines skipped entirely because the thread was too late.
+    uint64_t num_missed=0;
+
+    uint64_t max_latency_us=0;
+    uint64_t max_jitter_us=0;
+
+    uint64_t latency[NUM_BUCKETS]={};
+    uint64_t jitter[NUM_BUCKETS]={};
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 class VBlankMonitor {
 public:
     class Handler {
@@ -35,6 +64,11 @@ public:
 
     virtual void *GetDisplayDataForDisplayID(uint32_t display_id) const=0;
     virtual void *GetDisplayDataForPoint(int x,int y) const=0;
+
+    // If the display's vblanks are paced by the monitor, fill in *STATS
+    // and return true. Otherwise, return false. (The default
+    // implementation always returns false.)
+    virtual bool GetPacingStats(void *display_data,VBlankPacingStats *stats) const;
 protected:
 private:
 };
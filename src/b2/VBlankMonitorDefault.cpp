@@ -7,6 +7,13 @@
 #include "Messages.h"
 #include <shared/log.h>
 #include <system_error>
+#include <shared/mutex.h>
+#include <algorithm>
+#if SYSTEM_LINUX
+#include <time.h>
+#include <errno.h>
+#include <sys/prctl.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -64,6 +71,17 @@ public:
         
         return m_display_data;
     }
+
+    bool GetPacingStats(void *display_data,VBlankPacingStats *stats) const override {
+        if(display_data!=m_display_data) {
+            return false;
+        }
+
+        std::lock_guard<Mutex> lock(m_stats_mutex);
+
+        *stats=m_stats;
+        return true;
+    }
 protected:
 private:
     std::chrono::microseconds m_interval;
@@ -72,13 +90,105 @@ private:
     std::atomic<bool> m_stop_thread{false};
     std::thread m_thread;
 
+    mutable Mutex m_stats_mutex;
+    VBlankPacingStats m_stats;
+
+    // Each vblank has an absolute deadline, one interval after the last
+    // one's, so that errors in the wakeup time don't accumulate. If the
+    // thread falls more than an interval behind, the missed deadlines
+    // are skipped rather than delivered in a burst.
     void ThreadFunc() {
+        SetCurrentThreadNamef("VBlank Monitor");
+
+        const uint64_t interval_ns=(uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(m_interval).count();
+
+        {
+            std::lock_guard<Mutex> lock(m_stats_mutex);
+
+            m_stats.interval_us=interval_ns/1000;
+        }
+
+#if SYSTEM_LINUX
+        // The default timer slack for a normal thread is 50 usec, which
+        // is all jitter as far as this thread is concerned.
+        prctl(PR_SET_TIMERSLACK,1,0,0,0);
+#endif
+
+        uint64_t deadline_ns=GetNowNS()+interval_ns;
+        uint64_t last_vblank_ns=0;
+
         while(!m_stop_thread) {
-            std::this_thread::sleep_for(m_interval);
+            SleepUntilNS(deadline_ns);
+
+            uint64_t now_ns=GetNowNS();
 
             m_handler->ThreadVBlank(1,m_display_data);
+
+            uint64_t latency_ns=now_ns>deadline_ns?now_ns-deadline_ns:0;
+
+            uint64_t num_missed=latency_ns/interval_ns;
+            deadline_ns+=(num_missed+1)*interval_ns;
+
+            {
+                std::lock_guard<Mutex> lock(m_stats_mutex);
+
+                ++m_stats.num_vblanks;
+                m_stats.num_missed+=num_missed;
+
+                AddToHistogram(m_stats.latency,&m_stats.max_latency_us,latency_ns);
+
+                if(last_vblank_ns!=0) {
+                    uint64_t gap_ns=now_ns-last_vblank_ns;
+                    uint64_t jitter_ns=gap_ns>interval_ns?gap_ns-interval_ns:interval_ns-gap_ns;
+
+                    AddToHistogram(m_stats.jitter,&m_stats.max_jitter_us,jitter_ns);
+                }
+            }
+
+            last_vblank_ns=now_ns;
         }
     }
+
+    static void AddToHistogram(uint64_t *buckets,uint64_t *max_us,uint64_t ns) {
+        uint64_t us=ns/1000;
+
+        size_t index=(size_t)std::min<uint64_t>(us/VBlankPacingStats::BUCKET_US,VBlankPacingStats::NUM_BUCKETS-1);
+        ++buckets[index];
+
+        if(us>*max_us) {
+            *max_us=us;
+        }
+    }
+
+#if SYSTEM_LINUX
+
+    static uint64_t GetNowNS() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC,&ts);
+
+        return (uint64_t)ts.tv_sec*1000000000u+(uint64_t)ts.tv_nsec;
+    }
+
+    static void SleepUntilNS(uint64_t deadline_ns) {
+        struct timespec ts;
+        ts.tv_sec=(time_t)(deadline_ns/1000000000u);
+        ts.tv_nsec=(long)(deadline_ns%1000000000u);
+
+        while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,nullptr)==EINTR) {
+        }
+    }
+
+#else
+
+    static uint64_t GetNowNS() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void SleepUntilNS(uint64_t deadline_ns) {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline_ns))));
+    }
+
+#endif
 };
 
 //////////////////////////////////////////////////////////////////////////
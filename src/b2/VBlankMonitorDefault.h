@@ -17,6 +17,10 @@ class VBlankMonitor;
 //
 // The handler functions are called as if there's 1 monitor, with id
 // 1, that's infinitely large.
+//
+// The interval is measured against absolute deadlines, so it doesn't
+// drift. (On Linux, this uses clock_nanosleep with TIMER_ABSTIME.) The
+// timing is available from GetPacingStats.
 
 std::unique_ptr<VBlankMonitor> CreateVBlankMonitorDefault(std::chrono::microseconds interval);
 
@@ -38,6 +38,7 @@
 #include "HTTPMethodsHandler.h"
 #include <curl/curl.h>
 #include "DirectDiscImage.h"
+#include "HostTrace.h"
 
 #include <shared/enum_decl.h>
 #include "b2.inl"
@@ -223,8 +224,13 @@ static void ThreadFillAudioBuffer(void *userdata,uint8_t *stream,int len) {
     uint64_t now_ticks=GetCurrentTickCount();
     if(data->first_call_ticks==0) {
         data->first_call_ticks=now_ticks;
+
+        // SDL's audio thread doesn't go through SetCurrentThreadName.
+        SetHostTraceThreadName("Audio");
     }
 
+    HostTraceScope hts("Audio callback");
+
     ASSERT(len>=0);
     ASSERT((size_t)len%4==0);
     size_t num_samples=(size_t)len/4;
@@ -780,13 +786,17 @@ static void SaveKeyWindowSettings() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-#if RMT_ENABLED
-static void SetRmtThreadName(const char *name,void *context) {
+static void SetThreadName(const char *name,void *context) {
     (void)context;
 
-    rmt_SetCurrentThreadName(name);
-}
+    SetHostTraceThreadName(name);
+
+#if RMT_ENABLED
+    if(g_remotery) {
+        rmt_SetCurrentThreadName(name);
+    }
 #endif
+}
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -797,14 +807,16 @@ static bool main2(int argc,char *argv[],const std::shared_ptr<MessageList> &init
 #if RMT_ENABLED
     {
         rmtError x=rmt_CreateGlobalInstance(&g_remotery);
-        if(x==RMT_ERROR_NONE) {
-            SetSetCurrentThreadNameCallback(&SetRmtThreadName,nullptr);
-        } else {
+        if(x!=RMT_ERROR_NONE) {
+            g_remotery=nullptr;
             init_messages.w.f("Failed to initialise Remotery\n");
         }
     }
 #endif
 
+    SetSetCurrentThreadNameCallback(&SetThreadName,nullptr);
+    SetHostTraceThreadName("Main");
+
     // https://curl.haxx.se/libcurl/c/curl_global_init.html
     {
         CURLcode r=curl_global_init(CURL_GLOBAL_DEFAULT);
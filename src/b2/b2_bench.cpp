@@ -0,0 +1,855 @@
+#include <shared/system.h>
+#include <shared/CommandLineParser.h>
+#include <shared/path.h>
+#include <shared/debug.h>
+#include <shared/log.h>
+#include <beeb/BBCMicro.h>
+#include <beeb/TVOutput.h>
+#include <beeb/SN76489.h>
+#include <beeb/sound.h>
+#include <beeb/video.h>
+#include <beeb/OutputData.h>
+#include <beeb/DiscImage.h>
+#include "test_common.h"
+#include "filters.h"
+#include "Remapper.h"
+#include "MemoryDiscImage.h"
+#include "Messages.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Micro-benchmarks for the emulator's hot paths.
+//
+// Each benchmark does a fixed amount of work, so the numbers are
+// comparable from run to run, and is repeated a few times. Only the work
+// itself is timed - not booting the BBC, loading files, and so on.
+//
+// The results go to stdout (or the -o file) as JSON. The rate for each
+// repetition is included, along with the best and the median. Progress
+// goes to stderr.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+struct Options {
+    std::string output_path;
+    std::string filter;
+    int num_repetitions=3;
+    bool list=false;
+};
+
+// Result of one repetition of a benchmark.
+struct Measurement {
+    uint64_t num_items=0;
+
+    // Only used if the benchmark has secondary units.
+    uint64_t num_secondary_items=0;
+
+    uint64_t num_ticks=0;
+};
+
+struct Benchmark {
+    std::string name;
+    const char *units=nullptr;
+    const char *secondary_units=nullptr;
+    std::function<Measurement()> fun;
+};
+
+struct BenchmarkResult {
+    const Benchmark *benchmark=nullptr;
+    std::vector<double> rates;
+    std::vector<double> secondary_rates;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const uint64_t NUM_6502_CYCLES=20*1000*1000;
+static const uint64_t NUM_BBC_CYCLES=4*1000*1000;
+static const size_t NUM_TV_OUTPUT_UNITS=2*1000*1000;
+static const uint64_t NUM_SN76489_UNITS=SOUND_CLOCK_HZ*20;
+static const uint64_t NUM_MIX_SOUND_UNITS=SOUND_CLOCK_HZ*10;
+static const uint64_t MIX_SOUND_FREQ=48000;
+static const uint64_t NUM_OUTPUT_DATA_BUFFER_UNITS=16*1000*1000;
+static const uint64_t NUM_CLONES=200;
+static const size_t NUM_DISC_READ_PASSES=50;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static double GetRate(uint64_t num_items,uint64_t num_ticks) {
+    double num_seconds=GetSecondsFromTicks(num_ticks);
+
+    if(num_seconds<=0.) {
+        return 0.;
+    }
+
+    return num_items/num_seconds;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static double GetMedian(std::vector<double> values) {
+    ASSERT(!values.empty());
+
+    std::sort(values.begin(),values.end());
+
+    size_t n=values.size();
+    if(n%2==1) {
+        return values[n/2];
+    } else {
+        return (values[n/2-1]+values[n/2])*.5;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The 6502 benchmarks run the core on its own, with a flat 64K of
+// memory, as the 6502 tests do.
+
+static uint8_t g_6502_mem[65536];
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Klaus Dormann's functional tests. The test is considered finished when
+// it writes to $ff00 - see klaus.cpp.
+static Measurement Run6502Klaus(const std::string &fname,const M6502Config *config) {
+    std::vector<uint8_t> data;
+    if(!PathLoadBinaryFile(&data,PathJoined(KLAUS_FOLDER_NAME,fname))) {
+        fprintf(stderr,"FATAL: failed to load: %s\n",fname.c_str());
+        exit(1);
+    }
+
+    memset(g_6502_mem,0,sizeof g_6502_mem);
+    memcpy(g_6502_mem,data.data(),std::min(data.size(),sizeof g_6502_mem));
+
+    M6502 s;
+    M6502_Init(&s,config);
+    s.tfn=&M6502_NextInstruction;
+    s.pc.w=0x400;
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    uint64_t num_cycles=0;
+    uint64_t num_instructions=0;
+    while(num_cycles<NUM_6502_CYCLES) {
+        if(M6502_IsAboutToExecute(&s)) {
+            ++num_instructions;
+        }
+
+        M6502_Step(&s);
+        ++num_cycles;
+
+        if(s.read) {
+            s.dbus=g_6502_mem[s.abus.w];
+        } else {
+            if(s.abus.w==0xff00) {
+                break;
+            }
+
+            g_6502_mem[s.abus.w]=s.dbus;
+        }
+    }
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=num_instructions;
+    m.num_secondary_items=num_cycles;
+
+    M6502_Destroy(&s);
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Wolfgang Lorenz's test suite, from the start, with just enough C64 to
+// keep it going - see lorenz.cpp.
+
+#define LORENZ_HACK_OPCODE (2)
+
+static bool g_lorenz_done;
+
+static void LoadLorenzFile(const std::string &fname,M6502 *s) {
+    if(PathCompare(fname,"trap1")==0) {
+        g_lorenz_done=true;
+        return;
+    }
+
+    std::vector<uint8_t> data;
+    if(!PathLoadBinaryFile(&data,PathJoined(LORENZ_FOLDER_NAME,fname))||data.size()<2) {
+        fprintf(stderr,"FATAL: failed to load: %s\n",fname.c_str());
+        exit(1);
+    }
+
+    static const uint8_t IRQ[]={
+        0x48,0x8A,0x48,0x98,0x48,0xBA,0xBD,0x04,0x01,0x29,0x10,0xF0,0x03,0x6C,0x16,0x03,0x6C,0x14,0x03,
+    };
+
+    memset(g_6502_mem,0,sizeof g_6502_mem);
+
+    M6502Word addr;
+    addr.b.l=data[0];
+    addr.b.h=data[1];
+    for(size_t i=2;i<data.size();++i) {
+        g_6502_mem[addr.w++]=data[i];
+    }
+
+    g_6502_mem[0x0002]=0x00;
+    g_6502_mem[0xA002]=0x00;
+    g_6502_mem[0xA003]=0x80;
+    g_6502_mem[0xFFFE]=0x48;
+    g_6502_mem[0xFFFF]=0xFF;
+    g_6502_mem[0x01FE]=0xFF;
+    g_6502_mem[0x01FF]=0x7F;
+
+    memcpy(&g_6502_mem[0xff48],IRQ,sizeof IRQ);
+
+    g_6502_mem[0xffd2]=LORENZ_HACK_OPCODE;
+    g_6502_mem[0xffd3]=0x60;
+
+    g_6502_mem[0xe16f]=LORENZ_HACK_OPCODE;
+    g_6502_mem[0xe170]=0x60;
+
+    g_6502_mem[0xffe4]=LORENZ_HACK_OPCODE;
+    g_6502_mem[0xffe5]=0x60;
+
+    g_6502_mem[0x8000]=LORENZ_HACK_OPCODE;
+    g_6502_mem[0xa474]=LORENZ_HACK_OPCODE;
+
+    s->s.b.l=0xfd;
+    s->p.bits.i=1;
+    s->pc.w=0x816;
+    s->tfn=&M6502_NextInstruction;
+}
+
+static void LorenzHackOpcode(M6502 *s) {
+    switch((uint16_t)(s->pc.w-1)) {
+    default:
+        // Test failed. Not the benchmark's problem.
+        g_lorenz_done=true;
+        break;
+
+    case 0xffd2:
+        // Print character.
+        g_6502_mem[0x30c]=0;
+        M6502_NextInstruction(s);
+        break;
+
+    case 0xe16f:
+        // Load.
+        {
+            M6502Word addr;
+            addr.b.l=g_6502_mem[0xbb];
+            addr.b.h=g_6502_mem[0xbc];
+
+            std::string fname((const char *)&g_6502_mem[addr.w],g_6502_mem[0xb7]);
+
+            LoadLorenzFile(fname,s);
+        }
+        break;
+
+    case 0xffe4:
+        // Scan keyboard.
+        s->a=3;
+        M6502_NextInstruction(s);
+        break;
+    }
+}
+
+static void HandleLorenzIllegalOpcode(M6502 *s,void *context) {
+    (void)s,(void)context;
+
+    g_lorenz_done=true;
+}
+
+static Measurement Run6502Lorenz() {
+    M6502 s;
+    M6502_Init(&s,&M6502_nmos6502_config);
+
+    M6502Fns fns[256];
+    memcpy(fns,s.fns,sizeof fns);
+    fns[LORENZ_HACK_OPCODE].t0fn=&LorenzHackOpcode;
+    s.fns=fns;
+
+    s.ill_fn=&HandleLorenzIllegalOpcode;
+
+    g_lorenz_done=false;
+    LoadLorenzFile("start",&s);
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    uint64_t num_cycles=0;
+    uint64_t num_instructions=0;
+    while(num_cycles<NUM_6502_CYCLES&&!g_lorenz_done) {
+        if(M6502_IsAboutToExecute(&s)) {
+            ++num_instructions;
+        }
+
+        M6502_Step(&s);
+        ++num_cycles;
+
+        if(s.read) {
+            s.dbus=g_6502_mem[s.abus.w];
+        } else {
+            g_6502_mem[s.abus.w]=s.dbus;
+        }
+    }
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=num_instructions;
+    m.num_secondary_items=num_cycles;
+
+    s.fns=nullptr;
+    M6502_Destroy(&s);
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Boot, select the given screen mode, and set a BASIC program running
+// that prints to the screen forever.
+static std::unique_ptr<TestBBCMicro> CreateBusyBBCMicro(TestBBCMicroType type,int mode) {
+    std::unique_ptr<TestBBCMicro> bbc=std::make_unique<TestBBCMicro>(type);
+
+    bbc->RunUntilOSWORD0(10.0);
+
+    bbc->Paste(strprintf("MODE %d\r10PRINT\"b2 bench \";:GOTO10\rRUN\r",mode));
+
+    VideoDataUnit vunit;
+    SoundDataUnit sunit;
+    while(bbc->IsPasting()) {
+        bbc->Update(&vunit,&sunit);
+    }
+
+    return bbc;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static Measurement RunBBCMicroUpdate(TestBBCMicroType type,int mode,bool video) {
+    std::unique_ptr<TestBBCMicro> bbc=CreateBusyBBCMicro(type,mode);
+
+    // Video off is as when seeking or fast forwarding.
+    bbc->SetVideoEnabled(video,0);
+
+    // Cycle through a buffer, much as BeebThread does, so the video
+    // output isn't all going to the same spot.
+    std::vector<VideoDataUnit> vunits(65536);
+    SoundDataUnit sunit;
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    for(uint64_t i=0;i<NUM_BBC_CYCLES;++i) {
+        bbc->Update(&vunits[i&65535],&sunit);
+    }
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=NUM_BBC_CYCLES;
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::vector<VideoDataUnit> GetVideoDataUnits(TestBBCMicroType type,int mode) {
+    std::unique_ptr<TestBBCMicro> bbc=CreateBusyBBCMicro(type,mode);
+
+    std::vector<VideoDataUnit> vunits;
+    vunits.reserve(NUM_TV_OUTPUT_UNITS);
+
+    VideoDataUnit vunit;
+    SoundDataUnit sunit;
+    while(vunits.size()<NUM_TV_OUTPUT_UNITS) {
+        if(bbc->Update(&vunit,&sunit)&BBCMicroUpdateResultFlag_VideoUnit) {
+            vunits.push_back(vunit);
+        }
+    }
+
+    return vunits;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static Measurement RunTVOutput(TestBBCMicroType type,int mode) {
+    std::vector<VideoDataUnit> vunits=GetVideoDataUnits(type,mode);
+
+    TVOutput tv;
+    tv.Init(16,8,0);
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    tv.Update(vunits.data(),vunits.size());
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=vunits.size();
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// All 4 channels going: 3 tones at various volumes, and periodic noise.
+static const uint8_t SN76489_SETUP[]={
+    0x8e,0x0f,0x90,
+    0xa5,0x03,0xb2,
+    0xc9,0x01,0xd4,
+    0xe4,0xf0,
+};
+
+// (SN76489 isn't copyable - it has pointers into itself.)
+static void InitBusySN76489(SN76489 *sn) {
+#if BBCMICRO_TRACE
+    sn->SetTrace(nullptr);
+#endif
+
+    for(uint8_t value:SN76489_SETUP) {
+        sn->Update(true,value);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static Measurement RunSN76489() {
+    SN76489 sn;
+    InitBusySN76489(&sn);
+
+    Measurement m;
+
+    // Sum the outputs, so they can't be optimized away.
+    uint32_t total=0;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    for(uint64_t i=0;i<NUM_SN76489_UNITS;++i) {
+        SN76489::Output output=sn.Update(false,0);
+
+        total+=(uint32_t)output.ch[0]+output.ch[1]+output.ch[2]+output.ch[3];
+    }
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=NUM_SN76489_UNITS;
+
+    if(total==0) {
+        fprintf(stderr,"WARNING: SN76489 output is silent\n");
+    }
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The resampling done by BeebThread::ThreadRenderAudio: filter each
+// output sample's worth of sound units.
+static Measurement RunAudioMix() {
+    SN76489 sn;
+    InitBusySN76489(&sn);
+
+    std::vector<SoundDataUnit> sunits(NUM_MIX_SOUND_UNITS);
+    for(SoundDataUnit &sunit:sunits) {
+        sunit=SoundDataUnit();
+        sunit.sn_output=sn.Update(false,0);
+    }
+
+    Remapper remapper(MIX_SOUND_FREQ,SOUND_CLOCK_HZ);
+    uint64_t num_samples=NUM_MIX_SOUND_UNITS*MIX_SOUND_FREQ/SOUND_CLOCK_HZ;
+    std::vector<float> samples(num_samples);
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    size_t unit_index=0;
+    float last_sample=0.f;
+    size_t num_mixed=ResampleSoundUnits(samples.data(),samples.size(),
+                                        &unit_index,sunits.data(),sunits.size(),nullptr,0,
+                                        &remapper,&last_sample,
+                                        1/4.f,1.f);
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=num_mixed;
+    m.num_secondary_items=unit_index;
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Video units from one thread to another, as from the BeebThread to the
+// main thread.
+static Measurement RunOutputDataBuffer() {
+    OutputDataBuffer<VideoDataUnit> buffer(262144);
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    std::thread consumer([&buffer]() {
+        uint64_t num_left=NUM_OUTPUT_DATA_BUFFER_UNITS;
+        while(num_left>0) {
+            const VideoDataUnit *a,*b;
+            size_t na,nb;
+            if(!buffer.GetConsumerBuffers(&a,&na,&b,&nb)) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            buffer.Consume(na+nb);
+            num_left-=na+nb;
+        }
+    });
+
+    VideoDataUnit value=VideoDataUnit();
+    value.pixels.pixels[0].all=0x0fff;
+
+    uint64_t num_left=NUM_OUTPUT_DATA_BUFFER_UNITS;
+    while(num_left>0) {
+        VideoDataUnit *a,*b;
+        size_t na,nb;
+        if(!buffer.GetProducerBuffers(&a,&na,&b,&nb)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t n=(size_t)std::min<uint64_t>(na+nb,num_left);
+        n=std::min<size_t>(n,2000);
+
+        for(size_t i=0;i<n;++i) {
+            if(i<na) {
+                a[i]=value;
+            } else {
+                b[i-na]=value;
+            }
+        }
+
+        buffer.Produce(n);
+        num_left-=n;
+    }
+
+    consumer.join();
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=NUM_OUTPUT_DATA_BUFFER_UNITS;
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// BBCMicro::Clone is what saving a state, or a timeline event, costs.
+static Measurement RunClone(TestBBCMicroType type) {
+    std::unique_ptr<TestBBCMicro> bbc=CreateBusyBBCMicro(type,7);
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    for(uint64_t i=0;i<NUM_CLONES;++i) {
+        std::unique_ptr<BBCMicro> clone=bbc->Clone();
+        ASSERT(!!clone);
+    }
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=NUM_CLONES;
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Reads a whole .ssd (80 tracks x 10 sectors x 256 bytes) from a
+// MemoryDiscImage, a byte at a time as the WD1770 does without turbo
+// disc, or a sector at a time as it does with it.
+static const uint8_t DISC_NUM_TRACKS=80;
+static const uint8_t DISC_NUM_SECTORS=10;
+static const size_t DISC_SECTOR_SIZE=256;
+
+static Measurement RunDiscImageRead(bool whole_sectors) {
+    Messages msg;
+    std::string path=PathJoined(DISCS_FOLDER_NAME,"Welcome.ssd");
+    std::shared_ptr<const DiscImage> disc_image=MemoryDiscImage::LoadFromFile(path,&msg);
+    if(!disc_image) {
+        fprintf(stderr,"FATAL: failed to load: %s\n",path.c_str());
+        exit(1);
+    }
+
+    uint8_t buf[DISC_SECTOR_SIZE];
+    uint32_t total=0;
+
+    Measurement m;
+
+    uint64_t start_ticks=GetCurrentTickCount();
+
+    for(size_t pass=0;pass<NUM_DISC_READ_PASSES;++pass) {
+        for(uint8_t track=0;track<DISC_NUM_TRACKS;++track) {
+            for(uint8_t sector=0;sector<DISC_NUM_SECTORS;++sector) {
+                if(whole_sectors) {
+                    disc_image->ReadSector(buf,sizeof buf,0,track,sector);
+                } else {
+                    for(size_t offset=0;offset<sizeof buf;++offset) {
+                        disc_image->Read(&buf[offset],0,track,sector,offset);
+                    }
+                }
+
+                total+=buf[0];
+            }
+        }
+    }
+
+    m.num_ticks=GetCurrentTickCount()-start_ticks;
+    m.num_items=NUM_DISC_READ_PASSES*DISC_NUM_TRACKS*DISC_NUM_SECTORS*sizeof buf;
+
+    (void)total;
+
+    return m;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::vector<Benchmark> GetBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({"6502/klaus/nmos6502","instructions/sec","cycles/sec",[]() {
+        return Run6502Klaus("6502.bin",&M6502_nmos6502_config);
+    }});
+
+    benchmarks.push_back({"6502/klaus/cmos6502","instructions/sec","cycles/sec",[]() {
+        return Run6502Klaus("65c02.bin",&M6502_cmos6502_config);
+    }});
+
+    benchmarks.push_back({"6502/lorenz/nmos6502","instructions/sec","cycles/sec",[]() {
+        return Run6502Lorenz();
+    }});
+
+    static const TestBBCMicroType BBC_TYPES[]={
+        TestBBCMicroType_BTape,
+        TestBBCMicroType_BPlusTape,
+        TestBBCMicroType_Master128MOS320,
+    };
+
+    static const int MODES[]={0,2,4,7};
+
+    for(TestBBCMicroType type:BBC_TYPES) {
+        for(int mode:MODES) {
+            benchmarks.push_back({strprintf("BBCMicro/Update/%s/MODE%d",GetTestBBCMicroTypeEnumName(type),mode),"cycles/sec",nullptr,[type,mode]() {
+                return RunBBCMicroUpdate(type,mode,true);
+            }});
+        }
+    }
+
+    for(int mode:{2,7}) {
+        benchmarks.push_back({strprintf("BBCMicro/Update/BTape/MODE%d/video-off",mode),"cycles/sec",nullptr,[mode]() {
+            return RunBBCMicroUpdate(TestBBCMicroType_BTape,mode,false);
+        }});
+    }
+
+    for(int mode:{2,7}) {
+        benchmarks.push_back({strprintf("TVOutput/Update/MODE%d",mode),"units/sec",nullptr,[mode]() {
+            return RunTVOutput(TestBBCMicroType_BTape,mode);
+        }});
+    }
+
+    benchmarks.push_back({"SN76489/Update","units/sec",nullptr,[]() {
+        return RunSN76489();
+    }});
+
+    benchmarks.push_back({"audio/mix","samples/sec","units/sec",[]() {
+        return RunAudioMix();
+    }});
+
+    benchmarks.push_back({"OutputDataBuffer/VideoDataUnit","units/sec",nullptr,[]() {
+        return RunOutputDataBuffer();
+    }});
+
+    for(TestBBCMicroType type:{TestBBCMicroType_BTape,TestBBCMicroType_Master128MOS320}) {
+        benchmarks.push_back({strprintf("BBCMicro/Clone/%s",GetTestBBCMicroTypeEnumName(type)),"clones/sec",nullptr,[type]() {
+            return RunClone(type);
+        }});
+    }
+
+    benchmarks.push_back({"DiscImage/Read","bytes/sec",nullptr,[]() {
+        return RunDiscImageRead(false);
+    }});
+
+    benchmarks.push_back({"DiscImage/ReadSector","bytes/sec",nullptr,[]() {
+        return RunDiscImageRead(true);
+    }});
+
+    return benchmarks;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void PrintRatesJSON(FILE *f,const char *name,const std::vector<double> &rates) {
+    fprintf(f,"      \"%s\": [",name);
+    for(size_t i=0;i<rates.size();++i) {
+        fprintf(f,"%s%.1f",i==0?"":", ",rates[i]);
+    }
+    fprintf(f,"],\n");
+}
+
+static void PrintJSON(FILE *f,const std::vector<BenchmarkResult> &results) {
+    fprintf(f,"{\n");
+    fprintf(f,"  \"benchmarks\": [\n");
+
+    for(size_t i=0;i<results.size();++i) {
+        const BenchmarkResult *r=&results[i];
+
+        // Benchmark names and units are all plain ASCII, with nothing
+        // needing escaping.
+        fprintf(f,"    {\n");
+        fprintf(f,"      \"name\": \"%s\",\n",r->benchmark->name.c_str());
+        fprintf(f,"      \"units\": \"%s\",\n",r->benchmark->units);
+        PrintRatesJSON(f,"rates",r->rates);
+        fprintf(f,"      \"best\": %.1f,\n",*std::max_element(r->rates.begin(),r->rates.end()));
+
+        if(r->benchmark->secondary_units) {
+            fprintf(f,"      \"secondary_units\": \"%s\",\n",r->benchmark->secondary_units);
+            PrintRatesJSON(f,"secondary_rates",r->secondary_rates);
+            fprintf(f,"      \"secondary_median\": %.1f,\n",GetMedian(r->secondary_rates));
+        }
+
+        fprintf(f,"      \"median\": %.1f\n",GetMedian(r->rates));
+        fprintf(f,"    }%s\n",i+1<results.size()?",":"");
+    }
+
+    fprintf(f,"  ]\n");
+    fprintf(f,"}\n");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static bool DoCommandLine(Options *options,int argc,char *argv[]) {
+    CommandLineParser p("Run emulator micro-benchmarks, and print the results as JSON","[OPTIONS]");
+
+    p.AddOption('o',"output").Arg(&options->output_path).Meta("FILE").Help("write JSON results to FILE rather than stdout");
+    p.AddOption('f',"filter").Arg(&options->filter).Meta("STR").Help("only run benchmarks whose names contain STR");
+    p.AddOption('n',"repetitions").Arg(&options->num_repetitions).Meta("N").Help("run each benchmark N times (default: 3)");
+    p.AddOption('l',"list").SetIfPresent(&options->list).Help("list benchmarks and exit");
+    p.AddHelpOption();
+
+    std::vector<std::string> other_args;
+    if(!p.Parse(argc,argv,&other_args)) {
+        return false;
+    }
+
+    if(!other_args.empty()) {
+        fprintf(stderr,"FATAL: additional arguments supplied\n");
+        return false;
+    }
+
+    if(options->num_repetitions<1) {
+        fprintf(stderr,"FATAL: repetitions must be at least 1\n");
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main(int argc,char *argv[]) {
+    Options options;
+    if(!DoCommandLine(&options,argc,argv)) {
+        return 1;
+    }
+
+    // Some of the emulator's logs print to stdout, which would spoil the
+    // JSON.
+    for(auto &&it:GetLogListsByTag()) {
+        for(Log *log:it.second) {
+            log->Disable();
+        }
+    }
+
+    std::vector<Benchmark> benchmarks=GetBenchmarks();
+
+    if(options.list) {
+        for(const Benchmark &benchmark:benchmarks) {
+            printf("%s\n",benchmark.name.c_str());
+        }
+
+        return 0;
+    }
+
+    std::vector<BenchmarkResult> results;
+
+    for(const Benchmark &benchmark:benchmarks) {
+        if(benchmark.name.find(options.filter)==std::string::npos) {
+            continue;
+        }
+
+        fprintf(stderr,"%s: ",benchmark.name.c_str());
+        fflush(stderr);
+
+        BenchmarkResult result;
+        result.benchmark=&benchmark;
+
+        for(int i=0;i<options.num_repetitions;++i) {
+            Measurement m=benchmark.fun();
+
+            result.rates.push_back(GetRate(m.num_items,m.num_ticks));
+            result.secondary_rates.push_back(GetRate(m.num_secondary_items,m.num_ticks));
+
+            fprintf(stderr,"%s%.4g",i==0?"":", ",result.rates.back());
+            fflush(stderr);
+        }
+
+        fprintf(stderr," %s\n",benchmark.units);
+
+        results.push_back(std::move(result));
+    }
+
+    FILE *f=stdout;
+    if(!options.output_path.empty()) {
+        f=fopen(options.output_path.c_str(),"wt");
+        if(!f) {
+            fprintf(stderr,"FATAL: failed to open output file: %s\n",options.output_path.c_str());
+            return 1;
+        }
+    }
+
+    PrintJSON(f,results);
+
+    if(f!=stdout) {
+        fclose(f);
+    }
+
+    return 0;
+}
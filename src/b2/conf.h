@@ -64,11 +64,21 @@ static const size_t NUM_THUMBNAIL_RENDER_FRAMES=2;
 // a cold boot. Takes longer due to memory clear, ROM init, etc.
 static const size_t NUM_BOOTUP_THUMBNAIL_RENDER_FRAMES=11;
 
+// Thumbnails are stored at half size - each pixel is the average of a
+// 2x2 block of the TV texture.
+static const int THUMBNAIL_WIDTH=TV_TEXTURE_WIDTH/2;
+static const int THUMBNAIL_HEIGHT=TV_TEXTURE_HEIGHT/2;
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
 #if BBCMICRO_DEBUGGER
 #define HTTP_SERVER 1
+
+// Default maximum number of debug snapshots published per second while
+// running. Halting, and changes made by the debugger, publish a snapshot
+// straight away regardless.
+static const float DEFAULT_DEBUG_SNAPSHOT_RATE_HZ=25.f;
 #endif
 
 //////////////////////////////////////////////////////////////////////////
@@ -26,6 +26,7 @@
 
 #include <unordered_map>
 #include <algorithm>
+#include <map>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -111,26 +112,26 @@ public:
         // The big page this refers to.
         const BigPageMetadata *metadata=nullptr;
 
-        // points to this->ram_buffer, or NULL.
+        // The debug snapshot the pointers point into. Keeps it alive for
+        // as long as this DebugBigPage is around.
+        std::shared_ptr<const BBCMicro> snapshot;
+
+        // points to the big page's contents, or NULL.
         const uint8_t *r=nullptr;
 
         // set if writeable - use one of the thread messages to actually do
         // the writing.
         bool writeable=false;
 
-        // points to this->byte_flags_buffer, or NULL.
+        // points to the big page's byte flags, or NULL.
         const uint8_t *byte_flags=nullptr;
 
         // The address flags are per-address, not per big page - it's just
         // convenient to have them as part of the same struct.
         //
-        // Points to this->addr_flags_buffer, or NULL.
+        // Points to the address flags for the big page's address range, or
+        // NULL.
         const uint8_t *addr_flags=nullptr;
-
-        // buffers for the above.
-        uint8_t ram_buffer[BBCMicro::BIG_PAGE_SIZE_BYTES]={};
-        uint8_t addr_flags_buffer[BBCMicro::BIG_PAGE_SIZE_BYTES]={};
-        uint8_t byte_flags_buffer[BBCMicro::BIG_PAGE_SIZE_BYTES]={};
     };
 
     bool OnClose() override;
@@ -301,8 +302,7 @@ void DebugUI::DoDebugPageOverrideImGui() {
     uint32_t dpo_mask;
     uint32_t dpo_current;
     {
-        std::unique_lock<Mutex> lock;
-        const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+        const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
         dpo_mask=m->GetType()->dpo_mask;
         dpo_current=m->DebugGetCurrentPageOverride();
     }
@@ -607,38 +607,15 @@ const DebugUI::DebugBigPage *DebugUI::GetDebugBigPageForAddress(M6502Word addr,
     if(!m_dbps[mos][addr.p.p]) {
         auto dbp=std::make_unique<DebugBigPage>();
 
-        std::unique_lock<Mutex> lock;
-        const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+        dbp->snapshot=m_beeb_thread->GetDebugSnapshotPtr();
+        const BBCMicro *m=dbp->snapshot.get();
 
         const BBCMicro::BigPage *bp=m->DebugGetBigPageForAddress(addr,mos,m_dpo);
         dbp->metadata=bp->metadata;
-
-        if(bp->r) {
-            memcpy(dbp->ram_buffer,bp->r,BBCMicro::BIG_PAGE_SIZE_BYTES);
-            dbp->r=dbp->ram_buffer;
-        } else {
-            dbp->r=nullptr;
-        }
-
-        if(bp->w&&bp->r) {
-            dbp->writeable=true;
-        } else {
-            dbp->writeable=false;
-        }
-
-        if(bp->debug) {
-            memcpy(dbp->byte_flags_buffer,bp->debug,BBCMicro::BIG_PAGE_SIZE_BYTES);
-            dbp->byte_flags=dbp->byte_flags_buffer;
-        } else {
-            dbp->byte_flags=nullptr;
-        }
-
-        if(const uint8_t *addr_flags=m->DebugGetAddressDebugFlagsForMemBigPage(addr.p.p)) {
-            memcpy(dbp->addr_flags_buffer,addr_flags,4096);
-            dbp->addr_flags=dbp->addr_flags_buffer;
-        } else {
-            dbp->addr_flags=nullptr;
-        }
+        dbp->r=bp->r;
+        dbp->writeable=bp->w&&bp->r;
+        dbp->byte_flags=bp->debug;
+        dbp->addr_flags=m->DebugGetAddressDebugFlagsForMemBigPage(addr.p.p);
 
         m_dbps[mos][addr.p.p]=std::move(dbp);
     }
@@ -730,8 +707,7 @@ protected:
         char halt_reason[1000];
 
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             const M6502 *s=m->GetM6502();
 
             config=s->config;
@@ -828,8 +804,7 @@ protected:
         this->DoDebugPageOverrideImGui();
 
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
 
             m_type=m->GetType();
         }
@@ -951,8 +926,7 @@ protected:
         bool enabled;
         uint8_t l,h;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
 
             if(const ExtMem *s=m->DebugGetExtMem()) {
                 enabled=true;
@@ -983,8 +957,7 @@ private:
 
         ASSERT((uint32_t)off==off);
 
-        std::unique_lock<Mutex> lock;
-        const BBCMicro *m=self->m_beeb_thread->LockBeeb(&lock);
+        const BBCMicro *m=self->m_beeb_thread->GetDebugSnapshot();
         const ExtMem *s=m->DebugGetExtMem();
         return ExtMem::ReadMemory(s,(uint32_t)off);
     }
@@ -1009,6 +982,161 @@ std::unique_ptr<SettingsUI> CreateExtMemoryDebugWindow(BeebWindow *beeb_window)
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Instruction boundaries for each big page, shared by all the disassembly
+// windows for a BeebThread.
+//
+// Known instruction starts are recorded from PC values seen in the debug
+// snapshots. The other instruction starts are found by walking forward
+// from those (or from the start of the page), and are only worked out
+// again when the page contents change.
+class DisassemblyCache {
+public:
+    // Flags for each byte.
+    static const uint8_t KNOWN_START=1;
+    static const uint8_t START=2;
+
+    // Returns the flags for the big page's bytes, or nullptr if it isn't
+    // readable.
+    const uint8_t *GetFlags(const BigPageMetadata *metadata,const uint8_t *r,const M6502Config *config) {
+        Page *page=this->GetPage(metadata,r,config);
+        if(!page) {
+            return nullptr;
+        }
+
+        if(page->dirty) {
+            this->FindStarts(page);
+        }
+
+        return page->flags;
+    }
+
+    void AddKnownStart(const BigPageMetadata *metadata,const uint8_t *r,uint16_t offset,const M6502Config *config) {
+        ASSERT(offset<BBCMicro::BIG_PAGE_SIZE_BYTES);
+
+        Page *page=this->GetPage(metadata,r,config);
+        if(!page) {
+            return;
+        }
+
+        if(!(page->flags[offset]&KNOWN_START)) {
+            page->flags[offset]|=KNOWN_START;
+            page->dirty=true;
+        }
+    }
+protected:
+private:
+    struct Page {
+        int checked_frame=-1;
+        bool dirty=true;
+        uint8_t contents[BBCMicro::BIG_PAGE_SIZE_BYTES]={};
+        uint8_t flags[BBCMicro::BIG_PAGE_SIZE_BYTES]={};
+    };
+
+    const M6502Config *m_config=nullptr;
+    std::unique_ptr<Page> m_pages[BBCMicro::NUM_BIG_PAGES];
+
+    Page *GetPage(const BigPageMetadata *metadata,const uint8_t *r,const M6502Config *config) {
+        if(!r) {
+            return nullptr;
+        }
+
+        if(config!=m_config) {
+            // Different type of BBC - start again.
+            for(std::unique_ptr<Page> &page:m_pages) {
+                page.reset();
+            }
+
+            m_config=config;
+        }
+
+        ASSERT(metadata->index<BBCMicro::NUM_BIG_PAGES);
+        std::unique_ptr<Page> *page=&m_pages[metadata->index];
+
+        if(!*page) {
+            *page=std::make_unique<Page>();
+        }
+
+        // The contents only change when there's a new snapshot, so once
+        // per frame is plenty.
+        int frame=ImGui::GetFrameCount();
+        if((*page)->checked_frame!=frame) {
+            (*page)->checked_frame=frame;
+            this->UpdateContents(page->get(),r);
+        }
+
+        return page->get();
+    }
+
+    void UpdateContents(Page *page,const uint8_t *r) {
+        if(memcmp(page->contents,r,BBCMicro::BIG_PAGE_SIZE_BYTES)==0) {
+            return;
+        }
+
+        // Forget any known starts whose instruction bytes changed.
+        for(size_t i=0;i<BBCMicro::BIG_PAGE_SIZE_BYTES;++i) {
+            if(page->contents[i]!=r[i]) {
+                for(size_t j=0;j<3&&j<=i;++j) {
+                    page->flags[i-j]&=~KNOWN_START;
+                }
+            }
+        }
+
+        memcpy(page->contents,r,BBCMicro::BIG_PAGE_SIZE_BYTES);
+        page->dirty=true;
+    }
+
+    // Walk from the start of the page to the first known start, then
+    // from each known start to the next.
+    void FindStarts(Page *page) {
+        for(size_t i=0;i<BBCMicro::BIG_PAGE_SIZE_BYTES;++i) {
+            page->flags[i]&=~START;
+        }
+
+        size_t i=0;
+        while(i<BBCMicro::BIG_PAGE_SIZE_BYTES) {
+            size_t next_known=i+1;
+            while(next_known<BBCMicro::BIG_PAGE_SIZE_BYTES&&!(page->flags[next_known]&KNOWN_START)) {
+                ++next_known;
+            }
+
+            for(size_t j=i;j<next_known;j+=m_config->disassembly_info[page->contents[j]].num_bytes) {
+                page->flags[j]|=START;
+            }
+
+            i=next_known;
+        }
+
+        page->dirty=false;
+    }
+};
+
+// Keyed on the BeebThread's control block, so a new BeebThread that
+// happens to reuse an old one's address doesn't get its cache.
+static std::map<std::weak_ptr<BeebThread>,std::weak_ptr<DisassemblyCache>,std::owner_less<std::weak_ptr<BeebThread>>> g_disassembly_cache_by_beeb_thread;
+
+static std::shared_ptr<DisassemblyCache> GetDisassemblyCache(const std::shared_ptr<BeebThread> &beeb_thread) {
+    auto &&it=g_disassembly_cache_by_beeb_thread.begin();
+    while(it!=g_disassembly_cache_by_beeb_thread.end()) {
+        if(it->first.expired()||it->second.expired()) {
+            it=g_disassembly_cache_by_beeb_thread.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::shared_ptr<DisassemblyCache> cache=g_disassembly_cache_by_beeb_thread[beeb_thread].lock();
+
+    if(!cache) {
+        cache=std::make_shared<DisassemblyCache>();
+        g_disassembly_cache_by_beeb_thread[beeb_thread]=cache;
+    }
+
+    return cache;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 class DisassemblyDebugWindow:
 public DebugUI,
 public RevealTargetUI
@@ -1053,8 +1181,7 @@ protected:
         const BBCMicroType *type;
         bool halted;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             const M6502 *s=m->GetM6502();
 
             type=m->GetType();
@@ -1069,6 +1196,19 @@ protected:
             sp=s->s;
             has_debug_state=m->HasDebugState();
             m->GetMemBigPageIsMOSTable(pc_is_mos,m_dpo);
+
+            if(!m_disassembly_cache) {
+                m_disassembly_cache=GetDisassemblyCache(m_beeb_thread);
+            }
+
+            // Note where the CPU actually is, regardless of any debug page
+            // overrides.
+            uint8_t actual_pc_is_mos[16];
+            m->GetMemBigPageIsMOSTable(actual_pc_is_mos,0);
+
+            M6502Word pc_word={pc};
+            const BBCMicro::BigPage *pc_bp=m->DebugGetBigPageForAddress(pc_word,!!actual_pc_is_mos[pc_word.p.p],0);
+            m_disassembly_cache->AddKnownStart(pc_bp->metadata,pc_bp->r,(uint16_t)pc_word.p.o,config);
         }
 
         float maxY=ImGui::GetCurrentWindow()->Size.y;//-ImGui::GetTextLineHeight()-GImGui->Style.WindowPadding.y*2.f;
@@ -1124,6 +1264,8 @@ protected:
             }
         }
 
+        this->AlignUsingCache(config);
+
         m_num_lines=0;
         uint16_t addr=m_addr;
         while(ImGui::GetCursorPosY()<=maxY) {
@@ -1368,6 +1510,16 @@ protected:
                     this->DoIndirect(operand.w+x,mos,0xffff,0);
                     break;
             }
+
+            // If the CPU has been seen executing from somewhere inside
+            // this instruction, carry on from there.
+            for(uint16_t i=1;i<di->num_bytes;++i) {
+                M6502Word known_addr={(uint16_t)(line_addr.w+i)};
+                if(this->GetDisassemblyCacheFlags(known_addr,config)&DisassemblyCache::KNOWN_START) {
+                    addr=known_addr.w;
+                    break;
+                }
+            }
         }
 
         if(ImGui::IsWindowHovered()) {
@@ -1394,6 +1546,7 @@ private:
     uint16_t m_addr=0;
     bool m_track_pc=true;
     int32_t m_old_pc=-1;
+    std::shared_ptr<DisassemblyCache> m_disassembly_cache;
     char m_address_text[100]={};
     //std::vector<uint16_t> m_line_addrs;
     std::vector<uint16_t> m_history;
@@ -1577,6 +1730,11 @@ private:
 
     void Up(const M6502Config *config,int n) {
         for(int i=0;i<n;++i) {
+            if(this->UpUsingCache(config)) {
+                continue;
+            }
+
+            // Guess.
             uint8_t opcode;
 
             this->ReadByte(&opcode,nullptr,nullptr,m_addr-1,false);
@@ -1595,6 +1753,69 @@ private:
         }
     }
 
+    // Disassembly cache flags for ADDR, or 0 if the cache doesn't know.
+    uint8_t GetDisassemblyCacheFlags(M6502Word addr,const M6502Config *config) {
+        if(!m_disassembly_cache) {
+            return 0;
+        }
+
+        const DebugBigPage *dbp=this->GetDebugBigPageForAddress(addr,false);
+
+        const uint8_t *flags=m_disassembly_cache->GetFlags(dbp->metadata,dbp->r,config);
+        if(!flags) {
+            return 0;
+        }
+
+        return flags[addr.p.o];
+    }
+
+    // Step back to the previous instruction start, if the cache knows of
+    // one that ends at m_addr.
+    bool UpUsingCache(const M6502Config *config) {
+        for(uint16_t num_bytes=1;num_bytes<=3;++num_bytes) {
+            M6502Word addr={(uint16_t)(m_addr-num_bytes)};
+
+            if(!(this->GetDisassemblyCacheFlags(addr,config)&DisassemblyCache::START)) {
+                continue;
+            }
+
+            uint8_t opcode;
+            this->ReadByte(&opcode,nullptr,nullptr,addr.w,false);
+            if(config->disassembly_info[opcode].num_bytes!=num_bytes) {
+                continue;
+            }
+
+            m_addr=addr.w;
+            return true;
+        }
+
+        return false;
+    }
+
+    // If the cache knows that m_addr is in the middle of an instruction,
+    // move back to the start of it.
+    void AlignUsingCache(const M6502Config *config) {
+        if(this->GetDisassemblyCacheFlags({m_addr},config)&DisassemblyCache::START) {
+            return;
+        }
+
+        for(uint16_t num_bytes=1;num_bytes<3;++num_bytes) {
+            M6502Word addr={(uint16_t)(m_addr-num_bytes)};
+
+            if(!(this->GetDisassemblyCacheFlags(addr,config)&DisassemblyCache::START)) {
+                continue;
+            }
+
+            uint8_t opcode;
+            this->ReadByte(&opcode,nullptr,nullptr,addr.w,false);
+            if(config->disassembly_info[opcode].num_bytes>num_bytes) {
+                m_addr=addr.w;
+            }
+
+            return;
+        }
+    }
+
     void Down(const M6502Config *config,int n) {
         for(int i=0;i<n;++i) {
             uint8_t opcode;
@@ -1604,8 +1825,7 @@ private:
     }
 
     const M6502Config *Get6502Config() {
-        std::unique_lock<Mutex> lock;
-        const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+        const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
         const M6502 *s=m->GetM6502();
 
         return s->config;
@@ -1672,8 +1892,7 @@ protected:
         BBCMicro::AddressableLatch latch;
 
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
 
             const CRTC *c=m->DebugGetCRTC();
             //const VideoULA *u=m->DebugGetVideoULA();
@@ -1741,8 +1960,7 @@ protected:
         VideoDataPixel nula_palette[16];
 
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
 
             const VideoULA *u=m->DebugGetVideoULA();
 
@@ -1916,9 +2134,14 @@ protected:
             }
 
             if(changed) {
-                std::unique_lock<Mutex> lock;
-                BBCMicro *m=m_beeb_thread->LockMutableBeeb(&lock);
-                m->SetHardwareDebugState(hw);
+                {
+                    std::unique_lock<Mutex> lock;
+                    BBCMicro *m=m_beeb_thread->LockMutableBeeb(&lock);
+                    m->SetHardwareDebugState(hw);
+                }
+
+                // Get the change into the debug snapshot.
+                m_beeb_thread->Send(std::make_shared<BeebThread::DebugWakeUpMessage>());
             }
         }
     }
@@ -2009,8 +2232,7 @@ protected:
         BBCMicro::HardwareDebugState hw;
         uint8_t rtc_addr=0;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             this->GetState(&state,m->DebugGetSystemVIA());
             latch=m->DebugGetAddressableLatch();
             type=m->GetType();
@@ -2090,8 +2312,7 @@ protected:
         bool has_debug_state;
         BBCMicro::HardwareDebugState hw;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             this->GetState(&state,m->DebugGetUserVIA());
             has_debug_state=m->HasDebugState();
             hw=m->GetHardwareDebugState();
@@ -2117,8 +2338,7 @@ protected:
     void DoImGui2() override {
         std::vector<uint8_t> nvram;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
 
             nvram=m->GetNVRAM();
         }
@@ -2203,8 +2423,7 @@ protected:
         uint16_t seed;
         bool we;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             const SN76489 *sn=m->DebugGetSN76489();
             sn->GetState(values,&seed);
 
@@ -2290,8 +2509,7 @@ protected:
         ACCCON acccon;
         const BBCMicroType *type;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             m->DebugGetPaging(&romsel,&acccon);
             type=m->GetType();
         }
@@ -2394,8 +2612,7 @@ protected:
         bool changed=false;
         const BBCMicroType *type;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
 
             uint64_t breakpoints_change_counter=m->DebugGetBreakpointsChangeCounter();
             if(breakpoints_change_counter!=m_breakpoints_change_counter) {
@@ -2607,8 +2824,7 @@ protected:
             if(unit->metadata.flags&VideoDataUnitMetadataFlag_HasAddress) {
                 const BBCMicroType *type;
                 {
-                    std::unique_lock<Mutex> lock;
-                    const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+                    const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
                     type=m->GetType();
                 }
 
@@ -2681,8 +2897,7 @@ protected:
 
         uint8_t s;
         {
-            std::unique_lock<Mutex> lock;
-            const BBCMicro *m=m_beeb_thread->LockBeeb(&lock);
+            const BBCMicro *m=m_beeb_thread->GetDebugSnapshot();
             const M6502 *cpu=m->GetM6502();
             s=cpu->s.b.l;
         }
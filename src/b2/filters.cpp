@@ -1,6 +1,8 @@
 #include <shared/system.h>
 #include "filters.h"
 #include <shared/debug.h>
+#include <beeb/sound.h>
+#include "Remapper.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdlib.h>
@@ -10,6 +12,16 @@
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+const float SN_VOLUMES_TABLE[16]={
+    0.00000f, 0.03981f, 0.05012f, 0.06310f,
+    0.07943f, 0.10000f, 0.12589f, 0.15849f,
+    0.19953f, 0.25119f, 0.31623f, 0.39811f,
+    0.50119f, 0.63096f, 0.79433f, 1.00000f,
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 static const size_t MAX_FILTER_WIDTH=1024;
 
 static std::vector<float> g_filters[MAX_FILTER_WIDTH];
@@ -69,3 +81,70 @@ void GetFilterForWidth(const float **values,size_t *num_values,size_t width) {
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
+
+size_t ResampleSoundUnits(float *dest,
+                          size_t num_dest,
+                          size_t *unit_index,
+                          const SoundDataUnit *ua,
+                          size_t num_ua,
+                          const SoundDataUnit *ub,
+                          size_t num_ub,
+                          Remapper *remapper,
+                          float *last_sample,
+                          float sn_scale,
+                          float disc_sound_scale)
+{
+#if !BBCMICRO_ENABLE_DISC_DRIVE_SOUND
+    (void)disc_sound_scale;
+#endif
+
+    size_t num_units=num_ua+num_ub;
+    size_t num_samples=0;
+
+    while(num_samples<num_dest) {
+        uint64_t num_sample_units=remapper->GetNumUnits(1);
+        if(num_sample_units>num_units-*unit_index) {
+            break;
+        }
+
+        remapper->Step();
+
+        if(num_sample_units>0) {
+            const float *filter;
+            size_t filter_width;
+            GetFilterForWidth(&filter,&filter_width,(size_t)num_sample_units);
+            ASSERT(filter_width<=num_sample_units);
+
+            float acc=0.f;
+            for(size_t i=0;i<filter_width;++i) {
+                const SoundDataUnit *unit;
+                if(*unit_index+i<num_ua) {
+                    unit=&ua[*unit_index+i];
+                } else {
+                    unit=&ub[*unit_index+i-num_ua];
+                }
+
+                float value=sn_scale*(SN_VOLUMES_TABLE[unit->sn_output.ch[0]]+
+                                      SN_VOLUMES_TABLE[unit->sn_output.ch[1]]+
+                                      SN_VOLUMES_TABLE[unit->sn_output.ch[2]]+
+                                      SN_VOLUMES_TABLE[unit->sn_output.ch[3]]);
+#if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
+                value+=disc_sound_scale*unit->disc_drive_sound;
+#endif
+
+                acc+=filter[i]*value;
+            }
+
+            *unit_index+=(size_t)num_sample_units;
+            *last_sample=acc;
+        }
+
+        *dest++=*last_sample;
+        ++num_samples;
+    }
+
+    return num_samples;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
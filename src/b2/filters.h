@@ -4,9 +4,49 @@
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+#include <beeb/conf.h>
+
+struct SoundDataUnit;
+class Remapper;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Linear output level for each SN76489 attenuation setting (index is
+// SoundDataUnit::sn_output value, 0=silent, 15=loudest).
+extern const float SN_VOLUMES_TABLE[16];
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void GetFilterForWidth(const float **values,size_t *num_values,size_t width);
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Filter and resample sound units into DEST, stepping REMAPPER once per
+// output sample. The units are the two parts UA and UB, as from
+// OutputDataBuffer::GetConsumerBuffers, starting from *UNIT_INDEX, which
+// is updated.
+//
+// Stops when DEST is full or there aren't enough units left for the next
+// sample. *LAST_SAMPLE is the most recent sample, repeated for steps that
+// don't need any units, and is updated.
+//
+// Returns the number of samples written.
+size_t ResampleSoundUnits(float *dest,
+                          size_t num_dest,
+                          size_t *unit_index,
+                          const SoundDataUnit *ua,
+                          size_t num_ua,
+                          const SoundDataUnit *ub,
+                          size_t num_ub,
+                          Remapper *remapper,
+                          float *last_sample,
+                          float sn_scale,
+                          float disc_sound_scale);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #endif
@@ -93,30 +93,6 @@ static std::string GetUTF8String(const wchar_t *str) {
 }
 #endif
 
-#if SYSTEM_WINDOWS
-static std::wstring GetWideString(const char *str) {
-    size_t len=strlen(str);
-
-    if(len>INT_MAX) {
-        return L"";
-    }
-
-    int n=MultiByteToWideChar(CP_UTF8,0,str,(int)len,nullptr,0);
-    if(n==0) {
-        return L"";
-    }
-
-    std::vector<wchar_t> buffer;
-    buffer.resize(n);
-    MultiByteToWideChar(CP_UTF8,0,str,(int)len,buffer.data(),(int)buffer.size());
-
-    return std::wstring(buffer.begin(),buffer.end());
-}
-#endif
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
 #if SYSTEM_WINDOWS
 static std::string GetWindowsPath(const GUID &known_folder,const std::string &path) {
     std::string result;
@@ -397,241 +373,6 @@ static bool GetDataFromHexString(std::vector<uint8_t> *data,const std::string &s
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-static void AddError(Messages *msg,
-                     const std::string &path,
-                     const char *what1,
-                     const char *what2,
-                     int err)
-{
-    msg->w.f("%s failed: %s\n",what1,path.c_str());
-
-    if(err!=0) {
-        msg->i.f("(%s: %s)\n",what2,strerror(err));
-    } else {
-        msg->i.f("(%s)\n",what2);
-    }
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-FILE *fopenUTF8(const char *path,const char *mode) {
-#if SYSTEM_WINDOWS
-
-    return _wfopen(GetWideString(path).c_str(),GetWideString(mode).c_str());
-
-#else
-
-    return fopen(path,mode);
-
-#endif
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-template<class ContType>
-static bool LoadFile2(ContType *data,
-                      const std::string &path,
-                      Messages *msg,
-                      uint32_t flags,
-                      const char *mode)
-{
-    static_assert(sizeof(typename ContType::value_type)==1,"LoadFile2 can only load into a vector of bytes");
-    FILE *f=NULL;
-    bool good=false;
-    long len;
-    size_t num_bytes,num_read;
-
-    f=fopenUTF8(path.c_str(),mode);
-    if(!f) {
-        if(errno==ENOENT&&(flags&LoadFlag_MightNotExist)) {
-            // ignore this error.
-        } else {
-            AddError(msg,path,"load","open failed",errno);
-        }
-
-        goto done;
-    }
-
-    if(fseek(f,0,SEEK_END)==-1) {
-        AddError(msg,path,"load","fseek (1) failed",errno);
-        goto done;
-    }
-
-    len=ftell(f);
-    if(len<0) {
-        AddError(msg,path,"load","ftell failed",errno);
-        goto done;
-    }
-
-#if LONG_MAX>SIZE_MAX
-    if(len>(long)SIZE_MAX) {
-        AddError(msg,path,"load","file is too large",0);
-        goto done;
-    }
-#endif
-
-    if(fseek(f,0,SEEK_SET)==-1) {
-        AddError(msg,path,"load","fseek (2) failed",errno);
-        goto done;
-    }
-
-    num_bytes=(size_t)len;
-    data->resize(num_bytes);
-
-    num_read=fread(data->data(),1,num_bytes,f);
-    if(ferror(f)) {
-        AddError(msg,path,"load","read failed",errno);
-        goto done;
-    }
-
-    // Number of bytes read may be smaller if mode is rt.
-    data->resize(num_read);
-    good=true;
-
-done:;
-    if(!good) {
-        data->clear();
-    }
-
-    if(f) {
-        fclose(f);
-        f=NULL;
-    }
-
-    return good;
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-bool LoadFile(std::vector<uint8_t> *data,
-              const std::string &path,
-              Messages *messages,
-              uint32_t flags)
-{
-    if(!LoadFile2(data,path,messages,flags,"rb")) {
-        return false;
-    }
-
-    data->shrink_to_fit();
-    return true;
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-bool LoadTextFile(std::vector<char> *data,
-                  const std::string &path,
-                  Messages *messages,
-                  uint32_t flags)
-{
-    if(!LoadFile2(data,path,messages,flags,"rt")) {
-        return false;
-    }
-
-    data->push_back(0);
-    return true;
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-static bool SaveFile2(const void *data,size_t data_size,const std::string &path,Messages *messages,const char *fopen_mode) {
-    FILE *f=fopen(path.c_str(),fopen_mode);
-    if(!f) {
-        AddError(messages,path,"save","fopen failed",errno);
-        return false;
-    }
-
-    fwrite(data,1,data_size,f);
-
-    bool bad=!!ferror(f);
-    int e=errno;
-
-    fclose(f);
-    f=nullptr;
-
-    if(bad) {
-        AddError(messages,path,"save","write failed",e);
-        return false;
-    }
-
-    return true;
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-bool SaveFile(const void *data,size_t data_size,const std::string &path,Messages *messages) {
-    return SaveFile2(data,data_size,path,messages,"wb");
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-bool SaveFile(const std::vector<uint8_t> &data,const std::string &path,Messages *messages) {
-    return SaveFile(data.data(),data.size(),path,messages);
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-bool SaveTextFile(const std::string &data,const std::string &path,Messages *messages) {
-    return SaveFile2(data.c_str(),data.size(),path,messages,"wt");
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-bool GetFileDetails(size_t *size,bool *can_write,const char *path) {
-    FILE *fp=nullptr;
-    bool good=false;
-    long len;
-
-    fp=fopenUTF8(path,"r+b");
-    if(fp) {
-        *can_write=true;
-    } else {
-        // doesn't exist, or read-only.
-        fp=fopenUTF8(path,"rb");
-        if(!fp) {
-            // assume doesn't exist.
-            goto done;
-        }
-
-        *can_write=false;
-    }
-
-    if(fseek(fp,0,SEEK_END)!=0) {
-        goto done;
-    }
-
-    len=ftell(fp);
-    if(len<0) {
-        goto done;
-    }
-
-    if((unsigned long)len>SIZE_MAX) {
-        *size=SIZE_MAX;
-    } else {
-        *size=(size_t)len;
-    }
-
-    good=true;
-done:
-    if(fp!=nullptr) {
-        fclose(fp);
-        fp=nullptr;
-    }
-
-    return good;
-}
-
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
 // RapidJSON-friendly stream class that writes its output into a
 // std::string.
 
@@ -1081,6 +822,7 @@ static const char VSYNC[]="vsync";
 static const char EXT_MEM[]="ext_mem";
 static const char UNLIMITED[]="unlimited";
 static const char BEEBLINK[]="beeblink";
+static const char TURBO_DISC[]="turbo_disc";
 static const char URLS[]="urls";
 static const char NVRAM[]="nvram";
 static const char START_INSTRUCTION_ADDRESS[]="start_address";//yes, inconsistent naming...
@@ -1089,6 +831,9 @@ static const char STOP_WRITE_ADDRESS[]="stop_write_address";
 static const char STOP_NUM_CYCLES[]="stop_num_cycles";
 static const char CYCLES_OUTPUT[]="cycles_output";
 static const char POWER_ON_TONE[]="power_on_tone";
+#if BBCMICRO_DEBUGGER
+static const char DEBUG_SNAPSHOT_RATE[]="debug_snapshot_rate";
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -1386,6 +1131,9 @@ static bool LoadWindows(rapidjson::Value *windows,Messages *msg) {
     FindBoolMember(&BeebWindows::defaults.display_auto_scale,windows,AUTO_SCALE,nullptr);
     FindFloatMember(&BeebWindows::defaults.display_manual_scale,windows,MANUAL_SCALE,nullptr);
     FindBoolMember(&BeebWindows::defaults.power_on_tone,windows,POWER_ON_TONE,nullptr);
+#if BBCMICRO_DEBUGGER
+    FindFloatMember(&BeebWindows::defaults.debug_snapshot_rate,windows,DEBUG_SNAPSHOT_RATE,nullptr);
+#endif
 
     {
         std::string keymap_name;
@@ -1463,6 +1211,7 @@ static bool LoadConfigs(rapidjson::Value *configs_json,Messages *msg) {
 
         FindBoolMember(&config.ext_mem,config_json,EXT_MEM,msg);
         FindBoolMember(&config.beeblink,config_json,BEEBLINK,msg);
+        FindBoolMember(&config.turbo_disc,config_json,TURBO_DISC,msg);
 
         BeebWindows::AddConfig(std::move(config));
     }
@@ -1836,6 +1585,9 @@ static void SaveConfigs(JSONWriter<StringStream> *writer) {
             writer->Key(BEEBLINK);
             writer->Bool(config->beeblink);
 
+            writer->Key(TURBO_DISC);
+            writer->Bool(config->turbo_disc);
+
             return true;
         });
     }
@@ -1903,6 +1655,11 @@ static void SaveWindows(JSONWriter<StringStream> *writer) {
 
         writer->Key(POWER_ON_TONE);
         writer->Bool(BeebWindows::defaults.power_on_tone);
+
+#if BBCMICRO_DEBUGGER
+        writer->Key(DEBUG_SNAPSHOT_RATE);
+        writer->Double(BeebWindows::defaults.debug_snapshot_rate);
+#endif
     }
 }
 
@@ -45,6 +45,8 @@ std::string GetCachePath(const std::string &path);
 //////////////////////////////////////////////////////////////////////////
 
 // File names are assumed to be UTF-8.
+//
+// (These are in load_save_files.cpp.)
 
 bool LoadFile(std::vector<uint8_t> *data,
               const std::string &path,
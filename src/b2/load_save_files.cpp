@@ -0,0 +1,274 @@
+#include <shared/system.h>
+#include "load_save.h"
+#include "Messages.h"
+#include <shared/system_specific.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+
+// The plain file loading and saving functions from load_save.h. These
+// don't need the UI or the config, so they're separate - the disc image
+// classes can then be used outside b2 itself.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if SYSTEM_WINDOWS
+static std::wstring GetWideString(const char *str) {
+    size_t len=strlen(str);
+
+    if(len>INT_MAX) {
+        return L"";
+    }
+
+    int n=MultiByteToWideChar(CP_UTF8,0,str,(int)len,nullptr,0);
+    if(n==0) {
+        return L"";
+    }
+
+    std::vector<wchar_t> buffer;
+    buffer.resize(n);
+    MultiByteToWideChar(CP_UTF8,0,str,(int)len,buffer.data(),(int)buffer.size());
+
+    return std::wstring(buffer.begin(),buffer.end());
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void AddError(Messages *msg,
+                     const std::string &path,
+                     const char *what1,
+                     const char *what2,
+                     int err)
+{
+    msg->w.f("%s failed: %s\n",what1,path.c_str());
+
+    if(err!=0) {
+        msg->i.f("(%s: %s)\n",what2,strerror(err));
+    } else {
+        msg->i.f("(%s)\n",what2);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+FILE *fopenUTF8(const char *path,const char *mode) {
+#if SYSTEM_WINDOWS
+
+    return _wfopen(GetWideString(path).c_str(),GetWideString(mode).c_str());
+
+#else
+
+    return fopen(path,mode);
+
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+template<class ContType>
+static bool LoadFile2(ContType *data,
+                      const std::string &path,
+                      Messages *msg,
+                      uint32_t flags,
+                      const char *mode)
+{
+    static_assert(sizeof(typename ContType::value_type)==1,"LoadFile2 can only load into a vector of bytes");
+    FILE *f=NULL;
+    bool good=false;
+    long len;
+    size_t num_bytes,num_read;
+
+    f=fopenUTF8(path.c_str(),mode);
+    if(!f) {
+        if(errno==ENOENT&&(flags&LoadFlag_MightNotExist)) {
+            // ignore this error.
+        } else {
+            AddError(msg,path,"load","open failed",errno);
+        }
+
+        goto done;
+    }
+
+    if(fseek(f,0,SEEK_END)==-1) {
+        AddError(msg,path,"load","fseek (1) failed",errno);
+        goto done;
+    }
+
+    len=ftell(f);
+    if(len<0) {
+        AddError(msg,path,"load","ftell failed",errno);
+        goto done;
+    }
+
+#if LONG_MAX>SIZE_MAX
+    if(len>(long)SIZE_MAX) {
+        AddError(msg,path,"load","file is too large",0);
+        goto done;
+    }
+#endif
+
+    if(fseek(f,0,SEEK_SET)==-1) {
+        AddError(msg,path,"load","fseek (2) failed",errno);
+        goto done;
+    }
+
+    num_bytes=(size_t)len;
+    data->resize(num_bytes);
+
+    num_read=fread(data->data(),1,num_bytes,f);
+    if(ferror(f)) {
+        AddError(msg,path,"load","read failed",errno);
+        goto done;
+    }
+
+    // Number of bytes read may be smaller if mode is rt.
+    data->resize(num_read);
+    good=true;
+
+done:;
+    if(!good) {
+        data->clear();
+    }
+
+    if(f) {
+        fclose(f);
+        f=NULL;
+    }
+
+    return good;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool LoadFile(std::vector<uint8_t> *data,
+              const std::string &path,
+              Messages *messages,
+              uint32_t flags)
+{
+    if(!LoadFile2(data,path,messages,flags,"rb")) {
+        return false;
+    }
+
+    data->shrink_to_fit();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool LoadTextFile(std::vector<char> *data,
+                  const std::string &path,
+                  Messages *messages,
+                  uint32_t flags)
+{
+    if(!LoadFile2(data,path,messages,flags,"rt")) {
+        return false;
+    }
+
+    data->push_back(0);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static bool SaveFile2(const void *data,size_t data_size,const std::string &path,Messages *messages,const char *fopen_mode) {
+    FILE *f=fopen(path.c_str(),fopen_mode);
+    if(!f) {
+        AddError(messages,path,"save","fopen failed",errno);
+        return false;
+    }
+
+    fwrite(data,1,data_size,f);
+
+    bool bad=!!ferror(f);
+    int e=errno;
+
+    fclose(f);
+    f=nullptr;
+
+    if(bad) {
+        AddError(messages,path,"save","write failed",e);
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool SaveFile(const void *data,size_t data_size,const std::string &path,Messages *messages) {
+    return SaveFile2(data,data_size,path,messages,"wb");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool SaveFile(const std::vector<uint8_t> &data,const std::string &path,Messages *messages) {
+    return SaveFile(data.data(),data.size(),path,messages);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool SaveTextFile(const std::string &data,const std::string &path,Messages *messages) {
+    return SaveFile2(data.c_str(),data.size(),path,messages,"wt");
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool GetFileDetails(size_t *size,bool *can_write,const char *path) {
+    FILE *fp=nullptr;
+    bool good=false;
+    long len;
+
+    fp=fopenUTF8(path,"r+b");
+    if(fp) {
+        *can_write=true;
+    } else {
+        // doesn't exist, or read-only.
+        fp=fopenUTF8(path,"rb");
+        if(!fp) {
+            // assume doesn't exist.
+            goto done;
+        }
+
+        *can_write=false;
+    }
+
+    if(fseek(fp,0,SEEK_END)!=0) {
+        goto done;
+    }
+
+    len=ftell(fp);
+    if(len<0) {
+        goto done;
+    }
+
+    if((unsigned long)len>SIZE_MAX) {
+        *size=SIZE_MAX;
+    } else {
+        *size=(size_t)len;
+    }
+
+    good=true;
+done:
+    if(fp!=nullptr) {
+        fclose(fp);
+        fp=nullptr;
+    }
+
+    return good;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
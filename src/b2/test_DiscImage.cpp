@@ -0,0 +1,190 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include <shared/path.h>
+#include <beeb/DiscImage.h>
+#include "MemoryDiscImage.h"
+#include "DirectDiscImage.h"
+#include "DiscGeometry.h"
+#include "Messages.h"
+#include "load_save.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Checks the ReadSector/WriteSector overrides against the byte at a time
+// Read/Write.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const size_t NUM_TRACKS=80;
+static const size_t NUM_SECTORS=10;
+static const size_t SECTOR_SIZE=256;
+
+// The image is truncated after this many tracks, as .ssd files often are.
+static const size_t NUM_IMAGE_TRACKS=4;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::vector<uint8_t> GetImageData() {
+    std::vector<uint8_t> data(NUM_IMAGE_TRACKS*NUM_SECTORS*SECTOR_SIZE);
+
+    for(size_t i=0;i<data.size();++i) {
+        data[i]=(uint8_t)(i*3+i/SECTOR_SIZE);
+    }
+
+    return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::vector<uint8_t> ReadSectorBytes(const DiscImage *disc_image,uint8_t track,uint8_t sector) {
+    std::vector<uint8_t> data(SECTOR_SIZE);
+
+    for(size_t i=0;i<SECTOR_SIZE;++i) {
+        TEST_TRUE(disc_image->Read(&data[i],0,track,sector,i));
+    }
+
+    return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// FILL_BYTE is what a read past the end of the image data gets.
+static void TestDiscImage(DiscImage *disc_image,uint8_t fill_byte) {
+    std::vector<uint8_t> image_data=GetImageData();
+
+    // ReadSector gets the same as Read.
+    for(uint8_t track=0;track<NUM_IMAGE_TRACKS;++track) {
+        for(uint8_t sector=0;sector<NUM_SECTORS;++sector) {
+            uint8_t buf[SECTOR_SIZE];
+            TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,track,sector));
+            TEST_EQ_AA(buf,&image_data[(track*NUM_SECTORS+sector)*SECTOR_SIZE],SECTOR_SIZE);
+
+            std::vector<uint8_t> bytes=ReadSectorBytes(disc_image,track,sector);
+            TEST_EQ_AA(buf,bytes.data(),SECTOR_SIZE);
+        }
+    }
+
+    // Past the end of the data.
+    {
+        uint8_t buf[SECTOR_SIZE];
+        TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,NUM_IMAGE_TRACKS,0));
+
+        std::vector<uint8_t> fill(SECTOR_SIZE,fill_byte);
+        TEST_EQ_AA(buf,fill.data(),SECTOR_SIZE);
+    }
+
+    std::vector<uint8_t> data(SECTOR_SIZE);
+    for(size_t i=0;i<data.size();++i) {
+        data[i]=(uint8_t)~i;
+    }
+
+    // Whole sector.
+    {
+        TEST_TRUE(disc_image->WriteSector(0,1,2,data.data(),SECTOR_SIZE));
+
+        uint8_t buf[SECTOR_SIZE];
+        TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,1,2));
+        TEST_EQ_AA(buf,data.data(),SECTOR_SIZE);
+
+        std::vector<uint8_t> bytes=ReadSectorBytes(disc_image,1,2);
+        TEST_EQ_AA(bytes.data(),data.data(),SECTOR_SIZE);
+
+        // Neighbours are untouched.
+        TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,1,1));
+        TEST_EQ_AA(buf,&image_data[(1*NUM_SECTORS+1)*SECTOR_SIZE],SECTOR_SIZE);
+
+        TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,1,3));
+        TEST_EQ_AA(buf,&image_data[(1*NUM_SECTORS+3)*SECTOR_SIZE],SECTOR_SIZE);
+    }
+
+    // Part of a sector, as when a write is interrupted.
+    {
+        const size_t SIZE=100;
+
+        TEST_TRUE(disc_image->WriteSector(0,2,5,data.data(),SIZE));
+
+        uint8_t buf[SECTOR_SIZE];
+        TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,2,5));
+        TEST_EQ_AA(buf,data.data(),SIZE);
+        TEST_EQ_AA(buf+SIZE,&image_data[(2*NUM_SECTORS+5)*SECTOR_SIZE+SIZE],SECTOR_SIZE-SIZE);
+    }
+
+    // Past the end of the data.
+    {
+        TEST_TRUE(disc_image->WriteSector(0,NUM_IMAGE_TRACKS+1,4,data.data(),SECTOR_SIZE));
+
+        uint8_t buf[SECTOR_SIZE];
+        TEST_TRUE(disc_image->ReadSector(buf,sizeof buf,0,NUM_IMAGE_TRACKS+1,4));
+        TEST_EQ_AA(buf,data.data(),SECTOR_SIZE);
+    }
+
+    // Bad requests.
+    {
+        uint8_t buf[SECTOR_SIZE+1]={};
+
+        TEST_FALSE(disc_image->ReadSector(buf,sizeof buf,0,0,0));
+        TEST_FALSE(disc_image->WriteSector(0,0,0,buf,sizeof buf));
+
+        TEST_FALSE(disc_image->ReadSector(buf,SECTOR_SIZE,0,0,NUM_SECTORS));
+        TEST_FALSE(disc_image->WriteSector(0,0,NUM_SECTORS,buf,SECTOR_SIZE));
+
+        TEST_FALSE(disc_image->ReadSector(buf,SECTOR_SIZE,0,NUM_TRACKS,0));
+        TEST_FALSE(disc_image->WriteSector(0,NUM_TRACKS,0,buf,SECTOR_SIZE));
+
+        TEST_FALSE(disc_image->ReadSector(buf,SECTOR_SIZE,1,0,0));
+        TEST_FALSE(disc_image->WriteSector(1,0,0,buf,SECTOR_SIZE));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestMemoryDiscImage() {
+    Messages msg;
+    std::vector<uint8_t> image_data=GetImageData();
+
+    std::shared_ptr<MemoryDiscImage> disc_image=MemoryDiscImage::LoadFromBuffer("test.ssd",
+                                                                                 MemoryDiscImage::LOAD_METHOD_FILE,
+                                                                                 image_data,
+                                                                                 DiscGeometry(NUM_TRACKS,NUM_SECTORS,SECTOR_SIZE),
+                                                                                 &msg);
+    TEST_NON_NULL(disc_image.get());
+
+    TestDiscImage(disc_image.get(),MemoryDiscImage::FILL_BYTE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestDirectDiscImage() {
+    Messages msg;
+    std::string path=PathJoined(PathGetFolder(PathGetEXEFileName()),"test_DiscImage.ssd");
+
+    TEST_TRUE(SaveFile(GetImageData(),path,&msg));
+
+    std::shared_ptr<DirectDiscImage> disc_image=DirectDiscImage::CreateForFile(path,&msg);
+    TEST_NON_NULL(disc_image.get());
+
+    // DirectDiscImage pads short files with zeros.
+    TestDiscImage(disc_image.get(),0);
+
+    disc_image=nullptr;
+    remove(path.c_str());
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestMemoryDiscImage();
+    TestDirectDiscImage();
+}
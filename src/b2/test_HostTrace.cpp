@@ -0,0 +1,111 @@
+#include <shared/system.h>
+#include "HostTrace.h"
+#include <shared/testing.h>
+#include <thread>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const HostTraceThread *FindThread(const std::vector<HostTraceThread> &threads,const char *name) {
+    for(const HostTraceThread &thread:threads) {
+        if(thread.name==name) {
+            return &thread;
+        }
+    }
+
+    return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+namespace TestNamespace {
+
+struct TestBase {
+    virtual ~TestBase()=default;
+};
+
+struct TestDerived:
+    TestBase
+{
+};
+
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main(void) {
+    SetHostTraceThreadName("Main");
+
+    {
+        HostTraceScope hts("Outer",100);
+        hts.SetDetail("detail \"quoted\"");
+
+        {
+            HostTraceScope hts2("Inner");
+        }
+
+        hts.SetEndCycle(250);
+    }
+
+    // Wrap the other thread's ring buffer. The thread must still be
+    // running when the events are collected.
+    std::vector<HostTraceThread> threads;
+    {
+        std::thread thread([&threads]() {
+            SetHostTraceThreadName("Other");
+
+            for(size_t i=0;i<HOST_TRACE_MAX_NUM_EVENTS+10;++i) {
+                HostTraceScope hts("Loop",i);
+            }
+
+            threads=GetHostTraceThreads();
+        });
+        thread.join();
+    }
+
+    const HostTraceThread *main_thread=FindThread(threads,"Main");
+    TEST_NON_NULL(main_thread);
+    TEST_EQ_UU(main_thread->events.size(),2);
+    TEST_EQ_SS(main_thread->events[0].name,"Inner");
+    TEST_EQ_SS(main_thread->events[1].name,"Outer");
+    TEST_EQ_UU(main_thread->events[1].begin_cycle,100);
+    TEST_EQ_UU(main_thread->events[1].end_cycle,250);
+    TEST_TRUE(main_thread->events[1].begin_ticks<=main_thread->events[0].begin_ticks);
+    TEST_TRUE(main_thread->events[1].end_ticks>=main_thread->events[0].end_ticks);
+
+    const HostTraceThread *other_thread=FindThread(threads,"Other");
+    TEST_NON_NULL(other_thread);
+    TEST_EQ_UU(other_thread->events.size(),HOST_TRACE_MAX_NUM_EVENTS);
+    TEST_EQ_UU(other_thread->events.front().begin_cycle,10);
+    TEST_EQ_UU(other_thread->events.back().begin_cycle,HOST_TRACE_MAX_NUM_EVENTS+9);
+
+    // The other thread has gone now.
+    TEST_NULL(FindThread(GetHostTraceThreads(),"Other"));
+
+    // Type names are per dynamic type, and each one is only made once.
+    {
+        TestNamespace::TestDerived derived;
+        const TestNamespace::TestBase *base=&derived;
+
+        const char *name=GetHostTraceTypeName(typeid(*base));
+        TEST_TRUE(name==GetHostTraceTypeName(typeid(TestNamespace::TestDerived)));
+        TEST_TRUE(strstr(name,"TestDerived")!=nullptr);
+#ifdef __GNUC__
+        TEST_EQ_SS(name,"TestNamespace::TestDerived");
+#endif
+    }
+
+    std::string json=GetHostTraceChromeTrace(threads);
+    TEST_TRUE(json[0]=='{');
+    TEST_TRUE(json.find("\"name\":\"Main\"")!=std::string::npos);
+    TEST_TRUE(json.find("\"name\":\"Other\"")!=std::string::npos);
+    TEST_TRUE(json.find("\"cycle\":100,\"num_cycles\":150,\"detail\":\"detail \\\"quoted\\\"\"")!=std::string::npos);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -3,6 +3,9 @@
 #include <shared/testing.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <vector>
+#include <string>
+#include <algorithm>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -41,6 +44,107 @@ struct TestJob1:
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Appends its name to a shared string when run. Only used with 1 thread,
+// so no need for any locking.
+struct OrderJob:
+    JobQueue::Job
+{
+    JobPriority priority=JobPriority_Background;
+    std::string *order=nullptr;
+    char name=0;
+
+    JobPriority GetPriority() const override {
+        return this->priority;
+    }
+
+    void ThreadExecute() override {
+        *this->order+=this->name;
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Adds 1 to each value in its range.
+struct IncrementJob:
+    JobQueue::Job
+{
+    std::vector<int32_t> *values=nullptr;
+    size_t begin=0,end=0;
+
+    void ThreadExecute() override {
+        for(size_t i=this->begin;i<this->end;++i) {
+            ++(*this->values)[i];
+        }
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Fans out IncrementJobs over its values, plus a job that depends on all of
+// them to check the results.
+struct FanOutJob:
+    JobQueue::Job
+{
+    JobQueue *jq=nullptr;
+    std::vector<int32_t> values;
+    std::shared_ptr<JobQueue::Job> check_job;
+
+    void ThreadExecute() override;
+};
+
+struct CheckJob:
+    JobQueue::Job
+{
+    const std::vector<int32_t> *values=nullptr;
+    std::atomic<bool> *good=nullptr;
+
+    void ThreadExecute() override {
+        bool ok=true;
+
+        for(int32_t value:*this->values) {
+            if(value!=1) {
+                ok=false;
+            }
+        }
+
+        this->good->store(ok,std::memory_order_release);
+    }
+};
+
+void FanOutJob::ThreadExecute() {
+    std::vector<std::shared_ptr<JobQueue::Job>> sub_jobs;
+
+    for(size_t i=0;i<this->values.size();i+=100) {
+        auto job=std::make_shared<IncrementJob>();
+
+        job->values=&this->values;
+        job->begin=i;
+        job->end=std::min(i+100,this->values.size());
+
+        sub_jobs.push_back(job);
+    }
+
+    this->jq->AddJob(this->check_job,sub_jobs);
+
+    for(const std::shared_ptr<JobQueue::Job> &job:sub_jobs) {
+        this->jq->AddJob(job);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void WaitForJob(const std::shared_ptr<JobQueue::Job> &job) {
+    while(!job->IsFinished()) {
+        SleepMS(1);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 int main(void) {
     setbuf(stdout,nullptr);
     
@@ -108,4 +212,79 @@ int main(void) {
 
         printf("all done...\n");
     }
+
+    // Interactive jobs jump the queue, and canceled jobs are dropped.
+    {
+        JobQueue jq;
+
+        TEST_TRUE(jq.Init(1));
+
+        auto &&blocker=std::make_shared<BlockJob>();
+        jq.AddJob(blocker);
+
+        while(!blocker->IsRunning()) {
+            SleepMS(1);
+        }
+
+        std::string order;
+        std::vector<std::shared_ptr<OrderJob>> jobs;
+        const char NAMES[]="abcDEfG";
+
+        for(size_t i=0;NAMES[i]!=0;++i) {
+            auto job=std::make_shared<OrderJob>();
+
+            job->order=&order;
+            job->name=NAMES[i];
+            if(job->name>='A'&&job->name<='Z') {
+                job->priority=JobPriority_Interactive;
+            }
+
+            jobs.push_back(job);
+            jq.AddJob(job);
+        }
+
+        jobs[1]->Cancel();//b
+        jobs[4]->Cancel();//E
+
+        // Dropped straight away, without waiting to reach the front.
+        TEST_TRUE(jobs[1]->IsFinished());
+        TEST_TRUE(jobs[4]->IsFinished());
+        TEST_EQ_UU(jq.GetJobs().size(),1+jobs.size()-2);
+
+        blocker->Cancel();
+
+        for(const std::shared_ptr<OrderJob> &job:jobs) {
+            WaitForJob(job);
+        }
+
+        printf("order: %s\n",order.c_str());
+        TEST_EQ_SS(order,"DGacf");
+    }
+
+    // Fan out, with dependencies, across several threads.
+    {
+        JobQueue jq;
+
+        TEST_TRUE(jq.Init(4));
+
+        std::atomic<bool> good{false};
+
+        auto fan_out_job=std::make_shared<FanOutJob>();
+        fan_out_job->jq=&jq;
+        fan_out_job->values.resize(10000);
+
+        auto check_job=std::make_shared<CheckJob>();
+        check_job->values=&fan_out_job->values;
+        check_job->good=&good;
+        fan_out_job->check_job=check_job;
+
+        jq.AddJob(fan_out_job);
+
+        WaitForJob(fan_out_job);
+        WaitForJob(check_job);
+
+        TEST_TRUE(good.load(std::memory_order_acquire));
+
+        printf("fan out done...\n");
+    }
 }
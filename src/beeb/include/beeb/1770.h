@@ -11,6 +11,7 @@
 struct DiscDrive;
 class DiscInterface;
 class Trace;
+class SHA1;
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -50,9 +51,11 @@ public:
 
     virtual bool IsWriteProtected()=0;
 
-    // These always operate on the current track.
-    virtual bool GetByte(uint8_t *value,uint8_t sector,size_t offset)=0;
-    virtual bool SetByte(uint8_t track,size_t offset,uint8_t value)=0;
+    // These always operate on the current track. The WD1770 buffers one
+    // sector at a time, and reads or writes the first SIZE bytes of the
+    // sector in one go.
+    virtual bool ReadSector(uint8_t *buf,uint8_t sector,size_t size)=0;
+    virtual bool WriteSector(uint8_t sector,const uint8_t *buf,size_t size)=0;
     virtual bool GetSectorDetails(uint8_t *track,uint8_t *side,size_t *size,uint8_t sector,bool double_density)=0;
 protected:
     WD1770Handler(const WD1770Handler &)=default;
@@ -62,12 +65,6 @@ protected:
 private:
 };
 
-//////////////////////////////////////////////////////////////////////////
-//////////////////////////////////////////////////////////////////////////
-
-#if WD1770_DUMP_WRITTEN_SECTOR||WD1770_DUMP_READ_SECTOR||BBCMICRO_TRACE
-#define WD1770_SAVE_SECTOR_DATA 1
-#endif
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -165,6 +162,16 @@ public:
 
     void Set1772(bool is1772);
     void SetNoINTRQ(bool no_intrq);
+
+    // In turbo mode, the mechanical and rotational delays - spin up, step,
+    // settle, head load, waiting for a sector that isn't there - take
+    // only a few microseconds. Data is still transferred one byte per DRQ
+    // at the usual rate, so the ROM's NMI handler sees the same protocol.
+    void SetTurbo(bool turbo);
+    bool IsTurbo() const;
+
+    // Feed the state to HASHER. See BBCMicro::UpdateHash.
+    void UpdateHash(SHA1 *hasher) const;
 protected:
 private:
     WD1770Handler *m_handler=nullptr;
@@ -172,6 +179,7 @@ private:
     //
     bool m_no_intrq=false;
     bool m_is1772=false;
+    bool m_turbo=false;
 
     // The drive the FDC is operating on. 
     //struct DiscDrive *m_drive=nullptr;
@@ -197,9 +205,8 @@ private:
     WD1770State m_next_state=WD1770State_BeginIdle;
     int m_state_time=0;
 
-#if WD1770_SAVE_SECTOR_DATA
+    // The sector being read or written.
     uint8_t m_sector_data[1024]={};
-#endif
 
 #if BBCMICRO_TRACE
     Trace *m_trace=nullptr;
@@ -223,9 +230,12 @@ private:
     void DoTypeIII(WD1770State state);
     void DoTypeIV();
     void Wait(int us,WD1770State next_state);
+    void WaitMechanical(int us,WD1770State next_state);
+    int GetMechanicalDelay(int us) const;
     void DoTypeIIOrTypeIIIDelay(WD1770State next_state);
     int DoTypeIIFindSector();
     void DoTypeIINextByte(WD1770State next_byte_state,WD1770State next_sector_state);
+    void FlushWrittenSector(size_t size);
     void UpdateTrack0Status();
 };
 
@@ -8,6 +8,8 @@
 #include "6502.h"
 #include "Trace.h"
 
+class SHA1;
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
@@ -170,6 +172,22 @@ public:
     void UpdatePhi2TrailingEdge();
     bool AnyIRQs() const;
 
+    // Number of upcoming 1 MHz ticks (trailing edge+leading edge
+    // updates) for which nothing will happen besides the timers
+    // counting - no port or control line activity, no timeouts, so no
+    // change to IFR or the IRQ output. Assumes nothing outside the VIA
+    // touches it in the meantime.
+    //
+    // Call immediately after UpdatePhi2LeadingEdge.
+    uint32_t GetNumIdleTicks() const;
+
+    // Equivalent to NUM_TICKS calls to UpdatePhi2TrailingEdge and
+    // UpdatePhi2LeadingEdge, if NUM_TICKS<=GetNumIdleTicks().
+    void SkipIdleTicks(uint32_t num_ticks);
+
+    // Feed the state to HASHER. See BBCMicro::UpdateHash.
+    void UpdateHash(SHA1 *hasher) const;
+
 #if BBCMICRO_TRACE
     void SetTrace(Trace *t);
 #endif
@@ -212,6 +230,7 @@ private:
     uint8_t m_id=0;
     const char *m_name=nullptr;
 
+    static bool IsPortIdle(const Port *port,uint8_t pcr_bits);
     void TickControlPhi2TrailingEdge(Port *port,
                                      uint8_t latching,
                                      uint8_t pcr_bits,
@@ -229,6 +248,7 @@ private:
 CHECK_SIZEOF(R6522::PCR,1);
 CHECK_SIZEOF(R6522::ACR,1);
 CHECK_SIZEOF(R6522::IRQ,1);
+CHECK_SIZEOF(R6522::Port,9);
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
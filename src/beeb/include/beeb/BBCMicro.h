@@ -16,8 +16,10 @@ class TraceEventType;
 class DiscImage;
 class BeebLinkHandler;
 class BeebLink;
+class SHA1;
 
 #include <array>
+#include <map>
 #include <memory>
 #include <vector>
 #include "conf.h"
@@ -35,6 +37,8 @@ class BeebLink;
 #include "keys.h"
 #include "video.h"
 #include "type.h"
+#include "SubsystemProfiler.h"
+#include "CycleProfiler.h"
 
 #include <shared/enum_decl.h>
 #include "BBCMicro.inl"
@@ -154,6 +158,14 @@ public:
 
     std::unique_ptr<BBCMicro> Clone() const;
 
+#if BBCMICRO_DEBUGGER
+    // Create a copy for the debugger to look at. Unlike Clone, this
+    // includes the debug state, and excludes the disc images, so the
+    // clone impediments don't apply. The copy is only for inspection -
+    // don't run it.
+    std::unique_ptr<BBCMicro> CloneForDebugger() const;
+#endif
+
     typedef std::array<uint8_t,16384> ROMData;
 
 #if BBCMICRO_TRACE
@@ -231,6 +243,16 @@ public:
 #endif
     };
 
+    // The fully resolved paging for one ROMSEL/ACCCON combination.
+    // pc_mem_big_pages points into mem_big_pages, so these don't move
+    // once created.
+    struct Paging {
+        MemoryBigPages mem_big_pages[2]={};
+        const MemoryBigPages *pc_mem_big_pages[16]={};
+        bool io=false;
+        bool crt_shadow=false;
+    };
+
     typedef uint8_t (*ReadMMIOFn)(void *,M6502Word);
     //struct ReadMMIO {
     //    ReadMMIOFn fn;
@@ -290,6 +312,21 @@ public:
     // GetTypeInfo(m)->ram_size.
     const uint8_t *GetRAM() const;
 
+    // Feed the emulated state to HASHER, for caching things that are
+    // derived from it, such as thumbnails. Equal hashes mean the display
+    // will look the same for the next few frames at least. Everything
+    // that goes in is a value, never a pointer or padding, so the hash is
+    // the same from one run to the next.
+    //
+    // The sound, RTC and 1MHz bus state is left out. It could only
+    // affect the display indirectly, by way of the CPU, and none of it
+    // can change by itself. The disc state can - a sector can arrive at
+    // any time - so the FDC, the drives and the disc contents go in.
+    //
+    // Returns false if a disc image has no hash (see DiscImage::GetHash),
+    // in which case the hash is no use.
+    bool UpdateHash(SHA1 *hasher) const;
+
     // Set key state. If the key is Break, handle the reset line
     // appropriately.
     //
@@ -303,7 +340,58 @@ public:
     void SetTeletextDebug(bool teletext_debug);
 #endif
 
-    bool Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit);
+    // Result is a combination of BBCMicroUpdateResultFlag.
+    uint32_t Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit);
+
+    // When video output is disabled, the video hardware still runs as
+    // normal, so the emulated state is exactly as it would be otherwise,
+    // but Update leaves the VideoDataUnit untouched and doesn't report a
+    // video unit. This is for fast forwarding, when the output would be
+    // thrown away anyway - the caller has nothing to store or convert.
+    //
+    // If preview_interval is non-zero, one field in every
+    // preview_interval fields is generated as normal regardless. Each
+    // preview field starts at vsync, so the output is always whole
+    // fields.
+    //
+    // The video output setting isn't part of the emulated state, and
+    // isn't copied by Clone.
+    void SetVideoEnabled(bool enabled,uint32_t preview_interval);
+    bool IsVideoEnabled() const;
+
+    // When profiling is enabled, Update attributes the host time it
+    // takes, and the number of calls it makes, to each part of the
+    // system, and counts the instructions executed at each address - see
+    // SubsystemProfiler.h. Update takes a separate path while profiling,
+    // so it costs nothing when disabled.
+    //
+    // Enabling profiling when it's already enabled leaves the results as
+    // they are. Use GetProfiler()->Reset() to start again.
+    //
+    // The profiler isn't part of the emulated state, and isn't copied by
+    // Clone.
+    void SetProfiling(bool profiling);
+    bool IsProfiling() const;
+
+    // nullptr if profiling is disabled.
+    SubsystemProfiler *GetProfiler();
+    const SubsystemProfiler *GetProfiler() const;
+
+#if BBCMICRO_DEBUGGER
+    // When cycle profiling is enabled, each CPU cycle is attributed to the
+    // instruction being executed, taking paging into account - see
+    // CycleProfiler.h. This uses the same slower data bus handler as the
+    // instruction and write callbacks, so it costs nothing when disabled.
+    //
+    // Like the profiler, the cycle profiler isn't part of the emulated
+    // state, and isn't copied by Clone.
+    void SetCycleProfiling(bool cycle_profiling);
+    bool IsCycleProfiling() const;
+
+    // nullptr if cycle profiling is disabled.
+    CycleProfiler *GetCycleProfiler();
+    const CycleProfiler *GetCycleProfiler() const;
+#endif
 
 #if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
     // The disc drive sounds are used by all BBCMicro objects created
@@ -364,6 +452,12 @@ public:
     // false.
     bool GetAndResetDiscAccessFlag();
 
+    // Turbo disc mode skips the disc drive's mechanical delays. See
+    // WD1770::SetTurbo. The setting is part of the emulated state, so it
+    // gets saved and cloned along with everything else.
+    void SetTurboDisc(bool turbo_disc);
+    bool GetTurboDisc() const;
+
     static const char PASTE_START_CHAR;
 
     bool IsPasting() const;
@@ -383,6 +477,8 @@ public:
     const VideoULA *DebugGetVideoULA() const;
     AddressableLatch DebugGetAddressableLatch() const;
     const R6522 *DebugGetSystemVIA() const;
+    // Call on a CloneForDebugger copy only - the user VIA may otherwise
+    // be behind.
     const R6522 *DebugGetUserVIA() const;
     const SN76489 *DebugGetSN76489() const;
     const MC146818 *DebugGetRTC() const;
@@ -522,6 +618,14 @@ private:
 
         R6522 user_via;
 
+        // While the user VIA is idle (see R6522::GetNumIdleTicks), its
+        // edge updates are skipped, then caught up all at once when the
+        // CPU accesses it or its idle period ends.
+        // user_via_num_idle_edges is the number skipped so far, out of a
+        // maximum of user_via_max_num_idle_edges.
+        uint32_t user_via_num_idle_edges=0;
+        uint32_t user_via_max_num_idle_edges=0;
+
         ROMSEL romsel={};
         ACCCON acccon={};
 
@@ -620,9 +724,12 @@ private:
     bool m_has_rtc=false;
     void (*m_handle_cpu_data_bus_fn)(BBCMicro *)=nullptr;
 
-    // Memory
-    MemoryBigPages m_mem_big_pages[2]={};
-    const MemoryBigPages *m_pc_mem_big_pages[16];
+    // Memory. Each Paging is built the first time its ROMSEL/ACCCON
+    // combination is used, so switching is then just a lookup. The cache
+    // is cleared by InitPaging, when the ROMs or sideways RAM change.
+    // m_pc_mem_big_pages points to the current Paging's pc_mem_big_pages.
+    std::map<uint16_t,Paging> m_paging_cache;
+    const MemoryBigPages *const *m_pc_mem_big_pages=nullptr;
 
     // [0] is for page FC, [1] for FD and [2] for FE.
     //
@@ -676,6 +783,21 @@ private:
     // influence.
     bool m_disc_access=false;
 
+    // Video output control - see SetVideoEnabled. m_video_output is the
+    // setting for the current field.
+    bool m_video_enabled=true;
+    bool m_video_output=true;
+    uint32_t m_video_preview_interval=0;
+    uint32_t m_video_preview_counter=0;
+
+    // See SetProfiling.
+    std::unique_ptr<SubsystemProfiler> m_profiler;
+
+#if BBCMICRO_DEBUGGER
+    // See SetCycleProfiling.
+    std::unique_ptr<CycleProfiler> m_cycle_profiler;
+#endif
+
 #if VIDEO_TRACK_METADATA
     // This doesn't need to be copied. If it becomes stale, it'll be
     // refreshed within 1 cycle...
@@ -711,11 +833,18 @@ private:
     BeebLinkHandler *m_beeblink_handler=nullptr;
     std::unique_ptr<BeebLink> m_beeblink;
 
+    // Whether the user VIA's idle periods may be skipped. Not when
+    // something else is watching it or driving its pins.
+    bool m_skip_idle_user_via=false;
+
+    BBCMicro(const BBCMicro &src,bool clone_disc_images);
+
     void InitStuff();
 #if BBCMICRO_TRACE
     void SetTrace(std::shared_ptr<Trace> trace,uint32_t trace_flags);
 #endif
     void UpdatePaging();
+    void InitPagingCacheEntry(Paging *paging,ROMSEL romsel,ACCCON acccon);
     void InitPaging();
     static void Write1770ControlRegister(void *m_,M6502Word a,uint8_t value);
     static uint8_t Read1770ControlRegister(void *m_,M6502Word a);
@@ -752,8 +881,8 @@ private:
     void SpinUp() override;
     void SpinDown() override;
     bool IsWriteProtected() override;
-    bool GetByte(uint8_t *value,uint8_t sector,size_t offset) override;
-    bool SetByte(uint8_t sector,size_t offset,uint8_t value) override;
+    bool ReadSector(uint8_t *buf,uint8_t sector,size_t size) override;
+    bool WriteSector(uint8_t sector,const uint8_t *buf,size_t size) override;
     bool GetSectorDetails(uint8_t *track,uint8_t *side,size_t *size,uint8_t sector,bool double_density) override;
     DiscDrive *GetDiscDrive();
 #if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
@@ -762,6 +891,10 @@ private:
     float UpdateDiscDriveSound(DiscDrive *dd);
 #endif
     void UpdateCPUDataBusFn();
+    void UpdateSkipIdleUserVIA();
+    void CatchUpUserVIA();
+    template<bool PROFILING>
+    uint32_t UpdateTemplated(VideoDataUnit *video_unit,SoundDataUnit *sound_unit);
 };
 
 //////////////////////////////////////////////////////////////////////////
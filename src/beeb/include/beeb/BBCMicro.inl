@@ -41,6 +41,22 @@ EEND()
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+#define ENAME BBCMicroUpdateResultFlag
+EBEGIN()
+// The SoundDataUnit was filled in.
+EPNV(AudioUnit,1<<0)
+
+// The VideoDataUnit was filled in. Always set when video output is enabled.
+EPNV(VideoUnit,1<<1)
+
+// The CRTC's vsync output went active this cycle.
+EPNV(VSync,1<<2)
+EEND()
+#undef ENAME
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #define ENAME BBCMicroPasteState
 EBEGIN()
 // No pasting. Hack flags paste bit must be reset.
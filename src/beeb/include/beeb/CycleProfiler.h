@@ -0,0 +1,111 @@
+#ifndef HEADER_F25478F7932A4EA3B7A1937793AE171C// -*- mode:c++ -*-
+#define HEADER_F25478F7932A4EA3B7A1937793AE171C
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Guest code profiler - see BBCMicro::SetCycleProfiling.
+//
+// Every emulated CPU cycle, including any cycles the CPU spends stretched
+// for a 1 MHz bus access, is attributed to the instruction being
+// executed. Instructions are identified by big page and offset, so each
+// sideways ROM, the shadow RAM, and so on, gets its own 64K-style
+// histogram - see the notes in type.h.
+//
+// An interrupt's 7-cycle entry sequence is attributed to the instruction
+// it interrupted.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#include <shared/system.h>
+#include "conf.h"
+#include "type.h"
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+struct CycleProfilerCounts {
+    uint64_t num_cycles=0;
+    uint64_t num_instructions=0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class CycleProfiler {
+public:
+    // Entries per big page. Index into the counts with big page
+    // index*NUM_BIG_PAGE_COUNTS+offset.
+    static const size_t NUM_BIG_PAGE_COUNTS=4096;
+
+    CycleProfiler();
+
+    CycleProfiler(const CycleProfiler &)=delete;
+    CycleProfiler &operator=(const CycleProfiler &)=delete;
+    CycleProfiler(CycleProfiler &&)=delete;
+    CycleProfiler &operator=(CycleProfiler &&)=delete;
+
+    void Reset();
+
+    // NUM_BIG_PAGES*NUM_BIG_PAGE_COUNTS entries.
+    const std::vector<CycleProfilerCounts> &GetCounts() const;
+
+    uint64_t GetNumCycles() const;
+    uint64_t GetNumInstructions() const;
+
+    // Called by the BBCMicro data bus handler each time the CPU accesses
+    // memory, with the location of the current instruction's opcode and
+    // the current cycle count. The cycles since the previous call go to
+    // that instruction. If instruction is true, the access is the opcode
+    // fetch.
+    void Update(uint8_t big_page_index,uint16_t offset,uint64_t num_2MHz_cycles,bool instruction) {
+        uint64_t num_cycles=num_2MHz_cycles-m_last_2MHz_cycles;
+
+        // A stretched access takes at most 3 cycles. Anything else is
+        // the first call after a reset.
+        if(num_cycles>MAX_NUM_CYCLES_PER_ACCESS) {
+            num_cycles=1;
+        }
+
+        m_last_2MHz_cycles=num_2MHz_cycles;
+
+        CycleProfilerCounts *counts=&m_counts_data[(size_t)big_page_index*NUM_BIG_PAGE_COUNTS+offset];
+        counts->num_cycles+=num_cycles;
+        m_num_cycles+=num_cycles;
+
+        if(instruction) {
+            ++counts->num_instructions;
+            ++m_num_instructions;
+        }
+    }
+protected:
+private:
+    static const uint64_t MAX_NUM_CYCLES_PER_ACCESS=3;
+
+    std::vector<CycleProfilerCounts> m_counts;
+    CycleProfilerCounts *m_counts_data=nullptr;
+    uint64_t m_num_cycles=0;
+    uint64_t m_num_instructions=0;
+    uint64_t m_last_2MHz_cycles=0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Callgrind format profile data, suitable for KCachegrind or
+// callgrind_annotate. Each big page with any cycles is a file, split into
+// one function per 256 bytes, and costs are per instruction address.
+// There's no call graph.
+//
+// counts is as returned by CycleProfiler::GetCounts. type supplies the
+// names and addresses of the big pages.
+std::string GetCycleProfileCallgrind(const std::vector<CycleProfilerCounts> &counts,
+                                     const BBCMicroType *type);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -7,7 +7,6 @@
 #include <memory>
 #include <string>
 
-class FileDialog;
 class Messages;
 
 //////////////////////////////////////////////////////////////////////////
@@ -76,10 +75,10 @@ public:
 
     virtual std::string GetDescription() const=0;
 
-    // Adds file dialog filter suitable for selecting files of
-    // whatever type of disc image this image was loaded from. Use
-    // this to populate a save dialog when saving a copy.
-    virtual void AddFileDialogFilter(FileDialog *fd) const=0;
+    // Extension, including the '.', for files of whatever type of
+    // disc image this image was loaded from, or nullptr if there isn't
+    // one. Use this to populate a save dialog when saving a copy.
+    virtual const char *GetFileExtension() const=0;
 
     // Save a copy of this disc image to the given file. If
     // successful, returns a clone with the new name and whatever load
@@ -90,6 +89,13 @@ public:
     virtual bool Read(uint8_t *value,uint8_t side,uint8_t track,uint8_t sector,size_t offset) const=0;
     virtual bool Write(uint8_t side,uint8_t track,uint8_t sector,size_t offset,uint8_t value)=0;
 
+    // Read or write the first SIZE bytes of a sector in one go. SIZE
+    // mustn't be larger than the sector size.
+    //
+    // Default impls do it a byte at a time with Read or Write.
+    virtual bool ReadSector(uint8_t *buf,size_t size,uint8_t side,uint8_t track,uint8_t sector) const;
+    virtual bool WriteSector(uint8_t side,uint8_t track,uint8_t sector,const uint8_t *buf,size_t size);
+
     virtual bool GetDiscSectorSize(size_t *size,uint8_t side,uint8_t track,uint8_t sector,bool double_density) const=0;
     virtual bool IsWriteProtected() const=0;
 protected:
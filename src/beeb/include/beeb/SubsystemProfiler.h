@@ -0,0 +1,190 @@
+#ifndef HEADER_31B0EED198A844CBBE2F58C9BF4264DC// -*- mode:c++ -*-
+#define HEADER_31B0EED198A844CBBE2F58C9BF4264DC
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Host time profiler for BBCMicro::Update - see BBCMicro::SetProfiling.
+//
+// Update tells the profiler each time it moves on to a different part
+// of the system, so all the host time spent in Update is attributed to
+// one subsystem or another. Reading the clock costs more than a lot of
+// the subsystem updates do, so only 1 cycle in every sample_interval is
+// timed, and the totals are estimated from those. The number of calls
+// into each subsystem is counted every cycle.
+//
+// The cost of the profiler's own clock reads is measured when it's
+// created, and subtracted from each timed section. Even so, the
+// numbers are only a guide: Update is slower with the profiler, and
+// the host's caches and branch predictors see a different picture.
+//
+// The profiler also counts the instructions executed at each address,
+// as the CPU sees it - paging isn't taken into account.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#include <shared/system.h>
+#include <string>
+#include <vector>
+
+#include <shared/enum_decl.h>
+#include "SubsystemProfiler.inl"
+#include <shared/enum_end.h>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Pages FC-FE.
+static constexpr size_t SUBSYSTEM_PROFILER_NUM_MMIO_ADDRESSES=768;
+
+struct SubsystemProfilerCounts {
+    uint64_t num_calls=0;
+
+    // Calls made during timed cycles, and the host ticks they took.
+    uint64_t num_sampled_calls=0;
+    uint64_t num_sampled_ticks=0;
+
+    // Estimate of the total host ticks taken by all the calls.
+    double GetEstimatedTicks() const;
+};
+
+struct SubsystemProfile {
+    uint32_t sample_interval=0;
+
+    // Estimated cost of each clock read, in host ticks.
+    uint64_t overhead_ticks=0;
+
+    uint64_t num_cycles=0;
+    uint64_t num_sampled_cycles=0;
+
+    SubsystemProfilerCounts subsystems[BBCMicroSubsystem_Count];
+
+    // Index is address-0xfc00.
+    SubsystemProfilerCounts mmio[SUBSYSTEM_PROFILER_NUM_MMIO_ADDRESSES];
+
+    // Index is the address of the opcode. 65536 entries.
+    std::vector<uint64_t> num_executions;
+};
+
+// One timed part of a sampled cycle.
+struct SubsystemProfilerEvent {
+    uint64_t cycle=0;
+    uint64_t begin_ticks=0;
+    uint32_t num_ticks=0;
+    BBCMicroSubsystem subsystem=BBCMicroSubsystem_Other;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class SubsystemProfiler {
+public:
+    static const uint32_t DEFAULT_SAMPLE_INTERVAL=7;
+
+    // The most recent events are kept, up to this many.
+    static const size_t MAX_NUM_EVENTS=1<<17;
+
+    // The sample interval should be odd, so that the timed cycles don't
+    // always fall on the same phase of the 1 MHz bus or the sound
+    // clock. An even interval is rounded up.
+    explicit SubsystemProfiler(uint32_t sample_interval=DEFAULT_SAMPLE_INTERVAL);
+
+    SubsystemProfiler(const SubsystemProfiler &)=delete;
+    SubsystemProfiler &operator=(const SubsystemProfiler &)=delete;
+    SubsystemProfiler(SubsystemProfiler &&)=delete;
+    SubsystemProfiler &operator=(SubsystemProfiler &&)=delete;
+
+    void Reset();
+
+    const SubsystemProfile &GetProfile() const;
+
+    // Oldest first.
+    void GetEvents(std::vector<SubsystemProfilerEvent> *events) const;
+
+    // Called by BBCMicro::Update. Each cycle is BeginCycle, any number of
+    // Enter/EnterMMIO/AddExecution calls, then EndCycle. Until the first
+    // Enter, time goes to BBCMicroSubsystem_Other.
+    void BeginCycle(uint64_t cycle) {
+        ++m_profile.num_cycles;
+        m_current=BBCMicroSubsystem_Other;
+
+        if(--m_sample_countdown==0) {
+            m_sample_countdown=m_profile.sample_interval;
+            m_sampling=true;
+            m_cycle=cycle;
+            ++m_profile.num_sampled_cycles;
+            m_last_ticks=GetCurrentTickCount();
+        } else {
+            m_sampling=false;
+        }
+    }
+
+    void Enter(BBCMicroSubsystem subsystem) {
+        this->Count(&m_profile.subsystems[subsystem]);
+        m_current=subsystem;
+    }
+
+    void EnterMMIO(uint16_t addr) {
+        this->Enter(BBCMicroSubsystem_MMIO);
+
+        m_mmio=&m_profile.mmio[addr-0xfc00u];
+        ++m_mmio->num_calls;
+        if(m_sampling) {
+            ++m_mmio->num_sampled_calls;
+        }
+    }
+
+    void AddExecution(uint16_t addr) {
+        ++m_num_executions[addr];
+    }
+
+    void EndCycle() {
+        if(m_sampling) {
+            this->Flush();
+        }
+    }
+protected:
+private:
+    SubsystemProfile m_profile;
+    uint64_t *m_num_executions=nullptr;
+
+    std::vector<SubsystemProfilerEvent> m_events;
+    size_t m_event_index=0;
+    bool m_events_wrapped=false;
+
+    uint32_t m_sample_countdown=1;
+    bool m_sampling=false;
+    uint64_t m_cycle=0;
+    uint64_t m_last_ticks=0;
+    BBCMicroSubsystem m_current=BBCMicroSubsystem_Other;
+    SubsystemProfilerCounts *m_mmio=nullptr;
+
+    void Count(SubsystemProfilerCounts *counts) {
+        ++counts->num_calls;
+
+        if(m_sampling) {
+            ++counts->num_sampled_calls;
+            this->Flush();
+        }
+    }
+
+    void Flush();
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Totals per subsystem, per MMIO address and per instruction address.
+// Addresses with no calls or executions are left out.
+std::string GetSubsystemProfileJSON(const SubsystemProfile &profile);
+
+// Chrome trace event format JSON, suitable for chrome://tracing or
+// Perfetto. Each sampled cycle is one slice, with its subsystems
+// inside it.
+std::string GetSubsystemProfilerEventsChromeTrace(const std::vector<SubsystemProfilerEvent> &events);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,41 @@
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#define ENAME BBCMicroSubsystem
+EBEGIN()
+// 6502 emulation.
+EPN(CPU)
+
+// Data bus accesses to RAM and ROM.
+EPN(Memory)
+
+// Data bus accesses to pages FC-FE, via the MMIO handlers.
+EPN(MMIO)
+
+// Data bus accesses while the hacks handler is in use - instruction and
+// write callbacks, pasting, tracing, debugger stepping and async calls.
+// The access itself is included.
+EPN(Hooks)
+
+EPN(CRTC)
+EPN(VideoULA)
+EPN(SAA5050)
+EPN(SystemVIA)
+EPN(UserVIA)
+EPN(Keyboard)
+EPN(BeebLink)
+EPN(RTC)
+EPN(1770)
+EPN(SN76489)
+EPN(DiscDriveSound)
+
+// Everything else: the glue between the subsystems, display output
+// flags, the addressable latch, IRQ lines, and so on.
+EPN(Other)
+
+EQPN(Count)
+EEND()
+#undef ENAME
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -59,6 +59,24 @@ public:
 
     void CopyTexturePixels(void *dest_pixels,size_t dest_pitch) const;
 
+    // Copy rows [begin_y,end_y) of the texture. dest_pixels points to where
+    // row begin_y should go. The markers are only drawn when copying the full
+    // texture - but GetDirtyRows always returns the full range when any are
+    // visible.
+    void CopyTexturePixels(void *dest_pixels,size_t dest_pitch,size_t begin_y,size_t end_y) const;
+
+    // Get range of texture rows that have changed since the last
+    // ClearDirtyRows call. Returns false if nothing has changed.
+    //
+    // (A scanline is only considered changed if its pixel values differ
+    // from what was there before, so a static display stays clean.)
+    bool GetDirtyRows(size_t *begin_y,size_t *end_y) const;
+    void ClearDirtyRows();
+
+    // Mark the whole texture as changed, e.g., because the destination
+    // has been recreated.
+    void SetAllRowsDirty();
+
 #if VIDEO_TRACK_METADATA
     const VideoDataUnit *GetTextureUnits() const;
 #endif
@@ -96,6 +114,13 @@ private:
 #endif
     uint64_t m_texture_data_version=1;
 
+    // Dirty row tracking. m_line_changed accumulates differences between
+    // old and new pixel values for the scanline in progress.
+    uint32_t m_line_changed=0;
+    size_t m_dirty_begin_y=0;
+    size_t m_dirty_end_y=0;
+    bool m_markers_were_shown=false;
+
 #if TRACK_VIDEO_LATENCY
     uint64_t render_latency_ticks;
     size_t num_renders;
@@ -119,6 +144,8 @@ private:
 
     uint32_t GetTexelValue(uint8_t r,uint8_t g,uint8_t b) const;
     void InitPalette();
+    void FlushLineChanged();
+    bool AreMarkersShown() const;
 #if VIDEO_TRACK_METADATA
     void AddMetadataMarkers(void *dest_pixels,size_t dest_pitch_bytes,bool add,uint8_t metadata_flag,uint32_t xor_value) const;
 #endif
@@ -9,6 +9,7 @@
 union VideoDataUnitPixels;
 union M6502Word;
 class Trace;
+class SHA1;
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -60,6 +61,9 @@ public:
 
     void EmitPixels(VideoDataUnitPixels *pixels);
 
+    // Feed the state to HASHER. See BBCMicro::UpdateHash.
+    void UpdateHash(SHA1 *hasher) const;
+
 #if BBCMICRO_TRACE
     void SetTrace(Trace *t);
 #endif
@@ -84,13 +88,20 @@ private:
     uint8_t m_blanking_counter=0;
     NuLAAttributeMode m_attribute_mode={};
     PixelBuffer m_pixel_buffer={};
+
+    // Pixels for each possible value of m_work_byte, for the standard
+    // (non-attribute) modes, as a function of the current palette and line
+    // width. Rebuilt on demand when m_byte_pixels_dirty is set.
+    bool m_byte_pixels_dirty=true;
+    VideoDataUnitPixels m_byte_pixels[256]={};
 #if BBCMICRO_TRACE
     Trace *m_trace=nullptr;
 #endif
 
     void ResetNuLAState();
     VideoDataPixel GetPalette(uint8_t index);
-    VideoDataPixel Shift();
+    void UpdateBytePixels();
+    void EmitBytePixels(VideoDataUnitPixels *pixels,uint8_t num_shifts);
     VideoDataPixel ShiftAttributeMode0();
     VideoDataPixel ShiftAttributeMode1();
     VideoDataPixel ShiftAttributeText();
@@ -8,6 +8,7 @@
 #include "6502.h"
 
 class Trace;
+class SHA1;
 
 #include <shared/enum_decl.h>
 #include "crtc.inl"
@@ -45,6 +46,9 @@ public:
 
     Output Update();
 
+    // Feed the state to HASHER. See BBCMicro::UpdateHash.
+    void UpdateHash(SHA1 *hasher) const;
+
 #if BBCMICRO_TRACE
     void SetTrace(Trace *t,
                   bool trace_scanlines,
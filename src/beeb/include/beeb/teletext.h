@@ -10,6 +10,8 @@ union VideoDataUnitPixels;
 
 #include "video.h"
 
+class SHA1;
+
 #include <shared/enum_decl.h>
 #include "teletext.inl"
 #include <shared/enum_end.h>
@@ -31,6 +33,9 @@ public:
 
     void VSync();
 
+    // Feed the state to HASHER. See BBCMicro::UpdateHash.
+    void UpdateHash(SHA1 *hasher) const;
+
 #if BBCMICRO_DEBUGGER
     bool IsDebug() const;
     void SetDebug(bool debug);
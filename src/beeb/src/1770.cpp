@@ -7,6 +7,7 @@
 #include <ctype.h>
 #include <beeb/DiscInterface.h>
 #include <beeb/Trace.h>
+#include <shared/sha1.h>
 
 #include <shared/enum_def.h>
 #include <beeb/1770.inl>
@@ -69,6 +70,9 @@ static const int uS_PER_BYTE=64;
 // Assuming 300rpm.
 #define INDEX_PULSES_uS(N) ((N)*200000)
 
+// Length of any mechanical or rotational delay in turbo mode.
+static const int TURBO_DELAY_uS=4;
+
 static const uint8_t STEP_IN=0;
 static const uint8_t STEP_OUT=1;
 
@@ -239,7 +243,7 @@ void WD1770::SetINTRQ(bool value) {
 void WD1770::DoSpinUp(int h,WD1770State state) {
     if(h==0&&!m_status.bits.motor_on) {
         this->SpinUp();
-        m_wait_us=INDEX_PULSES_uS(6);
+        m_wait_us=this->GetMechanicalDelay(INDEX_PULSES_uS(6));
         this->SetState(WD1770State_WaitForSpinUp);
         m_next_state=state;
         m_status.bits.deleted_or_spinup=0;
@@ -321,6 +325,18 @@ void WD1770::DoTypeIV() {
         m_command.bits_iv._);
 
     if(m_status.bits.busy) {
+#if WD1770_ENABLE_WRITE
+        // (WriteSectorWriteByte is possible too, for the 1 cycle after
+        // the wait ends and before the byte is written.)
+        if(m_state==WD1770State_WriteSectorNextByte||
+           m_state==WD1770State_WriteSectorWriteByte||
+           (m_state==WD1770State_Wait&&m_next_state==WD1770State_WriteSectorWriteByte))
+        {
+            // Whatever got written before the interruption is on the disc.
+            this->FlushWrittenSector(m_offset);
+        }
+#endif
+
         m_status.bits.busy=0;
         this->SetState(WD1770State_BeginIdle);
     } else {
@@ -329,7 +345,7 @@ void WD1770::DoTypeIV() {
         } else if(m_command.bits_iv.index) {
             // "Used by Superior Collection *INIT command", says my
             // comments from model-b...
-            m_wait_us=INDEX_PULSES_uS(1);
+            m_wait_us=this->GetMechanicalDelay(INDEX_PULSES_uS(1));
             this->SetState(WD1770State_Wait);
             m_next_state=WD1770State_ForceInterrupt;
         } else if((m_command.value&0x0f)==0) {
@@ -510,15 +526,32 @@ void WD1770::Wait(int us,WD1770State next_state) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Wait for the drive, rather than for the data.
+void WD1770::WaitMechanical(int us,WD1770State next_state) {
+    this->Wait(this->GetMechanicalDelay(us),next_state);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int WD1770::GetMechanicalDelay(int us) const {
+    if(m_turbo) {
+        return TURBO_DELAY_uS;
+    } else {
+        return us;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 // If the command's E bit is set, delay 30ms and go to next_state.
 // Otherwise, go to next_state immediately.
 void WD1770::DoTypeIIOrTypeIIIDelay(WD1770State next_state) {
-#if WD1770_SAVE_SECTOR_DATA
     memset(m_sector_data,0,sizeof m_sector_data);
-#endif
 
     if(m_command.bits_ii.e) {
-        this->Wait(30000,next_state);
+        this->WaitMechanical(30000,next_state);
     } else {
         m_state=next_state;
     }
@@ -542,18 +575,16 @@ int WD1770::DoTypeIIFindSector() {
         goto rnf;
     }
 
-#if WD1770_SAVE_SECTOR_DATA
     if(m_sector_size>sizeof m_sector_data) {
         goto rnf;
     }
-#endif
 
     m_status.bits.deleted_or_spinup=0;//not deleted data
 
     return 1;
 
 rnf:
-    this->Wait(INDEX_PULSES_uS(6),WD1770State_RecordNotFound);
+    this->WaitMechanical(INDEX_PULSES_uS(6),WD1770State_RecordNotFound);
     return 0;
 }
 
@@ -606,6 +637,26 @@ void WD1770::DoTypeIINextByte(WD1770State next_byte_state,WD1770State next_secto
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+#if WD1770_ENABLE_WRITE
+// Write out the first SIZE bytes of the sector buffer.
+void WD1770::FlushWrittenSector(size_t size) {
+    if(size==0) {
+        return;
+    }
+
+    if(!m_handler->WriteSector(m_sector,m_sector_data,size)) {
+        m_status.bits.lost_or_track0=1;
+
+#if WD1770_VERBOSE_WRITE_SECTOR
+        LOGF(1770nd,"(WriteSector failed.)\n");
+#endif
+    }
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void WD1770::UpdateTrack0Status() {
     m_status.bits.lost_or_track0=m_handler->IsTrack0();
 }
@@ -768,7 +819,7 @@ WD1770::Pins WD1770::Update() {
             }
 
             int step_rate_us=this->GetStepRate(m_command.bits_i.r);
-            this->Wait(step_rate_us,m_next_state);
+            this->WaitMechanical(step_rate_us,m_next_state);
         }
         break;
 
@@ -806,7 +857,7 @@ WD1770::Pins WD1770::Update() {
             this->UpdateTrack0Status();
 
             if(m_command.bits_i.v) {
-                this->Wait(SETTLE_uS_1770,WD1770State_FinishCommand);
+                this->WaitMechanical(SETTLE_uS_1770,WD1770State_FinishCommand);
             } else {
                 m_state=WD1770State_FinishCommand;
             }
@@ -877,11 +928,16 @@ WD1770::Pins WD1770::Update() {
             //    break;
             //}
 
-            if(!m_handler->GetByte(&m_data,m_sector,m_offset)) {
-                this->SetState(WD1770State_RecordNotFound);
-                break;
+            if(m_offset==0) {
+                if(!m_handler->ReadSector(m_sector_data,m_sector,m_sector_size)) {
+                    this->SetState(WD1770State_RecordNotFound);
+                    break;
+                }
             }
 
+            ASSERT(m_offset<sizeof m_sector_data);
+            m_data=m_sector_data[m_offset];
+
 #if WD1770_VERBOSE_READ_SECTOR
             LOGF(1770nd,"T%02u S%02u +%03zu (0x%02zx): %d 0x%x",m_track,m_sector,m_offset,m_offset,m_data,m_data);
             if(isprint(m_data)) {
@@ -909,11 +965,6 @@ WD1770::Pins WD1770::Update() {
                 m_status.bits.lost_or_track0=1;
             }
 
-#if WD1770_SAVE_SECTOR_DATA
-            ASSERT(m_offset<sizeof m_sector_data);
-            m_sector_data[m_offset]=m_data;
-#endif
-
             this->SetDRQ(1);
 
             this->Wait(uS_PER_BYTE,WD1770State_ReadSectorNextByte);
@@ -989,18 +1040,11 @@ WD1770::Pins WD1770::Update() {
             }
 #endif
 
-#if WD1770_SAVE_SECTOR_DATA
             ASSERT(m_offset<sizeof m_sector_data);
             m_sector_data[m_offset]=value;
-#endif
-
-            if(!m_handler->SetByte(m_sector,m_offset,value)) {
-                value=0;
-                m_status.bits.lost_or_track0=1;
 
-#if WD1770_VERBOSE_WRITE_SECTOR
-                LOGF(1770nd,"(DiscDrive_SetByte failed.)\n");
-#endif
+            if(m_offset+1==m_sector_size) {
+                this->FlushWrittenSector(m_sector_size);
             }
 
             this->DoTypeIINextByte(WD1770State_WriteSectorNextByte,WD1770State_WriteSectorFindSector);
@@ -1142,3 +1186,47 @@ void WD1770::SetNoINTRQ(bool no_intrq) {
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
+
+void WD1770::SetTurbo(bool turbo) {
+    m_turbo=turbo;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool WD1770::IsTurbo() const {
+    return m_turbo;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void WD1770::UpdateHash(SHA1 *hasher) const {
+    int64_t values[]={
+        m_no_intrq,
+        m_is1772,
+        m_turbo,
+        m_status.value,
+        m_command.value,
+        m_track,
+        m_sector,
+        m_data,
+        m_dden,
+        m_pins.value,
+        m_direction,
+        m_restore_count,
+        (int64_t)m_offset,
+        (int64_t)m_sector_size,
+        m_wait_us,
+        m_state,
+        m_next_state,
+        m_state_time,
+    };
+    hasher->Update(values,sizeof values);
+
+    hasher->Update(m_address,sizeof m_address);
+    hasher->Update(m_sector_data,sizeof m_sector_data);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
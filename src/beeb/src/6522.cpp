@@ -4,6 +4,7 @@
 #include <beeb/6522.h>
 #include <string.h>
 #include <beeb/Trace.h>
+#include <shared/sha1.h>
 
 #include <shared/enum_def.h>
 #include <beeb/6522.inl>
@@ -613,6 +614,164 @@ void R6522::UpdatePhi2TrailingEdge() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Upper limit for GetNumIdleTicks, when no timer is pending. Arbitrary,
+// but keeps the edge counts in BBCMicro well inside 32 bits.
+static const uint32_t MAX_NUM_IDLE_TICKS=1<<20;
+
+uint32_t R6522::GetNumIdleTicks() const {
+    if(!IsPortIdle(&this->a,m_pcr.value>>0)) {
+        return 0;
+    }
+
+    if(!IsPortIdle(&this->b,m_pcr.value>>4)) {
+        return 0;
+    }
+
+    if(m_acr.bits.t2_count_pb6) {
+        // PB6 isn't changing, so there'll be no more pulses - but there
+        // might be one being counted right now.
+        if(m_t2_count||m_old_pb!=this->b.p) {
+            return 0;
+        }
+    } else {
+        ASSERT(m_t2_count);
+    }
+
+    uint32_t n=MAX_NUM_IDLE_TICKS;
+
+    // Stop short of the tick on which a pending timer would time out.
+    if(m_t1_pending) {
+        uint32_t t1n;
+        if(m_t1_reload) {
+            t1n=1u+(uint32_t)(m_t1ll|m_t1lh<<8);
+        } else {
+            t1n=m_t1;
+        }
+
+        if(t1n<n) {
+            n=t1n;
+        }
+    }
+
+    if(m_t2_pending&&m_t2_count) {
+        uint32_t t2n;
+        if(m_t2_reload) {
+            t2n=1u+(uint32_t)(m_t2ll|m_t2lh<<8);
+        } else {
+            t2n=m_t2;
+        }
+
+        if(t2n<n) {
+            n=t2n;
+        }
+    }
+
+    return n;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void R6522::SkipIdleTicks(uint32_t num_ticks) {
+    if(num_ticks==0) {
+        return;
+    }
+
+    // The ports and control lines are idle, so only the timers need
+    // updating.
+
+    /* T1 */
+    {
+        uint32_t n=num_ticks;
+
+        if(m_t1_reload) {
+            m_t1=m_t1ll|m_t1lh<<8;
+            m_t1_reload=false;
+            --n;
+        }
+
+        if(n<=m_t1) {
+            m_t1-=n;
+        } else {
+            // T1 isn't pending, so it free runs - reaching $ffff,
+            // reloading on the next tick, then counting down from the
+            // latch value again, every latch+2 ticks.
+            ASSERT(!m_t1_pending);
+            n-=m_t1+1u;
+            n%=(uint32_t)(m_t1ll|m_t1lh<<8)+2u;
+
+            if(n==0) {
+                m_t1=0xffff;
+                m_t1_reload=true;
+            } else {
+                m_t1=(uint16_t)((m_t1ll|m_t1lh<<8)-(n-1));
+            }
+        }
+
+        m_t1_timeout=false;
+    }
+
+    /* T2 */
+    {
+        uint32_t n=num_ticks;
+
+        if(m_t2_reload) {
+            m_t2=m_t2ll|m_t2lh<<8;
+            m_t2_reload=false;
+            --n;
+        }
+
+        if(m_t2_count) {
+            ASSERT(!m_t2_pending||n<=m_t2);
+            m_t2=(uint16_t)(m_t2-n);
+        }
+
+        m_t2_timeout=false;
+    }
+
+    if(m_acr.bits.t2_count_pb6) {
+        ASSERT(!m_t2_count);
+        ASSERT(m_old_pb==this->b.p);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void R6522::UpdateHash(SHA1 *hasher) const {
+    // Port is all uint8_t, so there's no padding.
+    hasher->Update(&this->a,sizeof this->a);
+    hasher->Update(&this->b,sizeof this->b);
+
+    uint16_t values[]={
+        this->ifr.value,
+        this->ier.value,
+        m_t1ll,
+        m_t1lh,
+        m_t2ll,
+        m_t2lh,
+        m_sr,
+        m_acr.value,
+        m_pcr.value,
+        m_t1,
+        m_t1_reload,
+        m_t1_pending,
+        m_t1_timeout,
+        m_t2,
+        m_t2_reload,
+        m_t2_pending,
+        m_t2_timeout,
+        m_t2_count,
+        m_t1_pb7,
+        m_old_pb,
+        m_id,
+    };
+    hasher->Update(values,sizeof values);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_TRACE
 void R6522::SetTrace(Trace *trace) {
     m_trace=trace;
@@ -622,6 +781,55 @@ void R6522::SetTrace(Trace *trace) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// True if TickControlPhi2TrailingEdge would leave the port unchanged, and
+// would continue to do so for as long as nothing changes it from outside.
+bool R6522::IsPortIdle(const Port *port,uint8_t pcr_bits) {
+    if(port->c1!=1||port->old_c1!=1) {
+        return false;
+    }
+
+    if(port->c2!=port->old_c2) {
+        return false;
+    }
+
+    switch((R6522Cx2Control)((pcr_bits>>1)&7)) {
+        case R6522Cx2Control_Input_IndIRQNegEdge:
+        case R6522Cx2Control_Input_NegEdge:
+        case R6522Cx2Control_Input_IndIRQPosEdge:
+        case R6522Cx2Control_Input_PosEdge:
+        case R6522Cx2Control_Output_High:
+            if(port->c2!=1) {
+                return false;
+            }
+            break;
+
+        case R6522Cx2Control_Output_Low:
+            if(port->c2!=0) {
+                return false;
+            }
+            break;
+
+        case R6522Cx2Control_Output_Pulse:
+            if(port->pulse>0) {
+                return false;
+            }
+            break;
+
+        case R6522Cx2Control_Output_Handshake:
+            // Cx1 is 1, so Cx2 won't change.
+            break;
+    }
+
+    if(port->p!=(uint8_t)(~port->ddr|(port->or_&port->ddr))) {
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void R6522::TickControlPhi2TrailingEdge(Port *port,
                                         uint8_t latching,
                                         uint8_t pcr_bits,
@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <inttypes.h>
 #include <beeb/BeebLink.h>
+#include <shared/sha1.h>
 
 #include <shared/enum_decl.h>
 #include "BBCMicro_private.inl"
@@ -144,17 +145,27 @@ m_beeblink_handler(beeblink_handler)
 //////////////////////////////////////////////////////////////////////////
 
 BBCMicro::BBCMicro(const BBCMicro &src):
+BBCMicro(src,true)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+BBCMicro::BBCMicro(const BBCMicro &src,bool clone_disc_images):
 m_state(src.m_state),
 m_type(src.m_type),
 m_disc_interface(src.m_disc_interface?src.m_disc_interface->Clone():nullptr),
 m_video_nula(src.m_video_nula),
 m_ext_mem(src.m_ext_mem)
 {
-    ASSERT(src.GetCloneImpediments()==0);
+    if(clone_disc_images) {
+        ASSERT(src.GetCloneImpediments()==0);
 
-    for(int i=0;i<NUM_DRIVES;++i) {
-        std::shared_ptr<DiscImage> disc_image=DiscImage::Clone(src.GetDiscImage(i));
-        this->SetDiscImage(i,std::move(disc_image));
+        for(int i=0;i<NUM_DRIVES;++i) {
+            std::shared_ptr<DiscImage> disc_image=DiscImage::Clone(src.GetDiscImage(i));
+            this->SetDiscImage(i,std::move(disc_image));
+        }
     }
 
     this->InitStuff();
@@ -206,6 +217,33 @@ std::unique_ptr<BBCMicro> BBCMicro::Clone() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+#if BBCMICRO_DEBUGGER
+std::unique_ptr<BBCMicro> BBCMicro::CloneForDebugger() const {
+    std::unique_ptr<BBCMicro> copy(new BBCMicro(*this,false));
+
+    if(m_debug) {
+        auto debug=std::make_unique<DebugState>(*m_debug);
+
+        // These point into this BBCMicro's debug state, and the copy
+        // won't be running anyway.
+        debug->temp_execute_breakpoints.clear();
+
+        copy->SetDebugState(std::move(debug));
+    }
+
+    // The debugger looks at the VIA state directly, so it needs to be up
+    // to date.
+    if(copy->m_state.user_via_max_num_idle_edges>0) {
+        copy->CatchUpUserVIA();
+    }
+
+    return copy;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_TRACE
 void BBCMicro::SetTrace(std::shared_ptr<Trace> trace,uint32_t trace_flags) {
     m_trace_ptr=std::move(trace);
@@ -224,6 +262,7 @@ void BBCMicro::SetTrace(std::shared_ptr<Trace> trace,uint32_t trace_flags) {
                           !!(trace_flags&BBCMicroTraceFlag_6845ScanlinesSeparators));
     m_state.system_via.SetTrace(trace_flags&BBCMicroTraceFlag_SystemVIA?m_trace:nullptr);
     m_state.user_via.SetTrace(trace_flags&BBCMicroTraceFlag_UserVIA?m_trace:nullptr);
+    this->UpdateSkipIdleUserVIA();
     m_state.video_ula.SetTrace(trace_flags&BBCMicroTraceFlag_VideoULA?m_trace:nullptr);
     m_state.sn76489.SetTrace(trace_flags&BBCMicroTraceFlag_SN76489?m_trace:nullptr);
 
@@ -239,41 +278,25 @@ void BBCMicro::SetTrace(std::shared_ptr<Trace> trace,uint32_t trace_flags) {
 //////////////////////////////////////////////////////////////////////////
 
 void BBCMicro::UpdatePaging() {
-    MemoryBigPageTables tables;
-    bool io;
-    bool crt_shadow;
-    (*m_type->get_mem_big_page_tables_fn)(&tables,
-                                          &io,
-                                          &crt_shadow,
-                                          m_state.romsel,
-                                          m_state.acccon);
-
-    for(size_t i=0;i<2;++i) {
-        MemoryBigPages *mbp=&m_mem_big_pages[i];
+    uint16_t key=(uint16_t)(m_state.romsel.value|m_state.acccon.value<<8);
 
-        for(size_t j=0;j<16;++j) {
-            const BigPage *bp=&m_big_pages[tables.mem_big_pages[i][j]];
-
-            mbp->w[j]=bp->w;
-            mbp->r[j]=bp->r;
-#if BBCMICRO_DEBUGGER
-            mbp->debug[j]=bp->debug;
-            mbp->bp[j]=bp;
-#endif
-        }
+    auto it=m_paging_cache.find(key);
+    if(it==m_paging_cache.end()) {
+        it=m_paging_cache.emplace(key,Paging()).first;
+        this->InitPagingCacheEntry(&it->second,m_state.romsel,m_state.acccon);
     }
 
-    for(size_t i=0;i<16;++i) {
-        ASSERT(tables.pc_mem_big_pages_set[i]==0||tables.pc_mem_big_pages_set[i]==1);
-        m_pc_mem_big_pages[i]=&m_mem_big_pages[tables.pc_mem_big_pages_set[i]];
-    }
+    const Paging *paging=&it->second;
+
+    m_pc_mem_big_pages=paging->pc_mem_big_pages;
 
-    if(crt_shadow) {
+    if(paging->crt_shadow) {
         m_state.shadow_select_mask=0x8000;
     } else {
         m_state.shadow_select_mask=0;
     }
 
+    bool io=paging->io;
     if(io!=m_rom_mmio) {
         if(io) {
             for(int i=0;i<3;++i) {
@@ -296,6 +319,38 @@ void BBCMicro::UpdatePaging() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+void BBCMicro::InitPagingCacheEntry(Paging *paging,ROMSEL romsel,ACCCON acccon) {
+    MemoryBigPageTables tables;
+    (*m_type->get_mem_big_page_tables_fn)(&tables,
+                                          &paging->io,
+                                          &paging->crt_shadow,
+                                          romsel,
+                                          acccon);
+
+    for(size_t i=0;i<2;++i) {
+        MemoryBigPages *mbp=&paging->mem_big_pages[i];
+
+        for(size_t j=0;j<16;++j) {
+            const BigPage *bp=&m_big_pages[tables.mem_big_pages[i][j]];
+
+            mbp->w[j]=bp->w;
+            mbp->r[j]=bp->r;
+#if BBCMICRO_DEBUGGER
+            mbp->debug[j]=bp->debug;
+            mbp->bp[j]=bp;
+#endif
+        }
+    }
+
+    for(size_t i=0;i<16;++i) {
+        ASSERT(tables.pc_mem_big_pages_set[i]==0||tables.pc_mem_big_pages_set[i]==1);
+        paging->pc_mem_big_pages[i]=&paging->mem_big_pages[tables.pc_mem_big_pages_set[i]];
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void BBCMicro::InitPaging() {
     for(BigPage &bp:m_big_pages) {
         bp={};
@@ -349,6 +404,9 @@ void BBCMicro::InitPaging() {
         bp->index=i;
     }
 
+    // The big pages have changed, so the cached paging is stale.
+    m_paging_cache.clear();
+
 #if BBCMICRO_DEBUGGER
     this->UpdateDebugState();
 #endif
@@ -599,6 +657,136 @@ const uint8_t *BBCMicro::GetRAM() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool BBCMicro::UpdateHash(SHA1 *hasher) const {
+    const M6502 *cpu=&m_state.cpu;
+
+    uint64_t values[]={
+        (uint64_t)m_type->type_id,
+        m_video_nula,
+        m_state.num_2MHz_cycles,
+        m_state.last_vsync_2MHz_cycles,
+        m_state.last_frame_2MHz_cycles,
+
+        cpu->abus.w,
+        cpu->read,
+        cpu->dbus,
+        cpu->irq_flags,
+        cpu->nmi_flags,
+        cpu->device_irq_flags,
+        cpu->device_nmi_flags,
+        cpu->pc.w,
+        cpu->s.w,
+        cpu->ad.w,
+        cpu->ia.w,
+        cpu->opcode_pc.w,
+        cpu->a,
+        cpu->x,
+        cpu->y,
+        cpu->p.value,
+        cpu->opcode,
+        cpu->data,
+        m_state.stretch,
+        m_state.resetting,
+
+        m_state.romsel.value,
+        m_state.acccon.value,
+        m_state.addressable_latch.value,
+        m_state.old_addressable_latch.value,
+        m_state.old_system_via_pb.value,
+        m_state.ic15_byte,
+        m_state.shadow_select_mask,
+        m_state.cursor_pattern,
+        m_state.key_scan_column,
+        (uint64_t)m_state.num_keys_down,
+        m_state.user_via_num_idle_edges,
+        m_state.user_via_max_num_idle_edges,
+        m_state.hack_flags,
+
+        (uint64_t)m_state.paste_state,
+        m_state.paste_index,
+        m_state.paste_wait_end,
+    };
+    hasher->Update(values,sizeof values);
+
+    hasher->Update(m_state.key_columns,sizeof m_state.key_columns);
+
+    if(!!m_state.paste_text) {
+        hasher->Update(m_state.paste_text->data(),m_state.paste_text->size());
+    }
+
+    m_state.crtc.UpdateHash(hasher);
+    m_state.video_ula.UpdateHash(hasher);
+    m_state.saa5050.UpdateHash(hasher);
+    m_state.system_via.UpdateHash(hasher);
+    m_state.user_via.UpdateHash(hasher);
+
+    // This includes any shadow RAM.
+    hasher->Update(m_state.ram_buffer.data(),m_state.ram_buffer.size());
+
+    // Each ROM slot is marked as empty, ROM or RAM, so that moving the
+    // contents from one slot to another changes the hash.
+    if(!!m_state.os_buffer) {
+        hasher->Update(m_state.os_buffer->data(),m_state.os_buffer->size());
+    }
+
+    for(int i=0;i<16;++i) {
+        uint8_t kind;
+        if(!!m_state.sideways_rom_buffers[i]) {
+            kind=1;
+            hasher->Update(&kind,1);
+            hasher->Update(m_state.sideways_rom_buffers[i]->data(),m_state.sideways_rom_buffers[i]->size());
+        } else if(!m_state.sideways_ram_buffers[i].empty()) {
+            kind=2;
+            hasher->Update(&kind,1);
+            hasher->Update(m_state.sideways_ram_buffers[i].data(),m_state.sideways_ram_buffers[i].size());
+        } else {
+            kind=0;
+            hasher->Update(&kind,1);
+        }
+    }
+
+    if(m_disc_interface) {
+        m_state.fdc.UpdateHash(hasher);
+
+        int64_t control_values[]={
+            m_state.disc_control.drive,
+            m_state.disc_control.dden,
+            m_state.disc_control.side,
+            m_state.disc_control.reset,
+        };
+        hasher->Update(control_values,sizeof control_values);
+
+        for(int i=0;i<NUM_DRIVES;++i) {
+            const DiscDrive *dd=&m_state.drives[i];
+            const std::shared_ptr<DiscImage> &disc_image=m_disc_images[i];
+
+            uint8_t drive_values[]={
+                dd->motor,
+                dd->track,
+                !!disc_image,
+            };
+            hasher->Update(drive_values,sizeof drive_values);
+
+            if(!!disc_image) {
+                std::string hash=disc_image->GetHash();
+                if(hash.empty()) {
+                    return false;
+                }
+
+                hasher->Update(hash.data(),hash.size());
+
+                uint8_t write_protected=disc_image->IsWriteProtected();
+                hasher->Update(&write_protected,1);
+            }
+        }
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool BBCMicro::SetKeyState(BeebKey key,bool new_state) {
     ASSERT(key>=0&&(int)key<128);
 
@@ -790,6 +978,19 @@ void BBCMicro::HandleCPUDataBusWithShadowRAMDebug(BBCMicro *m) {
 
 void BBCMicro::HandleCPUDataBusWithHacks(BBCMicro *m) {
 #if BBCMICRO_DEBUGGER
+    if(m->m_cycle_profiler) {
+        // The big page the current opcode was fetched from - as
+        // DebugGetBigPageForAddress would find, but without rebuilding
+        // the paging tables.
+        M6502Word opcode_pc=m->m_state.cpu.opcode_pc;
+        const BigPage *bp=m->m_pc_mem_big_pages[opcode_pc.p.p]->bp[opcode_pc.p.p];
+
+        m->m_cycle_profiler->Update(bp->index,
+                                    opcode_pc.p.o,
+                                    m->m_state.num_2MHz_cycles,
+                                    M6502_IsAboutToExecute(&m->m_state.cpu));
+    }
+
     if(m->m_state.async_call_address.w!=INVALID_ASYNC_CALL_ADDRESS) {
         if(m->m_state.cpu.read==M6502ReadType_Interrupt&&M6502_IsProbablyIRQ(&m->m_state.cpu)) {
             TRACEF(m->m_trace,"Enqueuing async call: address=$%04x, A=%03u ($%02x) X=%03u ($%02x) Y=%03u ($%02X) C=%s\n",
@@ -1159,27 +1360,55 @@ uint16_t BBCMicro::DebugGetBeebAddressFromCRTCAddress(uint8_t h,uint8_t l) const
 // 1. Delay the trailing edge for 1 x 2 MHz cycle. The trailing edges of both
 // clocks then line up.
 //
-bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
+uint32_t BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
+    if(m_profiler) {
+        return this->UpdateTemplated<true>(video_unit,sound_unit);
+    } else {
+        return this->UpdateTemplated<false>(video_unit,sound_unit);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// When PROFILING is true, m_profiler is non-null, and gets told each time
+// the update moves on to a different subsystem.
+template<bool PROFILING>
+uint32_t BBCMicro::UpdateTemplated(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
+    SubsystemProfiler *profiler=m_profiler.get();
+    if(PROFILING) {
+        profiler->BeginCycle(m_state.num_2MHz_cycles);
+    }
+
     uint8_t phi2_1MHz_trailing_edge=m_state.num_2MHz_cycles&1;
-    bool sound=false;
+    uint32_t result=0;
+
+    // Any change due to vsync takes effect from the next cycle, so the
+    // unit with the vsync flag set is always output if the field before
+    // it was.
+    bool video=m_video_output;
 
 #if VIDEO_TRACK_METADATA
-    video_unit->metadata.flags=0;
+    if(video) {
+        video_unit->metadata.flags=0;
 
-    if(phi2_1MHz_trailing_edge) {
-        video_unit->metadata.flags|=VideoDataUnitMetadataFlag_OddCycle;
+        if(phi2_1MHz_trailing_edge) {
+            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_OddCycle;
+        }
     }
 #endif
 
     // Update CPU.
+    if(PROFILING) {
+        profiler->Enter(BBCMicroSubsystem_CPU);
+    }
 
-    // Update CPU.
     if(m_state.stretch) {
         if(phi2_1MHz_trailing_edge) {
             m_state.stretch=false;
         }
     } else {
-        (*m_state.cpu.tfn)(&m_state.cpu);
+        M6502_Step(&m_state.cpu);
 
         uint8_t mmio_page=m_state.cpu.abus.b.h-0xfc;
         if(mmio_page<3) {
@@ -1192,11 +1421,39 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
     }
 
     if(!m_state.stretch) {
+        if(m_state.user_via_max_num_idle_edges>0) {
+            if((m_state.cpu.abus.w&0xffe0)==0xfe60) {
+                if(PROFILING) {
+                    profiler->Enter(BBCMicroSubsystem_UserVIA);
+                }
+
+                this->CatchUpUserVIA();
+            }
+        }
+
+        if(PROFILING) {
+            if(M6502_IsAboutToExecute(&m_state.cpu)) {
+                profiler->AddExecution(m_state.cpu.abus.w);
+            }
+
+            if(m_handle_cpu_data_bus_fn==&HandleCPUDataBusWithHacks) {
+                profiler->Enter(BBCMicroSubsystem_Hooks);
+            } else if((uint8_t)(m_state.cpu.abus.b.h-0xfc)<3) {
+                profiler->EnterMMIO(m_state.cpu.abus.w);
+            } else {
+                profiler->Enter(BBCMicroSubsystem_Memory);
+            }
+        }
+
         (*m_handle_cpu_data_bus_fn)(this);
     }
 
     // Update video hardware.
     if(m_state.video_ula.control.bits.fast_6845|phi2_1MHz_trailing_edge) {
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_CRTC);
+        }
+
         CRTC::Output output=m_state.crtc.Update();
 
         m_state.cursor_pattern>>=1;
@@ -1226,6 +1483,10 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
 
         // Teletext update.
         if(phi2_1MHz_trailing_edge) {
+            if(PROFILING) {
+                profiler->Enter(BBCMicroSubsystem_SAA5050);
+            }
+
             if(output.vsync) {
                 if(!m_state.crtc_last_output.vsync) {
                     m_state.last_frame_2MHz_cycles=m_state.num_2MHz_cycles-m_state.last_vsync_2MHz_cycles;
@@ -1277,12 +1538,18 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
             }
 
 #if VIDEO_TRACK_METADATA
-            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_HasValue;
-            video_unit->metadata.value=m_state.ic15_byte;
+            if(video) {
+                video_unit->metadata.flags|=VideoDataUnitMetadataFlag_HasValue;
+                video_unit->metadata.value=m_state.ic15_byte;
+            }
 #endif
         }
 
         if(!m_state.video_ula.control.bits.teletext) {
+            if(PROFILING) {
+                profiler->Enter(BBCMicroSubsystem_VideoULA);
+            }
+
             if(!m_state.crtc_last_output.display) {
                 m_state.video_ula.DisplayEnabled();
             }
@@ -1291,83 +1558,160 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
             m_state.video_ula.Byte(value);
 
 #if VIDEO_TRACK_METADATA
-            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_HasValue;
-            video_unit->metadata.value=value;
+            if(video) {
+                video_unit->metadata.flags|=VideoDataUnitMetadataFlag_HasValue;
+                video_unit->metadata.value=value;
+            }
 #endif
         }
 
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_Other);
+        }
+
         if(output.cudisp) {
             m_state.cursor_pattern=CURSOR_PATTERNS[m_state.video_ula.control.bits.cursor];
         }
 
 #if VIDEO_TRACK_METADATA
-        // TODO - can't remember why this is stored off like this...
-        m_last_video_access_address=addr;
+        if(video) {
+            // TODO - can't remember why this is stored off like this...
+            m_last_video_access_address=addr;
 
-        video_unit->metadata.flags|=VideoDataUnitMetadataFlag_HasAddress;
-        video_unit->metadata.address=m_last_video_access_address;
+            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_HasAddress;
+            video_unit->metadata.address=m_last_video_access_address;
+        }
 #endif
 
+        if(!m_video_enabled) {
+            if(output.vsync&&!m_state.crtc_last_output.vsync) {
+                if(m_video_preview_interval>0&&
+                   ++m_video_preview_counter>=m_video_preview_interval)
+                {
+                    m_video_preview_counter=0;
+                    m_video_output=true;
+                } else {
+                    m_video_output=false;
+                }
+            }
+        }
+
+        if(output.vsync&&!m_state.crtc_last_output.vsync) {
+            result|=BBCMicroUpdateResultFlag_VSync;
+        }
+
         m_state.crtc_last_output=output;
     }
 
     // Update display output.
+    //
+    // With video output off, the pixels are still generated, as that's
+    // what advances the Video ULA and SAA5050 - only the output is
+    // discarded. The emulated state is then the same either way. The
+    // cursor and the blank areas only affect the output, so they're
+    // skipped.
+    VideoDataUnitPixels discarded_pixels;
+    VideoDataUnitPixels *pixels=video?&video_unit->pixels:&discarded_pixels;
+
     //if(m_state.crtc_last_output.display) {
 #if VIDEO_TRACK_METADATA
-    if(m_state.crtc_last_output.raster==0) {
-        video_unit->metadata.flags|=VideoDataUnitMetadataFlag_6845Raster0;
-    }
+    if(video) {
+        if(m_state.crtc_last_output.raster==0) {
+            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_6845Raster0;
+        }
 
-    if(m_state.crtc_last_output.display) {
-        video_unit->metadata.flags|=VideoDataUnitMetadataFlag_6845DISPEN;
-    }
+        if(m_state.crtc_last_output.display) {
+            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_6845DISPEN;
+        }
 
-    if(m_state.crtc_last_output.cudisp) {
-        video_unit->metadata.flags|=VideoDataUnitMetadataFlag_6845CUDISP;
+        if(m_state.crtc_last_output.cudisp) {
+            video_unit->metadata.flags|=VideoDataUnitMetadataFlag_6845CUDISP;
+        }
     }
 #endif
 
     if(m_state.video_ula.control.bits.teletext) {
-        m_state.saa5050.EmitPixels(&video_unit->pixels);
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_SAA5050);
+        }
+
+        m_state.saa5050.EmitPixels(pixels);
 
-        if(m_state.cursor_pattern&1) {
-            video_unit->pixels.pixels[0].all^=0x0fff;
-            video_unit->pixels.pixels[1].all^=0x0fff;
+        if(video) {
+            if(m_state.cursor_pattern&1) {
+                pixels->pixels[0].all^=0x0fff;
+                pixels->pixels[1].all^=0x0fff;
+            }
         }
     } else {
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_VideoULA);
+        }
+
         if(m_state.crtc_last_output.display&&
            m_state.crtc_last_output.raster<8)
         {
-            m_state.video_ula.EmitPixels(&video_unit->pixels);
+            m_state.video_ula.EmitPixels(pixels);
 
-            if(m_state.cursor_pattern&1) {
-                video_unit->pixels.values[0]^=0x0fff0fff0fff0fffull;
-                video_unit->pixels.values[1]^=0x0fff0fff0fff0fffull;
+            if(video) {
+                if(m_state.cursor_pattern&1) {
+                    pixels->values[0]^=0x0fff0fff0fff0fffull;
+                    pixels->values[1]^=0x0fff0fff0fff0fffull;
+                }
             }
-        } else {
+        } else if(video) {
             if(m_state.cursor_pattern&1) {
-                video_unit->pixels.values[1]=video_unit->pixels.values[0]=0x0fff0fff0fff0fffull;
+                pixels->values[1]=pixels->values[0]=0x0fff0fff0fff0fffull;
             } else {
-                video_unit->pixels.values[1]=video_unit->pixels.values[0]=0;
+                pixels->values[1]=pixels->values[0]=0;
             }
         }
     }
 
-    video_unit->pixels.pixels[1].bits.x=0;
-
-    if(m_state.crtc_last_output.hsync) {
-        video_unit->pixels.pixels[1].bits.x|=VideoDataUnitFlag_HSync;
+    if(PROFILING) {
+        profiler->Enter(BBCMicroSubsystem_Other);
     }
 
-    if(m_state.crtc_last_output.vsync) {
-        video_unit->pixels.pixels[1].bits.x|=VideoDataUnitFlag_VSync;
+    if(video) {
+        video_unit->pixels.pixels[1].bits.x=0;
+
+        if(m_state.crtc_last_output.hsync) {
+            video_unit->pixels.pixels[1].bits.x|=VideoDataUnitFlag_HSync;
+        }
+
+        if(m_state.crtc_last_output.vsync) {
+            video_unit->pixels.pixels[1].bits.x|=VideoDataUnitFlag_VSync;
+        }
+
+        result|=BBCMicroUpdateResultFlag_VideoUnit;
     }
 
     // Update VIAs and slow data bus.
     if(phi2_1MHz_trailing_edge) {
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_SystemVIA);
+        }
+
         // Update IRQs.
         m_state.system_via.UpdatePhi2TrailingEdge();
-        m_state.user_via.UpdatePhi2TrailingEdge();
+
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_UserVIA);
+        }
+
+        if(m_state.user_via_num_idle_edges<m_state.user_via_max_num_idle_edges) {
+            ++m_state.user_via_num_idle_edges;
+        } else {
+            if(m_state.user_via_max_num_idle_edges>0) {
+                this->CatchUpUserVIA();
+            }
+
+            m_state.user_via.UpdatePhi2TrailingEdge();
+        }
+
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_Keyboard);
+        }
 
         // Update vsync.
         if(!m_state.crtc_last_output.vsync) {
@@ -1407,12 +1751,20 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
 
         if(m_beeblink_handler) {
             // Update BeebLink.
+            if(PROFILING) {
+                profiler->Enter(BBCMicroSubsystem_BeebLink);
+            }
+
             m_beeblink->Update(&m_state.user_via);
         } else {
             // Nothing connected to the user port.
         }
 
         // Update addressable latch and RTC.
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_Other);
+        }
+
         SystemVIAPB pb;
         pb.value=m_state.system_via.b.p;
 
@@ -1445,6 +1797,10 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
         }
 
         if(m_has_rtc) {
+            if(PROFILING) {
+                profiler->Enter(BBCMicroSubsystem_RTC);
+            }
+
             if(pb.m128_bits.rtc_chip_select&&
                !pb.m128_bits.rtc_address_strobe)
             {
@@ -1468,8 +1824,32 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
 
         m_state.old_addressable_latch=m_state.addressable_latch;
     } else {
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_SystemVIA);
+        }
+
         m_state.system_via.UpdatePhi2LeadingEdge();
-        m_state.user_via.UpdatePhi2LeadingEdge();
+
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_UserVIA);
+        }
+
+        if(m_state.user_via_num_idle_edges<m_state.user_via_max_num_idle_edges) {
+            ++m_state.user_via_num_idle_edges;
+        } else {
+            // Idle periods always end just before a trailing edge.
+            ASSERT(m_state.user_via_max_num_idle_edges==0);
+
+            m_state.user_via.UpdatePhi2LeadingEdge();
+
+            if(m_skip_idle_user_via) {
+                m_state.user_via_max_num_idle_edges=m_state.user_via.GetNumIdleTicks()*2;
+            }
+        }
+
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_Other);
+        }
 
         bool any_system_via_IRQs=m_state.system_via.AnyIRQs();
         bool any_user_via_IRQs=m_state.user_via.AnyIRQs();
@@ -1489,30 +1869,141 @@ bool BBCMicro::Update(VideoDataUnit *video_unit,SoundDataUnit *sound_unit) {
 
     // Update 1770.
     if(phi2_1MHz_trailing_edge) {
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_1770);
+        }
+
         M6502_SetDeviceNMI(&m_state.cpu,BBCMicroNMIDevice_1770,m_state.fdc.Update().value);
     }
 
     // Update sound.
     if((m_state.num_2MHz_cycles&((1<<SOUND_CLOCK_SHIFT)-1))==0) {
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_SN76489);
+        }
+
         sound_unit->sn_output=m_state.sn76489.Update(!m_state.addressable_latch.bits.not_sound_write,
                                                      m_state.system_via.a.p);
 
 #if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
         // The disc drive sounds are pretty quiet.
+        if(PROFILING) {
+            profiler->Enter(BBCMicroSubsystem_DiscDriveSound);
+        }
+
         sound_unit->disc_drive_sound=this->UpdateDiscDriveSound(&m_state.drives[0]);
         sound_unit->disc_drive_sound+=this->UpdateDiscDriveSound(&m_state.drives[1]);
 #endif
-        sound=true;
+        result|=BBCMicroUpdateResultFlag_AudioUnit;
+    }
+
+    if(PROFILING) {
+        profiler->EndCycle();
     }
 
     ++m_state.num_2MHz_cycles;
 
-    return sound;
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BBCMicro::SetVideoEnabled(bool enabled,uint32_t preview_interval) {
+    m_video_enabled=enabled;
+    m_video_output=enabled;
+    m_video_preview_interval=preview_interval;
+    m_video_preview_counter=0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BBCMicro::IsVideoEnabled() const {
+    return m_video_enabled;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BBCMicro::SetProfiling(bool profiling) {
+    if(profiling) {
+        if(!m_profiler) {
+            m_profiler=std::make_unique<SubsystemProfiler>();
+        }
+    } else {
+        m_profiler.reset();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BBCMicro::IsProfiling() const {
+    return !!m_profiler;
 }
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+SubsystemProfiler *BBCMicro::GetProfiler() {
+    return m_profiler.get();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+const SubsystemProfiler *BBCMicro::GetProfiler() const {
+    return m_profiler.get();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+void BBCMicro::SetCycleProfiling(bool cycle_profiling) {
+    if(cycle_profiling) {
+        if(!m_cycle_profiler) {
+            m_cycle_profiler=std::make_unique<CycleProfiler>();
+        }
+    } else {
+        m_cycle_profiler.reset();
+    }
+
+    this->UpdateCPUDataBusFn();
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+bool BBCMicro::IsCycleProfiling() const {
+    return !!m_cycle_profiler;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+CycleProfiler *BBCMicro::GetCycleProfiler() {
+    return m_cycle_profiler.get();
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if BBCMICRO_DEBUGGER
+const CycleProfiler *BBCMicro::GetCycleProfiler() const {
+    return m_cycle_profiler.get();
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_ENABLE_DISC_DRIVE_SOUND
 void BBCMicro::SetDiscDriveSound(DiscDriveType type,DiscDriveSound sound,std::vector<float> samples) {
     ASSERT(sound>=0&&sound<DiscDriveSound_EndValue);
@@ -1747,6 +2238,20 @@ bool BBCMicro::GetAndResetDiscAccessFlag() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+void BBCMicro::SetTurboDisc(bool turbo_disc) {
+    m_state.fdc.SetTurbo(turbo_disc);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool BBCMicro::GetTurboDisc() const {
+    return m_state.fdc.IsTurbo();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool BBCMicro::IsPasting() const {
     return (m_state.hack_flags&BBCMicroHackFlag_Paste)!=0;
 }
@@ -1843,6 +2348,9 @@ const R6522 *BBCMicro::DebugGetSystemVIA() const {
 
 #if BBCMICRO_DEBUGGER
 const R6522 *BBCMicro::DebugGetUserVIA() const {
+    // Only valid on a CloneForDebugger copy, which has caught up.
+    ASSERT(m_state.user_via_num_idle_edges==0);
+
     return &m_state.user_via;
 }
 #endif
@@ -2387,11 +2895,13 @@ void BBCMicro::UpdateDebugState() {
         }
     }
 
-    for(size_t i=0;i<2;++i) {
-        MemoryBigPages *mbp=&m_mem_big_pages[i];
+    for(auto &&it:m_paging_cache) {
+        for(size_t i=0;i<2;++i) {
+            MemoryBigPages *mbp=&it.second.mem_big_pages[i];
 
-        for(size_t j=0;j<16;++j) {
-            mbp->debug[j]=mbp->bp[j]?mbp->bp[j]->debug:nullptr;
+            for(size_t j=0;j<16;++j) {
+                mbp->debug[j]=mbp->bp[j]?mbp->bp[j]->debug:nullptr;
+            }
         }
     }
 
@@ -2529,6 +3039,7 @@ void BBCMicro::InitStuff() {
     }
 
     this->UpdateCPUDataBusFn();
+    this->UpdateSkipIdleUserVIA();
 
     m_romsel_mask=m_type->romsel_mask;
     m_acccon_mask=m_type->acccon_mask;
@@ -2680,16 +3191,16 @@ bool BBCMicro::IsWriteProtected() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-bool BBCMicro::GetByte(uint8_t *value,uint8_t sector,size_t offset) {
+bool BBCMicro::ReadSector(uint8_t *buf,uint8_t sector,size_t size) {
     if(DiscDrive *dd=this->GetDiscDrive()) {
         m_disc_access=true;
 
         if(m_disc_images[m_state.disc_control.drive]) {
-            if(m_disc_images[m_state.disc_control.drive]->Read(value,
-                                                               m_state.disc_control.side,
-                                                               dd->track,
-                                                               sector,
-                                                               offset))
+            if(m_disc_images[m_state.disc_control.drive]->ReadSector(buf,
+                                                                     size,
+                                                                     m_state.disc_control.side,
+                                                                     dd->track,
+                                                                     sector))
             {
                 return true;
             }
@@ -2702,16 +3213,16 @@ bool BBCMicro::GetByte(uint8_t *value,uint8_t sector,size_t offset) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-bool BBCMicro::SetByte(uint8_t sector,size_t offset,uint8_t value) {
+bool BBCMicro::WriteSector(uint8_t sector,const uint8_t *buf,size_t size) {
     if(DiscDrive *dd=this->GetDiscDrive()) {
         m_disc_access=true;
 
         if(m_disc_images[m_state.disc_control.drive]) {
-            if(m_disc_images[m_state.disc_control.drive]->Write(m_state.disc_control.side,
-                                                                dd->track,
-                                                                sector,
-                                                                offset,
-                                                                value))
+            if(m_disc_images[m_state.disc_control.drive]->WriteSector(m_state.disc_control.side,
+                                                                      dd->track,
+                                                                      sector,
+                                                                      buf,
+                                                                      size))
             {
                 return true;
             }
@@ -2920,6 +3431,12 @@ void BBCMicro::UpdateCPUDataBusFn() {
     }
 #endif
 
+#if BBCMICRO_DEBUGGER
+    if(m_cycle_profiler) {
+        goto hack;
+    }
+#endif
+
     // No hacks.
     m_handle_cpu_data_bus_fn=m_default_handle_cpu_data_bus_fn;
     return;
@@ -2930,3 +3447,46 @@ hack:;
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
+
+void BBCMicro::UpdateSkipIdleUserVIA() {
+    m_skip_idle_user_via=true;
+
+    // BeebLink drives the user port every cycle.
+    if(m_beeblink_handler) {
+        m_skip_idle_user_via=false;
+    }
+
+#if BBCMICRO_TRACE
+    // The trace should show the timer reloads as they happen.
+    if(m_trace&&(m_trace_flags&BBCMicroTraceFlag_UserVIA)) {
+        m_skip_idle_user_via=false;
+    }
+#endif
+
+    if(!m_skip_idle_user_via) {
+        if(m_state.user_via_max_num_idle_edges>0) {
+            this->CatchUpUserVIA();
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void BBCMicro::CatchUpUserVIA() {
+    uint32_t num_edges=m_state.user_via_num_idle_edges;
+
+    m_state.user_via.SkipIdleTicks(num_edges>>1);
+
+    if(num_edges&1) {
+        // Idle periods start after a leading edge, so the odd edge out is
+        // a trailing edge.
+        m_state.user_via.UpdatePhi2TrailingEdge();
+    }
+
+    m_state.user_via_num_idle_edges=0;
+    m_state.user_via_max_num_idle_edges=0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,139 @@
+#include <shared/system.h>
+#include <shared/debug.h>
+#include <beeb/CycleProfiler.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void PRINTF_LIKE(2,3) AppendF(std::string *str,const char *fmt,...) {
+    char buf[500];
+
+    va_list v;
+    va_start(v,fmt);
+    int n=vsnprintf(buf,sizeof buf,fmt,v);
+    va_end(v);
+
+    ASSERT(n>=0&&(size_t)n<sizeof buf);
+    (void)n;
+
+    str->append(buf);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+CycleProfiler::CycleProfiler():
+    m_counts((size_t)NUM_BIG_PAGES*NUM_BIG_PAGE_COUNTS)
+{
+    m_counts_data=m_counts.data();
+
+    this->Reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void CycleProfiler::Reset() {
+    for(CycleProfilerCounts &counts:m_counts) {
+        counts=CycleProfilerCounts();
+    }
+
+    m_num_cycles=0;
+    m_num_instructions=0;
+
+    // Far enough from any plausible cycle count that the first Update
+    // counts as 1 cycle.
+    m_last_2MHz_cycles=UINT64_MAX/2;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+const std::vector<CycleProfilerCounts> &CycleProfiler::GetCounts() const {
+    return m_counts;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t CycleProfiler::GetNumCycles() const {
+    return m_num_cycles;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t CycleProfiler::GetNumInstructions() const {
+    return m_num_instructions;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::string GetCycleProfileCallgrind(const std::vector<CycleProfilerCounts> &counts,
+                                     const BBCMicroType *type)
+{
+    ASSERT(counts.size()==(size_t)NUM_BIG_PAGES*CycleProfiler::NUM_BIG_PAGE_COUNTS);
+    ASSERT(type->big_pages_metadata.size()==NUM_BIG_PAGES);
+
+    std::string callgrind;
+
+    CycleProfilerCounts total;
+    for(const CycleProfilerCounts &c:counts) {
+        total.num_cycles+=c.num_cycles;
+        total.num_instructions+=c.num_instructions;
+    }
+
+    callgrind+="# callgrind format\n";
+    callgrind+="version: 1\n";
+    callgrind+="creator: b2\n";
+    AppendF(&callgrind,"cmd: %s\n",GetBBCMicroTypeIDEnumName(type->type_id));
+    callgrind+="positions: instr\n";
+    callgrind+="events: Cycles Instructions\n";
+    AppendF(&callgrind,"summary: %" PRIu64 " %" PRIu64 "\n",total.num_cycles,total.num_instructions);
+    callgrind+="\n";
+    AppendF(&callgrind,"ob=%s\n",GetBBCMicroTypeIDEnumName(type->type_id));
+
+    for(uint8_t big_page=0;big_page<NUM_BIG_PAGES;++big_page) {
+        const BigPageMetadata *metadata=&type->big_pages_metadata[big_page];
+        const CycleProfilerCounts *big_page_counts=&counts[big_page*CycleProfiler::NUM_BIG_PAGE_COUNTS];
+        bool any_fl=false;
+
+        for(size_t page=0;page<CycleProfiler::NUM_BIG_PAGE_COUNTS/256;++page) {
+            bool any_fn=false;
+
+            for(size_t offset=page*256;offset<page*256+256;++offset) {
+                const CycleProfilerCounts *c=&big_page_counts[offset];
+                if(c->num_cycles==0&&c->num_instructions==0) {
+                    continue;
+                }
+
+                // Every big page with any counts is visible on this
+                // model, so it has a proper address.
+                ASSERT(metadata->addr!=0xffff);
+                size_t addr=metadata->addr+offset;
+
+                if(!any_fl) {
+                    AppendF(&callgrind,"\nfl=%s\n",metadata->description.c_str());
+                    any_fl=true;
+                }
+
+                // Functions are named with the debugger's address syntax.
+                if(!any_fn) {
+                    AppendF(&callgrind,"fn=%c%c$%04zx\n",metadata->code,ADDRESS_PREFIX_SEPARATOR,addr&~(size_t)0xff);
+                    any_fn=true;
+                }
+
+                AppendF(&callgrind,"0x%04zx %" PRIu64 " %" PRIu64 "\n",addr,c->num_cycles,c->num_instructions);
+            }
+        }
+    }
+
+    return callgrind;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
@@ -51,6 +51,32 @@ bool DiscImage::CanSave() const {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool DiscImage::ReadSector(uint8_t *buf,size_t size,uint8_t side,uint8_t track,uint8_t sector) const {
+    for(size_t i=0;i<size;++i) {
+        if(!this->Read(&buf[i],side,track,sector,i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool DiscImage::WriteSector(uint8_t side,uint8_t track,uint8_t sector,const uint8_t *buf,size_t size) {
+    for(size_t i=0;i<size;++i) {
+        if(!this->Write(side,track,sector,i,buf[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 DiscImageSummary DiscImage::GetSummary() const {
     DiscImageSummary s;
 
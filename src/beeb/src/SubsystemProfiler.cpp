@@ -0,0 +1,277 @@
+#include <shared/system.h>
+#include <shared/debug.h>
+#include <beeb/SubsystemProfiler.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <shared/enum_def.h>
+#include <beeb/SubsystemProfiler.inl>
+#include <shared/enum_end.h>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const int NUM_CALIBRATION_CYCLES=1000;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void PRINTF_LIKE(2,3) AppendF(std::string *str,const char *fmt,...) {
+    char buf[500];
+
+    va_list v;
+    va_start(v,fmt);
+    int n=vsnprintf(buf,sizeof buf,fmt,v);
+    va_end(v);
+
+    ASSERT(n>=0&&(size_t)n<sizeof buf);
+    (void)n;
+
+    str->append(buf);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+double SubsystemProfilerCounts::GetEstimatedTicks() const {
+    if(num_sampled_calls==0) {
+        return 0.;
+    }
+
+    return (double)num_sampled_ticks*num_calls/num_sampled_calls;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+SubsystemProfiler::SubsystemProfiler(uint32_t sample_interval):
+    m_events(MAX_NUM_EVENTS)
+{
+    m_profile.num_executions.resize(65536);
+    m_num_executions=m_profile.num_executions.data();
+
+    // The calibration cycles have nothing in them but the profiler, so
+    // the quickest one is the clock read overhead.
+    m_profile.sample_interval=1;
+    this->Reset();
+
+    for(int i=0;i<NUM_CALIBRATION_CYCLES;++i) {
+        this->BeginCycle(0);
+        this->EndCycle();
+    }
+
+    uint64_t overhead_ticks=UINT64_MAX;
+    for(size_t i=0;i<m_event_index;++i) {
+        if(m_events[i].num_ticks<overhead_ticks) {
+            overhead_ticks=m_events[i].num_ticks;
+        }
+    }
+
+    m_profile.overhead_ticks=overhead_ticks;
+    m_profile.sample_interval=sample_interval|1;
+    this->Reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+const SubsystemProfile &SubsystemProfiler::GetProfile() const {
+    return m_profile;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfiler::GetEvents(std::vector<SubsystemProfilerEvent> *events) const {
+    events->clear();
+
+    if(m_events_wrapped) {
+        events->insert(events->end(),m_events.begin()+(ptrdiff_t)m_event_index,m_events.end());
+    }
+
+    events->insert(events->end(),m_events.begin(),m_events.begin()+(ptrdiff_t)m_event_index);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfiler::Flush() {
+    uint64_t now_ticks=GetCurrentTickCount();
+
+    uint64_t num_ticks=now_ticks-m_last_ticks;
+    if(num_ticks>m_profile.overhead_ticks) {
+        num_ticks-=m_profile.overhead_ticks;
+    } else {
+        num_ticks=0;
+    }
+
+    m_profile.subsystems[m_current].num_sampled_ticks+=num_ticks;
+
+    if(m_current==BBCMicroSubsystem_MMIO) {
+        m_mmio->num_sampled_ticks+=num_ticks;
+    }
+
+    SubsystemProfilerEvent *e=&m_events[m_event_index];
+    e->cycle=m_cycle;
+    e->begin_ticks=m_last_ticks;
+    e->num_ticks=num_ticks>UINT32_MAX?UINT32_MAX:(uint32_t)num_ticks;
+    e->subsystem=m_current;
+
+    ++m_event_index;
+    if(m_event_index==m_events.size()) {
+        m_event_index=0;
+        m_events_wrapped=true;
+    }
+
+    m_last_ticks=now_ticks;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void SubsystemProfiler::Reset() {
+    m_profile.num_cycles=0;
+    m_profile.num_sampled_cycles=0;
+
+    for(SubsystemProfilerCounts &counts:m_profile.subsystems) {
+        counts=SubsystemProfilerCounts();
+    }
+
+    for(SubsystemProfilerCounts &counts:m_profile.mmio) {
+        counts=SubsystemProfilerCounts();
+    }
+
+    for(uint64_t &n:m_profile.num_executions) {
+        n=0;
+    }
+
+    m_event_index=0;
+    m_events_wrapped=false;
+
+    m_sample_countdown=1;
+    m_sampling=false;
+    m_current=BBCMicroSubsystem_Other;
+    m_mmio=nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void AppendCountsJSON(std::string *json,const SubsystemProfilerCounts &counts) {
+    AppendF(json,"\"num_calls\":%" PRIu64 ",\"num_sampled_calls\":%" PRIu64 ",\"sampled_seconds\":%.9f,\"estimated_seconds\":%.9f",
+            counts.num_calls,
+            counts.num_sampled_calls,
+            GetSecondsFromTicks(counts.num_sampled_ticks),
+            GetSecondsFromTicks(1)*counts.GetEstimatedTicks());
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::string GetSubsystemProfileJSON(const SubsystemProfile &profile) {
+    std::string json;
+
+    double total_ticks=0.;
+    for(const SubsystemProfilerCounts &counts:profile.subsystems) {
+        total_ticks+=counts.GetEstimatedTicks();
+    }
+
+    json+="{\n";
+    AppendF(&json,"  \"sample_interval\":%" PRIu32 ",\n",profile.sample_interval);
+    AppendF(&json,"  \"overhead_seconds\":%.9f,\n",GetSecondsFromTicks(profile.overhead_ticks));
+    AppendF(&json,"  \"num_cycles\":%" PRIu64 ",\n",profile.num_cycles);
+    AppendF(&json,"  \"num_sampled_cycles\":%" PRIu64 ",\n",profile.num_sampled_cycles);
+    AppendF(&json,"  \"estimated_seconds\":%.9f,\n",GetSecondsFromTicks(1)*total_ticks);
+
+    json+="  \"subsystems\":[\n";
+    for(int i=0;i<BBCMicroSubsystem_Count;++i) {
+        const SubsystemProfilerCounts &counts=profile.subsystems[i];
+
+        AppendF(&json,"    {\"name\":\"%s\",",GetBBCMicroSubsystemEnumName(i));
+        AppendCountsJSON(&json,counts);
+        AppendF(&json,",\"percentage\":%.3f}%s\n",
+                total_ticks>0.?100.*counts.GetEstimatedTicks()/total_ticks:0.,
+                i+1<BBCMicroSubsystem_Count?",":"");
+    }
+    json+="  ],\n";
+
+    json+="  \"mmio\":[";
+    const char *sep="\n";
+    for(size_t i=0;i<SUBSYSTEM_PROFILER_NUM_MMIO_ADDRESSES;++i) {
+        const SubsystemProfilerCounts &counts=profile.mmio[i];
+        if(counts.num_calls>0) {
+            AppendF(&json,"%s    {\"address\":%zu,",sep,0xfc00+i);
+            AppendCountsJSON(&json,counts);
+            json+="}";
+            sep=",\n";
+        }
+    }
+    json+="\n  ],\n";
+
+    // [address,count] pairs, to keep the size down.
+    json+="  \"executions\":[";
+    sep="\n";
+    for(size_t i=0;i<profile.num_executions.size();++i) {
+        if(profile.num_executions[i]>0) {
+            AppendF(&json,"%s    [%zu,%" PRIu64 "]",sep,i,profile.num_executions[i]);
+            sep=",\n";
+        }
+    }
+    json+="\n  ]\n";
+
+    json+="}\n";
+
+    return json;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+std::string GetSubsystemProfilerEventsChromeTrace(const std::vector<SubsystemProfilerEvent> &events) {
+    std::string json;
+
+    json+="{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    json+="{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"BBCMicro::Update\"}}";
+
+    if(!events.empty()) {
+        uint64_t base_ticks=events[0].begin_ticks;
+        double us_per_tick=GetSecondsFromTicks(1)*1e6;
+
+        size_t i=0;
+        while(i<events.size()) {
+            // Events for the same cycle are contiguous.
+            size_t end=i+1;
+            while(end<events.size()&&events[end].cycle==events[i].cycle) {
+                ++end;
+            }
+
+            const SubsystemProfilerEvent *last=&events[end-1];
+            uint64_t cycle_begin_ticks=events[i].begin_ticks-base_ticks;
+            uint64_t cycle_end_ticks=last->begin_ticks+last->num_ticks-base_ticks;
+
+            AppendF(&json,",\n{\"name\":\"Cycle\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cycle\":%" PRIu64 "}}",
+                    cycle_begin_ticks*us_per_tick,
+                    (cycle_end_ticks-cycle_begin_ticks)*us_per_tick,
+                    events[i].cycle);
+
+            for(size_t j=i;j<end;++j) {
+                const SubsystemProfilerEvent *e=&events[j];
+
+                AppendF(&json,",\n{\"name\":\"%s\",\"cat\":\"subsystem\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                        GetBBCMicroSubsystemEnumName(e->subsystem),
+                        (e->begin_ticks-base_ticks)*us_per_tick,
+                        e->num_ticks*us_per_tick);
+            }
+
+            i=end;
+        }
+    }
+
+    json+="\n]}\n";
+
+    return json;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
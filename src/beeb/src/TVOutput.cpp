@@ -45,6 +45,8 @@ void TVOutput::Init(uint32_t r_shift,uint32_t g_shift,uint32_t b_shift) {
 #endif
 
     this->InitPalette();
+
+    this->SetAllRowsDirty();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -108,6 +110,8 @@ void TVOutput::Update(const VideoDataUnit *units,size_t num_units) {
                 break;
 
             case TVOutputState_VerticalRetrace:
+                this->FlushLineChanged();
+
                 ++m_num_fields;
                 m_state=TVOutputState_VerticalRetraceWait;
                 ++m_texture_data_version;
@@ -167,28 +171,44 @@ void TVOutput::Update(const VideoDataUnit *units,size_t num_units) {
                             pixels1=pixels0+TV_TEXTURE_WIDTH;
 
                             const VideoDataPixel p0=unit->pixels.pixels[0];
-                            pixels1[0]=pixels0[0]=m_rs[p0.bits.r]|m_gs[p0.bits.g]|m_bs[p0.bits.b];
+                            const uint32_t v0=m_rs[p0.bits.r]|m_gs[p0.bits.g]|m_bs[p0.bits.b];
+                            m_line_changed|=(pixels0[0]^v0)|(pixels1[0]^v0);
+                            pixels1[0]=pixels0[0]=v0;
 
                             const VideoDataPixel p1=unit->pixels.pixels[1];
-                            pixels1[1]=pixels0[1]=m_rs[p1.bits.r]|m_gs[p1.bits.g]|m_bs[p1.bits.b];
+                            const uint32_t v1=m_rs[p1.bits.r]|m_gs[p1.bits.g]|m_bs[p1.bits.b];
+                            m_line_changed|=(pixels0[1]^v1)|(pixels1[1]^v1);
+                            pixels1[1]=pixels0[1]=v1;
 
                             const VideoDataPixel p2=unit->pixels.pixels[2];
-                            pixels1[2]=pixels0[2]=m_rs[p2.bits.r]|m_gs[p2.bits.g]|m_bs[p2.bits.b];
+                            const uint32_t v2=m_rs[p2.bits.r]|m_gs[p2.bits.g]|m_bs[p2.bits.b];
+                            m_line_changed|=(pixels0[2]^v2)|(pixels1[2]^v2);
+                            pixels1[2]=pixels0[2]=v2;
 
                             const VideoDataPixel p3=unit->pixels.pixels[3];
-                            pixels1[3]=pixels0[3]=m_rs[p3.bits.r]|m_gs[p3.bits.g]|m_bs[p3.bits.b];
+                            const uint32_t v3=m_rs[p3.bits.r]|m_gs[p3.bits.g]|m_bs[p3.bits.b];
+                            m_line_changed|=(pixels0[3]^v3)|(pixels1[3]^v3);
+                            pixels1[3]=pixels0[3]=v3;
 
                             const VideoDataPixel p4=unit->pixels.pixels[4];
-                            pixels1[4]=pixels0[4]=m_rs[p4.bits.r]|m_gs[p4.bits.g]|m_bs[p4.bits.b];
+                            const uint32_t v4=m_rs[p4.bits.r]|m_gs[p4.bits.g]|m_bs[p4.bits.b];
+                            m_line_changed|=(pixels0[4]^v4)|(pixels1[4]^v4);
+                            pixels1[4]=pixels0[4]=v4;
 
                             const VideoDataPixel p5=unit->pixels.pixels[5];
-                            pixels1[5]=pixels0[5]=m_rs[p5.bits.r]|m_gs[p5.bits.g]|m_bs[p5.bits.b];
+                            const uint32_t v5=m_rs[p5.bits.r]|m_gs[p5.bits.g]|m_bs[p5.bits.b];
+                            m_line_changed|=(pixels0[5]^v5)|(pixels1[5]^v5);
+                            pixels1[5]=pixels0[5]=v5;
 
                             const VideoDataPixel p6=unit->pixels.pixels[6];
-                            pixels1[6]=pixels0[6]=m_rs[p6.bits.r]|m_gs[p6.bits.g]|m_bs[p6.bits.b];
+                            const uint32_t v6=m_rs[p6.bits.r]|m_gs[p6.bits.g]|m_bs[p6.bits.b];
+                            m_line_changed|=(pixels0[6]^v6)|(pixels1[6]^v6);
+                            pixels1[6]=pixels0[6]=v6;
 
                             const VideoDataPixel p7=unit->pixels.pixels[7];
-                            pixels1[7]=pixels0[7]=m_rs[p7.bits.r]|m_gs[p7.bits.g]|m_bs[p7.bits.b];
+                            const uint32_t v7=m_rs[p7.bits.r]|m_gs[p7.bits.g]|m_bs[p7.bits.b];
+                            m_line_changed|=(pixels0[7]^v7)|(pixels1[7]^v7);
+                            pixels1[7]=pixels0[7]=v7;
 
 #if VIDEO_TRACK_METADATA
                             VideoDataUnit *units0=m_units_line+m_x;
@@ -300,23 +320,44 @@ void TVOutput::Update(const VideoDataUnit *units,size_t num_units) {
                             uint32_t g71=m_gs[p51.bits.g];
                             uint32_t b71=m_bs[p51.bits.b];
 
-                            pixels0[0]=r00|g00|b00;
-                            pixels0[1]=r10|g10|b10;
-                            pixels0[2]=r20|g20|b20;
-                            pixels0[3]=r30|g30|b30;
-                            pixels0[4]=r40|g40|b40;
-                            pixels0[5]=r50|g50|b50;
-                            pixels0[6]=r60|g60|b60;
-                            pixels0[7]=r70|g70|b70;
-
-                            pixels1[0]=r01|g01|b01;
-                            pixels1[1]=r11|g11|b11;
-                            pixels1[2]=r21|g21|b21;
-                            pixels1[3]=r31|g31|b31;
-                            pixels1[4]=r41|g41|b41;
-                            pixels1[5]=r51|g51|b51;
-                            pixels1[6]=r61|g61|b61;
-                            pixels1[7]=r71|g71|b71;
+                            const uint32_t v00=r00|g00|b00;
+                            const uint32_t v10=r10|g10|b10;
+                            const uint32_t v20=r20|g20|b20;
+                            const uint32_t v30=r30|g30|b30;
+                            const uint32_t v40=r40|g40|b40;
+                            const uint32_t v50=r50|g50|b50;
+                            const uint32_t v60=r60|g60|b60;
+                            const uint32_t v70=r70|g70|b70;
+
+                            const uint32_t v01=r01|g01|b01;
+                            const uint32_t v11=r11|g11|b11;
+                            const uint32_t v21=r21|g21|b21;
+                            const uint32_t v31=r31|g31|b31;
+                            const uint32_t v41=r41|g41|b41;
+                            const uint32_t v51=r51|g51|b51;
+                            const uint32_t v61=r61|g61|b61;
+                            const uint32_t v71=r71|g71|b71;
+
+                            m_line_changed|=(pixels0[0]^v00)|(pixels0[1]^v10)|(pixels0[2]^v20)|(pixels0[3]^v30)|(pixels0[4]^v40)|(pixels0[5]^v50)|(pixels0[6]^v60)|(pixels0[7]^v70);
+                            m_line_changed|=(pixels1[0]^v01)|(pixels1[1]^v11)|(pixels1[2]^v21)|(pixels1[3]^v31)|(pixels1[4]^v41)|(pixels1[5]^v51)|(pixels1[6]^v61)|(pixels1[7]^v71);
+
+                            pixels0[0]=v00;
+                            pixels0[1]=v10;
+                            pixels0[2]=v20;
+                            pixels0[3]=v30;
+                            pixels0[4]=v40;
+                            pixels0[5]=v50;
+                            pixels0[6]=v60;
+                            pixels0[7]=v70;
+
+                            pixels1[0]=v01;
+                            pixels1[1]=v11;
+                            pixels1[2]=v21;
+                            pixels1[3]=v31;
+                            pixels1[4]=v41;
+                            pixels1[5]=v51;
+                            pixels1[6]=v61;
+                            pixels1[7]=v71;
 
 #if VIDEO_TRACK_METADATA
                             VideoDataUnit *units0=m_units_line+m_x;
@@ -382,14 +423,26 @@ void TVOutput::Update(const VideoDataUnit *units,size_t num_units) {
                             uint32_t g7=m_gs[p5.bits.g];
                             uint32_t b7=m_bs[p5.bits.b];
 
-                            pixels1[0]=pixels0[0]=r0|g0|b0;
-                            pixels1[1]=pixels0[1]=r1|g1|b1;
-                            pixels1[2]=pixels0[2]=r2|g2|b2;
-                            pixels1[3]=pixels0[3]=r3|g3|b3;
-                            pixels1[4]=pixels0[4]=r4|g4|b4;
-                            pixels1[5]=pixels0[5]=r5|g5|b5;
-                            pixels1[6]=pixels0[6]=r6|g6|b6;
-                            pixels1[7]=pixels0[7]=r7|g7|b7;
+                            const uint32_t v0=r0|g0|b0;
+                            const uint32_t v1=r1|g1|b1;
+                            const uint32_t v2=r2|g2|b2;
+                            const uint32_t v3=r3|g3|b3;
+                            const uint32_t v4=r4|g4|b4;
+                            const uint32_t v5=r5|g5|b5;
+                            const uint32_t v6=r6|g6|b6;
+                            const uint32_t v7=r7|g7|b7;
+
+                            m_line_changed|=(pixels0[0]^v0)|(pixels0[1]^v1)|(pixels0[2]^v2)|(pixels0[3]^v3)|(pixels0[4]^v4)|(pixels0[5]^v5)|(pixels0[6]^v6)|(pixels0[7]^v7);
+                            m_line_changed|=(pixels1[0]^v0)|(pixels1[1]^v1)|(pixels1[2]^v2)|(pixels1[3]^v3)|(pixels1[4]^v4)|(pixels1[5]^v5)|(pixels1[6]^v6)|(pixels1[7]^v7);
+
+                            pixels1[0]=pixels0[0]=v0;
+                            pixels1[1]=pixels0[1]=v1;
+                            pixels1[2]=pixels0[2]=v2;
+                            pixels1[3]=pixels0[3]=v3;
+                            pixels1[4]=pixels0[4]=v4;
+                            pixels1[5]=pixels0[5]=v5;
+                            pixels1[6]=pixels0[6]=v6;
+                            pixels1[7]=pixels0[7]=v7;
 
 #if VIDEO_TRACK_METADATA
                             VideoDataUnit *units0=m_units_line+m_x;
@@ -412,6 +465,8 @@ void TVOutput::Update(const VideoDataUnit *units,size_t num_units) {
                 break;
 
             case TVOutputState_HorizontalRetrace:
+                this->FlushLineChanged();
+
                 m_state=TVOutputState_HorizontalRetraceWait;
                 m_x=0;
                 m_y+=HEIGHT_SCALE;
@@ -529,6 +584,8 @@ void TVOutput::FillWithTestPattern() {
             } while(tmp!=0);
         }
     }
+
+    this->SetAllRowsDirty();
 }
 #endif
 
@@ -548,22 +605,37 @@ const uint32_t *TVOutput::GetTexturePixels(uint64_t *texture_data_version) const
 //////////////////////////////////////////////////////////////////////////
 
 void TVOutput::CopyTexturePixels(void *dest_pixels,size_t dest_pitch_bytes) const {
+    this->CopyTexturePixels(dest_pixels,dest_pitch_bytes,0,TV_TEXTURE_HEIGHT);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void TVOutput::CopyTexturePixels(void *dest_pixels,size_t dest_pitch_bytes,size_t begin_y,size_t end_y) const {
     ASSERT(dest_pitch_bytes>0);
+    ASSERT(begin_y<=end_y);
+    ASSERT(end_y<=TV_TEXTURE_HEIGHT);
     size_t src_pitch_bytes=TV_TEXTURE_WIDTH*4;
 
     if(src_pitch_bytes==dest_pitch_bytes) {
-        memcpy(dest_pixels,m_texture_pixels.data(),TV_TEXTURE_HEIGHT*TV_TEXTURE_WIDTH*4);
+        memcpy(dest_pixels,m_texture_pixels.data()+begin_y*TV_TEXTURE_WIDTH,(end_y-begin_y)*TV_TEXTURE_WIDTH*4);
     } else {
         auto dest=(char *)dest_pixels;
-        auto src=(const char *)m_texture_pixels.data();
+        auto src=(const char *)(m_texture_pixels.data()+begin_y*TV_TEXTURE_WIDTH);
 
-        for(size_t y=0;y<TV_TEXTURE_HEIGHT;++y) {
+        for(size_t y=begin_y;y<end_y;++y) {
             memcpy(dest,src,src_pitch_bytes);
             dest+=dest_pitch_bytes;
             src+=src_pitch_bytes;
         }
     }
 
+    if(begin_y!=0||end_y!=TV_TEXTURE_HEIGHT) {
+        // Partial updates are only for when there are no markers.
+        ASSERT(!this->AreMarkersShown());
+        return;
+    }
+
     if(this->show_usec_markers||this->show_half_usec_markers) {
         for(size_t x=0;x<TV_TEXTURE_WIDTH;x+=8) {
             char *dest=(char*)((uint32_t *)dest_pixels+x);
@@ -661,6 +733,44 @@ void TVOutput::CopyTexturePixels(void *dest_pixels,size_t dest_pitch_bytes) cons
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+bool TVOutput::GetDirtyRows(size_t *begin_y,size_t *end_y) const {
+    if(this->AreMarkersShown()||m_markers_were_shown) {
+        // Markers are drawn on top of the destination, so they need the
+        // whole thing redoing, as does getting rid of them.
+        *begin_y=0;
+        *end_y=TV_TEXTURE_HEIGHT;
+        return true;
+    }
+
+    if(m_dirty_begin_y>=m_dirty_end_y) {
+        return false;
+    }
+
+    *begin_y=m_dirty_begin_y;
+    *end_y=m_dirty_end_y;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void TVOutput::ClearDirtyRows() {
+    m_dirty_begin_y=0;
+    m_dirty_end_y=0;
+    m_markers_were_shown=this->AreMarkersShown();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void TVOutput::SetAllRowsDirty() {
+    m_dirty_begin_y=0;
+    m_dirty_end_y=TV_TEXTURE_HEIGHT;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if VIDEO_TRACK_METADATA
 const VideoDataUnit *TVOutput::GetTextureUnits() const {
     return m_texture_units.data();
@@ -761,6 +871,51 @@ void TVOutput::InitPalette() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+void TVOutput::FlushLineChanged() {
+    if(m_line_changed!=0) {
+        ASSERT(m_y<TV_TEXTURE_HEIGHT);
+
+        if(m_dirty_begin_y>=m_dirty_end_y) {
+            m_dirty_begin_y=m_y;
+            m_dirty_end_y=m_y+HEIGHT_SCALE;
+        } else {
+            if(m_y<m_dirty_begin_y) {
+                m_dirty_begin_y=m_y;
+            }
+
+            if(m_y+HEIGHT_SCALE>m_dirty_end_y) {
+                m_dirty_end_y=m_y+HEIGHT_SCALE;
+            }
+        }
+
+        m_line_changed=0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+bool TVOutput::AreMarkersShown() const {
+    if(this->show_usec_markers||
+       this->show_half_usec_markers||
+       this->show_6845_row_markers||
+       this->show_6845_dispen_markers)
+    {
+        return true;
+    }
+
+#if BBCMICRO_DEBUGGER
+    if(this->show_beam_position) {
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if VIDEO_TRACK_METADATA
 void TVOutput::AddMetadataMarkers(void *dest_pixels,
                                   size_t dest_pitch_bytes,
@@ -6,6 +6,7 @@
 #include <shared/debug.h>
 #include <shared/log.h>
 #include <beeb/Trace.h>
+#include <shared/sha1.h>
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -20,8 +21,16 @@ void VideoULA::WriteControlRegister(void *ula_,M6502Word a,uint8_t value) {
     (void)a;
 
     if(value!=ula->control.value) {
+        Control old=ula->control;
+
         ula->control.value=value;
 
+        if(ula->control.bits.flash!=old.bits.flash||
+           ula->control.bits.line_width!=old.bits.line_width)
+        {
+            ula->m_byte_pixels_dirty=true;
+        }
+
         TRACEF(ula->m_trace,"ULA Control: Flash=%s Teletext=%s Line Width=%d Fast6845=%s Cursor=%d\n",BOOL_STR(ula->control.bits.flash),BOOL_STR(ula->control.bits.teletext),ula->control.bits.line_width,BOOL_STR(ula->control.bits.fast_6845),ula->control.bits.cursor);
     }
 }
@@ -37,6 +46,7 @@ void VideoULA::WritePalette(void *ula_,M6502Word a,uint8_t value) {
     uint8_t log=value>>4;
 
     ula->m_palette[log]=phy;
+    ula->m_byte_pixels_dirty=true;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -55,6 +65,7 @@ void VideoULA::WriteNuLAControlRegister(void *ula_,M6502Word a,uint8_t value) {
         case 1:
             // Toggle direct palette mode.
             ula->m_direct_palette=param;
+            ula->m_byte_pixels_dirty=true;
             TRACEF(ula->m_trace,"NuLA Control: Direct Palette=%s\n",BOOL_STR(ula->m_direct_palette));
             break;
 
@@ -98,6 +109,7 @@ void VideoULA::WriteNuLAControlRegister(void *ula_,M6502Word a,uint8_t value) {
             ula->m_flash[9]=param&0x04;
             ula->m_flash[10]=param&0x02;
             ula->m_flash[11]=param&0x01;
+            ula->m_byte_pixels_dirty=true;
             TRACEF(ula->m_trace,"NuLA Control: Flash: 8=%s 9=%s 10=%s 11=%s\n",BOOL_STR(ula->m_flash[8]),BOOL_STR(ula->m_flash[9]),BOOL_STR(ula->m_flash[10]),BOOL_STR(ula->m_flash[11]));
             break;
 
@@ -107,6 +119,7 @@ void VideoULA::WriteNuLAControlRegister(void *ula_,M6502Word a,uint8_t value) {
             ula->m_flash[13]=param&0x04;
             ula->m_flash[14]=param&0x02;
             ula->m_flash[15]=param&0x01;
+            ula->m_byte_pixels_dirty=true;
             TRACEF(ula->m_trace,"NuLA Control: Flash: 12=%s 13=%s 14=%s 15=%s\n",BOOL_STR(ula->m_flash[12]),BOOL_STR(ula->m_flash[13]),BOOL_STR(ula->m_flash[14]),BOOL_STR(ula->m_flash[15]));
             break;
 
@@ -137,6 +150,7 @@ void VideoULA::WriteNuLAPalette(void *ula_,M6502Word a,uint8_t value) {
             entry->bits.x=0;
 
             ula->m_flash[index]=0;
+            ula->m_byte_pixels_dirty=true;
 
             TRACEF(ula->m_trace,
                    "NuLA Palette: index=%u, rgb=0x%x%x%x\n",
@@ -194,6 +208,32 @@ void VideoULA::EmitPixels(VideoDataUnitPixels *pixels) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// m_byte_pixels is left out, as it's just derived from the rest.
+void VideoULA::UpdateHash(SHA1 *hasher) const {
+    hasher->Update(m_palette,sizeof m_palette);
+    hasher->Update(m_output_palette,sizeof m_output_palette);
+    hasher->Update(m_flash,sizeof m_flash);
+    hasher->Update(m_pixel_buffer.values,sizeof m_pixel_buffer.values);
+
+    uint8_t values[]={
+        this->control.value,
+        m_work_byte,
+        m_original_byte,
+        m_nula_palette_write_state,
+        m_nula_palette_write_buffer,
+        m_direct_palette,
+        m_disable_a1,
+        m_scroll_offset,
+        m_blanking_size,
+        m_blanking_counter,
+        m_attribute_mode.value,
+    };
+    hasher->Update(values,sizeof values);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_TRACE
 void VideoULA::SetTrace(Trace *t) {
     m_trace=t;
@@ -230,6 +270,8 @@ void VideoULA::ResetNuLAState() {
 
     // Reset attribute mode.
     m_attribute_mode={};
+
+    m_byte_pixels_dirty=true;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -252,14 +294,34 @@ VideoDataPixel VideoULA::GetPalette(uint8_t index) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-VideoDataPixel VideoULA::Shift() {
-    uint8_t index=m_work_byte;
-    index=((index>>1)&1)|((index>>2)&2)|((index>>3)&4)|((index>>4)&8);
+void VideoULA::UpdateBytePixels() {
+    VideoDataPixel palette[16];
+    for(uint8_t i=0;i<16;++i) {
+        palette[i]=this->GetPalette(i);
+    }
 
-    m_work_byte<<=1;
-    m_work_byte|=1;
+    // 1, 2, 4 or 8 shifts per 0.5us, each pixel covering 8, 4, 2 or 1
+    // output pixels.
+    unsigned num_shifts=1u<<this->control.bits.line_width;
+    unsigned pixel_width=8u>>this->control.bits.line_width;
 
-    return this->GetPalette(index);
+    for(unsigned i=0;i<256;++i) {
+        uint8_t work_byte=(uint8_t)i;
+        VideoDataPixel *dest=m_byte_pixels[i].pixels;
+
+        for(unsigned j=0;j<num_shifts;++j) {
+            uint8_t index=((work_byte>>1)&1)|((work_byte>>2)&2)|((work_byte>>3)&4)|((work_byte>>4)&8);
+
+            for(unsigned k=0;k<pixel_width;++k) {
+                *dest++=palette[index];
+            }
+
+            work_byte<<=1;
+            work_byte|=1;
+        }
+    }
+
+    m_byte_pixels_dirty=false;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -303,19 +365,14 @@ VideoDataPixel VideoULA::ShiftAttributeText() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void VideoULA::Emit2MHz(VideoDataUnitPixels *pixels) {
-    VideoDataPixel *dest=&m_pixel_buffer.pixels[m_scroll_offset];
-
-    VideoDataPixel pixel=this->Shift();
-    
-    dest[0]=pixel;
-    dest[1]=pixel;
-    dest[2]=pixel;
-    dest[3]=pixel;
-    dest[4]=pixel;
-    dest[5]=pixel;
-    dest[6]=pixel;
-    dest[7]=pixel;
+void VideoULA::EmitBytePixels(VideoDataUnitPixels *pixels,uint8_t num_shifts) {
+    if(m_byte_pixels_dirty) {
+        this->UpdateBytePixels();
+    }
+
+    memcpy(&m_pixel_buffer.pixels[m_scroll_offset],&m_byte_pixels[m_work_byte],sizeof(VideoDataUnitPixels));
+
+    m_work_byte=(uint8_t)(m_work_byte<<num_shifts|((1u<<num_shifts)-1));
 
     pixels->values[0]=m_pixel_buffer.values[0];
     pixels->values[1]=m_pixel_buffer.values[1];
@@ -327,98 +384,29 @@ void VideoULA::Emit2MHz(VideoDataUnitPixels *pixels) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void VideoULA::Emit4MHz(VideoDataUnitPixels *pixels) {
-    VideoDataPixel *dest=&m_pixel_buffer.pixels[m_scroll_offset];
-
-    VideoDataPixel pixel;
-
-    pixel=this->Shift();
-    dest[0]=pixel;
-    dest[1]=pixel;
-    dest[2]=pixel;
-    dest[3]=pixel;
-
-    pixel=this->Shift();
-    dest[4]=pixel;
-    dest[5]=pixel;
-    dest[6]=pixel;
-    dest[7]=pixel;
+void VideoULA::Emit2MHz(VideoDataUnitPixels *pixels) {
+    this->EmitBytePixels(pixels,1);
+}
 
-    pixels->values[0]=m_pixel_buffer.values[0];
-    pixels->values[1]=m_pixel_buffer.values[1];
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
 
-    m_pixel_buffer.values[0]=m_pixel_buffer.values[2];
-    m_pixel_buffer.values[1]=m_pixel_buffer.values[3];
+void VideoULA::Emit4MHz(VideoDataUnitPixels *pixels) {
+    this->EmitBytePixels(pixels,2);
 }
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
 void VideoULA::Emit8MHz(VideoDataUnitPixels *pixels) {
-    VideoDataPixel *dest=&m_pixel_buffer.pixels[m_scroll_offset];
-
-    VideoDataPixel pixel;
-
-    pixel=this->Shift();
-    dest[0]=pixel;
-    dest[1]=pixel;
-
-    pixel=this->Shift();
-    dest[2]=pixel;
-    dest[3]=pixel;
-
-    pixel=this->Shift();
-    dest[4]=pixel;
-    dest[5]=pixel;
-
-    pixel=this->Shift();
-    dest[6]=pixel;
-    dest[7]=pixel;
-
-    pixels->values[0]=m_pixel_buffer.values[0];
-    pixels->values[1]=m_pixel_buffer.values[1];
-
-    m_pixel_buffer.values[0]=m_pixel_buffer.values[2];
-    m_pixel_buffer.values[1]=m_pixel_buffer.values[3];
+    this->EmitBytePixels(pixels,4);
 }
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
 void VideoULA::Emit16MHz(VideoDataUnitPixels *pixels) {
-    VideoDataPixel *dest=&m_pixel_buffer.pixels[m_scroll_offset];
-
-    VideoDataPixel pixel;
-
-    pixel=this->Shift();
-    dest[0]=pixel;
-
-    pixel=this->Shift();
-    dest[1]=pixel;
-
-    pixel=this->Shift();
-    dest[2]=pixel;
-
-    pixel=this->Shift();
-    dest[3]=pixel;
-
-    pixel=this->Shift();
-    dest[4]=pixel;
-
-    pixel=this->Shift();
-    dest[5]=pixel;
-
-    pixel=this->Shift();
-    dest[6]=pixel;
-
-    pixel=this->Shift();
-    dest[7]=pixel;
-
-    pixels->values[0]=m_pixel_buffer.values[0];
-    pixels->values[1]=m_pixel_buffer.values[1];
-
-    m_pixel_buffer.values[0]=m_pixel_buffer.values[2];
-    m_pixel_buffer.values[1]=m_pixel_buffer.values[3];
+    this->EmitBytePixels(pixels,8);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <beeb/crtc.h>
 #include <beeb/Trace.h>
+#include <shared/sha1.h>
 
 #include <shared/enum_def.h>
 #include <beeb/crtc.inl>
@@ -326,6 +327,32 @@ CRTC::Output CRTC::Update() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+void CRTC::UpdateHash(SHA1 *hasher) const {
+    hasher->Update(m_registers.values,sizeof m_registers.values);
+
+    int32_t values[]={
+        m_address,
+        m_num_frames,
+        m_interlace_delay_counter,
+        m_column,
+        m_row,
+        m_raster,
+        m_vsync_counter,
+        m_hsync_counter,
+        m_adj_counter,
+        m_hdisp,
+        m_vdisp,
+        m_line_addr.w,
+        m_char_addr.w,
+        m_skewed_display,
+        m_skewed_cudisp,
+    };
+    hasher->Update(values,sizeof values);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_TRACE
 void CRTC::SetTrace(Trace *t,
                     bool trace_scanlines,
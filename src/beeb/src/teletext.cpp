@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <beeb/teletext.h>
 #include <beeb/video.h>
+#include <shared/sha1.h>
 
 #include <shared/enum_def.h>
 #include <beeb/teletext.inl>
@@ -39,8 +40,12 @@ static uint16_t teletext_debug_font[128][10];
 static uint16_t teletext_debug_font_bgmask[128][10];
 #endif
 
-//[(bool)aa][(TeletextCharset)style][ch-32][row]
-static uint16_t teletext_font[2][3][96][20];
+// [(bool)double height][(TeletextCharset)style][ch-32][glyph row]
+//
+// Both scanlines' worth of (antialiased) glyph data for one display row,
+// packed as data0|data1<<16, so the character path is a single load
+// regardless of double height state.
+static uint32_t teletext_font_rows[2][3][96][20];
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -135,11 +140,11 @@ struct InitTeletextFont {
             for(uint8_t ch=0;ch<128;++ch) {
                 for(int y=0;y<20;++y) {
                     if(ch>=32) {
-                        // No AA
-                        teletext_font[0][style][ch-32][y]=Get16WideRow(style,ch,y);
+                        // Normal height: successive glyph rows.
+                        teletext_font_rows[0][style][ch-32][y]=(uint32_t)GetAARow(style,ch,y)|(uint32_t)GetAARow(style,ch,y+1)<<16;
 
-                        // AA
-                        teletext_font[1][style][ch-32][y]=GetAARow(style,ch,y);
+                        // Double height: same glyph row twice.
+                        teletext_font_rows[1][style][ch-32][y]=(uint32_t)GetAARow(style,ch,y)|(uint32_t)GetAARow(style,ch,y)<<16;
                     }
                 }
 
@@ -329,8 +334,9 @@ void SAA5050::Byte(uint8_t value,uint8_t dispen) {
         uint8_t glyph_raster=(m_raster+m_raster_offset)>>m_raster_shift;
 
         if(glyph_raster<20&&m_text_visible&&!m_conceal) {
-            data0=teletext_font[1][m_charset][value-32][glyph_raster];
-            data1=teletext_font[1][m_charset][value-32][glyph_raster+(1>>m_raster_shift)];
+            uint32_t rows=teletext_font_rows[m_raster_shift][m_charset][value-32][glyph_raster];
+            data0=(uint16_t)rows;
+            data1=(uint16_t)(rows>>16);
         } else {
             data0=0;
             data1=0;
@@ -452,6 +458,37 @@ void SAA5050::VSync() {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+void SAA5050::UpdateHash(SHA1 *hasher) const {
+    hasher->Update(m_output,sizeof m_output);
+
+    uint16_t values[]={
+        m_raster,
+        m_frame,
+        m_write_index,
+        m_read_index,
+        m_charset,
+        m_graphics_charset,
+        m_fg,
+        m_bg,
+        m_last_graphics_data0,
+        m_last_graphics_data1,
+        m_raster_shift,
+        m_raster_offset,
+        m_any_double_height,
+        m_conceal,
+        m_hold,
+        m_text_visible,
+        m_frame_flash_visible,
+#if BBCMICRO_DEBUGGER
+        m_debug,
+#endif
+    };
+    hasher->Update(values,sizeof values);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 #if BBCMICRO_DEBUGGER
 bool SAA5050::IsDebug() const {
     return m_debug;
@@ -0,0 +1,397 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include <shared/log.h>
+#include <beeb/1770.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+
+LOG_DEFINE(OUTPUT,"",&log_printer_stdout_and_debugger)
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// A single-sided, single density 80 track disc with 10 256-byte sectors
+// per track, as per a .ssd.
+
+static const uint8_t NUM_TRACKS=80;
+static const uint8_t NUM_SECTORS=10;
+static const size_t SECTOR_SIZE=256;
+
+class TestHandler:
+    public WD1770Handler
+{
+public:
+    std::vector<uint8_t> data;
+    uint8_t track=0;
+
+    size_t num_read_sector_calls=0;
+
+    size_t num_write_sector_calls=0;
+    size_t last_write_sector_size=0;
+
+    TestHandler():
+        data((size_t)NUM_TRACKS*NUM_SECTORS*SECTOR_SIZE)
+    {
+        for(size_t i=0;i<data.size();++i) {
+            data[i]=(uint8_t)(i*7+i/SECTOR_SIZE);
+        }
+    }
+
+    bool IsTrack0() override {
+        return this->track==0;
+    }
+
+    void StepOut() override {
+        if(this->track>0) {
+            --this->track;
+        }
+    }
+
+    void StepIn() override {
+        if(this->track<NUM_TRACKS-1) {
+            ++this->track;
+        }
+    }
+
+    void SpinUp() override {
+    }
+
+    void SpinDown() override {
+    }
+
+    bool IsWriteProtected() override {
+        return false;
+    }
+
+    bool ReadSector(uint8_t *buf,uint8_t sector,size_t size) override {
+        if(sector>=NUM_SECTORS||size>SECTOR_SIZE) {
+            return false;
+        }
+
+        memcpy(buf,&this->data[GetIndex(this->track,sector)],size);
+        ++this->num_read_sector_calls;
+
+        return true;
+    }
+
+    bool WriteSector(uint8_t sector,const uint8_t *buf,size_t size) override {
+        if(sector>=NUM_SECTORS||size>SECTOR_SIZE) {
+            return false;
+        }
+
+        memcpy(&this->data[GetIndex(this->track,sector)],buf,size);
+        ++this->num_write_sector_calls;
+        this->last_write_sector_size=size;
+
+        return true;
+    }
+
+    bool GetSectorDetails(uint8_t *track_,uint8_t *side,size_t *size,uint8_t sector,bool double_density) override {
+        if(double_density||sector>=NUM_SECTORS) {
+            return false;
+        }
+
+        *track_=this->track;
+        *side=0;
+        *size=SECTOR_SIZE;
+
+        return true;
+    }
+
+    static size_t GetIndex(uint8_t track,uint8_t sector) {
+        return ((size_t)track*NUM_SECTORS+sector)*SECTOR_SIZE;
+    }
+protected:
+private:
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+struct TestFDC {
+    WD1770 fdc;
+    TestHandler handler;
+
+    // 1 cycle=1 call to WD1770::Update=1 usec.
+    uint64_t num_cycles=0;
+
+    explicit TestFDC(bool turbo) {
+        this->fdc.SetHandler(&this->handler);
+        this->fdc.SetTurbo(turbo);
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// 10 seconds - plenty, even for a seek from track 79 to track 0.
+static const uint64_t MAX_NUM_COMMAND_CYCLES=10000000;
+
+static const M6502Word ADDR={};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Runs the 1770 until the current command finishes, reading the data
+// register on each DRQ, as the NMI handler does.
+static std::vector<uint8_t> RunCommand(TestFDC *t) {
+    std::vector<uint8_t> data;
+    uint64_t num_command_cycles=0;
+
+    for(;;) {
+        TEST_LT_UU(num_command_cycles,MAX_NUM_COMMAND_CYCLES);
+        ++num_command_cycles;
+
+        WD1770::Pins pins=t->fdc.Update();
+        ++t->num_cycles;
+
+        if(pins.bits.drq) {
+            data.push_back(WD1770::Read3(&t->fdc,ADDR));
+        }
+
+        if(pins.bits.intrq) {
+            break;
+        }
+    }
+
+    return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static WD1770::Status GetStatus(TestFDC *t) {
+    WD1770::Status status;
+    status.value=WD1770::Read0(&t->fdc,ADDR);
+
+    return status;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Seek with verify, at the 1770's slowest step rate, as DFS does with a
+// slow drive.
+static void Seek(TestFDC *t,uint8_t track) {
+    WD1770::Write3(&t->fdc,ADDR,track);
+    WD1770::Write0(&t->fdc,ADDR,0x17);
+
+    std::vector<uint8_t> data=RunCommand(t);
+    TEST_TRUE(data.empty());
+
+    WD1770::Status status=GetStatus(t);
+    TEST_FALSE(status.bits.rnf);
+    TEST_EQ_UU(t->handler.track,track);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Read Sector, with the 30 ms head settle delay.
+static std::vector<uint8_t> ReadSector(TestFDC *t,uint8_t sector) {
+    WD1770::Write2(&t->fdc,ADDR,sector);
+    WD1770::Write0(&t->fdc,ADDR,0x84);
+
+    std::vector<uint8_t> data=RunCommand(t);
+
+    WD1770::Status status=GetStatus(t);
+    TEST_FALSE(status.bits.rnf);
+    TEST_FALSE(status.bits.lost_or_track0);
+
+    return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const uint8_t TURBO_TEST_TRACKS[]={0,1,2,39,79,40,3};
+
+// Reads every sector of a few tracks, seeking between them.
+static std::vector<uint8_t> ReadTracks(TestFDC *t) {
+    std::vector<uint8_t> data;
+
+    for(uint8_t track:TURBO_TEST_TRACKS) {
+        Seek(t,track);
+
+        for(uint8_t sector=0;sector<NUM_SECTORS;++sector) {
+            std::vector<uint8_t> sector_data=ReadSector(t,sector);
+            TEST_EQ_UU(sector_data.size(),SECTOR_SIZE);
+            TEST_EQ_AA(sector_data.data(),&t->handler.data[TestHandler::GetIndex(track,sector)],SECTOR_SIZE);
+
+            data.insert(data.end(),sector_data.begin(),sector_data.end());
+        }
+    }
+
+    return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Turbo mode gets the same data, with the same number of DRQs, in far
+// fewer cycles.
+static void TestTurboRead() {
+    TestFDC normal(false);
+    std::vector<uint8_t> normal_data=ReadTracks(&normal);
+
+    TestFDC turbo(true);
+    std::vector<uint8_t> turbo_data=ReadTracks(&turbo);
+
+    TEST_EQ_UU(turbo_data.size(),normal_data.size());
+    TEST_EQ_AA(turbo_data.data(),normal_data.data(),normal_data.size());
+    TEST_EQ_UU(turbo.handler.num_read_sector_calls,normal.handler.num_read_sector_calls);
+
+    LOGF(OUTPUT,"Read %zu bytes: normal: %" PRIu64 " cycles; turbo: %" PRIu64 " cycles\n",
+         normal_data.size(),
+         normal.num_cycles,
+         turbo.num_cycles);
+
+    // The data still comes at the usual rate, so the saving is all in the
+    // seeks, settle delays and spin up - but that's most of the time.
+    TEST_LT_UU(turbo.num_cycles*3,normal.num_cycles);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+#if WD1770_ENABLE_WRITE
+
+// Supplies DRQ bytes from SRC until the command finishes or N bytes have
+// gone. Returns true if the command is waiting for byte N.
+static bool SupplyBytes(TestFDC *t,const uint8_t *src,size_t n) {
+    size_t num_supplied=0;
+    uint64_t num_command_cycles=0;
+
+    for(;;) {
+        TEST_LT_UU(num_command_cycles,MAX_NUM_COMMAND_CYCLES);
+        ++num_command_cycles;
+
+        WD1770::Pins pins=t->fdc.Update();
+        ++t->num_cycles;
+
+        if(pins.bits.intrq) {
+            return false;
+        }
+
+        if(pins.bits.drq) {
+            if(num_supplied==n) {
+                return true;
+            }
+
+            WD1770::Write3(&t->fdc,ADDR,src[num_supplied++]);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::vector<uint8_t> GetWriteData() {
+    std::vector<uint8_t> data(SECTOR_SIZE);
+
+    for(size_t i=0;i<data.size();++i) {
+        data[i]=(uint8_t)~i;
+    }
+
+    return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The sector goes to the handler in one go once the last byte arrives.
+static void TestWriteSector() {
+    const uint8_t TRACK=5,SECTOR=3;
+
+    TestFDC t(false);
+    Seek(&t,TRACK);
+
+    std::vector<uint8_t> old_data=t.handler.data;
+    std::vector<uint8_t> data=GetWriteData();
+
+    WD1770::Write2(&t.fdc,ADDR,SECTOR);
+    WD1770::Write0(&t.fdc,ADDR,0xa4);
+
+    // The byte before last is in, but not written.
+    TEST_TRUE(SupplyBytes(&t,data.data(),data.size()-1));
+    TEST_EQ_UU(t.handler.num_write_sector_calls,0);
+
+    TEST_FALSE(SupplyBytes(&t,&data.back(),1));
+    TEST_EQ_UU(t.handler.num_write_sector_calls,1);
+    TEST_EQ_UU(t.handler.last_write_sector_size,SECTOR_SIZE);
+
+    WD1770::Status status=GetStatus(&t);
+    TEST_FALSE(status.bits.rnf);
+    TEST_FALSE(status.bits.lost_or_track0);
+
+    // Only that sector changed.
+    size_t index=TestHandler::GetIndex(TRACK,SECTOR);
+    TEST_EQ_AA(t.handler.data.data(),old_data.data(),index);
+    TEST_EQ_AA(&t.handler.data[index],data.data(),SECTOR_SIZE);
+    TEST_EQ_AA(&t.handler.data[index+SECTOR_SIZE],&old_data[index+SECTOR_SIZE],old_data.size()-(index+SECTOR_SIZE));
+
+    std::vector<uint8_t> read_data=ReadSector(&t,SECTOR);
+    TEST_EQ_UU(read_data.size(),SECTOR_SIZE);
+    TEST_EQ_AA(read_data.data(),data.data(),SECTOR_SIZE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// A Force Interrupt part way through a Write Sector writes what's been
+// received so far, whenever it comes between one DRQ and the next.
+static void TestWriteSectorForceInterrupt() {
+    const uint8_t TRACK=0,SECTOR=7;
+    const size_t NUM_BYTES=100;
+
+    // 1 byte's worth of cycles, and then some - the next byte is then
+    // lost.
+    const uint64_t NUM_BYTE_CYCLES=64;
+
+    std::vector<uint8_t> data=GetWriteData();
+
+    for(uint64_t delay=0;delay<=NUM_BYTE_CYCLES;++delay) {
+        // Turbo skips the spin up, which would otherwise be most of
+        // the time.
+        TestFDC t(true);
+
+        std::vector<uint8_t> old_data=t.handler.data;
+
+        WD1770::Write2(&t.fdc,ADDR,SECTOR);
+        WD1770::Write0(&t.fdc,ADDR,0xa0);
+
+        TEST_TRUE(SupplyBytes(&t,data.data(),NUM_BYTES));
+        TEST_EQ_UU(t.handler.num_write_sector_calls,0);
+
+        for(uint64_t i=0;i<delay;++i) {
+            t.fdc.Update();
+        }
+
+        WD1770::Write0(&t.fdc,ADDR,0xd0);
+
+        TEST_EQ_UU(t.handler.num_write_sector_calls,1);
+        TEST_EQ_UU(t.handler.last_write_sector_size,NUM_BYTES);
+
+        size_t index=TestHandler::GetIndex(TRACK,SECTOR);
+        TEST_EQ_AA(&t.handler.data[index],data.data(),NUM_BYTES);
+        TEST_EQ_AA(&t.handler.data[index+NUM_BYTES],&old_data[index+NUM_BYTES],SECTOR_SIZE-NUM_BYTES);
+
+        WD1770::Status status=GetStatus(&t);
+        TEST_FALSE(status.bits.busy);
+    }
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestTurboRead();
+
+#if WD1770_ENABLE_WRITE
+    TestWriteSector();
+    TestWriteSectorForceInterrupt();
+#endif
+}
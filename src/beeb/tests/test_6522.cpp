@@ -2,6 +2,102 @@
 #include <shared/testing.h>
 #include <beeb/6522.h>
 
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void Tick(R6522 *via) {
+    via->UpdatePhi2TrailingEdge();
+    via->UpdatePhi2LeadingEdge();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Compares the register values, on copies, as some of the reads have side
+// effects.
+static void CheckSameRegisters(const R6522 &a_,const R6522 &b_) {
+    for(uint8_t reg=0;reg<16;++reg) {
+        R6522 a=a_,b=b_;
+        M6502Word addr={reg};
+
+        static uint8_t (*const READ_FNS[16])(void *,M6502Word)={
+            &R6522::Read0,&R6522::Read1,&R6522::Read2,&R6522::Read3,
+            &R6522::Read4,&R6522::Read5,&R6522::Read6,&R6522::Read7,
+            &R6522::Read8,&R6522::Read9,&R6522::ReadA,&R6522::ReadB,
+            &R6522::ReadC,&R6522::ReadD,&R6522::ReadE,&R6522::ReadF,
+        };
+
+        TEST_EQ_UU((*READ_FNS[reg])(&a,addr),(*READ_FNS[reg])(&b,addr));
+        TEST_EQ_UU(a.ifr.value,b.ifr.value);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Check SkipIdleTicks against ticking the VIA by hand, from each of the
+// next NUM_STEPS ticks' worth of states.
+static void TestSkipIdleTicks(R6522 via,int num_steps) {
+    for(int i=0;i<num_steps;++i) {
+        uint32_t n=via.GetNumIdleTicks();
+        if(n>100000) {
+            n=100000;
+        }
+
+        uint32_t ks[]={1,2,3,n/2,n-1,n};
+        for(uint32_t k:ks) {
+            if(k==0||k>n) {
+                continue;
+            }
+
+            R6522 ticked=via,skipped=via;
+
+            for(uint32_t j=0;j<k;++j) {
+                Tick(&ticked);
+            }
+
+            skipped.SkipIdleTicks(k);
+
+            CheckSameRegisters(ticked,skipped);
+
+            // Check any pending reload or timeout still happens at the
+            // same point.
+            for(int j=0;j<5;++j) {
+                Tick(&ticked);
+                Tick(&skipped);
+                CheckSameRegisters(ticked,skipped);
+            }
+        }
+
+        Tick(&via);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static R6522 GetVIA(uint8_t acr,uint16_t t1,uint16_t t2) {
+    R6522 via;
+    M6502Word addr={};
+
+    // Settle the control lines.
+    Tick(&via);
+    Tick(&via);
+
+    R6522::WriteB(&via,addr,acr);
+    R6522::Write4(&via,addr,(uint8_t)t1);
+    R6522::Write5(&via,addr,(uint8_t)(t1>>8));
+    R6522::Write8(&via,addr,(uint8_t)t2);
+    R6522::Write9(&via,addr,(uint8_t)(t2>>8));
+
+    Tick(&via);
+
+    return via;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 int main(void) {
     {
         R6522::PCR pcr;
@@ -23,4 +119,37 @@ int main(void) {
 
         TEST_TRUE(irq.bits.ca2);
     }
+
+    {
+        // Power-on state: T1 free running, T2 counting.
+        R6522 via;
+        Tick(&via);
+        Tick(&via);
+
+        TEST_GT_UU(via.GetNumIdleTicks(),0);
+        TestSkipIdleTicks(via,10);
+    }
+
+    // T1 continuous.
+    TestSkipIdleTicks(GetVIA(0x40,0x0010,0x0200),100);
+
+    // T1 one shot, then free running once it's timed out.
+    TestSkipIdleTicks(GetVIA(0x00,0x0003,0x0005),100);
+    TestSkipIdleTicks(GetVIA(0x00,0x0000,0x0000),100);
+
+    // T2 counting PB6 pulses - of which there are none.
+    TestSkipIdleTicks(GetVIA(0x20,0x00ff,0x0005),100);
+
+    {
+        // Port output changes aren't idle.
+        R6522 via=GetVIA(0x00,0x1000,0x1000);
+        M6502Word addr={};
+
+        R6522::Write2(&via,addr,0xff);
+        R6522::Write0(&via,addr,0x55);
+        TEST_EQ_UU(via.GetNumIdleTicks(),0);
+
+        Tick(&via);
+        TEST_GT_UU(via.GetNumIdleTicks(),0);
+    }
 }
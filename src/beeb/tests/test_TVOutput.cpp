@@ -0,0 +1,148 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include <beeb/TVOutput.h>
+#include <beeb/video.h>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Checks the dirty row tracking (see TVOutput::GetDirtyRows).
+//
+// Each scanline of the texture is two rows. Teletext can draw different
+// things on each, and the bitmap modes always draw the same thing on
+// both - so going from MODE 7 to a bitmap mode can leave the even rows
+// as they were while changing the odd ones.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Enough for the vertical retrace plus 280 scanlines, comfortably short
+// of the TV giving up and retracing by itself. The extra half a scanline
+// means the vsync comes during scanout, when the TV will notice it.
+static const size_t NUM_FIELD_UNITS=(12+280)*128+64;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static VideoDataUnit GetVSyncUnit() {
+    VideoDataUnit unit={};
+
+    unit.pixels.pixels[0].bits.x=VideoDataType_Bitmap16MHz;
+    unit.pixels.pixels[1].bits.x=VideoDataUnitFlag_VSync;
+
+    return unit;
+}
+
+// White on the first row of each scanline, black on the second.
+static VideoDataUnit GetTeletextUnit() {
+    VideoDataUnit unit={};
+
+    unit.pixels.pixels[0].bits.x=VideoDataType_Teletext;
+
+    unit.pixels.pixels[1].bits.r=15;
+    unit.pixels.pixels[1].bits.g=15;
+    unit.pixels.pixels[1].bits.b=15;
+
+    unit.pixels.pixels[2].all=0x3f;
+    unit.pixels.pixels[3].all=0;
+
+    return unit;
+}
+
+// White throughout.
+static VideoDataUnit GetBitmapUnit() {
+    VideoDataUnit unit={};
+
+    unit.pixels.pixels[0].bits.x=VideoDataType_Bitmap16MHz;
+
+    for(VideoDataPixel &pixel:unit.pixels.pixels) {
+        pixel.bits.r=15;
+        pixel.bits.g=15;
+        pixel.bits.b=15;
+    }
+
+    return unit;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Run a field's worth of UNIT, then vsync, so every scanline has been
+// checked for changes.
+static void UpdateField(TVOutput *tv,const VideoDataUnit &unit) {
+    std::vector<VideoDataUnit> units(NUM_FIELD_UNITS,unit);
+
+    units.push_back(GetVSyncUnit());
+    units.push_back(unit);
+
+    tv->Update(units.data(),units.size());
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::vector<uint32_t> GetTexturePixels(const TVOutput &tv) {
+    const uint32_t *pixels=tv.GetTexturePixels(nullptr);
+
+    return std::vector<uint32_t>(pixels,pixels+TV_TEXTURE_WIDTH*TV_TEXTURE_HEIGHT);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestTeletextToBitmap() {
+    TVOutput tv;
+    tv.Init(0,8,16);
+
+    // Get in sync.
+    UpdateField(&tv,VideoDataUnit{});
+    tv.ClearDirtyRows();
+
+    size_t begin_y,end_y;
+
+    UpdateField(&tv,GetTeletextUnit());
+    TEST_TRUE(tv.GetDirtyRows(&begin_y,&end_y));
+    TEST_LT_UU(begin_y,end_y);
+    TEST_EQ_UU(begin_y%2,0);
+    TEST_EQ_UU(end_y%2,0);
+    tv.ClearDirtyRows();
+
+    // The same again changes nothing.
+    UpdateField(&tv,GetTeletextUnit());
+    {
+        size_t same_begin_y,same_end_y;
+        TEST_FALSE(tv.GetDirtyRows(&same_begin_y,&same_end_y));
+    }
+
+    std::vector<uint32_t> teletext_pixels=GetTexturePixels(tv);
+
+    UpdateField(&tv,GetBitmapUnit());
+
+    std::vector<uint32_t> bitmap_pixels=GetTexturePixels(tv);
+
+    // Only the odd rows changed...
+    for(size_t y=begin_y;y<end_y;++y) {
+        const uint32_t *teletext_row=&teletext_pixels[y*TV_TEXTURE_WIDTH];
+        const uint32_t *bitmap_row=&bitmap_pixels[y*TV_TEXTURE_WIDTH];
+
+        if(y%2==0) {
+            TEST_EQ_AA(teletext_row,bitmap_row,TV_TEXTURE_WIDTH*sizeof(uint32_t));
+        } else {
+            TEST_NE_UU(teletext_row[0],bitmap_row[0]);
+        }
+    }
+
+    // ...but that's still every scanline.
+    size_t bitmap_begin_y,bitmap_end_y;
+    TEST_TRUE(tv.GetDirtyRows(&bitmap_begin_y,&bitmap_end_y));
+    TEST_EQ_UU(bitmap_begin_y,begin_y);
+    TEST_EQ_UU(bitmap_end_y,end_y);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestTeletextToBitmap();
+}
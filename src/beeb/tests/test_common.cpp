@@ -335,23 +335,28 @@ void TestBBCMicro::LoadFile(const std::string &path,uint16_t addr) {
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
-void TestBBCMicro::RunUntilOSWORD0(double max_num_seconds) {
+bool TestBBCMicro::IsAtOSWORD0() const {
     const uint8_t *ram=this->GetRAM();
     const M6502 *cpu=this->GetM6502();
 
+    return (M6502_IsAboutToExecute(cpu)&&
+            cpu->abus.b.l==ram[WORDV+0]&&
+            cpu->abus.b.h==ram[WORDV+1]&&
+            cpu->a==0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void TestBBCMicro::RunUntilOSWORD0(double max_num_seconds) {
     uint64_t max_num_cycles=(uint64_t)(max_num_seconds*2e6);
 
     uint64_t start_ticks=GetCurrentTickCount();
 
     uint64_t num_cycles=0;
     while(num_cycles<max_num_cycles) {
-        if(M6502_IsAboutToExecute(cpu)) {
-            if(cpu->abus.b.l==ram[WORDV+0]&&
-               cpu->abus.b.h==ram[WORDV+1]&&
-               cpu->a==0)
-            {
-                break;
-            }
+        if(this->IsAtOSWORD0()) {
+            break;
         }
 
         this->Update1();
@@ -520,7 +525,7 @@ void TestBBCMicro::LoadROMsB() {
 //////////////////////////////////////////////////////////////////////////
 
 void TestBBCMicro::LoadROMsBPlus() {
-    this->SetOSROM(LoadROM("B+MOS.ROM"));
+    this->SetOSROM(LoadROM("B+MOS.rom"));
     this->SetSidewaysROM(15,LoadROM("BASIC2.ROM"));
 }
 
@@ -795,6 +800,86 @@ void RunStandardTest(const std::string &beeblink_volume_path,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+static const char LOCKSTEP_TEST_PROGRAM[]=
+    "10MODE2\r"
+    "20FORI%=1TO50:GCOL0,I%MOD8:DRAWRND(1280),RND(1024):SOUND1,-15,I%,1:NEXT\r"
+    "30MODE7\r"
+    "40FORI%=1TO50:PRINTI%;\" \";SQR(I%);\" \";TIME:NEXT\r"
+    "RUN\r";
+
+static const uint64_t MAX_NUM_LOCKSTEP_CYCLES=100*1000*1000;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void PasteLockstepTestProgram(TestBBCMicro *bbc) {
+    bbc->RunUntilOSWORD0(10.0);
+    bbc->Paste(LOCKSTEP_TEST_PROGRAM);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+void TestLockstepOutputsEqual(const LockstepOutput &ref_output,const LockstepOutput &other_output) {
+    TEST_EQ_UU(ref_output.result,other_output.result);
+
+    // Compare member by member, as VideoDataUnit has padding.
+    TEST_EQ_AA(&ref_output.video_unit.pixels,&other_output.video_unit.pixels,sizeof ref_output.video_unit.pixels);
+#if VIDEO_TRACK_METADATA
+    TEST_EQ_UU(ref_output.video_unit.metadata.flags,other_output.video_unit.metadata.flags);
+    TEST_EQ_UU(ref_output.video_unit.metadata.value,other_output.video_unit.metadata.value);
+    TEST_EQ_UU(ref_output.video_unit.metadata.address,other_output.video_unit.metadata.address);
+#endif
+
+    if(ref_output.result&BBCMicroUpdateResultFlag_AudioUnit) {
+        TEST_EQ_AA(&ref_output.sound_unit,&other_output.sound_unit,sizeof ref_output.sound_unit);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+LockstepStats RunLockstepUntilOSWORD0(TestBBCMicro *ref,
+                                      TestBBCMicro *other,
+                                      const LockstepCycleFn &per_cycle_fn)
+{
+    LockstepOutput ref_output,other_output;
+    LockstepStats stats;
+
+    while(stats.num_cycles<MAX_NUM_LOCKSTEP_CYCLES) {
+        if(!ref->IsPasting()&&ref->IsAtOSWORD0()) {
+            break;
+        }
+
+        ref_output.video_unit=VideoDataUnit();
+        other_output.video_unit=VideoDataUnit();
+
+        ref_output.result=ref->Update(&ref_output.video_unit,&ref_output.sound_unit);
+        other_output.result=other->Update(&other_output.video_unit,&other_output.sound_unit);
+
+        if(per_cycle_fn) {
+            per_cycle_fn(ref_output,other_output);
+        } else {
+            TestLockstepOutputsEqual(ref_output,other_output);
+        }
+
+        if(M6502_IsAboutToExecute(ref->GetM6502())) {
+            ++stats.num_instructions;
+        }
+
+        ++stats.num_cycles;
+    }
+
+    TEST_LT_UU(stats.num_cycles,MAX_NUM_LOCKSTEP_CYCLES);
+    TEST_TRUE(other->IsAtOSWORD0());
+    TEST_EQ_AA(ref->GetRAM(),other->GetRAM(),32768);
+
+    return stats;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 void RunImageTest(const std::string &wanted_png_path,
                   const std::string &png_name,
                   TestBBCMicro *beeb)
@@ -14,7 +14,9 @@
 
 #include <beeb/BBCMicro.h>
 #include <beeb/sound.h>
+#include <beeb/video.h>
 #include <string>
+#include <functional>
 
 #include <shared/enum_decl.h>
 #include "test_common.inl"
@@ -39,6 +41,10 @@ public:
 
     void LoadFile(const std::string &path,uint16_t addr);
 
+    // true if the CPU is about to call OSWORD 0 - i.e., BASIC is waiting
+    // at the prompt.
+    bool IsAtOSWORD0() const;
+
     void RunUntilOSWORD0(double max_num_seconds);
 
     // return value is video output.
@@ -137,6 +143,48 @@ void RunImageTest(const std::string &wanted_png_path,
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+// Lockstep tests run a reference TestBBCMicro alongside an otherwise
+// identical one with some feature turned on, a cycle at a time, to check
+// the feature makes no difference to the emulation.
+//
+// Put both at the BASIC prompt with the program pasted in using
+// PasteLockstepTestProgram, turn the feature on, then call
+// RunLockstepUntilOSWORD0.
+
+struct LockstepOutput {
+    uint32_t result=0;//combination of BBCMicroUpdateResultFlag
+    VideoDataUnit video_unit;
+    SoundDataUnit sound_unit;
+};
+
+struct LockstepStats {
+    uint64_t num_cycles=0;
+    uint64_t num_instructions=0;
+};
+
+// Called after each cycle.
+typedef std::function<void(const LockstepOutput &ref_output,const LockstepOutput &other_output)> LockstepCycleFn;
+
+// Gets BBC to the BASIC prompt and pastes in the test program: some
+// MODE 2 graphics and sound, then some MODE 7 text. The program is then
+// running.
+void PasteLockstepTestProgram(TestBBCMicro *bbc);
+
+// Checks that the outputs are identical. This is the default
+// LockstepCycleFn.
+void TestLockstepOutputsEqual(const LockstepOutput &ref_output,const LockstepOutput &other_output);
+
+// Updates REF and OTHER a cycle at a time, calling PER_CYCLE_FN (or
+// TestLockstepOutputsEqual, if null) after each one, until REF is back at
+// the BASIC prompt. OTHER must then be at the prompt too, with the same
+// RAM contents.
+LockstepStats RunLockstepUntilOSWORD0(TestBBCMicro *ref,
+                                      TestBBCMicro *other,
+                                      const LockstepCycleFn &per_cycle_fn=nullptr);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
 bool SaveFileInternal(const void *contents,
                       size_t contents_size,
                       const std::string &path,
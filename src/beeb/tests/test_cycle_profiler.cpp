@@ -0,0 +1,94 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include "test_common.h"
+#include <beeb/CycleProfiler.h>
+#include <inttypes.h>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Checks that cycle profiling (see BBCMicro::SetCycleProfiling) makes no
+// difference to the emulation, and that the counts add up.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static CycleProfilerCounts GetTotalCounts(const std::vector<CycleProfilerCounts> &counts,
+                                          uint8_t begin_big_page,
+                                          uint8_t end_big_page)
+{
+    CycleProfilerCounts total;
+
+    for(size_t i=begin_big_page*CycleProfiler::NUM_BIG_PAGE_COUNTS;i<end_big_page*CycleProfiler::NUM_BIG_PAGE_COUNTS;++i) {
+        total.num_cycles+=counts[i].num_cycles;
+        total.num_instructions+=counts[i].num_instructions;
+    }
+
+    return total;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestCycleProfiler(TestBBCMicroType type) {
+    TestBBCMicro ref(type),prof(type);
+
+    PasteLockstepTestProgram(&ref);
+    PasteLockstepTestProgram(&prof);
+
+    prof.SetCycleProfiling(true);
+    TEST_TRUE(prof.IsCycleProfiling());
+
+    LockstepStats stats=RunLockstepUntilOSWORD0(&ref,&prof);
+
+    const CycleProfiler *profiler=prof.GetCycleProfiler();
+    TEST_NON_NULL(profiler);
+
+    const std::vector<CycleProfilerCounts> &counts=profiler->GetCounts();
+    TEST_EQ_UU(counts.size(),NUM_BIG_PAGES*CycleProfiler::NUM_BIG_PAGE_COUNTS);
+
+    // If the last access was stretched, its cycles aren't counted yet.
+    TEST_LE_UU(profiler->GetNumCycles(),stats.num_cycles);
+    TEST_GE_UU(profiler->GetNumCycles()+3,stats.num_cycles);
+    TEST_EQ_UU(profiler->GetNumInstructions(),stats.num_instructions);
+
+    CycleProfilerCounts total=GetTotalCounts(counts,0,NUM_BIG_PAGES);
+    TEST_EQ_UU(total.num_cycles,profiler->GetNumCycles());
+    TEST_EQ_UU(total.num_instructions,profiler->GetNumInstructions());
+
+    // BASIC and the MOS both get some time.
+    CycleProfilerCounts rom=GetTotalCounts(counts,ROM0_BIG_PAGE_INDEX,MOS_BIG_PAGE_INDEX);
+    TEST_GT_UU(rom.num_cycles,0);
+    TEST_GT_UU(rom.num_instructions,0);
+
+    CycleProfilerCounts mos=GetTotalCounts(counts,MOS_BIG_PAGE_INDEX,MOS_BIG_PAGE_INDEX+NUM_MOS_BIG_PAGES);
+    TEST_GT_UU(mos.num_cycles,0);
+    TEST_GT_UU(mos.num_instructions,0);
+
+    // Every instruction takes at least 2 cycles.
+    TEST_GE_UU(total.num_cycles,2*total.num_instructions);
+
+    std::string callgrind=GetCycleProfileCallgrind(counts,prof.GetType());
+    TEST_TRUE(callgrind.compare(0,18,"# callgrind format")==0);
+    TEST_NE_UU(callgrind.find("\nfl=MOS ROM\n"),std::string::npos);
+
+    printf("%s: %" PRIu64 " cycles, %" PRIu64 " instructions; ROM %.2f%%, MOS %.2f%%\n",
+           GetTestBBCMicroTypeEnumName(type),
+           total.num_cycles,
+           total.num_instructions,
+           100.*rom.num_cycles/total.num_cycles,
+           100.*mos.num_cycles/total.num_cycles);
+
+    prof.SetCycleProfiling(false);
+    TEST_FALSE(prof.IsCycleProfiling());
+    TEST_NULL(prof.GetCycleProfiler());
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestCycleProfiler(TestBBCMicroType_BTape);
+    TestCycleProfiler(TestBBCMicroType_Master128MOS320);
+}
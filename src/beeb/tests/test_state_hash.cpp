@@ -0,0 +1,172 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include <shared/sha1.h>
+#include "test_common.h"
+#include <beeb/DiscImage.h>
+#include <memory>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Checks that BBCMicro::UpdateHash gives the same result for the same
+// state, however it was arrived at, and a different one otherwise.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// A disc image that's just a hash.
+class TestDiscImage:
+    public DiscImage
+{
+public:
+    explicit TestDiscImage(std::string hash):
+        m_hash(std::move(hash))
+    {
+    }
+
+    std::shared_ptr<DiscImage> Clone() const override {
+        return nullptr;
+    }
+
+    std::string GetHash() const override {
+        return m_hash;
+    }
+
+    std::string GetName() const override {
+        return "test";
+    }
+
+    std::string GetLoadMethod() const override {
+        return "test";
+    }
+
+    std::string GetDescription() const override {
+        return "test";
+    }
+
+    const char *GetFileExtension() const override {
+        return nullptr;
+    }
+
+    bool SaveToFile(const std::string &file_name,Messages *msg) const override {
+        (void)file_name,(void)msg;
+
+        return false;
+    }
+
+    bool Read(uint8_t *value,uint8_t side,uint8_t track,uint8_t sector,size_t offset) const override {
+        (void)side,(void)track,(void)sector,(void)offset;
+
+        *value=0;
+        return true;
+    }
+
+    bool Write(uint8_t side,uint8_t track,uint8_t sector,size_t offset,uint8_t value) override {
+        (void)side,(void)track,(void)sector,(void)offset,(void)value;
+
+        return false;
+    }
+
+    bool GetDiscSectorSize(size_t *size,uint8_t side,uint8_t track,uint8_t sector,bool double_density) const override {
+        (void)side,(void)track,(void)sector,(void)double_density;
+
+        *size=256;
+        return true;
+    }
+
+    bool IsWriteProtected() const override {
+        return true;
+    }
+protected:
+private:
+    std::string m_hash;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static std::string GetHash(const BBCMicro *beeb) {
+    SHA1 hasher;
+    TEST_TRUE(beeb->UpdateHash(&hasher));
+
+    char digest_str[SHA1::DIGEST_STR_SIZE];
+    hasher.Finish(nullptr,digest_str);
+
+    return digest_str;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestStateHash(TestBBCMicroType type) {
+    TestBBCMicro a(type),b(type);
+
+    a.RunUntilOSWORD0(10.0);
+    b.RunUntilOSWORD0(10.0);
+
+    // Separately constructed, but in the same state.
+    TEST_EQ_SS(GetHash(&a),GetHash(&b));
+
+    std::unique_ptr<BBCMicro> clone=a.Clone();
+    TEST_NON_NULL(clone.get());
+    TEST_EQ_SS(GetHash(&a),GetHash(clone.get()));
+
+    // Same program, different colours. The programs are the same length,
+    // and just set things up then wait for a key.
+    a.Paste("MODE2:VDU19,0,1;0;:A=GET\r");
+    b.Paste("MODE2:VDU19,0,4;0;:A=GET\r");
+
+    while(a.IsPasting()||b.IsPasting()) {
+        a.Update1();
+        b.Update1();
+    }
+
+    // Give the VDU code plenty of time to finish.
+    for(int i=0;i<4000000;++i) {
+        a.Update1();
+        b.Update1();
+    }
+
+    TEST_EQ_UU(*a.GetNum2MHzCycles(),*b.GetNum2MHzCycles());
+    TEST_TRUE(GetHash(&a)!=GetHash(&b));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// The disc contents go in, by way of the disc image's hash.
+static void TestDiscHash() {
+    TestBBCMicro a(TestBBCMicroType_Master128MOS320),b(TestBBCMicroType_Master128MOS320);
+
+    TEST_EQ_SS(GetHash(&a),GetHash(&b));
+
+    a.SetDiscImage(0,std::make_shared<TestDiscImage>("1"));
+    TEST_TRUE(GetHash(&a)!=GetHash(&b));
+
+    b.SetDiscImage(0,std::make_shared<TestDiscImage>("2"));
+    TEST_TRUE(GetHash(&a)!=GetHash(&b));
+
+    b.SetDiscImage(0,std::make_shared<TestDiscImage>("1"));
+    TEST_EQ_SS(GetHash(&a),GetHash(&b));
+
+    // Same disc, different drive.
+    b.SetDiscImage(0,nullptr);
+    b.SetDiscImage(1,std::make_shared<TestDiscImage>("1"));
+    TEST_TRUE(GetHash(&a)!=GetHash(&b));
+
+    // No hash means no hash.
+    a.SetDiscImage(1,std::make_shared<TestDiscImage>(""));
+
+    SHA1 hasher;
+    TEST_FALSE(a.UpdateHash(&hasher));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestStateHash(TestBBCMicroType_BTape);
+    TestStateHash(TestBBCMicroType_Master128MOS320);
+    TestDiscHash();
+}
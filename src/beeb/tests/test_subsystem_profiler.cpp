@@ -0,0 +1,128 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include "test_common.h"
+#include <beeb/SubsystemProfiler.h>
+#include <inttypes.h>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Checks that profiling (see BBCMicro::SetProfiling) makes no difference
+// to the emulation, and that the counts add up.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Keeps the hacks handler active for the first few instructions, so
+// the hooks get some calls.
+static const uint64_t NUM_HOOKED_INSTRUCTIONS=100000;
+
+static bool CountInstruction(const BBCMicro *m,const M6502 *cpu,void *context) {
+    (void)m,(void)cpu;
+
+    auto num_instructions=(uint64_t *)context;
+
+    ++*num_instructions;
+    return *num_instructions<NUM_HOOKED_INSTRUCTIONS;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestProfiler(TestBBCMicroType type) {
+    TestBBCMicro ref(type),prof(type);
+
+    PasteLockstepTestProgram(&ref);
+    PasteLockstepTestProgram(&prof);
+
+    uint64_t num_hooked_instructions=0;
+    prof.AddInstructionFn(&CountInstruction,&num_hooked_instructions);
+
+    prof.SetProfiling(true);
+    TEST_TRUE(prof.IsProfiling());
+
+    LockstepStats stats=RunLockstepUntilOSWORD0(&ref,&prof);
+    uint64_t num_cycles=stats.num_cycles;
+
+    const SubsystemProfiler *profiler=prof.GetProfiler();
+    TEST_NON_NULL(profiler);
+
+    const SubsystemProfile &profile=profiler->GetProfile();
+    TEST_EQ_UU(profile.num_cycles,num_cycles);
+    TEST_GT_UU(profile.num_sampled_cycles,0);
+
+    TEST_EQ_UU(profile.subsystems[BBCMicroSubsystem_CPU].num_calls,num_cycles);
+    TEST_LE_UU(profile.subsystems[BBCMicroSubsystem_1770].num_calls-num_cycles/2,1);
+    TEST_LE_UU(profile.subsystems[BBCMicroSubsystem_SN76489].num_calls-num_cycles/8,1);
+    TEST_GT_UU(profile.subsystems[BBCMicroSubsystem_MMIO].num_calls,0);
+    TEST_EQ_UU(num_hooked_instructions,NUM_HOOKED_INSTRUCTIONS);
+    TEST_GT_UU(profile.subsystems[BBCMicroSubsystem_Hooks].num_calls,NUM_HOOKED_INSTRUCTIONS);
+
+    if(type==TestBBCMicroType_Master128MOS320) {
+        TEST_GT_UU(profile.subsystems[BBCMicroSubsystem_RTC].num_calls,0);
+    } else {
+        TEST_EQ_UU(profile.subsystems[BBCMicroSubsystem_RTC].num_calls,0);
+    }
+
+    // The MOS IRQ handler reads the system VIA's IFR.
+    TEST_GT_UU(profile.mmio[0xfe4d-0xfc00].num_calls,0);
+
+    uint64_t num_mmio_calls=0;
+    for(const SubsystemProfilerCounts &counts:profile.mmio) {
+        num_mmio_calls+=counts.num_calls;
+    }
+    TEST_EQ_UU(num_mmio_calls,profile.subsystems[BBCMicroSubsystem_MMIO].num_calls);
+
+    uint64_t num_executions=0;
+    for(uint64_t n:profile.num_executions) {
+        num_executions+=n;
+    }
+    TEST_EQ_UU(num_executions,stats.num_instructions);
+
+    std::vector<SubsystemProfilerEvent> events;
+    profiler->GetEvents(&events);
+    TEST_EQ_UU(events.size(),SubsystemProfiler::MAX_NUM_EVENTS);
+    for(size_t i=1;i<events.size();++i) {
+        TEST_GE_UU(events[i].cycle,events[i-1].cycle);
+    }
+
+    std::string json=GetSubsystemProfileJSON(profile);
+    TEST_FALSE(json.empty());
+    TEST_TRUE(json[0]=='{');
+
+    std::string trace=GetSubsystemProfilerEventsChromeTrace(events);
+    TEST_FALSE(trace.empty());
+    TEST_TRUE(trace[0]=='{');
+
+    double total_ticks=0.;
+    for(const SubsystemProfilerCounts &counts:profile.subsystems) {
+        total_ticks+=counts.GetEstimatedTicks();
+    }
+
+    printf("%s: %" PRIu64 " cycles, %" PRIu64 " sampled; overhead %" PRIu64 " ticks\n",
+           GetTestBBCMicroTypeEnumName(type),
+           profile.num_cycles,
+           profile.num_sampled_cycles,
+           profile.overhead_ticks);
+    for(int i=0;i<BBCMicroSubsystem_Count;++i) {
+        const SubsystemProfilerCounts &counts=profile.subsystems[i];
+
+        printf("    %-16s %12" PRIu64 " calls %6.2f%%\n",
+               GetBBCMicroSubsystemEnumName(i),
+               counts.num_calls,
+               total_ticks>0.?100.*counts.GetEstimatedTicks()/total_ticks:0.);
+    }
+
+    prof.SetProfiling(false);
+    TEST_FALSE(prof.IsProfiling());
+    TEST_NULL(prof.GetProfiler());
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestProfiler(TestBBCMicroType_BTape);
+    TestProfiler(TestBBCMicroType_Master128MOS320);
+}
@@ -0,0 +1,92 @@
+#include <shared/system.h>
+#include <shared/testing.h>
+#include "test_common.h"
+#include <inttypes.h>
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+// Checks that turning video output off (see BBCMicro::SetVideoEnabled)
+// makes no difference to the emulated state.
+//
+// One BBCMicro runs with video off, apart from the preview fields, then
+// with video back on, alongside one that has video on throughout. The
+// preview fields, and everything after video goes back on, must match
+// exactly. The second part is in MODE 7 with double height text, so the
+// SAA5050 has some state that lasts from one line to the next.
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static const uint32_t PREVIEW_INTERVAL=4;
+
+static const char DOUBLE_HEIGHT_PROGRAM[]=
+    "10FORI%=1TO10:PRINTCHR$141;CHR$(129+I%MOD7);\"DOUBLE \";I%\r"
+    "20PRINTCHR$141;CHR$(129+I%MOD7);\"DOUBLE \";I%:FORJ%=1TO200:NEXT:NEXT\r"
+    "RUN\r";
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+static void TestVideoOff(TestBBCMicroType type) {
+    TestBBCMicro ref(type),off(type);
+
+    PasteLockstepTestProgram(&ref);
+    PasteLockstepTestProgram(&off);
+
+    off.SetVideoEnabled(false,PREVIEW_INTERVAL);
+    TEST_FALSE(off.IsVideoEnabled());
+
+    uint64_t num_preview_units=0,num_skipped_units=0,num_vsyncs=0;
+    LockstepStats off_stats=RunLockstepUntilOSWORD0(&ref,&off,[&num_preview_units,&num_skipped_units,&num_vsyncs](const LockstepOutput &ref_output,const LockstepOutput &off_output) {
+        TEST_TRUE(ref_output.result&BBCMicroUpdateResultFlag_VideoUnit);
+
+        // Vsyncs are reported whether there's video or not.
+        TEST_EQ_UU(off_output.result&BBCMicroUpdateResultFlag_VSync,ref_output.result&BBCMicroUpdateResultFlag_VSync);
+        if(ref_output.result&BBCMicroUpdateResultFlag_VSync) {
+            ++num_vsyncs;
+        }
+
+        if(off_output.result&BBCMicroUpdateResultFlag_VideoUnit) {
+            TestLockstepOutputsEqual(ref_output,off_output);
+            ++num_preview_units;
+        } else {
+            TEST_EQ_UU(off_output.result,ref_output.result&~(uint32_t)BBCMicroUpdateResultFlag_VideoUnit);
+            if(ref_output.result&BBCMicroUpdateResultFlag_AudioUnit) {
+                TEST_EQ_AA(&ref_output.sound_unit,&off_output.sound_unit,sizeof ref_output.sound_unit);
+            }
+            ++num_skipped_units;
+        }
+    });
+
+    // Roughly 1 field in PREVIEW_INTERVAL was produced.
+    TEST_GT_UU(num_preview_units,0);
+    TEST_GT_UU(num_skipped_units,(PREVIEW_INTERVAL-2)*num_preview_units);
+    TEST_LT_UU(num_skipped_units,PREVIEW_INTERVAL*num_preview_units);
+
+    // 50 Hz, give or take the mode changes.
+    TEST_GE_UU(num_vsyncs+2,off_stats.num_cycles/40000);
+    TEST_LE_UU(num_vsyncs,off_stats.num_cycles/40000+2);
+
+    off.SetVideoEnabled(true,0);
+    TEST_TRUE(off.IsVideoEnabled());
+
+    ref.Paste(DOUBLE_HEIGHT_PROGRAM);
+    off.Paste(DOUBLE_HEIGHT_PROGRAM);
+
+    LockstepStats stats=RunLockstepUntilOSWORD0(&ref,&off);
+
+    printf("%s: %" PRIu64 " preview units, %" PRIu64 " skipped units; %" PRIu64 " cycles with video back on\n",
+           GetTestBBCMicroTypeEnumName(type),
+           num_preview_units,
+           num_skipped_units,
+           stats.num_cycles);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+int main() {
+    TestVideoOff(TestBBCMicroType_BTape);
+    TestVideoOff(TestBBCMicroType_Master128MOS320);
+}